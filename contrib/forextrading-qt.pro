@@ -62,16 +62,19 @@ HEADERS += src/activemasternode.h \
            src/allocators.h \
            src/amount.h \
            src/base58.h \
+           src/blockfilereader.h \
            src/bloom.h \
            src/chain.h \
            src/chainparams.h \
            src/chainparamsbase.h \
            src/chainparamsseeds.h \
+           src/chaintip.h \
            src/checkpoints.h \
            src/checkqueue.h \
            src/clientversion.h \
            src/coincontrol.h \
            src/coins.h \
+           src/coinstats.h \
            src/compat.h \
            src/compressor.h \
            src/core_io.h \
@@ -90,9 +93,12 @@ HEADERS += src/activemasternode.h \
            src/keystore.h \
            src/leveldbwrapper.h \
            src/limitedmap.h \
+           src/logwriter.h \
            src/main.h \
            src/masternode-budget.h \
+           src/masternode-collateral.h \
            src/masternode-payments.h \
+           src/masternode-sigverify.h \
            src/masternode-sync.h \
            src/masternode.h \
            src/masternodeconfig.h \
@@ -104,6 +110,7 @@ HEADERS += src/activemasternode.h \
            src/netbase.h \
            src/noui.h \
            src/pow.h \
+           src/prevector.h \
            src/protocol.h \
            src/pubkey.h \
            src/random.h \
@@ -126,6 +133,7 @@ HEADERS += src/activemasternode.h \
            src/utilmoneystr.h \
            src/utilstrencodings.h \
            src/utiltime.h \
+           src/utxosnapshot.h \
            src/version.h \
            src/wallet.h \
            src/wallet_ismine.h \
@@ -360,13 +368,16 @@ SOURCES += src/activemasternode.cpp \
            src/allocators.cpp \
            src/amount.cpp \
            src/base58.cpp \
+           src/blockfilereader.cpp \
            src/bloom.cpp \
            src/chain.cpp \
            src/chainparams.cpp \
            src/chainparamsbase.cpp \
+           src/chaintip.cpp \
            src/checkpoints.cpp \
            src/clientversion.cpp \
            src/coins.cpp \
+           src/coinstats.cpp \
            src/compressor.cpp \
            src/core_read.cpp \
            src/core_write.cpp \
@@ -387,9 +398,12 @@ SOURCES += src/activemasternode.cpp \
            src/key.cpp \
            src/keystore.cpp \
            src/leveldbwrapper.cpp \
+           src/logwriter.cpp \
            src/main.cpp \
            src/masternode-budget.cpp \
+           src/masternode-collateral.cpp \
            src/masternode-payments.cpp \
+           src/masternode-sigverify.cpp \
            src/masternode-sync.cpp \
            src/masternode.cpp \
            src/masternodeconfig.cpp \
@@ -426,6 +440,7 @@ SOURCES += src/activemasternode.cpp \
            src/utilmoneystr.cpp \
            src/utilstrencodings.cpp \
            src/utiltime.cpp \
+           src/utxosnapshot.cpp \
            src/wallet.cpp \
            src/wallet_ismine.cpp \
            src/walletdb.cpp \
@@ -10,6 +10,7 @@
 from test_framework import BitcoinTestFramework
 from util import *
 import base64
+import json
 
 try:
     import http.client as httplib
@@ -97,6 +98,57 @@ class HTTPBasicsTest (BitcoinTestFramework):
         out1 = conn.getresponse().read();
         assert_equal('"error":null' in out1, True)
         assert_equal(conn.sock!=None, True) #connection must be closed because bitcoind should use keep-alive by default
-        
+
+        ###########################################
+        # replies larger than one chunk (64 KiB)  #
+        ###########################################
+        # REST: 200 headers are sent chunked and still form one valid document
+        url = urlparse.urlparse(self.nodes[0].url)
+        hash1 = self.nodes[0].getblockhash(1)
+        conn = httplib.HTTPConnection(url.hostname, url.port)
+        conn.request('GET', '/rest/headers/200/'+hash1+'.json')
+        response = conn.getresponse()
+        assert_equal(response.status, 200)
+        assert_equal(response.getheader('transfer-encoding'), 'chunked')
+        headers_json = json.loads(response.read())
+        assert_equal(len(headers_json), 200)
+        assert_equal(headers_json[0]['hash'], hash1)
+        conn.close()
+
+        # a small reply from the same writer is not chunked
+        conn = httplib.HTTPConnection(url.hostname, url.port)
+        conn.request('GET', '/rest/headers/1/'+hash1+'.json')
+        response = conn.getresponse()
+        assert_equal(response.status, 200)
+        assert_equal(response.getheader('transfer-encoding'), None)
+        assert_equal(len(json.loads(response.read())), 1)
+        conn.close()
+
+        # JSON-RPC: a verbose mempool of a few hundred transactions is streamed
+        address = self.nodes[1].getnewaddress()
+        txids = [ self.nodes[0].sendtoaddress(address, 1) for i in range(300) ]
+        authpair = url.username + ':' + url.password
+        headers = {"Authorization": "Basic " + base64.b64encode(authpair)}
+        conn = httplib.HTTPConnection(url.hostname, url.port)
+        conn.request('POST', '/', '{"method": "getrawmempool", "params": [true], "id": 1}', headers)
+        response = conn.getresponse()
+        assert_equal(response.status, 200)
+        assert_equal(response.getheader('transfer-encoding'), 'chunked')
+        reply = json.loads(response.read())
+        assert_equal(reply['error'], None)
+        assert_equal(reply['id'], 1)
+        assert_equal(sorted(reply['result'].keys()), sorted(txids))
+        conn.close()
+
+        # a client that hangs up in the middle of a chunked reply doesn't take the server down
+        for i in range(5):
+            conn = httplib.HTTPConnection(url.hostname, url.port)
+            conn.request('POST', '/', '{"method": "getrawmempool", "params": [true], "id": 1}', headers)
+            response = conn.getresponse()
+            response.read(1024)
+            conn.sock.close()
+            conn.close()
+        assert_equal(len(self.nodes[0].getrawmempool()), 300)
+
 if __name__ == '__main__':
     HTTPBasicsTest ().main ()
@@ -9,7 +9,9 @@
 
 from test_framework import BitcoinTestFramework
 from util import *
+import binascii
 import json
+import struct
 
 try:
     import http.client as httplib
@@ -29,6 +31,37 @@ def http_get_call(host, port, path, response_object = 0):
         
     return conn.getresponse().read()
 
+def http_post_call(host, port, path, requestdata = '', response_object = 0):
+    conn = httplib.HTTPConnection(host, port)
+    conn.request('POST', path, requestdata)
+
+    if response_object:
+        return conn.getresponse()
+
+    return conn.getresponse().read()
+
+def ser_compact_size(n):
+    if n < 253:
+        return struct.pack("<B", n)
+    if n < 0x10000:
+        return struct.pack("<BH", 253, n)
+    return struct.pack("<BI", 254, n)
+
+def deser_compact_size(data, pos):
+    n = struct.unpack("<B", data[pos:pos+1])[0]
+    if n == 253:
+        return struct.unpack("<H", data[pos+1:pos+3])[0], pos + 3
+    if n == 254:
+        return struct.unpack("<I", data[pos+1:pos+5])[0], pos + 5
+    return n, pos + 1
+
+# the getutxos request body: checkmempool flag and the outpoints
+def getutxos_request_hex(check_mempool, outpoints):
+    data = struct.pack("<?", check_mempool) + ser_compact_size(len(outpoints))
+    for (txid, n) in outpoints:
+        data += binascii.unhexlify(txid)[::-1] + struct.pack("<I", n)
+    return binascii.hexlify(data)
+
 
 class RESTTest (BitcoinTestFramework):
     FORMAT_SEPARATOR = "."
@@ -82,8 +115,52 @@ class RESTTest (BitcoinTestFramework):
         json_obj = json.loads(json_string)
         for tx in txs:
             assert_equal(tx in json_obj['tx'], True)
-                
-        
+
+        # getutxos answers up to 10000 outpoints at once, looked up outside cs_main
+        utxo = self.nodes[0].listunspent()[0]
+        outpoints = [(utxo['txid'], utxo['vout'])]
+        for i in range(9999):
+            outpoints.append(("%064x" % (i + 1), 0))
+        response = http_post_call(url.hostname, url.port, '/rest/getutxos'+self.FORMAT_SEPARATOR+'hex', getutxos_request_hex(False, outpoints), True)
+        assert_equal(response.status, 200)
+        data = binascii.unhexlify(response.read().strip())
+        assert_equal(struct.unpack("<i", data[0:4])[0], self.nodes[0].getblockcount())
+        assert_equal(binascii.hexlify(data[4:36][::-1]), self.nodes[0].getbestblockhash())
+        bitmap_size, pos = deser_compact_size(data, 36)
+        assert_equal(bitmap_size, 1250)
+        bitmap = bytearray(data[pos:pos+bitmap_size])
+        assert_equal(bitmap[0], 1)
+        assert_equal(sum(bitmap), 1)
+        outs_size, pos = deser_compact_size(data, pos + bitmap_size)
+        assert_equal(outs_size, 1)
+
+        outpoints.append(("%064x" % 10000, 0))
+        response = http_post_call(url.hostname, url.port, '/rest/getutxos'+self.FORMAT_SEPARATOR+'hex', getutxos_request_hex(False, outpoints), True)
+        assert_equal(response.status, 500)
+
+        # blockhashbyheight, one hash or a range cut off at the tip
+        json_string = http_get_call(url.hostname, url.port, '/rest/blockhashbyheight/0'+self.FORMAT_SEPARATOR+'json')
+        assert_equal(json.loads(json_string)['blockhash'], self.nodes[0].getblockhash(0))
+
+        json_string = http_get_call(url.hostname, url.port, '/rest/blockhashbyheight/1/5'+self.FORMAT_SEPARATOR+'json')
+        assert_equal(json.loads(json_string), [self.nodes[0].getblockhash(i) for i in range(1, 6)])
+
+        height = self.nodes[0].getblockcount()
+        hex_string = http_get_call(url.hostname, url.port, '/rest/blockhashbyheight/'+str(height - 1)+'/10'+self.FORMAT_SEPARATOR+'hex')
+        assert_equal(hex_string.split(), [self.nodes[0].getblockhash(height - 1), self.nodes[0].getblockhash(height)])
+
+        response = http_get_call(url.hostname, url.port, '/rest/blockhashbyheight/2/3'+self.FORMAT_SEPARATOR+'bin', True)
+        assert_equal(response.status, 200)
+        bin_string = response.read()
+        assert_equal(len(bin_string), 3 * 32)
+        assert_equal(binascii.hexlify(bin_string[32:64][::-1]), self.nodes[0].getblockhash(3))
+
+        response = http_get_call(url.hostname, url.port, '/rest/blockhashbyheight/'+str(height + 1)+self.FORMAT_SEPARATOR+'json', True)
+        assert_equal(response.status, 404)
+        for path in ['abc', '-1', '1/0', '1/100001', '1/2/3']:
+            response = http_get_call(url.hostname, url.port, '/rest/blockhashbyheight/'+path+self.FORMAT_SEPARATOR+'json', True)
+            assert_equal(response.status, 400)
+
 
 if __name__ == '__main__':
     RESTTest ().main ()
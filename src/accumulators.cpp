@@ -5,6 +5,7 @@
 
 #include "accumulators.h"
 #include "accumulatormap.h"
+#include "accumulatorworker.h"
 #include "chainparams.h"
 #include "main.h"
 #include "txdb.h"
@@ -243,6 +244,16 @@ bool CalculateAccumulatorCheckpoint(int nHeight, uint256& nCheckpoint, Accumulat
 		return true;
 	}
 
+	//use the value computed in the background since the previous checkpoint block connected
+	AccumulatorCheckpoints::Checkpoint values;
+	CBlockIndex* pindexBase = chainActive[nHeight - 10];
+	if (pindexBase && accumulatorWorker.Get(pindexBase->GetBlockHash(), nCheckpoint, values)) {
+		mapAccumulators.Reset(Params().Zerocoin_Params(false));
+		mapAccumulators.Load(values);
+		LogPrint("zero", "%s checkpoint=%s (precomputed)\n", __func__, nCheckpoint.GetHex());
+		return true;
+	}
+
 	//set the accumulators to last checkpoint value
 	int nHeightCheckpoint;
 	mapAccumulators.Reset();
@@ -347,43 +358,133 @@ void RandomizeSecurityLevel(int& nSecurityLevel)
 	}
 }
 
+/**
+ * Mint counts per denomination from the zerocoin start height, summed every
+ * MINT_COUNT_INTERVAL blocks of the active chain. Each sum remembers the last
+ * block it covers, so sums disconnected by a reorg are dropped and recounted.
+ */
+static const int MINT_COUNT_INTERVAL = 1000;
+
+struct CMintCountSum {
+	uint256 hashBlock;
+	std::map<CoinDenomination, int> mapCount;
+};
+
+static std::vector<CMintCountSum> vMintCountSums;
+
 //Compute how many coins were added to an accumulator up to the end height
 int ComputeAccumulatedCoins(int nHeightEnd, libzerocoin::CoinDenomination denom)
 {
-	CBlockIndex* pindex = chainActive[GetZerocoinStartHeight()];
+	AssertLockHeld(cs_main);
+	int nHeightStart = GetZerocoinStartHeight();
+	nHeightEnd = std::min(nHeightEnd, chainActive.Height() + 1);
+	if (nHeightEnd <= nHeightStart)
+		return 0;
+
+	//drop the sums that are no longer in the active chain
+	while (!vMintCountSums.empty()) {
+		int nHeightLast = nHeightStart + (int)vMintCountSums.size() * MINT_COUNT_INTERVAL - 1;
+		if (nHeightLast <= chainActive.Height() && chainActive[nHeightLast]->GetBlockHash() == vMintCountSums.back().hashBlock)
+			break;
+		vMintCountSums.pop_back();
+	}
+
+	//extend the sums up to the end height
+	int nIntervals = (nHeightEnd - nHeightStart) / MINT_COUNT_INTERVAL;
+	while ((int)vMintCountSums.size() < nIntervals) {
+		CMintCountSum sum;
+		if (!vMintCountSums.empty())
+			sum.mapCount = vMintCountSums.back().mapCount;
+
+		int nHeightFirst = nHeightStart + (int)vMintCountSums.size() * MINT_COUNT_INTERVAL;
+		for (int nHeight = nHeightFirst; nHeight < nHeightFirst + MINT_COUNT_INTERVAL; nHeight++) {
+			for (auto d : chainActive[nHeight]->vMintDenominationsInBlock)
+				sum.mapCount[d]++;
+		}
+		sum.hashBlock = chainActive[nHeightFirst + MINT_COUNT_INTERVAL - 1]->GetBlockHash();
+		vMintCountSums.push_back(sum);
+	}
+
+	//start from the last sum below the end height and count the blocks after it
 	int n = 0;
-	while (pindex->nHeight < nHeightEnd) {
+	if (nIntervals > 0) {
+		std::map<CoinDenomination, int>::const_iterator it = vMintCountSums[nIntervals - 1].mapCount.find(denom);
+		if (it != vMintCountSums[nIntervals - 1].mapCount.end())
+			n = it->second;
+	}
+	for (int nHeight = nHeightStart + nIntervals * MINT_COUNT_INTERVAL; nHeight < nHeightEnd; nHeight++) {
+		const CBlockIndex* pindex = chainActive[nHeight];
 		n += count(pindex->vMintDenominationsInBlock.begin(), pindex->vMintDenominationsInBlock.end(), denom);
-		pindex = chainActive.Next(pindex);
 	}
 
 	return n;
 }
 
+//Split the pubcoins of a block by denomination, filtering invalid outpoints like the witness needs
+static bool BlockToPubcoinValues(const CBlock& block, std::map<CoinDenomination, std::vector<CBigNum> >& mapPubcoins)
+{
+	list<PublicCoin> listPubcoins;
+	if (!BlockToPubcoinList(block, listPubcoins, true))
+		return false;
+
+	for (const PublicCoin& pubcoin : listPubcoins)
+		mapPubcoins[pubcoin.getDenomination()].push_back(pubcoin.getValue());
+	return true;
+}
+
+bool IndexBlockPubcoins(const CBlock& block, const CBlockIndex* pindex)
+{
+	if (pindex->vMintDenominationsInBlock.empty())
+		return true;
+
+	//every minted denomination gets an entry, even when all of its mints are filtered out
+	std::map<CoinDenomination, std::vector<CBigNum> > mapPubcoins;
+	for (auto denom : pindex->vMintDenominationsInBlock)
+		mapPubcoins[denom];
+
+	if (!BlockToPubcoinValues(block, mapPubcoins))
+		return error("%s: failed to get zerocoin mintlist from block %d", __func__, pindex->nHeight);
+
+	return zerocoinDB->WriteBlockPubcoins(pindex->GetBlockHash(), mapPubcoins);
+}
+
+//Read the pubcoins of a denomination from the index, indexing the block if it was connected before the index existed
+static bool GetBlockPubcoins(const CBlockIndex* pindex, CoinDenomination denom, std::vector<CBigNum>& vValues)
+{
+	if (zerocoinDB->ReadBlockPubcoins(pindex->GetBlockHash(), denom, vValues))
+		return true;
+
+	CBlock block;
+	if (!ReadBlockFromDisk(block, pindex))
+		return error("%s: failed to read block from disk while adding pubcoins to witness", __func__);
+
+	if (!IndexBlockPubcoins(block, pindex))
+		LogPrintf("%s: failed to index pubcoins of block %d\n", __func__, pindex->nHeight);
+
+	std::map<CoinDenomination, std::vector<CBigNum> > mapPubcoins;
+	if (!BlockToPubcoinValues(block, mapPubcoins))
+		return error("%s: failed to get zerocoin mintlist from block %d", __func__, pindex->nHeight);
+
+	vValues = mapPubcoins[denom];
+	return true;
+}
+
 int AddBlockMintsToAccumulator(const libzerocoin::PublicCoin& coin, const int nHeightMintAdded, const CBlockIndex* pindex,
-	libzerocoin::Accumulator* accumulator, bool isWitness)
+	std::vector<CBigNum>& vPubcoinsAdd, bool isWitness)
 {
 	// if this block contains mints of the denomination that is being spent, then add them to the witness
 	int nMintsAdded = 0;
 	if (pindex->MintedDenomination(coin.getDenomination())) {
-		//grab mints from this block
-		CBlock block;
-		if (!ReadBlockFromDisk(block, pindex))
-			return error("%s: failed to read block from disk while adding pubcoins to witness", __func__);
-
-		list<PublicCoin> listPubcoins;
-		if (!BlockToPubcoinList(block, listPubcoins, true))
-			return error("%s: failed to get zerocoin mintlist from block %n\n", __func__, pindex->nHeight);
+		std::vector<CBigNum> vValues;
+		if (!GetBlockPubcoins(pindex, coin.getDenomination(), vValues))
+			return 0;
 
 		//add the mints to the witness
-		for (const PublicCoin& pubcoin : listPubcoins) {
-			if (pubcoin.getDenomination() != coin.getDenomination())
+		for (const CBigNum& bnValue : vValues) {
+			if (isWitness && pindex->nHeight == nHeightMintAdded && bnValue == coin.getValue())
 				continue;
 
-			if (isWitness && pindex->nHeight == nHeightMintAdded && pubcoin.getValue() == coin.getValue())
-				continue;
-
-			accumulator->increment(pubcoin.getValue());
+			vPubcoinsAdd.push_back(bnValue);
 			++nMintsAdded;
 		}
 	}
@@ -391,6 +492,24 @@ int AddBlockMintsToAccumulator(const libzerocoin::PublicCoin& coin, const int nH
 	return nMintsAdded;
 }
 
+/**
+ * Witness state of a wallet mint once the mints of every block up to
+ * hashBlock were added, so that the next spend or stake of the same mint only
+ * adds the blocks connected since. Only valid while hashBlock is in the
+ * active chain.
+ */
+struct CWitnessState {
+	uint256 hashBlock;
+	CBigNum bnWitness;
+	int nMintsAdded;
+	int nCheckpointsAdded;
+};
+
+static const unsigned int MAX_WITNESS_CACHE_SIZE = 1000;
+
+static CCriticalSection cs_witnessCache;
+static std::map<uint256, CWitnessState> mapWitnessCache; //! by pubcoin hash
+
 bool GetAccumulatorValue(int& nHeight, const libzerocoin::CoinDenomination denom, CBigNum& bnAccValue)
 {
 	if (nHeight > chainActive.Height())
@@ -420,111 +539,140 @@ bool GetAccumulatorValue(int& nHeight, const libzerocoin::CoinDenomination denom
 bool GenerateAccumulatorWitness(const PublicCoin &coin, Accumulator& accumulator, AccumulatorWitness& witness, int nSecurityLevel, int& nMintsAdded, string& strError, CBlockIndex* pindexCheckpoint)
 {
 	LogPrint("zero", "%s: generating\n", __func__);
-	int nLockAttempts = 0;
-	while (nLockAttempts < 100) {
-		TRY_LOCK(cs_main, lockMain);
-		if (!lockMain) {
-			MilliSleep(50);
-			nLockAttempts++;
-			continue;
-		}
-		break;
-	}
-	if (nLockAttempts == 100)
-		return error("%s: could not get lock on cs_main", __func__);
-	LogPrint("zero", "%s: after lock\n", __func__);
-	uint256 txid;
-	if (!zerocoinDB->ReadCoinMint(coin.getValue(), txid))
-		return error("%s failed to read mint from db", __func__);
-
-	CTransaction txMinted;
-	uint256 hashBlock;
-	if (!GetTransaction(txid, txMinted, hashBlock))
-		return error("%s failed to read tx", __func__);
-
-	int nHeightTest;
-	if (!IsTransactionInChain(txid, nHeightTest))
-		return error("%s: mint tx %s is not in chain", __func__, txid.GetHex());
-
-	int nHeightMintAdded = mapBlockIndex[hashBlock]->nHeight;
-
-	//get the checkpoint added at the next multiple of 10
-	int nHeightCheckpoint = nHeightMintAdded + (10 - (nHeightMintAdded % 10));
-
-	//the height to start accumulating coins to add to witness
-	int nAccStartHeight = nHeightMintAdded - (nHeightMintAdded % 10);
-
-	//Get the accumulator that is right before the cluster of blocks containing our mint was added to the accumulator
-	CBigNum bnAccValue = 0;
-	if (GetAccumulatorValue(nHeightCheckpoint, coin.getDenomination(), bnAccValue)) {
-		accumulator.setValue(bnAccValue);
-		witness.resetValue(accumulator, coin);
-	}
-
-	//add the pubcoins from the blockchain up to the next checksum starting from the block
-	if (nHeightCheckpoint < 10)
-		nHeightCheckpoint = 10;
-
-	CBlockIndex* pindex = chainActive[nHeightCheckpoint - 10];
-	int nChainHeight = chainActive.Height();
-	int nHeightStop = nChainHeight % 10;
-	nHeightStop = nChainHeight - nHeightStop - 20; // at least two checkpoints deep
+	uint256 hashPubcoin = GetPubCoinHash(coin.getValue());
+	RandomizeSecurityLevel(nSecurityLevel); //make security level not always the same and predictable
 
-												   //If looking for a specific checkpoint
-	if (pindexCheckpoint)
-		nHeightStop = pindexCheckpoint->nHeight - 10;
+	//The chain is walked under cs_main to collect the pubcoins and the accumulator increments are done after this scope.
+	//They only run without cs_main when the caller doesn't hold it: CreateCoinStake releases it first, a spend built by
+	//CreateZerocoinSpendTransaction still holds it throughout
+	std::vector<CBigNum> vPubcoinsAdd;
+	CBigNum bnWitnessStart;
+	CWitnessState stateLast;
+	int nMintsAccumulated = 0;
+	{
+		LOCK(cs_main);
+		uint256 txid;
+		if (!zerocoinDB->ReadCoinMint(coin.getValue(), txid))
+			return error("%s failed to read mint from db", __func__);
+
+		CTransaction txMinted;
+		uint256 hashBlock;
+		if (!GetTransaction(txid, txMinted, hashBlock))
+			return error("%s failed to read tx", __func__);
+
+		int nHeightTest;
+		if (!IsTransactionInChain(txid, nHeightTest))
+			return error("%s: mint tx %s is not in chain", __func__, txid.GetHex());
+
+		int nHeightMintAdded = mapBlockIndex[hashBlock]->nHeight;
+
+		//get the checkpoint added at the next multiple of 10
+		int nHeightCheckpoint = nHeightMintAdded + (10 - (nHeightMintAdded % 10));
+
+		//the height to start accumulating coins to add to witness
+		int nAccStartHeight = nHeightMintAdded - (nHeightMintAdded % 10);
+
+		//Get the accumulator that is right before the cluster of blocks containing our mint was added to the accumulator
+		CBigNum bnAccValue = 0;
+		if (GetAccumulatorValue(nHeightCheckpoint, coin.getDenomination(), bnAccValue)) {
+			accumulator.setValue(bnAccValue);
+			witness.resetValue(accumulator, coin);
+		}
 
-	//Iterate through the chain and calculate the witness
-	int nCheckpointsAdded = 0;
-	nMintsAdded = 0;
-	RandomizeSecurityLevel(nSecurityLevel); //make security level not always the same and predictable
-	libzerocoin::Accumulator witnessAccumulator = accumulator;
+		//add the pubcoins from the blockchain up to the next checksum starting from the block
+		if (nHeightCheckpoint < 10)
+			nHeightCheckpoint = 10;
+
+		CBlockIndex* pindex = chainActive[nHeightCheckpoint - 10];
+		int nChainHeight = chainActive.Height();
+		int nHeightStop = nChainHeight % 10;
+		nHeightStop = nChainHeight - nHeightStop - 20; // at least two checkpoints deep
+
+		//If looking for a specific checkpoint
+		if (pindexCheckpoint)
+			nHeightStop = pindexCheckpoint->nHeight - 10;
+
+		//Iterate through the chain and calculate the witness
+		int nCheckpointsAdded = 0;
+		nMintsAdded = 0;
+		bnWitnessStart = accumulator.getValue();
+
+		//Resume from the state of a previous spend or stake of this mint when it is still short of the stop point
+		{
+			LOCK(cs_witnessCache);
+			std::map<uint256, CWitnessState>::iterator it = mapWitnessCache.find(hashPubcoin);
+			if (it != mapWitnessCache.end()) {
+				const CWitnessState& state = it->second;
+				BlockMap::iterator mi = mapBlockIndex.find(state.hashBlock);
+				CBlockIndex* pindexCached = mi != mapBlockIndex.end() ? mi->second : nullptr;
+				if (!pindexCached || !chainActive.Contains(pindexCached)) {
+					mapWitnessCache.erase(it);
+				} else if (pindex && pindexCached->nHeight >= pindex->nHeight && pindexCached->nHeight < nHeightStop &&
+						   !(nSecurityLevel != 100 && state.nCheckpointsAdded >= nSecurityLevel)) {
+					bnWitnessStart = state.bnWitness;
+					nMintsAdded = state.nMintsAdded;
+					nCheckpointsAdded = state.nCheckpointsAdded;
+					pindex = chainActive.Next(pindexCached);
+					LogPrint("zero", "%s: resuming witness from block %d\n", __func__, pindexCached->nHeight);
+				}
+			}
+		}
 
-	bool fDoubleCounted = false;
-	while (pindex) {
-		if (pindex->nHeight != nAccStartHeight && pindex->pprev->nAccumulatorCheckpoint != pindex->nAccumulatorCheckpoint)
-			++nCheckpointsAdded;
+		CBlockIndex* pindexLast = nullptr;
+		while (pindex) {
+			if (pindex->nHeight != nAccStartHeight && pindex->pprev->nAccumulatorCheckpoint != pindex->nAccumulatorCheckpoint)
+				++nCheckpointsAdded;
 
-		//If the security level is satisfied, or the stop height is reached, then initialize the accumulator from here
-		bool fSecurityLevelSatisfied = (nSecurityLevel != 100 && nCheckpointsAdded >= nSecurityLevel);
-		if (pindex->nHeight >= nHeightStop || fSecurityLevelSatisfied) {
+			//If the security level is satisfied, or the stop height is reached, then initialize the accumulator from here
+			bool fSecurityLevelSatisfied = (nSecurityLevel != 100 && nCheckpointsAdded >= nSecurityLevel);
 			//If this height is within the invalid range (when fraudulent coins were being minted), then continue past this range
-			if (InvalidCheckpointRange(pindex->nHeight))
-				continue;
-
-			bnAccValue = 0;
-			uint256 nCheckpointSpend = chainActive[pindex->nHeight + 10]->nAccumulatorCheckpoint;
-			if (!GetAccumulatorValueFromDB(nCheckpointSpend, coin.getDenomination(), bnAccValue) || bnAccValue == 0)
-				return error("%s : failed to find checksum in database for accumulator", __func__);
+			if ((pindex->nHeight >= nHeightStop || fSecurityLevelSatisfied) && !InvalidCheckpointRange(pindex->nHeight)) {
+				bnAccValue = 0;
+				uint256 nCheckpointSpend = chainActive[pindex->nHeight + 10]->nAccumulatorCheckpoint;
+				if (!GetAccumulatorValueFromDB(nCheckpointSpend, coin.getDenomination(), bnAccValue) || bnAccValue == 0)
+					return error("%s : failed to find checksum in database for accumulator", __func__);
+
+				accumulator.setValue(bnAccValue);
+				break;
+			}
 
-			accumulator.setValue(bnAccValue);
-			break;
+			nMintsAdded += AddBlockMintsToAccumulator(coin, nHeightMintAdded, pindex, vPubcoinsAdd, true);
+			stateLast.nMintsAdded = nMintsAdded;
+			stateLast.nCheckpointsAdded = nCheckpointsAdded;
+			pindexLast = pindex;
+			pindex = chainActive.Next(pindex);
 		}
+		if (pindexLast)
+			stateLast.hashBlock = pindexLast->GetBlockHash();
 
-		nMintsAdded += AddBlockMintsToAccumulator(coin, nHeightMintAdded, pindex, &witnessAccumulator, true);
-
-		/*// 10 blocks were accumulated twice when z4xt v2 was activated
-		if (pindex->nHeight == 1050010 && !fDoubleCounted) {
-		pindex = chainActive[1050000];
-		fDoubleCounted = true;
-		continue;
-		}*/
-
-		pindex = chainActive.Next(pindex);
+		// calculate how many mints of this denomination existed in the accumulator we initialized
+		nMintsAccumulated = ComputeAccumulatedCoins(nAccStartHeight, coin.getDenomination());
 	}
 
+	libzerocoin::Accumulator witnessAccumulator = accumulator;
+	witnessAccumulator.setValue(bnWitnessStart);
+	for (const CBigNum& bnValue : vPubcoinsAdd)
+		witnessAccumulator.increment(bnValue);
+
 	witness.resetValue(witnessAccumulator, coin);
 	if (!witness.VerifyWitness(accumulator, coin))
 		return error("%s: failed to verify witness", __func__);
 
+	if (stateLast.hashBlock != 0) {
+		LOCK(cs_witnessCache);
+		if (!mapWitnessCache.count(hashPubcoin) && mapWitnessCache.size() >= MAX_WITNESS_CACHE_SIZE)
+			mapWitnessCache.erase(mapWitnessCache.begin());
+		stateLast.bnWitness = witnessAccumulator.getValue();
+		mapWitnessCache[hashPubcoin] = stateLast;
+	}
+
 	// A certain amount of accumulated coins are required
 	if (nMintsAdded < Params().Zerocoin_RequiredAccumulation()) {
 		strError = _(strprintf("Less than %d mints added, unable to create spend", Params().Zerocoin_RequiredAccumulation()).c_str());
 		return error("%s : %s", __func__, strError);
 	}
 
-	// calculate how many mints of this denomination existed in the accumulator we initialized
-	nMintsAdded += ComputeAccumulatedCoins(nAccStartHeight, coin.getDenomination());
+	nMintsAdded += nMintsAccumulated;
 	LogPrint("zero", "%s : %d mints added to witness\n", __func__, nMintsAdded);
 
 	return true;
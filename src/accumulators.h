@@ -29,6 +29,8 @@ uint32_t ParseChecksum(uint256 nChecksum, libzerocoin::CoinDenomination denomina
 uint32_t GetChecksum(const CBigNum &bnValue);
 int GetChecksumHeight(uint32_t nChecksum, libzerocoin::CoinDenomination denomination);
 bool InvalidCheckpointRange(int nHeight);
+bool IndexBlockPubcoins(const CBlock& block, const CBlockIndex* pindex);
+int ComputeAccumulatedCoins(int nHeightEnd, libzerocoin::CoinDenomination denom);
 bool ValidateAccumulatorCheckpoint(const CBlock& block, CBlockIndex* pindex, AccumulatorMap& mapAccumulators);
 
 #endif //ForexTrading_ACCUMULATORS_H
@@ -0,0 +1,197 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "accumulatorworker.h"
+
+#include "accumulatormap.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "main.h"
+#include "txdb.h"
+#include "util.h"
+#include "z4xtchain.h"
+
+#include <algorithm>
+
+#include <boost/thread.hpp>
+
+using namespace libzerocoin;
+
+CAccumulatorWorker accumulatorWorker;
+
+void ThreadAccumulatorWorker()
+{
+    RenameThread("forextrading-accumulator");
+    accumulatorWorker.Thread();
+}
+
+void CAccumulatorWorker::Schedule(const CBlockIndex* pindexBase)
+{
+    AssertLockHeld(cs_main);
+    if (pindexBase->nHeight % 10 != 0)
+        return;
+
+    // the heights that reload hard checkpoints or recalculate the accumulators stay with CalculateAccumulatorCheckpoint
+    int nHeight = pindexBase->nHeight + 10;
+    if (nHeight <= Params().Zerocoin_Block_V2_Start() + 20 || nHeight <= Params().Zerocoin_Block_RecalculateAccumulators())
+        return;
+
+    CJob job;
+    job.nStatus = JOB_PENDING;
+    job.nCheckpointPrev = pindexBase->nAccumulatorCheckpoint;
+    for (int i = nHeight - 20; i < nHeight - 10; i++) {
+        const CBlockIndex* pindex = pindexBase->GetAncestor(i);
+        if (!pindex->vMintDenominationsInBlock.empty()) {
+            std::set<CoinDenomination> setDenoms(pindex->vMintDenominationsInBlock.begin(), pindex->vMintDenominationsInBlock.end());
+            job.vBlocks.push_back(std::make_pair(pindex, setDenoms));
+        }
+    }
+
+    uint256 hashBase = pindexBase->GetBlockHash();
+    boost::unique_lock<boost::mutex> lock(mutex);
+    if (nThreads == 0 || mapJobs.count(hashBase))
+        return;
+
+    // forget the oldest results, but never a job a worker may still be on
+    while (mapJobs.size() >= MAX_ACCUMULATOR_JOBS && mapJobs[vJobOrder.front()].nStatus != JOB_PENDING) {
+        mapJobs.erase(vJobOrder.front());
+        vJobOrder.pop_front();
+    }
+
+    mapJobs[hashBase] = job;
+    vJobOrder.push_back(hashBase);
+    queue.push_back(hashBase);
+    condWorker.notify_one();
+}
+
+bool CAccumulatorWorker::Get(const uint256& hashBase, uint256& nCheckpoint, AccumulatorCheckpoints::Checkpoint& values)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    std::map<uint256, CJob>::iterator it = mapJobs.find(hashBase);
+    if (it == mapJobs.end())
+        return false;
+
+    if (it->second.nStatus == JOB_PENDING) {
+        // the caller computes it itself, don't let a worker start on it as well; a job no
+        // worker is on any more must not stay pending, Schedule never evicts those
+        std::deque<uint256>::iterator itQueue = std::find(queue.begin(), queue.end(), hashBase);
+        if (itQueue != queue.end()) {
+            queue.erase(itQueue);
+            it->second.nStatus = JOB_FAILED;
+        }
+        return false;
+    }
+
+    if (it->second.nStatus != JOB_DONE)
+        return false;
+
+    nCheckpoint = it->second.nCheckpoint;
+    values = it->second.values;
+    return true;
+}
+
+bool CAccumulatorWorker::IsFinished(const uint256& hashBase)
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    std::map<uint256, CJob>::const_iterator it = mapJobs.find(hashBase);
+    return it != mapJobs.end() && it->second.nStatus != JOB_PENDING;
+}
+
+int CAccumulatorWorker::GetThreadCount()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nThreads;
+}
+
+bool CAccumulatorWorker::Compute(CJob& job)
+{
+    AccumulatorMap mapAccumulators(Params().Zerocoin_Params(false));
+    if (job.nCheckpointPrev != 0 && !mapAccumulators.Load(job.nCheckpointPrev))
+        return error("%s: failed to load checkpoint %s", __func__, job.nCheckpointPrev.GetHex());
+
+    int nTotalMintsFound = 0;
+    for (unsigned int i = 0; i < job.vBlocks.size(); i++) {
+        const CBlockIndex* pindex = job.vBlocks[i].first;
+        const std::set<CoinDenomination>& setDenoms = job.vBlocks[i].second;
+
+        // the pubcoin index has the same filtered mints; blocks connected before it existed are read from disk
+        std::map<CoinDenomination, std::vector<CBigNum> > mapPubcoins;
+        bool fIndexed = true;
+        for (CoinDenomination denom : setDenoms) {
+            if (!zerocoinDB->ReadBlockPubcoins(pindex->GetBlockHash(), denom, mapPubcoins[denom])) {
+                fIndexed = false;
+                break;
+            }
+        }
+
+        if (!fIndexed) {
+            mapPubcoins.clear();
+            CBlock block;
+            if (!ReadBlockFromDisk(block, pindex))
+                return error("%s: failed to read block %d from disk", __func__, pindex->nHeight);
+
+            std::list<PublicCoin> listPubcoins;
+            if (!BlockToPubcoinList(block, listPubcoins, true))
+                return error("%s: failed to get zerocoin mintlist from block %d", __func__, pindex->nHeight);
+            for (const PublicCoin& pubcoin : listPubcoins)
+                mapPubcoins[pubcoin.getDenomination()].push_back(pubcoin.getValue());
+        }
+
+        for (std::map<CoinDenomination, std::vector<CBigNum> >::const_iterator it = mapPubcoins.begin(); it != mapPubcoins.end(); it++) {
+            for (const CBigNum& bnValue : it->second) {
+                if (!mapAccumulators.Accumulate(PublicCoin(Params().Zerocoin_Params(false), bnValue, it->first), true))
+                    return error("%s: failed to add pubcoin to accumulator at height %d", __func__, pindex->nHeight);
+                nTotalMintsFound++;
+            }
+        }
+    }
+
+    // if there were no new mints found, the accumulator checkpoint will be the same as the last checkpoint
+    job.nCheckpoint = nTotalMintsFound == 0 ? job.nCheckpointPrev : mapAccumulators.GetCheckpoint();
+    for (CoinDenomination denom : zerocoinDenomList)
+        job.values[denom] = mapAccumulators.GetValue(denom);
+    return true;
+}
+
+void CAccumulatorWorker::Thread()
+{
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nThreads++;
+    }
+
+    try {
+        while (true) {
+            uint256 hashBase;
+            CJob job;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                while (queue.empty())
+                    condWorker.wait(lock);
+
+                hashBase = queue.front();
+                queue.pop_front();
+                job = mapJobs[hashBase];
+            }
+
+            int64_t nTimeStart = GetTimeMillis();
+            bool fOk = Compute(job);
+            LogPrint("zero", "%s: checkpoint after block %s computed in %dms\n", __func__, hashBase.GetHex(), GetTimeMillis() - nTimeStart);
+
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                CJob& jobDone = mapJobs[hashBase];
+                jobDone.nStatus = fOk ? JOB_DONE : JOB_FAILED;
+                jobDone.nCheckpoint = job.nCheckpoint;
+                jobDone.values = job.values;
+            }
+
+            boost::this_thread::interruption_point();
+        }
+    } catch (const boost::thread_interrupted&) {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nThreads--;
+        throw;
+    }
+}
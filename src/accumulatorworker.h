@@ -0,0 +1,96 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef ForexTrading_ACCUMULATORWORKER_H
+#define ForexTrading_ACCUMULATORWORKER_H
+
+#include "accumulatorcheckpoints.h"
+#include "libzerocoin/Denominations.h"
+#include "uint256.h"
+
+#include <deque>
+#include <map>
+#include <set>
+#include <utility>
+#include <vector>
+
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CAccumulatorWorker;
+class CBlockIndex;
+
+/** Number of computed checkpoints kept for lookups and reorgs */
+static const unsigned int MAX_ACCUMULATOR_JOBS = 20;
+
+extern CAccumulatorWorker accumulatorWorker;
+
+void ThreadAccumulatorWorker();
+
+/**
+ * Computes accumulator checkpoints ahead of the block that has to contain them.
+ *
+ * The checkpoint of block H accumulates the mints of blocks H-20 to H-11 on top
+ * of the checkpoint of block H-10, so everything it depends on is known as soon
+ * as block H-10 connects. ConnectTip schedules it then and the worker thread
+ * computes it while the next nine blocks arrive; CalculateAccumulatorCheckpoint
+ * picks up the result instead of re-accumulating under cs_main, and falls back
+ * to accumulating inline when the worker hasn't finished.
+ *
+ * Results are keyed by the hash of block H-10, so a result computed on a chain
+ * that was reorganized away is simply never asked for again.
+ */
+class CAccumulatorWorker
+{
+private:
+    enum JobStatus {
+        JOB_PENDING,
+        JOB_DONE,
+        JOB_FAILED
+    };
+
+    struct CJob {
+        JobStatus nStatus;
+        uint256 nCheckpointPrev;
+        //! blocks to accumulate and the denominations each of them minted
+        std::vector<std::pair<const CBlockIndex*, std::set<libzerocoin::CoinDenomination> > > vBlocks;
+        uint256 nCheckpoint;
+        AccumulatorCheckpoints::Checkpoint values;
+    };
+
+    boost::mutex mutex;
+    boost::condition_variable condWorker;
+
+    //! base block hash -> job, oldest first in vJobOrder
+    std::map<uint256, CJob> mapJobs;
+    std::deque<uint256> vJobOrder;
+    std::deque<uint256> queue;
+    int nThreads;
+
+    static bool Compute(CJob& job);
+
+public:
+    CAccumulatorWorker() : nThreads(0) {}
+
+    /** Queue the checkpoint of the block 10 above pindexBase. Requires cs_main */
+    void Schedule(const CBlockIndex* pindexBase);
+
+    /**
+     * Result for the checkpoint 10 blocks above hashBase. Never waits, as the
+     * caller holds cs_main: a result that isn't ready yet is false and the
+     * caller computes the checkpoint inline.
+     */
+    bool Get(const uint256& hashBase, uint256& nCheckpoint, AccumulatorCheckpoints::Checkpoint& values);
+
+    /** Whether the job for hashBase has been computed or given up on, without taking it over like Get */
+    bool IsFinished(const uint256& hashBase);
+
+    /** Number of running worker threads */
+    int GetThreadCount();
+
+    /** Worker loop, returns on thread interruption */
+    void Thread();
+};
+
+#endif // ForexTrading_ACCUMULATORWORKER_H
@@ -11,6 +11,8 @@
 #include "serialize.h"
 #include "streams.h"
 
+#include <algorithm>
+
 using namespace std;
 
 int CAddrInfo::GetTriedBucket(const uint256& nKey) const
@@ -67,7 +69,7 @@ double CAddrInfo::GetChance(int64_t nNow) const
         nSinceLastTry = 0;
 
     // deprioritize very recent attempts away
-    if (nSinceLastTry < 60 * 10)
+    if (nSinceLastTry < ADDRMAN_RECENT_TRY_SECONDS)
         fChance *= 0.01;
 
     // deprioritize 66% after each failed attempt, but at most 1/28th to avoid the search taking forever or overly penalizing outages.
@@ -76,6 +78,41 @@ double CAddrInfo::GetChance(int64_t nNow) const
     return fChance;
 }
 
+//! GetChance in units of 2^-20, never zero so every entry can still be selected
+static uint32_t GetSelectWeight(const CAddrInfo& info, int64_t nNow)
+{
+    return max((uint32_t)1, (uint32_t)(info.GetChance(nNow) * (1 << 20)));
+}
+
+void CAddrSlotWeights::Clear()
+{
+    std::fill(vTree.begin(), vTree.end(), 0);
+    std::fill(vWeight.begin(), vWeight.end(), 0);
+}
+
+void CAddrSlotWeights::Set(unsigned int nSlot, uint32_t nWeight)
+{
+    // unsigned wrap-around takes care of a lower weight
+    uint64_t nDelta = (uint64_t)nWeight - vWeight[nSlot];
+    vWeight[nSlot] = nWeight;
+    for (unsigned int i = nSlot + 1; i < vTree.size(); i += i & (~i + 1))
+        vTree[i] += nDelta;
+}
+
+unsigned int CAddrSlotWeights::Find(uint64_t nValue) const
+{
+    const unsigned int nSlots = vWeight.size();
+    unsigned int nPos = 0;
+    for (unsigned int nStep = nSlots; nStep > 0; nStep >>= 1) {
+        if (nPos + nStep <= nSlots && vTree[nPos + nStep] <= nValue) {
+            nPos += nStep;
+            nValue -= vTree[nPos];
+        }
+    }
+    assert(nPos < nSlots);
+    return nPos;
+}
+
 CAddrInfo* CAddrMan::Find(const CNetAddr& addr, int* pnId)
 {
     std::map<CNetAddr, int>::iterator it = mapAddr.find(addr);
@@ -96,6 +133,7 @@ CAddrInfo* CAddrMan::Create(const CAddress& addr, const CNetAddr& addrSource, in
     mapAddr[addr] = nId;
     mapInfo[nId].nRandomPos = vRandom.size();
     vRandom.push_back(nId);
+    nChanges++;
     if (pnId)
         *pnId = nId;
     return &mapInfo[nId];
@@ -133,6 +171,7 @@ void CAddrMan::Delete(int nId)
     mapAddr.erase(info);
     mapInfo.erase(nId);
     nNew--;
+    nChanges++;
 }
 
 void CAddrMan::ClearNew(int nUBucket, int nUBucketPos)
@@ -141,32 +180,88 @@ void CAddrMan::ClearNew(int nUBucket, int nUBucketPos)
     if (vvNew[nUBucket][nUBucketPos] != -1) {
         int nIdDelete = vvNew[nUBucket][nUBucketPos];
         CAddrInfo& infoDelete = mapInfo[nIdDelete];
-        assert(infoDelete.nRefCount > 0);
-        infoDelete.nRefCount--;
-        vvNew[nUBucket][nUBucketPos] = -1;
+        RemoveFromNew(infoDelete, nUBucket, nUBucketPos);
         if (infoDelete.nRefCount == 0) {
             Delete(nIdDelete);
         }
     }
 }
 
-void CAddrMan::MakeTried(CAddrInfo& info, int nId)
+void CAddrMan::AddToNew(CAddrInfo& info, int nId, int nUBucket, int nUBucketPos)
 {
-    // remove the entry from all new buckets
-    for (int bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
-        int pos = info.GetBucketPosition(nKey, true, bucket);
-        if (vvNew[bucket][pos] == nId) {
-            vvNew[bucket][pos] = -1;
+    assert(vvNew[nUBucket][nUBucketPos] == -1);
+    assert(info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS);
+    int nSlot = nUBucket * ADDRMAN_BUCKET_SIZE + nUBucketPos;
+    vvNew[nUBucket][nUBucketPos] = nId;
+    info.vNewSlots[info.nRefCount++] = nSlot;
+    weightsNew.Set(nSlot, GetSelectWeight(info, GetAdjustedTime()));
+    nChanges++;
+}
+
+void CAddrMan::RemoveFromNew(CAddrInfo& info, int nUBucket, int nUBucketPos)
+{
+    assert(info.nRefCount > 0);
+    int nSlot = nUBucket * ADDRMAN_BUCKET_SIZE + nUBucketPos;
+    vvNew[nUBucket][nUBucketPos] = -1;
+    weightsNew.Set(nSlot, 0);
+    nChanges++;
+    for (int i = 0; i < info.nRefCount; i++) {
+        if (info.vNewSlots[i] == nSlot) {
+            info.vNewSlots[i] = info.vNewSlots[info.nRefCount - 1];
             info.nRefCount--;
+            return;
         }
     }
-    nNew--;
+    assert(!"entry not in its new table slot");
+}
 
-    assert(info.nRefCount == 0);
+void CAddrMan::GetTriedPosition(CAddrInfo& info, int& nKBucket, int& nKBucketPos)
+{
+    if (info.nTriedSlot == -1) {
+        int nBucket = info.GetTriedBucket(nKey);
+        info.nTriedSlot = nBucket * ADDRMAN_BUCKET_SIZE + info.GetBucketPosition(nKey, false, nBucket);
+    }
+    nKBucket = info.nTriedSlot / ADDRMAN_BUCKET_SIZE;
+    nKBucketPos = info.nTriedSlot % ADDRMAN_BUCKET_SIZE;
+}
+
+void CAddrMan::UpdateWeight(const CAddrInfo& info, int64_t nNow)
+{
+    uint32_t nWeight = GetSelectWeight(info, nNow);
+    if (info.fInTried)
+        weightsTried.Set(info.nTriedSlot, nWeight);
+    for (int i = 0; i < info.nRefCount; i++)
+        weightsNew.Set(info.vNewSlots[i], nWeight);
+}
+
+void CAddrMan::NoteTry(const CAddrInfo& info, int nId, int64_t nNow)
+{
+    UpdateWeight(info, nNow);
+    vRecentTries.push_back(std::make_pair(info.nLastTry + ADDRMAN_RECENT_TRY_SECONDS, nId));
+}
+
+void CAddrMan::RefreshWeights(int64_t nNow)
+{
+    while (!vRecentTries.empty() && vRecentTries.front().first <= nNow) {
+        std::map<int, CAddrInfo>::iterator it = mapInfo.find(vRecentTries.front().second);
+        vRecentTries.pop_front();
+        if (it != mapInfo.end())
+            UpdateWeight(it->second, nNow);
+    }
+}
+
+void CAddrMan::MakeTried(CAddrInfo& info, int nId)
+{
+    // remove the entry from all new buckets
+    while (info.nRefCount > 0) {
+        int nSlot = info.vNewSlots[info.nRefCount - 1];
+        RemoveFromNew(info, nSlot / ADDRMAN_BUCKET_SIZE, nSlot % ADDRMAN_BUCKET_SIZE);
+    }
+    nNew--;
 
     // which tried bucket to move the entry to
-    int nKBucket = info.GetTriedBucket(nKey);
-    int nKBucketPos = info.GetBucketPosition(nKey, false, nKBucket);
+    int nKBucket, nKBucketPos;
+    GetTriedPosition(info, nKBucket, nKBucketPos);
 
     // first make space to add it (the existing tried entry there is moved to new, deleting whatever is there).
     if (vvTried[nKBucket][nKBucketPos] != -1) {
@@ -178,17 +273,16 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
         // Remove the to-be-evicted item from the tried set.
         infoOld.fInTried = false;
         vvTried[nKBucket][nKBucketPos] = -1;
+        weightsTried.Set(infoOld.nTriedSlot, 0);
         nTried--;
 
         // find which new bucket it belongs to
         int nUBucket = infoOld.GetNewBucket(nKey);
         int nUBucketPos = infoOld.GetBucketPosition(nKey, true, nUBucket);
         ClearNew(nUBucket, nUBucketPos);
-        assert(vvNew[nUBucket][nUBucketPos] == -1);
 
         // Enter it into the new set again.
-        infoOld.nRefCount = 1;
-        vvNew[nUBucket][nUBucketPos] = nIdEvict;
+        AddToNew(infoOld, nIdEvict, nUBucket, nUBucketPos);
         nNew++;
     }
     assert(vvTried[nKBucket][nKBucketPos] == -1);
@@ -196,6 +290,8 @@ void CAddrMan::MakeTried(CAddrInfo& info, int nId)
     vvTried[nKBucket][nKBucketPos] = nId;
     nTried++;
     info.fInTried = true;
+    nChanges++;
+    UpdateWeight(info, GetAdjustedTime());
 }
 
 void CAddrMan::Good_(const CService& addr, int64_t nTime)
@@ -217,28 +313,18 @@ void CAddrMan::Good_(const CService& addr, int64_t nTime)
     info.nLastSuccess = nTime;
     info.nLastTry = nTime;
     info.nAttempts = 0;
+    nChanges++;
     // nTime is not updated here, to avoid leaking information about
     // currently-connected peers.
+    NoteTry(info, nId, GetAdjustedTime());
 
     // if it is already in the tried set, don't do anything else
     if (info.fInTried)
         return;
 
-    // find a bucket it is in now
-    int nRnd = GetRandInt(ADDRMAN_NEW_BUCKET_COUNT);
-    int nUBucket = -1;
-    for (unsigned int n = 0; n < ADDRMAN_NEW_BUCKET_COUNT; n++) {
-        int nB = (n + nRnd) % ADDRMAN_NEW_BUCKET_COUNT;
-        int nBpos = info.GetBucketPosition(nKey, true, nB);
-        if (vvNew[nB][nBpos] == nId) {
-            nUBucket = nB;
-            break;
-        }
-    }
-
-    // if no bucket is found, something bad happened;
+    // if it is in no bucket, something bad happened;
     // TODO: maybe re-add the node, but for now, just bail out
-    if (nUBucket == -1)
+    if (info.nRefCount == 0)
         return;
 
     LogPrint("addrman", "Moving %s to tried\n", addr.ToString());
@@ -260,11 +346,16 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
         // periodically update nTime
         bool fCurrentlyOnline = (GetAdjustedTime() - addr.nTime < 24 * 60 * 60);
         int64_t nUpdateInterval = (fCurrentlyOnline ? 60 * 60 : 24 * 60 * 60);
-        if (addr.nTime && (!pinfo->nTime || pinfo->nTime < addr.nTime - nUpdateInterval - nTimePenalty))
+        if (addr.nTime && (!pinfo->nTime || pinfo->nTime < addr.nTime - nUpdateInterval - nTimePenalty)) {
             pinfo->nTime = max((int64_t)0, addr.nTime - nTimePenalty);
+            nChanges++;
+        }
 
         // add services
-        pinfo->nServices |= addr.nServices;
+        if ((pinfo->nServices | addr.nServices) != pinfo->nServices) {
+            pinfo->nServices |= addr.nServices;
+            nChanges++;
+        }
 
         // do not update if no new information is present
         if (!addr.nTime || (pinfo->nTime && addr.nTime <= pinfo->nTime))
@@ -304,8 +395,7 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
         }
         if (fInsert) {
             ClearNew(nUBucket, nUBucketPos);
-            pinfo->nRefCount++;
-            vvNew[nUBucket][nUBucketPos] = nId;
+            AddToNew(*pinfo, nId, nUBucket, nUBucketPos);
         } else {
             if (pinfo->nRefCount == 0) {
                 Delete(nId);
@@ -317,7 +407,8 @@ bool CAddrMan::Add_(const CAddress& addr, const CNetAddr& source, int64_t nTimeP
 
 void CAddrMan::Attempt_(const CService& addr, int64_t nTime)
 {
-    CAddrInfo* pinfo = Find(addr);
+    int nId;
+    CAddrInfo* pinfo = Find(addr, &nId);
 
     // if not found, bail out
     if (!pinfo)
@@ -332,6 +423,8 @@ void CAddrMan::Attempt_(const CService& addr, int64_t nTime)
     // update info
     info.nLastTry = nTime;
     info.nAttempts++;
+    nChanges++;
+    NoteTry(info, nId, GetAdjustedTime());
 }
 
 CAddress CAddrMan::Select_()
@@ -339,38 +432,22 @@ CAddress CAddrMan::Select_()
     if (size() == 0)
         return CAddress();
 
-    // Use a 50% chance for choosing between tried and new table entries.
+    RefreshWeights(GetAdjustedTime());
+
+    // Use a 50% chance for choosing between tried and new table entries,
+    // then pick an occupied slot of that table weighted by the chance of its entry.
+    int nId;
     if (nTried > 0 && (nNew == 0 || GetRandInt(2) == 0)) {
         // use a tried node
-        double fChanceFactor = 1.0;
-        while (1) {
-            int nKBucket = GetRandInt(ADDRMAN_TRIED_BUCKET_COUNT);
-            int nKBucketPos = GetRandInt(ADDRMAN_BUCKET_SIZE);
-            if (vvTried[nKBucket][nKBucketPos] == -1)
-                continue;
-            int nId = vvTried[nKBucket][nKBucketPos];
-            assert(mapInfo.count(nId) == 1);
-            CAddrInfo& info = mapInfo[nId];
-            if (GetRandInt(1 << 30) < fChanceFactor * info.GetChance() * (1 << 30))
-                return info;
-            fChanceFactor *= 1.2;
-        }
+        unsigned int nSlot = weightsTried.Find(GetRand(weightsTried.Total()));
+        nId = vvTried[nSlot / ADDRMAN_BUCKET_SIZE][nSlot % ADDRMAN_BUCKET_SIZE];
     } else {
         // use a new node
-        double fChanceFactor = 1.0;
-        while (1) {
-            int nUBucket = GetRandInt(ADDRMAN_NEW_BUCKET_COUNT);
-            int nUBucketPos = GetRandInt(ADDRMAN_BUCKET_SIZE);
-            if (vvNew[nUBucket][nUBucketPos] == -1)
-                continue;
-            int nId = vvNew[nUBucket][nUBucketPos];
-            assert(mapInfo.count(nId) == 1);
-            CAddrInfo& info = mapInfo[nId];
-            if (GetRandInt(1 << 30) < fChanceFactor * info.GetChance() * (1 << 30))
-                return info;
-            fChanceFactor *= 1.2;
-        }
+        unsigned int nSlot = weightsNew.Find(GetRand(weightsNew.Total()));
+        nId = vvNew[nSlot / ADDRMAN_BUCKET_SIZE][nSlot % ADDRMAN_BUCKET_SIZE];
     }
+    assert(nId != -1 && mapInfo.count(nId) == 1);
+    return mapInfo[nId];
 }
 
 #ifdef DEBUG_ADDRMAN
@@ -422,7 +499,11 @@ int CAddrMan::Check_()
                     return -17;
                 if (mapInfo[vvTried[n][i]].GetBucketPosition(nKey, false, n) != i)
                     return -18;
+                if (mapInfo[vvTried[n][i]].nTriedSlot != n * ADDRMAN_BUCKET_SIZE + i || weightsTried.Get(n * ADDRMAN_BUCKET_SIZE + i) == 0)
+                    return -20;
                 setTried.erase(vvTried[n][i]);
+            } else if (weightsTried.Get(n * ADDRMAN_BUCKET_SIZE + i) != 0) {
+                return -20;
             }
         }
     }
@@ -434,8 +515,13 @@ int CAddrMan::Check_()
                     return -12;
                 if (mapInfo[vvNew[n][i]].GetBucketPosition(nKey, true, n) != i)
                     return -19;
+                const CAddrInfo& info = mapInfo[vvNew[n][i]];
+                if (std::count(info.vNewSlots, info.vNewSlots + info.nRefCount, n * ADDRMAN_BUCKET_SIZE + i) != 1 || weightsNew.Get(n * ADDRMAN_BUCKET_SIZE + i) == 0)
+                    return -21;
                 if (--mapNew[vvNew[n][i]] == 0)
                     mapNew.erase(vvNew[n][i]);
+            } else if (weightsNew.Get(n * ADDRMAN_BUCKET_SIZE + i) != 0) {
+                return -21;
             }
         }
     }
@@ -488,6 +574,8 @@ void CAddrMan::Connected_(const CService& addr, int64_t nTime)
 
     // update info
     int64_t nUpdateInterval = 20 * 60;
-    if (nTime - info.nTime > nUpdateInterval)
+    if (nTime - info.nTime > nUpdateInterval) {
         info.nTime = nTime;
+        nChanges++;
+    }
 }
@@ -15,11 +15,81 @@
 #include "timedata.h"
 #include "util.h"
 
+#include <algorithm>
+#include <deque>
 #include <map>
 #include <set>
 #include <stdint.h>
 #include <vector>
 
+/** Stochastic address manager
+ *
+ * Design goals:
+ *  * Keep the address tables in-memory, and asynchronously dump the entire to able in peers.dat.
+ *  * Make sure no (localized) attacker can fill the entire table with his nodes/addresses.
+ *
+ * To that end:
+ *  * Addresses are organized into buckets.
+ *    * Address that have not yet been tried go into 1024 "new" buckets.
+ *      * Based on the address range (/16 for IPv4) of source of the information, 64 buckets are selected at random
+ *      * The actual bucket is chosen from one of these, based on the range the address itself is located.
+ *      * One single address can occur in up to 8 different buckets, to increase selection chances for addresses that
+ *        are seen frequently. The chance for increasing this multiplicity decreases exponentially.
+ *      * When adding a new address to a full bucket, a randomly chosen entry (with a bias favoring less recently seen
+ *        ones) is removed from it first.
+ *    * Addresses of nodes that are known to be accessible go into 256 "tried" buckets.
+ *      * Each address range selects at random 8 of these buckets.
+ *      * The actual bucket is chosen from one of these, based on the full address.
+ *      * When adding a new good address to a full bucket, a randomly chosen entry (with a bias favoring less recently
+ *        tried ones) is evicted from it, back to the "new" buckets.
+ *    * Bucket selection is based on cryptographic hashing, using a randomly-generated 256-bit key, which should not
+ *      be observable by adversaries.
+ *    * Several indexes are kept for high performance. Defining DEBUG_ADDRMAN will introduce frequent (and expensive)
+ *      consistency checks for the entire data structure.
+ *      * Every entry remembers the table slots it occupies, so moving it never has to search the buckets.
+ *      * Every occupied slot carries the selection weight of its entry, summed in a tree per table, so an
+ *        address to connect to is picked in O(log n).
+ */
+
+//! total number of buckets for tried addresses
+#define ADDRMAN_TRIED_BUCKET_COUNT 256
+
+//! total number of buckets for new addresses
+#define ADDRMAN_NEW_BUCKET_COUNT 1024
+
+//! maximum allowed number of entries in buckets for new and tried addresses
+#define ADDRMAN_BUCKET_SIZE 64
+
+//! over how many buckets entries with tried addresses from a single group (/16 for IPv4) are spread
+#define ADDRMAN_TRIED_BUCKETS_PER_GROUP 8
+
+//! over how many buckets entries with new addresses originating from a single group are spread
+#define ADDRMAN_NEW_BUCKETS_PER_SOURCE_GROUP 64
+
+//! in how many buckets for entries with new addresses a single address may occur
+#define ADDRMAN_NEW_BUCKETS_PER_ADDRESS 8
+
+//! how old addresses can maximally be
+#define ADDRMAN_HORIZON_DAYS 30
+
+//! after how many failed attempts we give up on a new node
+#define ADDRMAN_RETRIES 3
+
+//! how many successive failures are allowed ...
+#define ADDRMAN_MAX_FAILURES 10
+
+//! ... in at least this many days
+#define ADDRMAN_MIN_FAIL_DAYS 7
+
+//! the maximum percentage of nodes to return in a getaddr call
+#define ADDRMAN_GETADDR_MAX_PCT 23
+
+//! the maximum number of nodes to return in a getaddr call
+#define ADDRMAN_GETADDR_MAX 2500
+
+//! for how long a connection attempt lowers the chance of an entry being selected
+#define ADDRMAN_RECENT_TRY_SECONDS (10 * 60)
+
 /** 
  * Extended statistics about a CAddress 
  */
@@ -47,6 +117,12 @@ private:
     //! position in vRandom
     int nRandomPos;
 
+    //! slot in the "tried" table, -1 until computed (memory only)
+    int nTriedSlot;
+
+    //! slots in the "new" table holding this entry, the first nRefCount are valid (memory only)
+    int vNewSlots[ADDRMAN_NEW_BUCKETS_PER_ADDRESS];
+
     friend class CAddrMan;
 
 public:
@@ -69,6 +145,7 @@ public:
         nRefCount = 0;
         fInTried = false;
         nRandomPos = -1;
+        nTriedSlot = -1;
     }
 
     CAddrInfo(const CAddress& addrIn, const CNetAddr& addrSource) : CAddress(addrIn), source(addrSource)
@@ -103,67 +180,31 @@ public:
     double GetChance(int64_t nNow = GetAdjustedTime()) const;
 };
 
-/** Stochastic address manager
- *
- * Design goals:
- *  * Keep the address tables in-memory, and asynchronously dump the entire to able in peers.dat.
- *  * Make sure no (localized) attacker can fill the entire table with his nodes/addresses.
- *
- * To that end:
- *  * Addresses are organized into buckets.
- *    * Address that have not yet been tried go into 1024 "new" buckets.
- *      * Based on the address range (/16 for IPv4) of source of the information, 64 buckets are selected at random
- *      * The actual bucket is chosen from one of these, based on the range the address itself is located.
- *      * One single address can occur in up to 8 different buckets, to increase selection chances for addresses that
- *        are seen frequently. The chance for increasing this multiplicity decreases exponentially.
- *      * When adding a new address to a full bucket, a randomly chosen entry (with a bias favoring less recently seen
- *        ones) is removed from it first.
- *    * Addresses of nodes that are known to be accessible go into 256 "tried" buckets.
- *      * Each address range selects at random 8 of these buckets.
- *      * The actual bucket is chosen from one of these, based on the full address.
- *      * When adding a new good address to a full bucket, a randomly chosen entry (with a bias favoring less recently
- *        tried ones) is evicted from it, back to the "new" buckets.
- *    * Bucket selection is based on cryptographic hashing, using a randomly-generated 256-bit key, which should not
- *      be observable by adversaries.
- *    * Several indexes are kept for high performance. Defining DEBUG_ADDRMAN will introduce frequent (and expensive)
- *      consistency checks for the entire data structure.
+/**
+ * Selection weights of the slots of one address table, in a Fenwick tree so
+ * that a slot can be picked with probability proportional to its weight, and
+ * a weight changed, in O(log n).
  */
+class CAddrSlotWeights
+{
+private:
+    //! 1-based tree over the slots, the slot count is a power of two
+    std::vector<uint64_t> vTree;
+    std::vector<uint32_t> vWeight;
 
-//! total number of buckets for tried addresses
-#define ADDRMAN_TRIED_BUCKET_COUNT 256
-
-//! total number of buckets for new addresses
-#define ADDRMAN_NEW_BUCKET_COUNT 1024
-
-//! maximum allowed number of entries in buckets for new and tried addresses
-#define ADDRMAN_BUCKET_SIZE 64
-
-//! over how many buckets entries with tried addresses from a single group (/16 for IPv4) are spread
-#define ADDRMAN_TRIED_BUCKETS_PER_GROUP 8
-
-//! over how many buckets entries with new addresses originating from a single group are spread
-#define ADDRMAN_NEW_BUCKETS_PER_SOURCE_GROUP 64
-
-//! in how many buckets for entries with new addresses a single address may occur
-#define ADDRMAN_NEW_BUCKETS_PER_ADDRESS 8
-
-//! how old addresses can maximally be
-#define ADDRMAN_HORIZON_DAYS 30
-
-//! after how many failed attempts we give up on a new node
-#define ADDRMAN_RETRIES 3
-
-//! how many successive failures are allowed ...
-#define ADDRMAN_MAX_FAILURES 10
+public:
+    explicit CAddrSlotWeights(unsigned int nSlots) : vTree(nSlots + 1, 0), vWeight(nSlots, 0) {}
 
-//! ... in at least this many days
-#define ADDRMAN_MIN_FAIL_DAYS 7
+    void Clear();
+    void Set(unsigned int nSlot, uint32_t nWeight);
+    uint32_t Get(unsigned int nSlot) const { return vWeight[nSlot]; }
 
-//! the maximum percentage of nodes to return in a getaddr call
-#define ADDRMAN_GETADDR_MAX_PCT 23
+    //! Sum of all weights
+    uint64_t Total() const { return vTree.back(); }
 
-//! the maximum number of nodes to return in a getaddr call
-#define ADDRMAN_GETADDR_MAX 2500
+    //! The slot in which the running sum of weights passes nValue, 0 <= nValue < Total()
+    unsigned int Find(uint64_t nValue) const;
+};
 
 /** 
  * Stochastical (IP) address manager 
@@ -201,6 +242,16 @@ private:
     //! list of "new" buckets
     int vvNew[ADDRMAN_NEW_BUCKET_COUNT][ADDRMAN_BUCKET_SIZE];
 
+    //! selection weight of the entry in every slot, indexed by bucket * ADDRMAN_BUCKET_SIZE + position
+    CAddrSlotWeights weightsTried;
+    CAddrSlotWeights weightsNew;
+
+    //! entries whose recent connection attempt stops lowering their weight at the given time
+    std::deque<std::pair<int64_t, int> > vRecentTries;
+
+    //! bumped whenever an entry or table position that peers.dat stores changes, to tell whether it is out of date
+    uint64_t nChanges;
+
 protected:
     //! Find an entry.
     CAddrInfo* Find(const CNetAddr& addr, int* pnId = NULL);
@@ -221,6 +272,24 @@ protected:
     //! Clear a position in a "new" table. This is the only place where entries are actually deleted.
     void ClearNew(int nUBucket, int nUBucketPos);
 
+    //! Put an entry in an empty position of the "new" table, taking a reference.
+    void AddToNew(CAddrInfo& info, int nId, int nUBucket, int nUBucketPos);
+
+    //! Take an entry out of a position of the "new" table, dropping its reference.
+    void RemoveFromNew(CAddrInfo& info, int nUBucket, int nUBucketPos);
+
+    //! Position of an entry in the "tried" table, computed once per entry.
+    void GetTriedPosition(CAddrInfo& info, int& nKBucket, int& nKBucketPos);
+
+    //! Recompute the selection weight of every slot holding an entry.
+    void UpdateWeight(const CAddrInfo& info, int64_t nNow);
+
+    //! Note a connection attempt to an entry, whose weight recovers ADDRMAN_RECENT_TRY_SECONDS later.
+    void NoteTry(const CAddrInfo& info, int nId, int64_t nNow);
+
+    //! Restore the weight of entries whose last attempt is no longer recent.
+    void RefreshWeights(int64_t nNow);
+
     //! Mark an entry "good", possibly moving it from "new" to "tried".
     void Good_(const CService& addr, int64_t nTime);
 
@@ -350,6 +419,7 @@ public:
         for (int n = 0; n < nNew; n++) {
             CAddrInfo& info = mapInfo[n];
             s >> info;
+            info.nLastTry = info.nLastSuccess;
             mapAddr[info] = n;
             info.nRandomPos = vRandom.size();
             vRandom.push_back(n);
@@ -358,10 +428,8 @@ public:
                 // immediately try to give them a reference based on their primary source address.
                 int nUBucket = info.GetNewBucket(nKey);
                 int nUBucketPos = info.GetBucketPosition(nKey, true, nUBucket);
-                if (vvNew[nUBucket][nUBucketPos] == -1) {
-                    vvNew[nUBucket][nUBucketPos] = n;
-                    info.nRefCount++;
-                }
+                if (vvNew[nUBucket][nUBucketPos] == -1)
+                    AddToNew(info, n, nUBucket, nUBucketPos);
             }
         }
         nIdCount = nNew;
@@ -371,8 +439,9 @@ public:
         for (int n = 0; n < nTried; n++) {
             CAddrInfo info;
             s >> info;
-            int nKBucket = info.GetTriedBucket(nKey);
-            int nKBucketPos = info.GetBucketPosition(nKey, false, nKBucket);
+            info.nLastTry = info.nLastSuccess;
+            int nKBucket, nKBucketPos;
+            GetTriedPosition(info, nKBucket, nKBucketPos);
             if (vvTried[nKBucket][nKBucketPos] == -1) {
                 info.nRandomPos = vRandom.size();
                 info.fInTried = true;
@@ -380,6 +449,7 @@ public:
                 mapInfo[nIdCount] = info;
                 mapAddr[info] = nIdCount;
                 vvTried[nKBucket][nKBucketPos] = nIdCount;
+                UpdateWeight(mapInfo[nIdCount], GetAdjustedTime());
                 nIdCount++;
             } else {
                 nLost++;
@@ -397,10 +467,8 @@ public:
                 if (nIndex >= 0 && nIndex < nNew) {
                     CAddrInfo& info = mapInfo[nIndex];
                     int nUBucketPos = info.GetBucketPosition(nKey, true, bucket);
-                    if (nVersion == 1 && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && vvNew[bucket][nUBucketPos] == -1 && info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS) {
-                        info.nRefCount++;
-                        vvNew[bucket][nUBucketPos] = nIndex;
-                    }
+                    if (nVersion == 1 && nUBuckets == ADDRMAN_NEW_BUCKET_COUNT && vvNew[bucket][nUBucketPos] == -1 && info.nRefCount < ADDRMAN_NEW_BUCKETS_PER_ADDRESS)
+                        AddToNew(info, nIndex, bucket, nUBucketPos);
                 }
             }
         }
@@ -420,6 +488,15 @@ public:
             LogPrint("addrman", "addrman lost %i new and %i tried addresses due to collisions\n", nLostUnk, nLost);
         }
 
+        // Entries connected to shortly before shutdown still carry the lowered weight, restore it when it expires.
+        int64_t nNow = GetAdjustedTime();
+        for (std::map<int, CAddrInfo>::const_iterator it = mapInfo.begin(); it != mapInfo.end(); it++) {
+            if (nNow - it->second.nLastTry < ADDRMAN_RECENT_TRY_SECONDS)
+                vRecentTries.push_back(std::make_pair(it->second.nLastTry + ADDRMAN_RECENT_TRY_SECONDS, it->first));
+        }
+        std::sort(vRecentTries.begin(), vRecentTries.end());
+
+        nChanges++;
         Check();
     }
 
@@ -431,6 +508,8 @@ public:
     void Clear()
     {
         std::vector<int>().swap(vRandom);
+        mapInfo.clear();
+        mapAddr.clear();
         nKey = GetRandHash();
         for (size_t bucket = 0; bucket < ADDRMAN_NEW_BUCKET_COUNT; bucket++) {
             for (size_t entry = 0; entry < ADDRMAN_BUCKET_SIZE; entry++) {
@@ -442,13 +521,17 @@ public:
                 vvTried[bucket][entry] = -1;
             }
         }
+        weightsTried.Clear();
+        weightsNew.Clear();
+        vRecentTries.clear();
 
         nIdCount = 0;
         nTried = 0;
         nNew = 0;
+        nChanges++;
     }
 
-    CAddrMan()
+    CAddrMan() : weightsTried(ADDRMAN_TRIED_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE), weightsNew(ADDRMAN_NEW_BUCKET_COUNT * ADDRMAN_BUCKET_SIZE), nChanges(0)
     {
         Clear();
     }
@@ -464,6 +547,13 @@ public:
         return vRandom.size();
     }
 
+    //! Changes to the tables so far; peers.dat only needs rewriting when this moved.
+    uint64_t GetChanges() const
+    {
+        LOCK(cs);
+        return nChanges;
+    }
+
     //! Consistency check
     void Check()
     {
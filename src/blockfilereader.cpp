@@ -0,0 +1,160 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilereader.h"
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "crypto/common.h"
+#include "primitives/block.h"
+#include "serialize.h"
+
+#include <algorithm>
+#include <limits>
+#include <string.h>
+
+#ifndef WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+/** How far ahead of the read position the kernel is asked to prefetch */
+static const size_t BLOCKFILE_READAHEAD_SIZE = 0x1000000; // 16 MiB
+
+namespace
+{
+/** Deserializes from a range of memory without copying it first */
+class CMemoryReader
+{
+private:
+    const char* pcur;
+    const char* pend;
+    const int nType;
+    const int nVersion;
+
+public:
+    CMemoryReader(const char* pbegin, size_t nSize, int nTypeIn, int nVersionIn) : pcur(pbegin), pend(pbegin + nSize), nType(nTypeIn), nVersion(nVersionIn) {}
+
+    int GetType() const { return nType; }
+    int GetVersion() const { return nVersion; }
+
+    CMemoryReader& read(char* pch, size_t nSize)
+    {
+        if (nSize > (size_t)(pend - pcur))
+            throw std::ios_base::failure("CMemoryReader::read : end of data");
+        memcpy(pch, pcur, nSize);
+        pcur += nSize;
+        return *this;
+    }
+
+    template <typename T>
+    CMemoryReader& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj, nType, nVersion);
+        return *this;
+    }
+};
+} // anon namespace
+
+CMappedBlockFile::CMappedBlockFile(FILE* fileIn) : file(fileIn), pbegin(NULL), nSize(0), nPrefetched(0)
+{
+#ifndef WIN32
+    struct stat st;
+    if (!file || fstat(fileno(file), &st) != 0 || st.st_size <= 0 || (uint64_t)st.st_size > std::numeric_limits<size_t>::max())
+        return;
+    void* pmap = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+    if (pmap == MAP_FAILED)
+        return;
+    pbegin = (const char*)pmap;
+    nSize = (size_t)st.st_size;
+    posix_madvise(pmap, nSize, POSIX_MADV_SEQUENTIAL);
+    Prefetch(0);
+#endif
+}
+
+CMappedBlockFile::~CMappedBlockFile()
+{
+#ifndef WIN32
+    if (pbegin)
+        munmap((void*)pbegin, nSize);
+#endif
+    if (file)
+        fclose(file);
+}
+
+FILE* CMappedBlockFile::release()
+{
+    FILE* ret = file;
+    file = NULL;
+    return ret;
+}
+
+void CMappedBlockFile::Prefetch(size_t nPos)
+{
+#ifndef WIN32
+    // nPrefetched only ever grows by whole windows, so it stays page aligned
+    size_t nEnd = std::min(nSize, nPos + BLOCKFILE_READAHEAD_SIZE);
+    while (nPrefetched < nEnd) {
+        size_t nLen = std::min(BLOCKFILE_READAHEAD_SIZE, nSize - nPrefetched);
+        posix_madvise((void*)(pbegin + nPrefetched), nLen, POSIX_MADV_WILLNEED);
+        nPrefetched += nLen;
+    }
+#endif
+}
+
+void CMappedBlockFile::ScanHeaders(std::vector<CBlockFileEntry>& vEntries)
+{
+    vEntries.clear();
+    const MessageStartChars& pchMessageStart = Params().MessageStart();
+    size_t nPos = 0;
+    while (nPos + MESSAGE_START_SIZE + 4 <= nSize) {
+        const char* pmagic = (const char*)memchr(pbegin + nPos, pchMessageStart[0], nSize - nPos);
+        if (!pmagic)
+            break;
+        nPos = pmagic - pbegin;
+        if (nPos + MESSAGE_START_SIZE + 4 > nSize)
+            break;
+        Prefetch(nPos);
+
+        // start one byte further next time, in case of failure
+        size_t nNext = nPos + 1;
+        if (memcmp(pmagic, pchMessageStart, MESSAGE_START_SIZE) != 0) {
+            nPos = nNext;
+            continue;
+        }
+        unsigned int nBlockSize = ReadLE32((const unsigned char*)pmagic + MESSAGE_START_SIZE);
+        size_t nBlockPos = nPos + MESSAGE_START_SIZE + 4;
+        if (nBlockSize < 80 || nBlockSize > MAX_BLOCK_SIZE_CURRENT || nBlockSize > nSize - nBlockPos) {
+            nPos = nNext;
+            continue;
+        }
+
+        CBlockHeader header;
+        try {
+            CMemoryReader reader(pbegin + nBlockPos, nBlockSize, SER_DISK, CLIENT_VERSION);
+            reader >> header;
+        } catch (const std::exception&) {
+            nPos = nNext;
+            continue;
+        }
+
+        CBlockFileEntry entry;
+        entry.hash = header.GetHash();
+        entry.hashPrev = header.hashPrevBlock;
+        entry.nPos = nBlockPos;
+        entry.nSize = nBlockSize;
+        vEntries.push_back(entry);
+        nPos = nBlockPos + nBlockSize;
+    }
+}
+
+bool CMappedBlockFile::ReadBlock(const CBlockFileEntry& entry, CBlock& block)
+{
+    if (IsNull() || entry.nPos > nSize || entry.nSize > nSize - entry.nPos)
+        return false;
+    Prefetch(entry.nPos + entry.nSize);
+    CMemoryReader reader(pbegin + entry.nPos, entry.nSize, SER_DISK, CLIENT_VERSION);
+    reader >> block;
+    return true;
+}
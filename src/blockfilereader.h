@@ -0,0 +1,74 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_BLOCKFILEREADER_H
+#define BITCOIN_BLOCKFILEREADER_H
+
+#include "uint256.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <vector>
+
+class CBlock;
+
+/** A block frame found by CMappedBlockFile::ScanHeaders */
+struct CBlockFileEntry {
+    uint256 hash;
+    uint256 hashPrev;
+    uint64_t nPos;      //! offset of the serialized block, after magic and size
+    unsigned int nSize; //! size of the serialized block
+};
+
+/**
+ * Read-only memory mapping of a whole block file (blk?????.dat, bootstrap.dat
+ * or a -loadblock file), used by LoadExternalBlockFile.
+ *
+ * The kernel is told the file is read sequentially and asked to prefetch a
+ * window ahead of the last position read, so reindexing runs at disk speed
+ * instead of stalling on every page fault. Blocks are decoded straight from
+ * the mapped pages without a copy through a stream buffer.
+ *
+ * Not available on Windows or when the file can't be mapped (IsNull()); the
+ * caller then reads the file through CBufferedFile.
+ */
+class CMappedBlockFile
+{
+private:
+    FILE* file;
+    const char* pbegin;
+    size_t nSize;
+    size_t nPrefetched;
+
+    // Disallow copies
+    CMappedBlockFile(const CMappedBlockFile&);
+    CMappedBlockFile& operator=(const CMappedBlockFile&);
+
+    //! ask the kernel to read ahead up to nPos + the read-ahead window
+    void Prefetch(size_t nPos);
+
+public:
+    //! Takes over fileIn, the mapping keeps it open until destruction
+    explicit CMappedBlockFile(FILE* fileIn);
+    ~CMappedBlockFile();
+
+    bool IsNull() const { return pbegin == NULL; }
+    size_t size() const { return nSize; }
+
+    //! Give up the file without closing it (when falling back to another reader)
+    FILE* release();
+
+    /**
+     * Find every block frame (message start, size, block) in the file and
+     * decode only the headers, in file order. Frames that don't fit in the
+     * file or have an implausible size are skipped like CBufferedFile
+     * scanning would.
+     */
+    void ScanHeaders(std::vector<CBlockFileEntry>& vEntries);
+
+    //! Decode the full block of an entry returned by ScanHeaders
+    bool ReadBlock(const CBlockFileEntry& entry, CBlock& block);
+};
+
+#endif // BITCOIN_BLOCKFILEREADER_H
@@ -6,6 +6,7 @@
 
 #include "bloom.h"
 
+#include "crypto/common.h"
 #include "hash.h"
 #include "primitives/transaction.h"
 #include "script/script.h"
@@ -14,6 +15,7 @@
 
 #include <math.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include <boost/foreach.hpp>
 
@@ -22,6 +24,109 @@
 
 using namespace std;
 
+static inline uint32_t ROTL32(uint32_t x, int8_t r)
+{
+    return (x << r) | (x >> (32 - r));
+}
+
+CBloomTxElements::CBloomTxElements(const CTransaction& tx)
+{
+    vOutputEnd.reserve(tx.vout.size());
+
+    const uint256& hash = tx.GetHash();
+    AddElement(hash.begin(), hash.size());
+
+    BOOST_FOREACH (const CTxOut& txout, tx.vout) {
+        AddScript(txout.scriptPubKey);
+        vOutputEnd.push_back(vElements.size());
+    }
+
+    BOOST_FOREACH (const CTxIn& txin, tx.vin) {
+        // serialized the same way as insert(COutPoint) does
+        unsigned char prevout[36];
+        memcpy(prevout, txin.prevout.hash.begin(), 32);
+        WriteLE32(prevout + 32, txin.prevout.n);
+        AddElement(prevout, sizeof(prevout));
+        AddScript(txin.scriptSig);
+    }
+}
+
+void CBloomTxElements::AddElement(const unsigned char* pbegin, unsigned int nSize)
+{
+    // The body and tail mixing of MurmurHash3, see hash.cpp
+    const uint32_t c1 = 0xcc9e2d51;
+    const uint32_t c2 = 0x1b873593;
+
+    Element element;
+    element.nOffset = vWords.size();
+    element.nSize = nSize;
+    vElements.push_back(element);
+
+    const unsigned int nBlocks = nSize / 4;
+    for (unsigned int i = 0; i < nBlocks; i++) {
+        uint32_t k1;
+        memcpy(&k1, pbegin + i * 4, 4);
+        k1 *= c1;
+        k1 = ROTL32(k1, 15);
+        k1 *= c2;
+        vWords.push_back(k1);
+    }
+
+    const unsigned char* tail = pbegin + nBlocks * 4;
+    uint32_t k1 = 0;
+    switch (nSize & 3) {
+    case 3:
+        k1 ^= tail[2] << 16;
+    case 2:
+        k1 ^= tail[1] << 8;
+    case 1:
+        k1 ^= tail[0];
+        k1 *= c1;
+        k1 = ROTL32(k1, 15);
+        k1 *= c2;
+        vWords.push_back(k1);
+    };
+}
+
+void CBloomTxElements::AddScript(const CScript& script)
+{
+    // Every non-empty pushdata up to the first invalid opcode, in the order IsRelevantAndUpdate checks them
+    CScript::const_iterator pc = script.begin();
+    vector<unsigned char> data;
+    while (pc < script.end()) {
+        opcodetype opcode;
+        if (!script.GetOp(pc, opcode, data))
+            break;
+        if (data.size() != 0)
+            AddElement(&data[0], data.size());
+    }
+}
+
+uint32_t CBloomTxElements::Hash(unsigned int nElement, uint32_t nHashSeed) const
+{
+    const Element& element = vElements[nElement];
+    const uint32_t* pword = vWords.data() + element.nOffset;
+    const uint32_t* pend = pword + element.nSize / 4;
+
+    uint32_t h1 = nHashSeed;
+    for (; pword < pend; pword++) {
+        h1 ^= *pword;
+        h1 = ROTL32(h1, 13);
+        h1 = h1 * 5 + 0xe6546b64;
+    }
+    if (element.nSize & 3)
+        h1 ^= *pword;
+
+    h1 ^= element.nSize;
+    h1 ^= h1 >> 16;
+    h1 *= 0x85ebca6b;
+    h1 ^= h1 >> 13;
+    h1 *= 0xc2b2ae35;
+    h1 ^= h1 >> 16;
+
+    return h1;
+}
+
 CBloomFilter::CBloomFilter(unsigned int nElements, double nFPRate, unsigned int nTweakIn, unsigned char nFlagsIn) :
  /**	
  * The ideal size for a bloom filter with a given number of elements and false positive rate is:
@@ -103,6 +208,17 @@ bool CBloomFilter::contains(const uint256& hash) const
     return contains(data);
 }
 
+bool CBloomFilter::contains(const CBloomTxElements& elements, unsigned int nElement) const
+{
+    const unsigned int nBits = vData.size() * 8;
+    for (unsigned int i = 0; i < nHashFuncs; i++) {
+        unsigned int nIndex = elements.Hash(nElement, i * 0xFBA4C795 + nTweak) % nBits;
+        if (!(vData[nIndex >> 3] & (1 << (7 & nIndex))))
+            return false;
+    }
+    return true;
+}
+
 void CBloomFilter::clear()
 {
     vData.assign(vData.size(), 0);
@@ -116,6 +232,15 @@ bool CBloomFilter::IsWithinSizeConstraints() const
 }
 
 bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
+{
+    if (isFull)
+        return true;
+    if (isEmpty)
+        return false;
+    return IsRelevantAndUpdate(tx, CBloomTxElements(tx));
+}
+
+bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx, const CBloomTxElements& elements)
 {
     bool fFound = false;
     // Match if the filter contains the hash of tx
@@ -124,56 +249,42 @@ bool CBloomFilter::IsRelevantAndUpdate(const CTransaction& tx)
         return true;
     if (isEmpty)
         return false;
-    const uint256& hash = tx.GetHash();
-    if (contains(hash))
+    if (contains(elements, 0))
         fFound = true;
 
+    unsigned int nElement = 1;
     for (unsigned int i = 0; i < tx.vout.size(); i++) {
         const CTxOut& txout = tx.vout[i];
         // Match if the filter contains any arbitrary script data element in any scriptPubKey in tx
         // If this matches, also add the specific output that was matched.
         // This means clients don't have to update the filter themselves when a new relevant tx
         // is discovered in order to find spending transactions, which avoids round-tripping and race conditions.
-        CScript::const_iterator pc = txout.scriptPubKey.begin();
-        vector<unsigned char> data;
-        while (pc < txout.scriptPubKey.end()) {
-            opcodetype opcode;
-            if (!txout.scriptPubKey.GetOp(pc, opcode, data))
-                break;
-            if (data.size() != 0 && contains(data)) {
+        for (; nElement < elements.vOutputEnd[i]; nElement++) {
+            if (contains(elements, nElement)) {
                 fFound = true;
                 if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_ALL)
-                    insert(COutPoint(hash, i));
+                    insert(COutPoint(tx.GetHash(), i));
                 else if ((nFlags & BLOOM_UPDATE_MASK) == BLOOM_UPDATE_P2PUBKEY_ONLY) {
                     txnouttype type;
                     vector<vector<unsigned char> > vSolutions;
                     if (Solver(txout.scriptPubKey, type, vSolutions) &&
                         (type == TX_PUBKEY || type == TX_MULTISIG))
-                        insert(COutPoint(hash, i));
+                        insert(COutPoint(tx.GetHash(), i));
                 }
                 break;
             }
         }
+        nElement = elements.vOutputEnd[i];
     }
 
     if (fFound)
         return true;
 
-    BOOST_FOREACH (const CTxIn& txin, tx.vin) {
-        // Match if the filter contains an outpoint tx spends
-        if (contains(txin.prevout))
+    // Match if the filter contains an outpoint tx spends (the first element of every input)
+    // or any arbitrary script data element in any scriptSig in tx
+    for (; nElement < elements.size(); nElement++) {
+        if (contains(elements, nElement))
             return true;
-
-        // Match if the filter contains any arbitrary script data element in any scriptSig in tx
-        CScript::const_iterator pc = txin.scriptSig.begin();
-        vector<unsigned char> data;
-        while (pc < txin.scriptSig.end()) {
-            opcodetype opcode;
-            if (!txin.scriptSig.GetOp(pc, opcode, data))
-                break;
-            if (data.size() != 0 && contains(data))
-                return true;
-        }
     }
 
     return false;
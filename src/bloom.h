@@ -9,9 +9,11 @@
 
 #include "serialize.h"
 
+#include <stdint.h>
 #include <vector>
 
 class COutPoint;
+class CScript;
 class CTransaction;
 class uint256;
 
@@ -31,6 +33,45 @@ enum bloomflags {
     BLOOM_UPDATE_MASK = 3,
 };
 
+/**
+ * The data elements of a transaction that IsRelevantAndUpdate looks at: its
+ * hash, the pushdata of every scriptPubKey and scriptSig and the outpoints it
+ * spends, extracted once so the transaction can be matched against the
+ * filters of many peers without parsing its scripts again.
+ *
+ * The per block mixing of MurmurHash3 doesn't depend on the seed, so every
+ * element is stored as its premixed 32-bit words and each filter hash function
+ * only runs the seed dependent rounds.
+ */
+class CBloomTxElements
+{
+private:
+    struct Element {
+        uint32_t nOffset;
+        uint32_t nSize;
+    };
+
+    //! premixed words of all elements
+    std::vector<uint32_t> vWords;
+    //! the tx hash, then the elements of every output, then those of every input
+    std::vector<Element> vElements;
+    //! end of the elements of each output in vElements, each input follows as its prevout and scriptSig elements
+    std::vector<uint32_t> vOutputEnd;
+
+    void AddElement(const unsigned char* pbegin, unsigned int nSize);
+    void AddScript(const CScript& script);
+
+    friend class CBloomFilter;
+
+public:
+    explicit CBloomTxElements(const CTransaction& tx);
+
+    unsigned int size() const { return vElements.size(); }
+
+    //! Same as MurmurHash3(nHashSeed, data of element nElement)
+    uint32_t Hash(unsigned int nElement, uint32_t nHashSeed) const;
+};
+
 /**
  * BloomFilter is a probabilistic filter which SPV clients provide
  * so that we can filter the transactions we sends them.
@@ -53,6 +94,7 @@ private:
     unsigned char nFlags;
 
     unsigned int Hash(unsigned int nHashNum, const std::vector<unsigned char>& vDataToHash) const;
+    bool contains(const CBloomTxElements& elements, unsigned int nElement) const;
 
 public:
     /**
@@ -94,6 +136,8 @@ public:
 
     //! Also adds any outputs which match the filter to the filter (to match their spending txes)
     bool IsRelevantAndUpdate(const CTransaction& tx);
+    //! Same as above, with the data elements of tx already extracted
+    bool IsRelevantAndUpdate(const CTransaction& tx, const CBloomTxElements& elements);
 
     //! Checks for empty and full filters to avoid wasting cpu
     void UpdateEmptyFull();
@@ -99,6 +99,9 @@ enum BlockStatus {
     BLOCK_FAILED_VALID = 32, //! stage after last reached validness failed
     BLOCK_FAILED_CHILD = 64, //! descends from failed block
     BLOCK_FAILED_MASK = BLOCK_FAILED_VALID | BLOCK_FAILED_CHILD,
+
+    //! stake not checked yet: header only, on top of such a block or staking an output not known yet
+    BLOCK_STAKE_PENDING = 128,
 };
 
 /** The block chain is a tree shaped structure starting with the
@@ -174,6 +174,11 @@ public:
 
 		convertSeed6(vFixedSeeds, pnSeed6_main, ARRAYLEN(pnSeed6_main));
 
+        // Snapshots -loadsnapshot accepts: mapSnapshots[height] = {block hash, snapshot_hash from dumptxoutset}.
+        // None are published yet, so -loadsnapshot stays out of the regular help and refuses to start;
+        // testnet and regtest inherit the empty list, the unit tests add theirs with setSnapshot.
+        mapSnapshots.clear();
+
         fMiningRequiresPeers = false;
         fAllowMinDifficultyBlocks = false;
         fDefaultConsistencyChecks = false;
@@ -181,7 +186,7 @@ public:
         fMineBlocksOnDemand = false;
         fSkipProofOfWorkCheck = false;
         fTestnetToBeDeprecatedFieldRPC = false;
-        fHeadersFirstSyncingActive = false;
+        fHeadersFirstSyncingActive = true;
 
         nPoolMaxTransactions = 3;
         strSporkKey = "0400994128f49c097b6911500a0f40fd6f0886f716d2f56100f375f3977c9efc7756271d36315abaa10cdf97a00c013d6efd8852d7da0b79becbff96436c05f419";
@@ -377,6 +382,14 @@ public:
     virtual void setDefaultConsistencyChecks(bool afDefaultConsistencyChecks) { fDefaultConsistencyChecks = afDefaultConsistencyChecks; }
     virtual void setAllowMinDifficultyBlocks(bool afAllowMinDifficultyBlocks) { fAllowMinDifficultyBlocks = afAllowMinDifficultyBlocks; }
     virtual void setSkipProofOfWorkCheck(bool afSkipProofOfWorkCheck) { fSkipProofOfWorkCheck = afSkipProofOfWorkCheck; }
+    virtual void setSnapshot(int anHeight, const uint256& ahashBlock, const uint256& ahashSnapshot)
+    {
+        CSnapshotData& snapshot = mapSnapshots[anHeight];
+        snapshot.hashBlock = ahashBlock;
+        snapshot.hashSnapshot = ahashSnapshot;
+    }
+    virtual void setZerocoinStartHeight(int anZerocoinStartHeight) { nZerocoinStartHeight = anZerocoinStartHeight; }
+    virtual void setZerocoinBlockV2Start(int anBlockZerocoinV2) { nBlockZerocoinV2 = anBlockZerocoinV2; }
 };
 static CUnitTestParams unitTestParams;
 
@@ -16,6 +16,7 @@
 #include "uint256.h"
 
 #include "libzerocoin/Params.h"
+#include <map>
 #include <vector>
 
 typedef unsigned char MessageStartChars[MESSAGE_START_SIZE];
@@ -25,6 +26,13 @@ struct CDNSSeedData {
     CDNSSeedData(const std::string& strName, const std::string& strHost) : name(strName), host(strHost) {}
 };
 
+/** A chain state snapshot -loadsnapshot accepts (see utxosnapshot.h) */
+struct CSnapshotData {
+    uint256 hashBlock;    //!< the block the snapshot was taken at
+    uint256 hashSnapshot; //!< the file checksum dumptxoutset reports as "snapshot_hash"
+};
+typedef std::map<int, CSnapshotData> MapSnapshotData;
+
 /**
  * CChainParams defines various tweakable parameters of a given instance of the
  * Forex Trading system. There are three: the main network on which people trade goods
@@ -90,6 +98,8 @@ public:
     const std::vector<unsigned char>& Base58Prefix(Base58Type type) const { return base58Prefixes[type]; }
     const std::vector<CAddress>& FixedSeeds() const { return vFixedSeeds; }
     virtual const Checkpoints::CCheckpointData& Checkpoints() const = 0;
+    /** Snapshots -loadsnapshot accepts, by base block height */
+    const MapSnapshotData& Snapshots() const { return mapSnapshots; }
     int PoolMaxTransactions() const { return nPoolMaxTransactions; }
 
     /** Spork key and Masternode Handling **/
@@ -155,6 +165,7 @@ protected:
     std::string strNetworkID;
     CBlock genesis;
     std::vector<CAddress> vFixedSeeds;
+    MapSnapshotData mapSnapshots;
     bool fMiningRequiresPeers;
     bool fAllowMinDifficultyBlocks;
     bool fDefaultConsistencyChecks;
@@ -208,6 +219,9 @@ public:
     virtual void setDefaultConsistencyChecks(bool aDefaultConsistencyChecks) = 0;
     virtual void setAllowMinDifficultyBlocks(bool aAllowMinDifficultyBlocks) = 0;
     virtual void setSkipProofOfWorkCheck(bool aSkipProofOfWorkCheck) = 0;
+    virtual void setSnapshot(int anHeight, const uint256& ahashBlock, const uint256& ahashSnapshot) = 0;
+    virtual void setZerocoinStartHeight(int anZerocoinStartHeight) = 0;
+    virtual void setZerocoinBlockV2Start(int anBlockZerocoinV2) = 0;
 };
 
 
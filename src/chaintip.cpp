@@ -0,0 +1,44 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "chaintip.h"
+
+#include "chain.h"
+#include "main.h"
+#include "txmempool.h"
+
+#include <boost/thread/mutex.hpp>
+
+namespace
+{
+//! guards only the pointer swap, readers never wait on validation
+boost::mutex csChainTip;
+CChainTipSnapshotRef chainTipSnapshot = std::make_shared<const CChainTipSnapshot>();
+}
+
+CChainTipSnapshotRef GetChainTipSnapshot()
+{
+    boost::unique_lock<boost::mutex> lock(csChainTip);
+    return chainTipSnapshot;
+}
+
+void PublishChainTipSnapshot()
+{
+    AssertLockHeld(cs_main);
+
+    std::shared_ptr<CChainTipSnapshot> snapshot = std::make_shared<CChainTipSnapshot>();
+    snapshot->pindexTip = chainActive.Tip();
+    snapshot->nHeight = chainActive.Height();
+    if (snapshot->pindexTip)
+        snapshot->hashTip = snapshot->pindexTip->GetBlockHash();
+    if (pindexBestHeader) {
+        snapshot->nHeaderHeight = pindexBestHeader->nHeight;
+        snapshot->hashBestHeader = pindexBestHeader->GetBlockHash();
+    }
+    snapshot->nMempoolTx = mempool.size();
+    snapshot->nMempoolBytes = mempool.GetTotalTxSize();
+
+    boost::unique_lock<boost::mutex> lock(csChainTip);
+    chainTipSnapshot = snapshot;
+}
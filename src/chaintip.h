@@ -0,0 +1,52 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_CHAINTIP_H
+#define BITCOIN_CHAINTIP_H
+
+#include "uint256.h"
+
+#include <stdint.h>
+
+#include <memory>
+
+class CBlockIndex;
+
+/**
+ * Immutable summary of the active chain and the mempool, taken whenever the
+ * tip, the best header or the mempool changes.
+ *
+ * Read-only RPCs that only report chain metadata use it instead of locking
+ * cs_main, so polling them doesn't hold up block validation. The fields read
+ * through pindexTip (height, hash, time, nBits, nChainWork, nChainTx) don't
+ * change once the block is connected. UnloadBlockIndex() publishes an empty
+ * snapshot when it drops the index, so pindexTip must not be kept past the
+ * call that fetched the snapshot.
+ */
+class CChainTipSnapshot
+{
+public:
+    //! active chain tip, NULL before the block index is loaded
+    CBlockIndex* pindexTip;
+    int nHeight;
+    uint256 hashTip;
+    //! most-work header, -1 height if none is known yet
+    int nHeaderHeight;
+    uint256 hashBestHeader;
+    //! mempool as of the moment the snapshot was taken
+    uint64_t nMempoolTx;
+    uint64_t nMempoolBytes;
+
+    CChainTipSnapshot() : pindexTip(NULL), nHeight(-1), nHeaderHeight(-1), nMempoolTx(0), nMempoolBytes(0) {}
+};
+
+typedef std::shared_ptr<const CChainTipSnapshot> CChainTipSnapshotRef;
+
+/** Most recently published snapshot, never NULL */
+CChainTipSnapshotRef GetChainTipSnapshot();
+
+/** Take a new snapshot of chainActive, pindexBestHeader and the mempool. Requires cs_main */
+void PublishChainTipSnapshot();
+
+#endif // BITCOIN_CHAINTIP_H
@@ -434,6 +434,12 @@ public:
     void SetBestBlock(const uint256& hashBlock);
     bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock);
 
+    /**
+     * Check if we have the given tx already loaded in this cache, without
+     * fetching it from the backing view.
+     */
+    bool HaveCoinsInCache(const uint256& txid) const;
+
     /**
      * Return a pointer to CCoins in the cache, or NULL if not found. This is
      * more efficient than GetCoins. Modifications to other cache entries are
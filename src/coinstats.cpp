@@ -0,0 +1,328 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinstats.h"
+
+#include "clientversion.h"
+#include "crypto/sha256.h"
+#include "hash.h"
+#include "main.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <set>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
+CCoinsStatsTracker coinsStatsTracker;
+
+CMuHash3072::CMuHash3072() : value(1)
+{
+}
+
+const CBigNum& CMuHash3072::Modulus()
+{
+    static const CBigNum bnModulus = (CBigNum(1) << 3072) - CBigNum(1103717);
+    return bnModulus;
+}
+
+CBigNum CMuHash3072::ToNum(const std::vector<unsigned char>& vch)
+{
+    // expand the element's hash to 384 bytes: SHA256(SHA256(data) || counter)
+    unsigned char hash[CSHA256::OUTPUT_SIZE];
+    CSHA256().Write(vch.empty() ? NULL : &vch[0], vch.size()).Finalize(hash);
+
+    std::vector<unsigned char> vchNum(384 + 1, 0); // trailing zero keeps it positive
+    for (unsigned char i = 0; i < 384 / CSHA256::OUTPUT_SIZE; i++)
+        CSHA256().Write(hash, sizeof(hash)).Write(&i, 1).Finalize(&vchNum[i * CSHA256::OUTPUT_SIZE]);
+
+    CBigNum bn;
+    bn.setvch(vchNum);
+    return bn % Modulus();
+}
+
+void CMuHash3072::Insert(const std::vector<unsigned char>& vch)
+{
+    value = value.mul_mod(ToNum(vch), Modulus());
+}
+
+void CMuHash3072::Remove(const std::vector<unsigned char>& vch)
+{
+    value = value.mul_mod(ToNum(vch).inverse(Modulus()), Modulus());
+}
+
+CMuHash3072& CMuHash3072::operator*=(const CMuHash3072& other)
+{
+    value = value.mul_mod(other.value, Modulus());
+    return *this;
+}
+
+uint256 CMuHash3072::Finalize() const
+{
+    std::vector<unsigned char> vch = value.getvch();
+    vch.resize(384, 0);
+    return Hash(vch.begin(), vch.end());
+}
+
+/** The data hash_serialized and the muhash cover for one coins entry */
+template <typename Stream>
+static void WriteCoinsForHash(Stream& ss, const uint256& txhash, const CCoins& coins)
+{
+    ss << txhash;
+    ss << VARINT(coins.nVersion);
+    ss << (coins.fCoinBase ? 'c' : 'n');
+    ss << VARINT(coins.nHeight);
+    for (unsigned int i = 0; i < coins.vout.size(); i++) {
+        const CTxOut& out = coins.vout[i];
+        if (!out.IsNull()) {
+            ss << VARINT(i + 1);
+            ss << out;
+        }
+    }
+    ss << VARINT(0);
+}
+
+void AddCoinsToMuHash(CMuHash3072& muhash, const uint256& txhash, const CCoins& coins)
+{
+    CDataStream ss(SER_GETHASH, PROTOCOL_VERSION);
+    WriteCoinsForHash(ss, txhash, coins);
+    muhash.Insert(std::vector<unsigned char>(ss.begin(), ss.end()));
+}
+
+static void AddCoinsToStats(CCoinsStats& stats, const CCoins& coins, unsigned int nValueSize)
+{
+    stats.nTransactions++;
+    for (unsigned int i = 0; i < coins.vout.size(); i++) {
+        const CTxOut& out = coins.vout[i];
+        if (!out.IsNull()) {
+            stats.nTransactionOutputs++;
+            stats.nTotalAmount += out.nValue;
+        }
+    }
+    stats.nSerializedSize += 32 + nValueSize;
+}
+
+namespace
+{
+/** One thread's share of a UTXO scan */
+struct CScanRange {
+    unsigned int nBegin;
+    unsigned int nEnd;
+    CoinStatsHashType hashType;
+    CCoinsStats stats;
+    CMuHash3072 muhash;
+    bool fOk;
+
+    CScanRange() : nBegin(0), nEnd(0), hashType(COINSTATS_HASH_NONE), fOk(false) {}
+};
+
+bool ScanCoins(CScanRange* prange, CHashWriter* pss, const uint256& txhash, const CCoins& coins, unsigned int nValueSize)
+{
+    AddCoinsToStats(prange->stats, coins, nValueSize);
+    if (prange->hashType == COINSTATS_HASH_SERIALIZED) {
+        WriteCoinsForHash(*pss, txhash, coins);
+    } else if (prange->hashType == COINSTATS_HASH_MUHASH) {
+        AddCoinsToMuHash(prange->muhash, txhash, coins);
+    }
+    return true;
+}
+
+void ScanRange(const CCoinsViewDB* pview, const leveldb::Snapshot* psnapshot, CScanRange* prange, CHashWriter* pss)
+{
+    prange->fOk = pview->ForEachCoins(psnapshot, prange->nBegin, prange->nEnd, boost::bind(&ScanCoins, prange, pss, _1, _2, _3));
+}
+} // anon namespace
+
+int GetUTXOStatsThreads()
+{
+    int nThreads = boost::thread::hardware_concurrency();
+    return std::max(1, std::min(nThreads, MAX_COINSTATS_THREADS));
+}
+
+bool GetUTXOStats(const CCoinsViewDB* pview, const leveldb::Snapshot* psnapshot, CCoinsStats& stats, CoinStatsHashType hashType, int nThreads)
+{
+    stats.hashBlock = pview->GetBestBlock(psnapshot);
+
+    // hash_serialized depends on the order of the entries, it has to be a single pass
+    if (hashType == COINSTATS_HASH_SERIALIZED)
+        nThreads = 1;
+    nThreads = std::max(1, std::min(nThreads, MAX_COINSTATS_THREADS));
+
+    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
+    ss << stats.hashBlock;
+
+    std::vector<CScanRange> vRanges(nThreads);
+    for (int i = 0; i < nThreads; i++) {
+        vRanges[i].nBegin = 256 * i / nThreads;
+        vRanges[i].nEnd = 256 * (i + 1) / nThreads;
+        vRanges[i].hashType = hashType;
+    }
+
+    if (nThreads == 1) {
+        ScanRange(pview, psnapshot, &vRanges[0], &ss);
+    } else {
+        boost::thread_group threadGroup;
+        for (int i = 0; i < nThreads; i++)
+            threadGroup.create_thread(boost::bind(&ScanRange, pview, psnapshot, &vRanges[i], (CHashWriter*)NULL));
+        try {
+            threadGroup.join_all();
+        } catch (const boost::thread_interrupted&) {
+            // the workers use our stack, don't leave before they do
+            threadGroup.interrupt_all();
+            threadGroup.join_all();
+            throw;
+        }
+    }
+
+    CMuHash3072 muhash;
+    for (int i = 0; i < nThreads; i++) {
+        const CScanRange& range = vRanges[i];
+        if (!range.fOk)
+            return false;
+        stats.nTransactions += range.stats.nTransactions;
+        stats.nTransactionOutputs += range.stats.nTransactionOutputs;
+        stats.nSerializedSize += range.stats.nSerializedSize;
+        stats.nTotalAmount += range.stats.nTotalAmount;
+        muhash *= range.muhash;
+    }
+
+    if (hashType == COINSTATS_HASH_SERIALIZED)
+        stats.hashSerialized = ss.GetHash();
+    else if (hashType == COINSTATS_HASH_MUHASH)
+        stats.hashSerialized = muhash.Finalize();
+    return true;
+}
+
+CCoinsStatsTracker::CDelta CCoinsStatsTracker::GetDelta(const CBlock& block, CCoinsViewCache& viewOld, CCoinsViewCache& viewNew)
+{
+    std::set<uint256> setTouched;
+    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
+        setTouched.insert(tx.GetHash());
+        if (tx.IsCoinBase() || tx.IsZerocoinSpend())
+            continue;
+        BOOST_FOREACH (const CTxIn& txin, tx.vin)
+            setTouched.insert(txin.prevout.hash);
+    }
+
+    CDelta delta;
+    BOOST_FOREACH (const uint256& txhash, setTouched) {
+        for (int nSign = -1; nSign <= 1; nSign += 2) {
+            const CCoins* coins = (nSign < 0 ? viewOld : viewNew).AccessCoins(txhash);
+            if (!coins || coins->IsPruned())
+                continue;
+            CCoinsStats stats;
+            AddCoinsToStats(stats, *coins, ::GetSerializeSize(*coins, SER_DISK, CLIENT_VERSION));
+            delta.nTransactions += nSign * (int64_t)stats.nTransactions;
+            delta.nTransactionOutputs += nSign * (int64_t)stats.nTransactionOutputs;
+            delta.nSerializedSize += nSign * (int64_t)stats.nSerializedSize;
+            delta.nTotalAmount += nSign * stats.nTotalAmount;
+        }
+    }
+    return delta;
+}
+
+void CCoinsStatsTracker::Apply(CCoinsStats& stats, const CDelta& delta, int nSign)
+{
+    stats.nTransactions += nSign * delta.nTransactions;
+    stats.nTransactionOutputs += nSign * delta.nTransactionOutputs;
+    stats.nSerializedSize += nSign * delta.nSerializedSize;
+    stats.nTotalAmount += nSign * delta.nTotalAmount;
+}
+
+void CCoinsStatsTracker::Enable()
+{
+    fEnabled = true;
+}
+
+void CCoinsStatsTracker::BlockConnected(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& viewOld, CCoinsViewCache& viewNew)
+{
+    if (!fEnabled)
+        return;
+
+    CDelta delta = GetDelta(block, viewOld, viewNew);
+    delta.hashPrev = pindex->pprev ? pindex->pprev->GetBlockHash() : uint256(0);
+
+    const uint256& hash = pindex->GetBlockHash();
+    if (!mapBlockDeltas.count(hash)) {
+        vBlockDeltaOrder.push_back(hash);
+        if (vBlockDeltaOrder.size() > MAX_BLOCK_DELTAS) {
+            mapBlockDeltas.erase(vBlockDeltaOrder.front());
+            vBlockDeltaOrder.pop_front();
+        }
+    }
+    mapBlockDeltas[hash] = delta;
+
+    if (!fValid)
+        return;
+    if (totals.hashBlock != delta.hashPrev) {
+        fValid = false;
+        return;
+    }
+    Apply(totals, delta, 1);
+    totals.hashBlock = hash;
+    totals.nHeight = pindex->nHeight;
+}
+
+void CCoinsStatsTracker::BlockDisconnected(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& viewOld, CCoinsViewCache& viewNew)
+{
+    if (!fEnabled || !fValid)
+        return;
+    if (totals.hashBlock != pindex->GetBlockHash() || !pindex->pprev) {
+        fValid = false;
+        return;
+    }
+    Apply(totals, GetDelta(block, viewOld, viewNew), 1);
+    totals.hashBlock = pindex->pprev->GetBlockHash();
+    totals.nHeight = pindex->pprev->nHeight;
+}
+
+bool CCoinsStatsTracker::SetBaseline(const CCoinsStats& stats)
+{
+    fEnabled = true;
+
+    BlockMap::iterator mi = mapBlockIndex.find(stats.hashBlock);
+    if (mi == mapBlockIndex.end() || !chainActive.Contains(mi->second))
+        return false;
+
+    CCoinsStats baseline;
+    baseline.nHeight = mi->second->nHeight;
+    baseline.hashBlock = stats.hashBlock;
+    baseline.nTransactions = stats.nTransactions;
+    baseline.nTransactionOutputs = stats.nTransactionOutputs;
+    baseline.nSerializedSize = stats.nSerializedSize;
+    baseline.nTotalAmount = stats.nTotalAmount;
+
+    // blocks connected while the snapshot was being scanned
+    for (CBlockIndex* pindex = chainActive.Next(mi->second); pindex; pindex = chainActive.Next(pindex)) {
+        std::map<uint256, CDelta>::const_iterator it = mapBlockDeltas.find(pindex->GetBlockHash());
+        if (it == mapBlockDeltas.end() || it->second.hashPrev != baseline.hashBlock)
+            return false;
+        Apply(baseline, it->second, 1);
+        baseline.hashBlock = pindex->GetBlockHash();
+        baseline.nHeight = pindex->nHeight;
+    }
+
+    totals = baseline;
+    fValid = true;
+    return true;
+}
+
+bool CCoinsStatsTracker::GetTotals(CCoinsStats& stats) const
+{
+    if (!fValid || !chainActive.Tip() || totals.hashBlock != chainActive.Tip()->GetBlockHash())
+        return false;
+    stats = totals;
+    return true;
+}
+
+void CCoinsStatsTracker::Clear()
+{
+    fEnabled = false;
+    fValid = false;
+    totals = CCoinsStats();
+    mapBlockDeltas.clear();
+    vBlockDeltaOrder.clear();
+}
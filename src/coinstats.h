@@ -0,0 +1,127 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_COINSTATS_H
+#define BITCOIN_COINSTATS_H
+
+#include "amount.h"
+#include "coins.h"
+#include "libzerocoin/bignum.h"
+#include "uint256.h"
+
+#include <deque>
+#include <map>
+#include <vector>
+
+class CBlock;
+class CBlockIndex;
+class CCoinsViewDB;
+class CCoinsStatsTracker;
+
+namespace leveldb
+{
+class Snapshot;
+}
+
+/** Upper bound on the number of threads used to scan the coin database */
+static const int MAX_COINSTATS_THREADS = 16;
+
+/** Which set hash a UTXO scan computes */
+enum CoinStatsHashType {
+    COINSTATS_HASH_NONE,       //! totals only
+    COINSTATS_HASH_SERIALIZED, //! legacy hash_serialized, single threaded
+    COINSTATS_HASH_MUHASH,     //! order independent, ranges are hashed in parallel
+};
+
+extern CCoinsStatsTracker coinsStatsTracker;
+
+/**
+ * Multiplicative set hash over the integers modulo 2^3072 - 1103717.
+ * Every element is expanded to a 3072-bit number and multiplied into the
+ * running product, so the result doesn't depend on insertion order and the
+ * products of disjoint subsets can be combined.
+ */
+class CMuHash3072
+{
+private:
+    CBigNum value;
+
+    static const CBigNum& Modulus();
+    static CBigNum ToNum(const std::vector<unsigned char>& vch);
+
+public:
+    CMuHash3072();
+
+    void Insert(const std::vector<unsigned char>& vch);
+    void Remove(const std::vector<unsigned char>& vch);
+    CMuHash3072& operator*=(const CMuHash3072& other);
+
+    uint256 Finalize() const;
+};
+
+/**
+ * Block-by-block totals of the UTXO set (everything in CCoinsStats but the hashes).
+ *
+ * Disabled until the first scan asks for it, then every block connected or
+ * disconnected by ConnectTip/DisconnectTip adjusts the totals by the
+ * difference of the coins entries it touched, so gettxoutsetinfo can answer
+ * without walking the database. The deltas of recent blocks are kept to bring
+ * a baseline scanned from an older snapshot up to the tip.
+ */
+class CCoinsStatsTracker
+{
+private:
+    struct CDelta {
+        uint256 hashPrev;
+        int64_t nTransactions;
+        int64_t nTransactionOutputs;
+        int64_t nSerializedSize;
+        CAmount nTotalAmount;
+
+        CDelta() : hashPrev(0), nTransactions(0), nTransactionOutputs(0), nSerializedSize(0), nTotalAmount(0) {}
+    };
+
+    static const unsigned int MAX_BLOCK_DELTAS = 1000;
+
+    bool fEnabled;
+    bool fValid;
+    CCoinsStats totals;
+    std::map<uint256, CDelta> mapBlockDeltas;
+    std::deque<uint256> vBlockDeltaOrder;
+
+    static CDelta GetDelta(const CBlock& block, CCoinsViewCache& viewOld, CCoinsViewCache& viewNew);
+    static void Apply(CCoinsStats& stats, const CDelta& delta, int nSign);
+
+public:
+    CCoinsStatsTracker() : fEnabled(false), fValid(false) {}
+
+    //! Start collecting block deltas
+    void Enable();
+
+    //! viewOld holds the coins without the block, viewNew with it (requires cs_main)
+    void BlockConnected(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& viewOld, CCoinsViewCache& viewNew);
+    //! viewOld holds the coins with the block, viewNew without it (requires cs_main)
+    void BlockDisconnected(const CBlock& block, const CBlockIndex* pindex, CCoinsViewCache& viewOld, CCoinsViewCache& viewNew);
+
+    //! Start from the result of a full scan, catching up to the tip if needed (requires cs_main)
+    bool SetBaseline(const CCoinsStats& stats);
+    //! Current totals, false if there is no baseline (requires cs_main)
+    bool GetTotals(CCoinsStats& stats) const;
+
+    void Clear();
+};
+
+/**
+ * Walk psnapshot of the coin database with up to nThreads threads and fill in
+ * stats (all fields but nHeight, which the caller knows from the block index).
+ */
+bool GetUTXOStats(const CCoinsViewDB* pview, const leveldb::Snapshot* psnapshot, CCoinsStats& stats, CoinStatsHashType hashType, int nThreads);
+
+/** Number of threads to use for UTXO scans on this machine */
+int GetUTXOStatsThreads();
+
+/** Add a coins entry to a muhash the way gettxoutsetinfo does */
+void AddCoinsToMuHash(CMuHash3072& muhash, const uint256& txhash, const CCoins& coins);
+
+#endif // BITCOIN_COINSTATS_H
@@ -9,6 +9,7 @@
 #include "base58.h"
 #include "chainparams.h"
 #include "httpserver.h"
+#include "jsonstream.h"
 #include "rpc/protocol.h"
 #include "rpc/server.h"
 #include "random.h"
@@ -90,6 +91,54 @@ static bool RPCAuthorized(const std::string& strAuth)
     return TimingResistantEqual(strUserPass, strRPCUserColonPass);
 }
 
+/**
+ * Reply to a single request whose method can stream its result. Once the reply
+ * outgrows one chunk it is sent chunked while it is being produced, a smaller
+ * one goes out as usual.
+ * @returns false, sending nothing, if the method has no stream actor.
+ */
+static bool JSONRPCStreamReply(HTTPRequest* req, const JSONRequest& jreq)
+{
+    bool fChunked = false;
+    CJSONStream stream(JSON_STREAM_CHUNK_SIZE, [&](const std::string& strChunk) {
+        if (!fChunked) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->StartReplyChunked(HTTP_OK);
+            fChunked = true;
+        }
+        if (!req->WriteReplyChunk(strChunk))
+            throw jsonstream_aborted("client went away");
+    });
+
+    try {
+        stream.BeginObject().Key("result");
+        if (!tableRPC.executeStream(jreq.strMethod, jreq.params, stream))
+            return false;
+        stream.Key("error").Null().Key("id").Value(jreq.id).EndObject().Raw("\n");
+        if (fChunked)
+            stream.Flush();
+    } catch (const jsonstream_aborted& e) {
+        LogPrint("http", "%s: %s reply aborted, %s\n", __func__, jreq.strMethod, e.what());
+        req->AbortReplyChunked();
+        return true;
+    } catch (...) {
+        // until the first chunk is out, the caller can still send an error reply
+        if (!fChunked)
+            throw;
+        LogPrintf("%s: %s failed after part of its reply was sent\n", __func__, jreq.strMethod);
+        req->AbortReplyChunked();
+        return true;
+    }
+
+    if (fChunked) {
+        req->EndReplyChunked();
+    } else {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, stream.GetBuffer());
+    }
+    return true;
+}
+
 static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
 {
     // JSONRPC handles only POST
@@ -128,6 +177,9 @@ static bool HTTPReq_JSONRPC(HTTPRequest* req, const std::string &)
         if (valRequest.isObject()) {
             jreq.parse(valRequest);
 
+            if (JSONRPCStreamReply(req, jreq))
+                return true;
+
             UniValue result = tableRPC.execute(jreq.strMethod, jreq.params);
 
             // Send reply
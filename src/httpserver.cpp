@@ -538,13 +538,105 @@ void HTTPEvent::trigger(struct timeval* tv)
     else
         evtimer_add(ev, tv); // trigger after timeval passed
 }
+/** Progress of a chunked reply, shared by the worker writing it and the http thread sending it */
+struct HTTPChunkState {
+    boost::mutex mutex;
+    boost::condition_variable cond;
+    //! bytes queued with WriteReplyChunk and not sent to the client yet
+    size_t nQueued;
+    //! bytes handed to libevent since its last "all sent" callback
+    size_t nHandedOver;
+    //! the connection closed, libevent freed the request (http thread only)
+    bool fClosed;
+    //! the worker stopped sending, the client is gone or stalled
+    bool fAbandoned;
+
+    HTTPChunkState() : nQueued(0), nHandedOver(0), fClosed(false), fAbandoned(false) {}
+
+    void Sent(size_t nSize)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        nQueued -= nSize;
+        cond.notify_all();
+    }
+};
+
+static void http_chunk_closed_cb(struct evhttp_connection*, void* arg)
+{
+    HTTPChunkState& state = **(std::shared_ptr<HTTPChunkState>*)arg;
+    boost::unique_lock<boost::mutex> lock(state.mutex);
+    state.fClosed = true;
+    state.cond.notify_all();
+}
+
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+static void http_chunk_sent_cb(struct evhttp_connection*, void* arg)
+{
+    // libevent calls this when its output buffer drained, everything handed over is sent
+    HTTPChunkState& state = **(std::shared_ptr<HTTPChunkState>*)arg;
+    size_t nSent = state.nHandedOver;
+    state.nHandedOver = 0;
+    state.Sent(nSent);
+}
+#endif
+
+static void http_reply_start(struct evhttp_request* req, int nStatus, std::shared_ptr<HTTPChunkState>* pstate)
+{
+    evhttp_send_reply_start(req, nStatus, NULL);
+    evhttp_connection_set_closecb(evhttp_request_get_connection(req), http_chunk_closed_cb, pstate);
+}
+
+static void http_reply_chunk(struct evhttp_request* req, struct evbuffer* buf, std::shared_ptr<HTTPChunkState>* pstate)
+{
+    HTTPChunkState& state = **pstate;
+    size_t nSize = evbuffer_get_length(buf);
+    if (state.fClosed) {
+        state.Sent(nSize);
+    } else {
+#if LIBEVENT_VERSION_NUMBER >= 0x02010100
+        state.nHandedOver += nSize;
+        evhttp_send_reply_chunk_with_cb(req, buf, http_chunk_sent_cb, pstate);
+#else
+        // no notification when it's on the wire, only bound what waits for this thread
+        evhttp_send_reply_chunk(req, buf);
+        state.Sent(nSize);
+#endif
+    }
+    evbuffer_free(buf);
+}
+
+static void http_reply_end(struct evhttp_request* req, std::shared_ptr<HTTPChunkState>* pstate)
+{
+    if (!(*pstate)->fClosed) {
+        evhttp_connection_set_closecb(evhttp_request_get_connection(req), NULL, NULL);
+        evhttp_send_reply_end(req);
+    }
+    delete pstate;
+}
+
+static void http_reply_abort(struct evhttp_request* req, std::shared_ptr<HTTPChunkState>* pstate)
+{
+    if (!(*pstate)->fClosed) {
+        // dropping the connection frees req as well, without the final "0\r\n\r\n"
+        struct evhttp_connection* evcon = evhttp_request_get_connection(req);
+        evhttp_connection_set_closecb(evcon, NULL, NULL);
+        evhttp_connection_free(evcon);
+    }
+    delete pstate;
+}
+
 HTTPRequest::HTTPRequest(struct evhttp_request* req) : req(req),
-                                                       replySent(false)
+                                                       replySent(false),
+                                                       pchunkStateHttp(NULL)
 {
 }
 HTTPRequest::~HTTPRequest()
 {
-    if (!replySent) {
+    if (!replySent && chunkState) {
+        // the body is cut short, but the request must be given back
+        LogPrintf("%s: Unfinished chunked reply\n", __func__);
+        AbortReplyChunked();
+    } else if (!replySent) {
         // Keep track of whether reply was sent to avoid request leaks
         LogPrintf("%s: Unhandled request\n", __func__);
         WriteReply(HTTP_INTERNAL, "Unhandled request");
@@ -609,6 +701,61 @@ void HTTPRequest::WriteReply(int nStatus, const std::string& strReply)
     req = 0; // transferred back to main thread
 }
 
+void HTTPRequest::StartReplyChunked(int nStatus)
+{
+    assert(!replySent && req && !chunkState);
+    chunkState.reset(new HTTPChunkState());
+    pchunkStateHttp = new std::shared_ptr<HTTPChunkState>(chunkState);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(http_reply_start, req, nStatus, pchunkStateHttp));
+    ev->trigger(0);
+}
+
+bool HTTPRequest::WriteReplyChunk(const std::string& strChunk)
+{
+    assert(!replySent && req && chunkState);
+    {
+        boost::unique_lock<boost::mutex> lock(chunkState->mutex);
+        while (chunkState->nQueued >= HTTP_MAX_QUEUED_CHUNK_BYTES && !chunkState->fClosed && !chunkState->fAbandoned) {
+            if (!chunkState->cond.timed_wait(lock, boost::posix_time::seconds(DEFAULT_HTTP_SERVER_TIMEOUT))) {
+                LogPrint("http", "%s: client stopped reading, dropping the rest of the reply\n", __func__);
+                chunkState->fAbandoned = true;
+            }
+        }
+        if (chunkState->fClosed || chunkState->fAbandoned)
+            return false;
+        chunkState->nQueued += strChunk.size();
+    }
+
+    struct evbuffer* buf = evbuffer_new();
+    assert(buf);
+    evbuffer_add(buf, strChunk.data(), strChunk.size());
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(http_reply_chunk, req, buf, pchunkStateHttp));
+    ev->trigger(0);
+    return true;
+}
+
+void HTTPRequest::EndReplyChunked()
+{
+    assert(!replySent && req && chunkState);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(http_reply_end, req, pchunkStateHttp));
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
+void HTTPRequest::AbortReplyChunked()
+{
+    assert(!replySent && req && chunkState);
+    HTTPEvent* ev = new HTTPEvent(eventBase, true,
+        boost::bind(http_reply_abort, req, pchunkStateHttp));
+    ev->trigger(0);
+    replySent = true;
+    req = 0; // transferred back to main thread
+}
+
 CService HTTPRequest::GetPeer()
 {
     evhttp_connection* con = evhttp_request_get_connection(req);
@@ -10,14 +10,20 @@
 #include <boost/thread.hpp>
 #include <boost/scoped_ptr.hpp>
 #include <boost/function.hpp>
+#include <memory>
 
 static const int DEFAULT_HTTP_THREADS=4;
 static const int DEFAULT_HTTP_WORKQUEUE=16;
 static const int DEFAULT_HTTP_SERVER_TIMEOUT=30;
+/** Default number of threads executing the calls of parallel JSON-RPC batches */
+static const int DEFAULT_RPC_BATCH_THREADS=4;
+/** Bytes of a chunked reply that may wait to be sent before WriteReplyChunk blocks */
+static const size_t HTTP_MAX_QUEUED_CHUNK_BYTES = 1024 * 1024;
 
 struct evhttp_request;
 struct event_base;
 class CService;
+struct HTTPChunkState;
 class HTTPRequest;
 
 /** Initialize HTTP server.
@@ -57,6 +63,10 @@ class HTTPRequest
 private:
     struct evhttp_request* req;
     bool replySent;
+    //! set while a chunked reply is in progress
+    std::shared_ptr<HTTPChunkState> chunkState;
+    //! the http thread's reference to chunkState, it frees it when the reply ends
+    std::shared_ptr<HTTPChunkState>* pchunkStateHttp;
 
 public:
     HTTPRequest(struct evhttp_request* req);
@@ -112,6 +122,37 @@ public:
      * main thread, do not call any other HTTPRequest methods after calling this.
      */
     void WriteReply(int nStatus, const std::string& strReply = "");
+
+    /**
+     * Start a chunked HTTP reply, for a body that is produced while it is sent.
+     * Headers must have been written before.
+     *
+     * @note Use instead of WriteReply, then send the body with WriteReplyChunk
+     * and finish with EndReplyChunked.
+     */
+    void StartReplyChunked(int nStatus);
+
+    /**
+     * Queue a piece of the body of a chunked reply.
+     * Blocks while HTTP_MAX_QUEUED_CHUNK_BYTES of the reply have not been sent
+     * to the client yet. Returns false if the client is gone or stopped reading,
+     * the chunk is dropped then.
+     */
+    bool WriteReplyChunk(const std::string& strChunk);
+
+    /**
+     * Finish a chunked reply.
+     * Like WriteReply this gives the request back to the main thread.
+     */
+    void EndReplyChunked();
+
+    /**
+     * Give up on a chunked reply whose body can't be completed.
+     * The connection is closed without the terminating chunk, so the client
+     * sees a truncated reply instead of a complete 200 with a cut-off body.
+     * Like WriteReply this gives the request back to the main thread.
+     */
+    void AbortReplyChunked();
 };
 
 /** Event handler closure.
@@ -14,6 +14,7 @@
 
 #include "accumulatorcheckpoints.h"
 #include "accumulators.h"
+#include "accumulatorworker.h"
 #include "activemasternode.h"
 #include "addrman.h"
 #include "amount.h"
@@ -25,7 +26,9 @@
 #include "key.h"
 #include "main.h"
 #include "masternode-budget.h"
+#include "masternode-collateral.h"
 #include "masternode-payments.h"
+#include "masternode-sigverify.h"
 #include "masternodeconfig.h"
 #include "masternodeman.h"
 #include "miner.h"
@@ -40,6 +43,7 @@
 #include "ui_interface.h"
 #include "util.h"
 #include "utilmoneystr.h"
+#include "utxosnapshot.h"
 #include "validationinterface.h"
 #include "z4xtchain.h"
 
@@ -168,7 +172,6 @@ public:
     // Writes do not need similar protection, as failure to write is handled by the caller.
 };
 
-static CCoinsViewDB* pcoinsdbview = NULL;
 static CCoinsViewErrorCatcher* pcoinscatcher = NULL;
 static boost::scoped_ptr<ECCVerifyHandle> globalVerifyHandle;
 
@@ -250,6 +253,8 @@ void PrepareShutdown()
         bitdb.Flush(true);
 #endif
 
+    UnregisterValidationInterface(&collateralTracker);
+
 #if ENABLE_ZMQ
     if (pzmqNotificationInterface) {
         UnregisterValidationInterface(pzmqNotificationInterface);
@@ -294,6 +299,7 @@ void Shutdown()
     globalVerifyHandle.reset();
     ECC_Stop();
     LogPrintf("%s: done\n", __func__);
+    StopLogWriter();
 }
 
 /**
@@ -375,6 +381,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-datadir=<dir>", _("Specify data directory"));
     strUsage += HelpMessageOpt("-dbcache=<n>", strprintf(_("Set database cache size in megabytes (%d to %d, default: %d)"), nMinDbCache, nMaxDbCache, nDefaultDbCache));
     strUsage += HelpMessageOpt("-loadblock=<file>", _("Imports blocks from external blk000??.dat file") + " " + _("on startup"));
+    if (GetBoolArg("-help-debug", false))
+        strUsage += HelpMessageOpt("-loadsnapshot=<file>", _("Start an empty data directory from a chain state snapshot written by dumptxoutset at a block this version knows the snapshot hash of (requires -txindex=0)"));
     strUsage += HelpMessageOpt("-maxreorg=<n>", strprintf(_("Set the Maximum reorg depth (default: %u)"), Params(CBaseChainParams::MAIN).MaxReorganizationDepth()));
     strUsage += HelpMessageOpt("-maxorphantx=<n>", strprintf(_("Keep at most <n> unconnectable transactions in memory (default: %u)"), DEFAULT_MAX_ORPHAN_TRANSACTIONS));
     strUsage += HelpMessageOpt("-par=<n>", strprintf(_("Set the number of script verification threads (%u to %d, 0 = auto, <0 = leave that many cores free, default: %d)"), -(int)boost::thread::hardware_concurrency(), MAX_SCRIPTCHECK_THREADS, DEFAULT_SCRIPTCHECK_THREADS));
@@ -497,6 +505,8 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-help-debug", _("Show all debugging options (usage: --help -help-debug)"));
     strUsage += HelpMessageOpt("-logips", strprintf(_("Include IP addresses in debug output (default: %u)"), 0));
     strUsage += HelpMessageOpt("-logtimestamps", strprintf(_("Prepend debug output with timestamp (default: %u)"), 1));
+    strUsage += HelpMessageOpt("-logasync", strprintf(_("Write debug output on a background thread, the last lines can be lost if the process crashes (default: %u)"), DEFAULT_LOGASYNC));
+    strUsage += HelpMessageOpt("-logformat=<format>", _("Format of debug.log lines, text or json (default: text, json implies -logasync)"));
     if (GetBoolArg("-help-debug", false)) {
         strUsage += HelpMessageOpt("-limitfreerelay=<n>", strprintf(_("Continuously rate-limit free transactions to <n>*1000 bytes per minute (default:%u)"), 15));
         strUsage += HelpMessageOpt("-relaypriority", strprintf(_("Require high priority for relaying free or low-fee transactions (default:%u)"), 1));
@@ -532,6 +542,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-mnconflock=<n>", strprintf(_("Lock masternodes from masternode configuration file (default: %u)"), 1));
     strUsage += HelpMessageOpt("-masternodeprivkey=<n>", _("Set the masternode private key"));
     strUsage += HelpMessageOpt("-masternodeaddr=<n>", strprintf(_("Set external address:port to get to this masternode (example: %s)"), "128.127.106.235:49994"));
+    strUsage += HelpMessageOpt("-mnsigthreads=<n>", strprintf(_("Set the number of threads verifying masternode and budget message signatures (0 to %d, 0 = verify on the message handler thread, default: %d)"), MAX_MN_SIGVERIFY_THREADS, DEFAULT_MN_SIGVERIFY_THREADS));
     strUsage += HelpMessageOpt("-budgetvotemode=<mode>", _("Change automatic finalized budget voting behavior. mode=auto: Vote for only exact finalized budget match to my generated budget. (string, default: auto)"));
 
 
@@ -561,6 +572,7 @@ std::string HelpMessage(HelpMessageMode mode)
     strUsage += HelpMessageOpt("-rpcport=<port>", strprintf(_("Listen for JSON-RPC connections on <port> (default: %u or testnet: %u)"), 49993, 49990));
     strUsage += HelpMessageOpt("-rpcallowip=<ip>", _("Allow JSON-RPC connections from specified source. Valid for <ip> are a single IP (e.g. 1.2.3.4), a network/netmask (e.g. 1.2.3.4/255.255.255.0) or a network/CIDR (e.g. 1.2.3.4/24). This option can be specified multiple times"));
     strUsage += HelpMessageOpt("-rpcthreads=<n>", strprintf(_("Set the number of threads to service RPC calls (default: %d)"), DEFAULT_HTTP_THREADS));
+    strUsage += HelpMessageOpt("-rpcbatchthreads=<n>", strprintf(_("Set the number of threads executing the read-only calls of JSON-RPC batches in parallel (default: %d)"), DEFAULT_RPC_BATCH_THREADS));
     if (GetBoolArg("-help-debug", false)) {
         strUsage += HelpMessageOpt("-rpcworkqueue=<n>", strprintf("Set the depth of the work queue to service RPC calls (default: %d)", DEFAULT_HTTP_WORKQUEUE));
         strUsage += HelpMessageOpt("-rpcservertimeout=<n>", strprintf("Timeout during HTTP requests (default: %d)", DEFAULT_HTTP_SERVER_TIMEOUT));
@@ -608,6 +620,16 @@ static void BlockSizeNotifyCallback(int size, const uint256& hashNewTip)
     boost::thread t(runCommand, strCmd); // thread runs free
 }
 
+#ifdef ENABLE_WALLET
+/** Push balance changes to NotifyBalanceChanged from the scheduler thread, so the GUI never computes them */
+static void NotifyWalletBalances(CScheduler* scheduler)
+{
+    pwalletMain->NotifyBalancesIfDirty();
+    scheduler->schedule(boost::bind(&NotifyWalletBalances, scheduler),
+        boost::chrono::system_clock::now() + boost::chrono::milliseconds(WALLET_BALANCE_NOTIFY_INTERVAL));
+}
+#endif
+
 struct CImportingNow {
     CImportingNow()
     {
@@ -1010,6 +1032,11 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 #endif
     if (GetBoolArg("-shrinkdebugfile", !fDebug))
         ShrinkDebugFile();
+    std::string strLogFormat = GetArg("-logformat", "text");
+    if (strLogFormat != "text" && strLogFormat != "json")
+        return InitError(strprintf(_("Unknown -logformat: '%s'"), strLogFormat));
+    if (GetBoolArg("-logasync", DEFAULT_LOGASYNC) || strLogFormat == "json")
+        StartLogWriter(strLogFormat == "json");
     LogPrintf("\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n\n");
     LogPrintf("Forex Trading version %s (%s)\n", FormatFullVersion(), CLIENT_DATE);
     LogPrintf("Using OpenSSL version %s\n", SSLeay_version(SSLEAY_VERSION));
@@ -1030,6 +1057,13 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
             threadGroup.create_thread(&ThreadScriptCheck);
     }
 
+    int nMnSigThreads = std::max(0, std::min((int)GetArg("-mnsigthreads", DEFAULT_MN_SIGVERIFY_THREADS), MAX_MN_SIGVERIFY_THREADS));
+    LogPrintf("Using %u threads for masternode signature verification\n", nMnSigThreads);
+    for (int i = 0; i < nMnSigThreads; i++)
+        threadGroup.create_thread(&ThreadMasternodeSigVerify);
+
+    threadGroup.create_thread(&ThreadAccumulatorWorker);
+
     if (mapArgs.count("-sporkkey")) // spork priv key
     {
         if (!sporkManager.SetPrivKey(GetArg("-sporkkey", "")))
@@ -1319,6 +1353,8 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
     BOOST_FOREACH (string strDest, mapMultiArgs["-seednode"])
         AddOneShot(strDest);
 
+    RegisterValidationInterface(&collateralTracker);
+
 #if ENABLE_ZMQ
     pzmqNotificationInterface = CZMQNotificationInterface::CreateWithArguments(mapArgs);
 
@@ -1403,6 +1439,23 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
                 if (fReindex)
                     pblocktree->WriteReindexing(true);
 
+                if (mapArgs.count("-loadsnapshot") && !fReindex && pcoinsdbview->GetBestBlock() == uint256(0)) {
+                    if (Params().Snapshots().empty())
+                        return InitError(_("-loadsnapshot: no snapshot is known for this network yet"));
+                    if (GetBoolArg("-txindex", true))
+                        return InitError(_("-loadsnapshot requires -txindex=0"));
+                    boost::filesystem::path pathSnapshot = GetArg("-loadsnapshot", "");
+                    if (!pathSnapshot.is_complete())
+                        pathSnapshot = GetDataDir() / pathSnapshot;
+                    uiInterface.InitMessage(_("Loading chain state snapshot..."));
+                    CUTXOSnapshotInfo info;
+                    std::string strSnapshotError;
+                    if (!LoadUTXOSnapshot(pathSnapshot, pblocktree, pcoinsdbview, zerocoinDB, info, strSnapshotError))
+                        return InitError(strprintf(_("Error loading chain state snapshot %s: %s. Remove the blocks and chainstate directories before trying again."), pathSnapshot.string(), strSnapshotError));
+                    LogPrintf("Loaded chain state snapshot at height %d (%s): %u coins, %u mints, %u spends\n",
+                        info.nHeight, info.hashBlock.ToString(), info.nCoins, info.nMints, info.nSpends);
+                }
+
                 // Forex Trading: load previous sessions sporks if we have them.
                 uiInterface.InitMessage(_("Loading sporks..."));
                 LoadSporksFromDB();
@@ -1892,6 +1945,12 @@ bool AppInit2(boost::thread_group& threadGroup, CScheduler& scheduler)
 
         // Run a thread to flush wallet periodically
         threadGroup.create_thread(boost::bind(&ThreadFlushWalletDB, boost::ref(pwalletMain->strWalletFile)));
+
+        // Recompute balances for the GUI when they changed
+        NotifyWalletBalances(&scheduler);
+
+        // MultiSend and combine dust after new blocks, outside block processing
+        scheduler.scheduleEvery(boost::bind(&CWallet::ConsolidateRewards, pwalletMain), 1);
     }
 #endif
 
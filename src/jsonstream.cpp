@@ -0,0 +1,128 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "jsonstream.h"
+
+#include <assert.h>
+
+#include <univalue.h>
+
+CJSONStream::CJSONStream(size_t nChunkSizeIn, const ChunkFn& chunkFnIn) : nChunkSize(nChunkSizeIn), chunkFn(chunkFnIn), fStarted(false), fAfterKey(false)
+{
+}
+
+void CJSONStream::Separator()
+{
+    if (fAfterKey) {
+        fAfterKey = false;
+        return;
+    }
+    if (vEmpty.empty())
+        return;
+    if (!vEmpty.back())
+        strBuffer += ',';
+    vEmpty.back() = false;
+}
+
+void CJSONStream::Written()
+{
+    if (chunkFn && strBuffer.size() >= nChunkSize)
+        Flush();
+}
+
+CJSONStream& CJSONStream::BeginObject()
+{
+    Separator();
+    strBuffer += '{';
+    vEmpty.push_back(true);
+    return *this;
+}
+
+CJSONStream& CJSONStream::EndObject()
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    vEmpty.pop_back();
+    strBuffer += '}';
+    Written();
+    return *this;
+}
+
+CJSONStream& CJSONStream::BeginArray()
+{
+    Separator();
+    strBuffer += '[';
+    vEmpty.push_back(true);
+    return *this;
+}
+
+CJSONStream& CJSONStream::EndArray()
+{
+    assert(!vEmpty.empty() && !fAfterKey);
+    vEmpty.pop_back();
+    strBuffer += ']';
+    Written();
+    return *this;
+}
+
+CJSONStream& CJSONStream::Key(const std::string& strKey)
+{
+    Separator();
+    strBuffer += UniValue(strKey).write();
+    strBuffer += ':';
+    fAfterKey = true;
+    return *this;
+}
+
+CJSONStream& CJSONStream::Value(const UniValue& value)
+{
+    Separator();
+    strBuffer += value.write();
+    Written();
+    return *this;
+}
+
+CJSONStream& CJSONStream::Value(const std::string& str)
+{
+    return Value(UniValue(str));
+}
+
+CJSONStream& CJSONStream::Value(int64_t n)
+{
+    return Value(UniValue(n));
+}
+
+CJSONStream& CJSONStream::Value(bool f)
+{
+    return Value(UniValue(f));
+}
+
+CJSONStream& CJSONStream::Null()
+{
+    return Value(NullUniValue);
+}
+
+CJSONStream& CJSONStream::Pairs(const UniValue& object)
+{
+    const std::vector<std::string>& vKeys = object.getKeys();
+    const std::vector<UniValue>& vValues = object.getValues();
+    for (unsigned int i = 0; i < vKeys.size(); i++)
+        Key(vKeys[i]).Value(vValues[i]);
+    return *this;
+}
+
+CJSONStream& CJSONStream::Raw(const std::string& str)
+{
+    strBuffer += str;
+    Written();
+    return *this;
+}
+
+void CJSONStream::Flush()
+{
+    if (!chunkFn || strBuffer.empty())
+        return;
+    fStarted = true;
+    chunkFn(strBuffer);
+    strBuffer.clear();
+}
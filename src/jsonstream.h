@@ -0,0 +1,89 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_JSONSTREAM_H
+#define BITCOIN_JSONSTREAM_H
+
+#include <stdint.h>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+
+class UniValue;
+
+/** Size of the pieces a streamed reply is sent in */
+static const size_t JSON_STREAM_CHUNK_SIZE = 64 * 1024;
+
+/** Thrown by a chunk function whose reader is gone, to stop writing the rest of the document */
+class jsonstream_aborted : public std::runtime_error
+{
+public:
+    explicit jsonstream_aborted(const std::string& msg) : std::runtime_error(msg) {}
+};
+
+/**
+ * Writes a JSON document piece by piece, for replies too large to build as
+ * one UniValue first.
+ *
+ * Text accumulates in a buffer. With a chunk function, the buffer is handed
+ * to it whenever it grows past the chunk size, so only about one chunk of the
+ * document is ever held in memory. Without one, the whole document stays in
+ * the buffer.
+ *
+ * Small parts of the document can still be built as UniValue and written
+ * with Value() or Pairs(). Commas between elements are inserted automatically.
+ */
+class CJSONStream
+{
+public:
+    typedef boost::function<void(const std::string&)> ChunkFn;
+
+private:
+    std::string strBuffer;
+    size_t nChunkSize;
+    ChunkFn chunkFn;
+    bool fStarted;
+    //! for each open object or array: whether it has no element yet
+    std::vector<bool> vEmpty;
+    //! a key was just written, its value follows without a separator
+    bool fAfterKey;
+
+    void Separator();
+    void Written();
+
+public:
+    explicit CJSONStream(size_t nChunkSizeIn = JSON_STREAM_CHUNK_SIZE, const ChunkFn& chunkFnIn = ChunkFn());
+
+    CJSONStream& BeginObject();
+    CJSONStream& EndObject();
+    CJSONStream& BeginArray();
+    CJSONStream& EndArray();
+    CJSONStream& Key(const std::string& strKey);
+
+    CJSONStream& Value(const UniValue& value);
+    CJSONStream& Value(const std::string& str);
+    CJSONStream& Value(const char* psz) { return Value(std::string(psz)); }
+    CJSONStream& Value(int64_t n);
+    CJSONStream& Value(bool f);
+    CJSONStream& Null();
+
+    //! Write every key/value pair of object into the object being written
+    CJSONStream& Pairs(const UniValue& object);
+
+    //! Append text as is, e.g. a trailing newline
+    CJSONStream& Raw(const std::string& str);
+
+    //! Hand whatever is buffered to the chunk function
+    void Flush();
+
+    //! Whether any text was handed to the chunk function yet
+    bool Started() const { return fStarted; }
+
+    //! Text not handed to the chunk function yet
+    const std::string& GetBuffer() const { return strBuffer; }
+};
+
+#endif // BITCOIN_JSONSTREAM_H
@@ -344,7 +344,7 @@ bool Stake(CStakeInput* stakeInput, unsigned int nBits, unsigned int nTimeBlockF
 }
 
 // Check kernel hash target and coinstake signature
-bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::unique_ptr<CStakeInput>& stake)
+bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::unique_ptr<CStakeInput>& stake, bool* pfMissingInput)
 {
     const CTransaction tx = block.vtx[1];
     if (!tx.IsCoinStake())
@@ -361,30 +361,51 @@ bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::uniqu
 
         stake = std::unique_ptr<CStakeInput>(new CZPscsStake(spend));
     } else {
-        // First try finding the previous transaction in database
-        uint256 hashBlock;
-        CTransaction txPrev;
-        if (!GetTransaction(txin.prevout.hash, txPrev, hashBlock, true))
-            return error("CheckProofOfStake() : INFO: read txPrev failed");
+        // The kernel only needs the output and the block it was created in. For an unspent
+        // output the coins view has both, also when that block came with a -loadsnapshot
+        // chain state and was never downloaded.
+        CTxOut outPrev;
+        CBlockIndex* pindexFrom = NULL;
+        {
+            LOCK(cs_main);
+            const CCoins* coins = pcoinsTip->AccessCoins(txin.prevout.hash);
+            if (coins && coins->IsAvailable(txin.prevout.n) && coins->nHeight <= chainActive.Height()) {
+                outPrev = coins->vout[txin.prevout.n];
+                pindexFrom = chainActive[coins->nHeight];
+            }
+        }
+
+        CPscsStake* ForexTradingInput = new CPscsStake();
+        std::unique_ptr<CStakeInput> input(ForexTradingInput);
+        if (pindexFrom) {
+            ForexTradingInput->SetInput(txin.prevout.hash, txin.prevout.n, outPrev, pindexFrom);
+        } else {
+            // spent in the active chain, staked by a fork: find the previous transaction in database
+            uint256 hashBlock;
+            CTransaction txPrev;
+            if (!GetTransaction(txin.prevout.hash, txPrev, hashBlock, true)) {
+                if (pfMissingInput)
+                    *pfMissingInput = true;
+                return error("CheckProofOfStake() : INFO: read txPrev failed");
+            }
+            if (txin.prevout.n >= txPrev.vout.size())
+                return error("CheckProofOfStake() : stake input %s out of range", txin.prevout.ToString());
+
+            outPrev = txPrev.vout[txin.prevout.n];
+            ForexTradingInput->SetInput(txPrev, txin.prevout.n);
+        }
 
         //verify signature and script
-        if (!VerifyScript(txin.scriptSig, txPrev.vout[txin.prevout.n].scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0)))
+        if (!VerifyScript(txin.scriptSig, outPrev.scriptPubKey, STANDARD_SCRIPT_VERIFY_FLAGS, TransactionSignatureChecker(&tx, 0)))
             return error("CheckProofOfStake() : VerifySignature failed on coinstake %s", tx.GetHash().ToString().c_str());
 
-        CPscsStake* ForexTradingInput = new CPscsStake();
-        ForexTradingInput->SetInput(txPrev, txin.prevout.n);
-        stake = std::unique_ptr<CStakeInput>(ForexTradingInput);
+        stake = std::move(input);
     }
 
     CBlockIndex* pindex = stake->GetIndexFrom();
     if (!pindex)
         return error("%s: Failed to find the block index", __func__);
 
-    // Read block header
-    CBlock blockprev;
-    if (!ReadBlockFromDisk(blockprev, pindex->GetBlockPos()))
-        return error("CheckProofOfStake(): INFO: failed to find block");
-
     uint256 bnTargetPerCoinDay;
     bnTargetPerCoinDay.SetCompact(block.nBits);
 
@@ -392,7 +413,8 @@ bool CheckProofOfStake(const CBlock block, uint256& hashProofOfStake, std::uniqu
     if (!stake->GetModifier(nStakeModifier))
         return error("%s failed to get modifier for stake input\n", __func__);
 
-    unsigned int nBlockFromTime = blockprev.nTime;
+    // the header time is all the kernel uses of the block the stake comes from
+    unsigned int nBlockFromTime = pindex->nTime;
     unsigned int nTxTime = block.nTime;
     if (!CheckStake(stake->GetUniqueness(), stake->GetValue(), nStakeModifier, bnTargetPerCoinDay, nBlockFromTime,
                     nTxTime, hashProofOfStake)) {
@@ -91,14 +91,23 @@ public:
 
     template <typename K, typename V>
     bool Read(const K& key, V& value) const
+    {
+        return Read(NULL, key, value);
+    }
+
+    //! read as of psnapshot, or the current state if NULL
+    template <typename K, typename V>
+    bool Read(const leveldb::Snapshot* psnapshot, const K& key, V& value) const
     {
         CDataStream ssKey(SER_DISK, CLIENT_VERSION);
         ssKey.reserve(ssKey.GetSerializeSize(key));
         ssKey << key;
         leveldb::Slice slKey(&ssKey[0], ssKey.size());
 
+        leveldb::ReadOptions options = readoptions;
+        options.snapshot = psnapshot;
         std::string strValue;
-        leveldb::Status status = pdb->Get(readoptions, slKey, &strValue);
+        leveldb::Status status = pdb->Get(options, slKey, &strValue);
         if (!status.ok()) {
             if (status.IsNotFound())
                 return false;
@@ -168,6 +177,25 @@ public:
     {
         return pdb->NewIterator(iteroptions);
     }
+
+    //! iterator over the state of the database at the time psnapshot was taken
+    leveldb::Iterator* NewIterator(const leveldb::Snapshot* psnapshot)
+    {
+        leveldb::ReadOptions options = iteroptions;
+        options.snapshot = psnapshot;
+        return pdb->NewIterator(options);
+    }
+
+    //! consistent read-only state of the database, must be released with ReleaseSnapshot
+    const leveldb::Snapshot* GetSnapshot()
+    {
+        return pdb->GetSnapshot();
+    }
+
+    void ReleaseSnapshot(const leveldb::Snapshot* psnapshot)
+    {
+        pdb->ReleaseSnapshot(psnapshot);
+    }
 };
 
 #endif // BITCOIN_LEVELDBWRAPPER_H
@@ -38,9 +38,10 @@ AccumulatorProofOfKnowledge::AccumulatorProofOfKnowledge(const AccumulatorAndPro
 	CBigNum r_2 = CBigNum::randBignum(params->accumulatorModulus / 4);
 	CBigNum r_3 = CBigNum::randBignum(params->accumulatorModulus / 4);
 
-	this->C_e = g_n.pow_mod(e, params->accumulatorModulus) * h_n.pow_mod(r_1, params->accumulatorModulus);
-	this->C_u = witness.getValue() * h_n.pow_mod(r_2, params->accumulatorModulus);
-	this->C_r = g_n.pow_mod(r_2, params->accumulatorModulus) * h_n.pow_mod(r_3, params->accumulatorModulus);
+	const IntegerGroupParams& qrn = params->accumulatorQRNCommitmentGroup;
+	this->C_e = qrn.pow_g(e, params->accumulatorModulus) * qrn.pow_h(r_1, params->accumulatorModulus);
+	this->C_u = witness.getValue() * qrn.pow_h(r_2, params->accumulatorModulus);
+	this->C_r = qrn.pow_g(r_2, params->accumulatorModulus) * qrn.pow_h(r_3, params->accumulatorModulus);
 
 	CBigNum r_alpha = CBigNum::randBignum(params->maxCoinValue * CBigNum(2).pow(params->k_prime + params->k_dprime));
 	if(!(CBigNum::randBignum(CBigNum(3)) % 2)) {
@@ -75,14 +76,15 @@ AccumulatorProofOfKnowledge::AccumulatorProofOfKnowledge(const AccumulatorAndPro
 		r_delta = 0-r_delta;
 	}
 
-	this->st_1 = (sg.pow_mod(r_alpha, params->accumulatorPoKCommitmentGroup.modulus) * sh.pow_mod(r_phi, params->accumulatorPoKCommitmentGroup.modulus)) % params->accumulatorPoKCommitmentGroup.modulus;
-	this->st_2 = (((commitmentToCoin.getCommitmentValue() * sg.inverse(params->accumulatorPoKCommitmentGroup.modulus)).pow_mod(r_gamma, params->accumulatorPoKCommitmentGroup.modulus)) * sh.pow_mod(r_psi, params->accumulatorPoKCommitmentGroup.modulus)) % params->accumulatorPoKCommitmentGroup.modulus;
-	this->st_3 = ((sg * commitmentToCoin.getCommitmentValue()).pow_mod(r_sigma, params->accumulatorPoKCommitmentGroup.modulus) * sh.pow_mod(r_xi, params->accumulatorPoKCommitmentGroup.modulus)) % params->accumulatorPoKCommitmentGroup.modulus;
+	const CBigNum& pokModulus = params->accumulatorPoKCommitmentGroup.modulus;
+	this->st_1 = params->accumulatorPoKCommitmentGroup.pow_gh(r_alpha, r_phi, pokModulus);
+	this->st_2 = CBigNum::multi_pow_mod(commitmentToCoin.getCommitmentValue() * sg.inverse(pokModulus), r_gamma, sh, r_psi, pokModulus);
+	this->st_3 = CBigNum::multi_pow_mod(sg * commitmentToCoin.getCommitmentValue(), r_sigma, sh, r_xi, pokModulus);
 
-	this->t_1 = (h_n.pow_mod(r_zeta, params->accumulatorModulus) * g_n.pow_mod(r_epsilon, params->accumulatorModulus)) % params->accumulatorModulus;
-	this->t_2 = (h_n.pow_mod(r_eta, params->accumulatorModulus) * g_n.pow_mod(r_alpha, params->accumulatorModulus)) % params->accumulatorModulus;
-	this->t_3 = (C_u.pow_mod(r_alpha, params->accumulatorModulus) * ((h_n.inverse(params->accumulatorModulus)).pow_mod(r_beta, params->accumulatorModulus))) % params->accumulatorModulus;
-	this->t_4 = (C_r.pow_mod(r_alpha, params->accumulatorModulus) * ((h_n.inverse(params->accumulatorModulus)).pow_mod(r_delta, params->accumulatorModulus)) * ((g_n.inverse(params->accumulatorModulus)).pow_mod(r_beta, params->accumulatorModulus))) % params->accumulatorModulus;
+	this->t_1 = CBigNum::multi_pow_mod(h_n, r_zeta, g_n, r_epsilon, params->accumulatorModulus);
+	this->t_2 = CBigNum::multi_pow_mod(h_n, r_eta, g_n, r_alpha, params->accumulatorModulus);
+	this->t_3 = CBigNum::multi_pow_mod(C_u, r_alpha, h_n, -r_beta, params->accumulatorModulus);
+	this->t_4 = CBigNum::multi_pow_mod(C_r, r_alpha, h_n, -r_delta, g_n, -r_beta, params->accumulatorModulus);
 
 	CHashWriter hasher(0,0);
 	hasher << *params << sg << sh << g_n << h_n << commitmentToCoin.getCommitmentValue() << C_e << C_u << C_r << st_1 << st_2 << st_3 << t_1 << t_2 << t_3 << t_4;
@@ -118,14 +120,15 @@ bool AccumulatorProofOfKnowledge:: Verify(const Accumulator& a, const CBigNum& v
 
 	CBigNum c = CBigNum(hasher.GetHash()); //this hash should be of length k_prime bits
 
-	CBigNum st_1_prime = (valueOfCommitmentToCoin.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) * sg.pow_mod(s_alpha, params->accumulatorPoKCommitmentGroup.modulus) * sh.pow_mod(s_phi, params->accumulatorPoKCommitmentGroup.modulus)) % params->accumulatorPoKCommitmentGroup.modulus;
-	CBigNum st_2_prime = (sg.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) * ((valueOfCommitmentToCoin * sg.inverse(params->accumulatorPoKCommitmentGroup.modulus)).pow_mod(s_gamma, params->accumulatorPoKCommitmentGroup.modulus)) * sh.pow_mod(s_psi, params->accumulatorPoKCommitmentGroup.modulus)) % params->accumulatorPoKCommitmentGroup.modulus;
-	CBigNum st_3_prime = (sg.pow_mod(c, params->accumulatorPoKCommitmentGroup.modulus) * (sg * valueOfCommitmentToCoin).pow_mod(s_sigma, params->accumulatorPoKCommitmentGroup.modulus) * sh.pow_mod(s_xi, params->accumulatorPoKCommitmentGroup.modulus)) % params->accumulatorPoKCommitmentGroup.modulus;
+	const CBigNum& pokModulus = params->accumulatorPoKCommitmentGroup.modulus;
+	CBigNum st_1_prime = CBigNum::multi_pow_mod(valueOfCommitmentToCoin, c, sg, s_alpha, sh, s_phi, pokModulus);
+	CBigNum st_2_prime = CBigNum::multi_pow_mod(sg, c, valueOfCommitmentToCoin * sg.inverse(pokModulus), s_gamma, sh, s_psi, pokModulus);
+	CBigNum st_3_prime = CBigNum::multi_pow_mod(sg, c, sg * valueOfCommitmentToCoin, s_sigma, sh, s_xi, pokModulus);
 
-	CBigNum t_1_prime = (C_r.pow_mod(c, params->accumulatorModulus) * h_n.pow_mod(s_zeta, params->accumulatorModulus) * g_n.pow_mod(s_epsilon, params->accumulatorModulus)) % params->accumulatorModulus;
-	CBigNum t_2_prime = (C_e.pow_mod(c, params->accumulatorModulus) * h_n.pow_mod(s_eta, params->accumulatorModulus) * g_n.pow_mod(s_alpha, params->accumulatorModulus)) % params->accumulatorModulus;
-	CBigNum t_3_prime = ((a.getValue()).pow_mod(c, params->accumulatorModulus) * C_u.pow_mod(s_alpha, params->accumulatorModulus) * ((h_n.inverse(params->accumulatorModulus)).pow_mod(s_beta, params->accumulatorModulus))) % params->accumulatorModulus;
-	CBigNum t_4_prime = (C_r.pow_mod(s_alpha, params->accumulatorModulus) * ((h_n.inverse(params->accumulatorModulus)).pow_mod(s_delta, params->accumulatorModulus)) * ((g_n.inverse(params->accumulatorModulus)).pow_mod(s_beta, params->accumulatorModulus))) % params->accumulatorModulus;
+	CBigNum t_1_prime = CBigNum::multi_pow_mod(C_r, c, h_n, s_zeta, g_n, s_epsilon, params->accumulatorModulus);
+	CBigNum t_2_prime = CBigNum::multi_pow_mod(C_e, c, h_n, s_eta, g_n, s_alpha, params->accumulatorModulus);
+	CBigNum t_3_prime = CBigNum::multi_pow_mod(a.getValue(), c, C_u, s_alpha, h_n, -s_beta, params->accumulatorModulus);
+	CBigNum t_4_prime = CBigNum::multi_pow_mod(C_r, s_alpha, h_n, -s_delta, g_n, -s_beta, params->accumulatorModulus);
 
 	bool result = false;
 
@@ -109,6 +109,14 @@ CalculateParams(ZerocoinParams &params, CBigNum N, string aux, uint32_t security
 	params.accumulatorParams.maxCoinValue = params.coinCommitmentGroup.modulus;
 	params.accumulatorParams.minCoinValue = CBigNum(2).pow((params.coinCommitmentGroup.modulus.bitSize() / 2) + 3);
 
+	// Precompute powers of the generators that commitments and proofs raise to
+	// exponents below the group order (below N for the QRN generators).
+	params.coinCommitmentGroup.Precompute(params.coinCommitmentGroup.modulus, params.coinCommitmentGroup.groupOrder.bitSize());
+	params.serialNumberSoKCommitmentGroup.Precompute(params.serialNumberSoKCommitmentGroup.modulus, params.serialNumberSoKCommitmentGroup.groupOrder.bitSize());
+	params.accumulatorParams.accumulatorPoKCommitmentGroup.Precompute(params.accumulatorParams.accumulatorPoKCommitmentGroup.modulus,
+	        params.accumulatorParams.accumulatorPoKCommitmentGroup.groupOrder.bitSize());
+	params.accumulatorParams.accumulatorQRNCommitmentGroup.Precompute(N, NLen);
+
 	// If all went well, mark params as successfully initialized.
 	params.accumulatorParams.initialized = true;
 
@@ -43,7 +43,30 @@ CBigNum IntegerGroupParams::randomElement() const {
 	// The generator of the group raised
 	// to a random number less than the order of the group
 	// provides us with a uniformly distributed random number.
-	return this->g.pow_mod(CBigNum::randBignum(this->groupOrder),this->modulus);
+	return this->pow_g(CBigNum::randBignum(this->groupOrder),this->modulus);
+}
+
+CBigNum IntegerGroupParams::pow_g(const CBigNum& x, const CBigNum& m) const {
+	if (ptableG && ptableG->getModulus() == m)
+		return ptableG->pow_mod(x);
+	return this->g.pow_mod(x, m);
+}
+
+CBigNum IntegerGroupParams::pow_h(const CBigNum& y, const CBigNum& m) const {
+	if (ptableH && ptableH->getModulus() == m)
+		return ptableH->pow_mod(y);
+	return this->h.pow_mod(y, m);
+}
+
+CBigNum IntegerGroupParams::pow_gh(const CBigNum& x, const CBigNum& y, const CBigNum& m) const {
+	if (ptableG && ptableH && ptableG->getModulus() == m && ptableG->covers(x) && ptableH->covers(y))
+		return ptableG->pow_mod(x).mul_mod(ptableH->pow_mod(y), m);
+	return CBigNum::multi_pow_mod(this->g, x, this->h, y, m);
+}
+
+void IntegerGroupParams::Precompute(const CBigNum& m, int nMaxBits) {
+	this->ptableG.reset(new CBigNumFixedBase(this->g, m, nMaxBits));
+	this->ptableH.reset(new CBigNumFixedBase(this->h, m, nMaxBits));
 }
 
 } /* namespace libzerocoin */
@@ -18,6 +18,8 @@
 #include "bignum.h"
 #include "ZerocoinDefines.h"
 
+#include <memory>
+
 namespace libzerocoin {
 
 class IntegerGroupParams {
@@ -57,6 +59,20 @@ public:
 	 */
 	CBigNum groupOrder;
 
+	/**
+	 * g^x, h^y and g^x * h^y mod m, using the fixed-base tables of
+	 * g and h when Precompute() built them for m.
+	 */
+	CBigNum pow_g(const CBigNum& x, const CBigNum& m) const;
+	CBigNum pow_h(const CBigNum& y, const CBigNum& m) const;
+	CBigNum pow_gh(const CBigNum& x, const CBigNum& y, const CBigNum& m) const;
+
+	/**
+	 * Builds the fixed-base tables of g and h mod m for exponents
+	 * of up to nMaxBits bits. They are not serialized.
+	 */
+	void Precompute(const CBigNum& m, int nMaxBits);
+
 	ADD_SERIALIZE_METHODS;
   template <typename Stream, typename Operation>  inline void SerializationOp(Stream& s, Operation ser_action, int nType, int nVersion) {
 		    READWRITE(initialized);
@@ -65,6 +81,10 @@ public:
 		    READWRITE(modulus);
 		    READWRITE(groupOrder);
 	}	
+
+private:
+	std::shared_ptr<const CBigNumFixedBase> ptableG;
+	std::shared_ptr<const CBigNumFixedBase> ptableH;
 };
 
 class AccumulatorAndProofParams {
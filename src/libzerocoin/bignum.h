@@ -8,9 +8,11 @@
 #ifndef BITCOIN_BIGNUM_H
 #define BITCOIN_BIGNUM_H
 
+#include <algorithm>
 #include <stdexcept>
 #include <vector>
 #include <openssl/bn.h>
+#include <boost/thread/tss.hpp>
 #include "serialize.h"
 #include "uint256.h"
 #include "version.h"
@@ -52,10 +54,100 @@ public:
 };
 
 
+/**
+ * Per-thread scratch state of the modular arithmetic in CBigNum: a BN_CTX that
+ * is reused by every operation instead of allocating one each time, and the
+ * Montgomery contexts of the last few odd moduli used. libzerocoin only works
+ * with a handful of moduli from ZerocoinParams, so BN_mod_exp no longer has to
+ * set up a Montgomery context on every call.
+ */
+class CBigNumThreadContext
+{
+private:
+    static const unsigned int MAX_MONT_CACHE_SIZE = 8;
+
+    BN_CTX* pctx;
+    //! modulus and its Montgomery context, least recently added first
+    std::vector<std::pair<BIGNUM*, BN_MONT_CTX*> > vMont;
+
+    CBigNumThreadContext(const CBigNumThreadContext&);
+    CBigNumThreadContext& operator=(const CBigNumThreadContext&);
+
+public:
+    CBigNumThreadContext()
+    {
+        pctx = BN_CTX_new();
+        if (pctx == NULL)
+            throw bignum_error("CBigNumThreadContext : BN_CTX_new() returned NULL");
+    }
+
+    ~CBigNumThreadContext()
+    {
+        for (unsigned int i = 0; i < vMont.size(); i++) {
+            BN_free(vMont[i].first);
+            BN_MONT_CTX_free(vMont[i].second);
+        }
+        BN_CTX_free(pctx);
+    }
+
+    BN_CTX* ctx() { return pctx; }
+
+    /** Montgomery context of modulus m, NULL if m is not odd */
+    BN_MONT_CTX* mont(const BIGNUM* m)
+    {
+        for (unsigned int i = 0; i < vMont.size(); i++) {
+            if (BN_cmp(vMont[i].first, m) == 0)
+                return vMont[i].second;
+        }
+        if (!BN_is_odd(m) || BN_is_negative(m))
+            return NULL;
+
+        if (vMont.size() >= MAX_MONT_CACHE_SIZE) {
+            BN_free(vMont.front().first);
+            BN_MONT_CTX_free(vMont.front().second);
+            vMont.erase(vMont.begin());
+        }
+
+        BIGNUM* pmodulus = BN_dup(m);
+        BN_MONT_CTX* pmont = BN_MONT_CTX_new();
+        if (pmodulus == NULL || pmont == NULL || !BN_MONT_CTX_set(pmont, m, pctx)) {
+            BN_free(pmodulus);
+            BN_MONT_CTX_free(pmont);
+            throw bignum_error("CBigNumThreadContext::mont : BN_MONT_CTX_set failed");
+        }
+        vMont.push_back(std::make_pair(pmodulus, pmont));
+        return pmont;
+    }
+
+    /** The calling thread's context */
+    static CBigNumThreadContext& get()
+    {
+        static boost::thread_specific_ptr<CBigNumThreadContext> ptr;
+        if (!ptr.get())
+            ptr.reset(new CBigNumThreadContext());
+        return *ptr;
+    }
+};
+
+
 /** C++ wrapper for BIGNUM (OpenSSL bignum) */
 class CBigNum
 {
     BIGNUM* bn;
+
+    //! Most terms multi_pow_mod combines in one pass, its table has 2^n entries
+    static const unsigned int MAX_MULTI_POW_TERMS = 4;
+
+    //! BN_mod_exp, through the cached Montgomery context of m when there is one
+    static int ModExp(BIGNUM* r, const BIGNUM* a, const BIGNUM* p, const BIGNUM* m, BN_CTX* pctx, BN_MONT_CTX* pmont)
+    {
+        if (pmont == NULL)
+            return BN_mod_exp(r, a, p, m, pctx);
+        return BN_mod_exp_mont(r, a, p, m, pctx, pmont);
+    }
+
+    friend class CBigNumFixedBase;
+
 public:
     CBigNum()
     {
@@ -431,9 +523,8 @@ public:
      * @param m modulus
      */
     CBigNum mul_mod(const CBigNum& b, const CBigNum& m) const {
-        CAutoBN_CTX pctx;
         CBigNum ret;
-        if (!BN_mod_mul(ret.bn, bn, b.bn, m.bn, pctx))
+        if (!BN_mod_mul(ret.bn, bn, b.bn, m.bn, CBigNumThreadContext::get().ctx()))
                 throw bignum_error("CBigNum::mul_mod : BN_mod_mul failed");
 
         return ret;
@@ -445,21 +536,108 @@ public:
      * @param m modulus
      */
     CBigNum pow_mod(const CBigNum& e, const CBigNum& m) const {
-        CAutoBN_CTX pctx;
+        CBigNumThreadContext& context = CBigNumThreadContext::get();
+        BN_MONT_CTX* pmont = context.mont(m.bn);
         CBigNum ret;
         if( e < 0){
             // g^-x = (g^-1)^x
             CBigNum inv = this->inverse(m);
             CBigNum posE = e * -1;
-            if (!BN_mod_exp(ret.bn, inv.bn, posE.bn, m.bn, pctx))
+            if (!ModExp(ret.bn, inv.bn, posE.bn, m.bn, context.ctx(), pmont))
                 throw bignum_error("CBigNum::pow_mod: BN_mod_exp failed on negative exponent");
         }else
-            if (!BN_mod_exp(ret.bn, bn, e.bn, m.bn, pctx))
+            if (!ModExp(ret.bn, bn, e.bn, m.bn, context.ctx(), pmont))
                 throw bignum_error("CBigNum::pow_mod : BN_mod_exp failed");
 
         return ret;
     }
 
+    /**
+     * simultaneous modular exponentiation: vBases[0]^vExps[0] * ... * vBases[n-1]^vExps[n-1] mod m
+     * Shares the squarings between all terms (Shamir's trick), which is cheaper
+     * than multiplying separate pow_mod results.
+     * @param vBases bases
+     * @param vExps exponents, negative ones use the inverse of their base
+     * @param m modulus
+     */
+    static CBigNum multi_pow_mod(const std::vector<CBigNum>& vBases, const std::vector<CBigNum>& vExps, const CBigNum& m) {
+        if (vBases.size() != vExps.size())
+            throw bignum_error("CBigNum::multi_pow_mod : base and exponent count differ");
+
+        CBigNumThreadContext& context = CBigNumThreadContext::get();
+        BN_MONT_CTX* pmont = context.mont(m.bn);
+        if (pmont == NULL || vBases.size() > MAX_MULTI_POW_TERMS) {
+            CBigNum ret = CBigNum(1) % m;
+            for (unsigned int i = 0; i < vBases.size(); i++)
+                ret = ret.mul_mod(vBases[i].pow_mod(vExps[i], m), m);
+            return ret;
+        }
+
+        BN_CTX* pctx = context.ctx();
+        unsigned int nTerms = vBases.size();
+        std::vector<CBigNum> vMontBases(nTerms), vAbsExps(nTerms);
+        int nBits = 0;
+        for (unsigned int i = 0; i < nTerms; i++) {
+            CBigNum base = vExps[i] < 0 ? vBases[i].inverse(m) : vBases[i] % m;
+            vAbsExps[i] = vExps[i] < 0 ? -vExps[i] : vExps[i];
+            if (!BN_to_montgomery(vMontBases[i].bn, base.bn, pmont, pctx))
+                throw bignum_error("CBigNum::multi_pow_mod : BN_to_montgomery failed");
+            nBits = std::max(nBits, vAbsExps[i].bitSize());
+        }
+
+        // products of every subset of the bases, indexed by bitmask
+        std::vector<CBigNum> vProducts(1 << nTerms);
+        if (!BN_to_montgomery(vProducts[0].bn, (CBigNum(1) % m).bn, pmont, pctx))
+            throw bignum_error("CBigNum::multi_pow_mod : BN_to_montgomery failed");
+        for (unsigned int nMask = 1; nMask < vProducts.size(); nMask++) {
+            unsigned int nLow = 0;
+            while (!(nMask & (1U << nLow)))
+                nLow++;
+            if (!BN_mod_mul_montgomery(vProducts[nMask].bn, vProducts[nMask ^ (1U << nLow)].bn, vMontBases[nLow].bn, pmont, pctx))
+                throw bignum_error("CBigNum::multi_pow_mod : BN_mod_mul_montgomery failed");
+        }
+
+        CBigNum acc = vProducts[0];
+        for (int nBit = nBits - 1; nBit >= 0; nBit--) {
+            if (!BN_mod_mul_montgomery(acc.bn, acc.bn, acc.bn, pmont, pctx))
+                throw bignum_error("CBigNum::multi_pow_mod : BN_mod_mul_montgomery failed");
+            unsigned int nMask = 0;
+            for (unsigned int i = 0; i < nTerms; i++) {
+                if (BN_is_bit_set(vAbsExps[i].bn, nBit))
+                    nMask |= 1U << i;
+            }
+            if (nMask && !BN_mod_mul_montgomery(acc.bn, acc.bn, vProducts[nMask].bn, pmont, pctx))
+                throw bignum_error("CBigNum::multi_pow_mod : BN_mod_mul_montgomery failed");
+        }
+
+        CBigNum ret;
+        if (!BN_from_montgomery(ret.bn, acc.bn, pmont, pctx))
+            throw bignum_error("CBigNum::multi_pow_mod : BN_from_montgomery failed");
+        return ret;
+    }
+
+    /** a^x * b^y mod m */
+    static CBigNum multi_pow_mod(const CBigNum& a, const CBigNum& x, const CBigNum& b, const CBigNum& y, const CBigNum& m) {
+        std::vector<CBigNum> vBases, vExps;
+        vBases.push_back(a);
+        vBases.push_back(b);
+        vExps.push_back(x);
+        vExps.push_back(y);
+        return multi_pow_mod(vBases, vExps, m);
+    }
+
+    /** a^x * b^y * c^z mod m */
+    static CBigNum multi_pow_mod(const CBigNum& a, const CBigNum& x, const CBigNum& b, const CBigNum& y, const CBigNum& c, const CBigNum& z, const CBigNum& m) {
+        std::vector<CBigNum> vBases, vExps;
+        vBases.push_back(a);
+        vBases.push_back(b);
+        vBases.push_back(c);
+        vExps.push_back(x);
+        vExps.push_back(y);
+        vExps.push_back(z);
+        return multi_pow_mod(vBases, vExps, m);
+    }
+
    /**
     * Calculates the inverse of this element mod m.
     * i.e. i such this*i = 1 mod m
@@ -467,9 +645,8 @@ public:
     * @return the inverse
     */
     CBigNum inverse(const CBigNum& m) const {
-        CAutoBN_CTX pctx;
         CBigNum ret;
-        if (!BN_mod_inverse(ret.bn, bn, m.bn, pctx))
+        if (!BN_mod_inverse(ret.bn, bn, m.bn, CBigNumThreadContext::get().ctx()))
             throw bignum_error("CBigNum::inverse*= :BN_mod_inverse");
         return ret;
     }
@@ -660,27 +837,24 @@ inline const CBigNum operator-(const CBigNum& a)
 
 inline const CBigNum operator*(const CBigNum& a, const CBigNum& b)
 {
-    CAutoBN_CTX pctx;
     CBigNum r;
-    if (!BN_mul(r.bn, a.bn, b.bn, pctx))
+    if (!BN_mul(r.bn, a.bn, b.bn, CBigNumThreadContext::get().ctx()))
         throw bignum_error("CBigNum::operator* : BN_mul failed");
     return r;
 }
 
 inline const CBigNum operator/(const CBigNum& a, const CBigNum& b)
 {
-    CAutoBN_CTX pctx;
     CBigNum r;
-    if (!BN_div(r.bn, NULL, a.bn, b.bn, pctx))
+    if (!BN_div(r.bn, NULL, a.bn, b.bn, CBigNumThreadContext::get().ctx()))
         throw bignum_error("CBigNum::operator/ : BN_div failed");
     return r;
 }
 
 inline const CBigNum operator%(const CBigNum& a, const CBigNum& b)
 {
-    CAutoBN_CTX pctx;
     CBigNum r;
-    if (!BN_nnmod(r.bn, a.bn, b.bn, pctx))
+    if (!BN_nnmod(r.bn, a.bn, b.bn, CBigNumThreadContext::get().ctx()))
         throw bignum_error("CBigNum::operator% : BN_div failed");
     return r;
 }
@@ -708,4 +882,90 @@ inline bool operator<(const CBigNum& a, const CBigNum& b)  { return (BN_cmp(a.bn
 inline bool operator>(const CBigNum& a, const CBigNum& b)  { return (BN_cmp(a.bn, b.bn) > 0); }
 inline std::ostream& operator<<(std::ostream &strm, const CBigNum &b) { return strm << b.ToString(10); }
 
+/**
+ * Powers of a fixed base modulo a fixed odd modulus, for exponents of up to
+ * nMaxBits bits. The table holds base^(j * 16^i) for every 4-bit digit j and
+ * position i in Montgomery form, so an exponentiation costs one Montgomery
+ * multiplication per non-zero digit and no squarings. Used for the group
+ * generators in ZerocoinParams; negative or longer exponents go through
+ * pow_mod.
+ */
+class CBigNumFixedBase
+{
+private:
+    static const int WINDOW_BITS = 4;
+    static const int WINDOW_SIZE = (1 << WINDOW_BITS) - 1;
+
+    CBigNum base;
+    CBigNum modulus;
+    int nMaxBits;
+    std::vector<CBigNum> vTable;
+
+public:
+    CBigNumFixedBase(const CBigNum& baseIn, const CBigNum& modulusIn, int nMaxBitsIn) : base(baseIn), modulus(modulusIn), nMaxBits(nMaxBitsIn)
+    {
+        CBigNumThreadContext& context = CBigNumThreadContext::get();
+        BN_MONT_CTX* pmont = context.mont(modulus.bn);
+        if (pmont == NULL || nMaxBits <= 0)
+            return;
+
+        int nWindows = (nMaxBits + WINDOW_BITS - 1) / WINDOW_BITS;
+        vTable.resize(nWindows * WINDOW_SIZE);
+        CBigNum power = base % modulus;
+        if (!BN_to_montgomery(power.bn, power.bn, pmont, context.ctx()))
+            throw bignum_error("CBigNumFixedBase : BN_to_montgomery failed");
+        for (int i = 0; i < nWindows; i++) {
+            // power is base^(16^i)
+            vTable[i * WINDOW_SIZE] = power;
+            for (int j = 1; j < WINDOW_SIZE; j++) {
+                if (!BN_mod_mul_montgomery(vTable[i * WINDOW_SIZE + j].bn, vTable[i * WINDOW_SIZE + j - 1].bn, power.bn, pmont, context.ctx()))
+                    throw bignum_error("CBigNumFixedBase : BN_mod_mul_montgomery failed");
+            }
+            if (!BN_mod_mul_montgomery(power.bn, vTable[i * WINDOW_SIZE + WINDOW_SIZE - 1].bn, power.bn, pmont, context.ctx()))
+                throw bignum_error("CBigNumFixedBase : BN_mod_mul_montgomery failed");
+        }
+    }
+
+    const CBigNum& getBase() const { return base; }
+    const CBigNum& getModulus() const { return modulus; }
+
+    /** Whether pow_mod(e) can use the table */
+    bool covers(const CBigNum& e) const { return !vTable.empty() && e >= 0 && e.bitSize() <= nMaxBits; }
+
+    /** base^e mod modulus */
+    CBigNum pow_mod(const CBigNum& e) const
+    {
+        if (!covers(e))
+            return base.pow_mod(e, modulus);
+
+        CBigNumThreadContext& context = CBigNumThreadContext::get();
+        BN_MONT_CTX* pmont = context.mont(modulus.bn);
+        CBigNum acc;
+        bool fOne = true;
+        for (int i = 0; i * WINDOW_BITS < e.bitSize(); i++) {
+            int nDigit = 0;
+            for (int b = WINDOW_BITS - 1; b >= 0; b--)
+                nDigit = (nDigit << 1) | (BN_is_bit_set(e.bn, i * WINDOW_BITS + b) ? 1 : 0);
+            if (nDigit == 0)
+                continue;
+
+            const CBigNum& entry = vTable[i * WINDOW_SIZE + nDigit - 1];
+            if (fOne) {
+                acc = entry;
+                fOne = false;
+            } else if (!BN_mod_mul_montgomery(acc.bn, acc.bn, entry.bn, pmont, context.ctx())) {
+                throw bignum_error("CBigNumFixedBase::pow_mod : BN_mod_mul_montgomery failed");
+            }
+        }
+
+        if (fOne)
+            return CBigNum(1) % modulus;
+
+        CBigNum ret;
+        if (!BN_from_montgomery(ret.bn, acc.bn, pmont, context.ctx()))
+            throw bignum_error("CBigNumFixedBase::pow_mod : BN_from_montgomery failed");
+        return ret;
+    }
+};
+
 #endif
@@ -0,0 +1,167 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "logwriter.h"
+
+#include "util.h"
+#include "utiltime.h"
+
+#include <algorithm>
+
+#include <boost/bind.hpp>
+
+const uint64_t CLogRing::SIZE;
+
+static void AppendJsonString(std::string& strOut, const std::string& str)
+{
+    strOut += '"';
+    for (unsigned char ch : str) {
+        if (ch == '"' || ch == '\\') {
+            strOut += '\\';
+            strOut += ch;
+        } else if (ch == '\n') {
+            strOut += "\\n";
+        } else if (ch < 0x20) {
+            strOut += strprintf("\\u%04x", ch);
+        } else {
+            strOut += ch;
+        }
+    }
+    strOut += '"';
+}
+
+CLogWriter::CLogWriter(const WriteFn& writeFnIn) : writeFn(writeFnIn), nSequence(0), fRunning(false), nPushing(0), fStop(false), fStartedNewLine(true), fJson(false)
+{
+}
+
+CLogWriter::~CLogWriter()
+{
+    Stop();
+}
+
+bool CLogWriter::Push(const std::string& str, const char* category)
+{
+    // announce the push before looking at fRunning: Stop clears fRunning
+    // first and then waits for nPushing, so either this line goes straight to
+    // the caller or Stop drains it
+    nPushing++;
+    if (!fRunning) {
+        nPushing--;
+        return false;
+    }
+
+    if (ring.get() == NULL) {
+        ring.reset(new std::shared_ptr<CLogRing>(new CLogRing()));
+        boost::unique_lock<boost::mutex> lock(mutex);
+        vRings.push_back(*ring);
+    }
+
+    CLogLine line;
+    line.nSequence = nSequence++;
+    line.nTime = GetTime();
+    line.str = str;
+    if (fJson) {
+        if (category)
+            line.strCategory = category;
+        line.strThread = GetThreadName();
+    }
+
+    // the writer keeps running until nPushing drops to zero, wait for it rather than lose the line
+    while (!(*ring)->Push(line)) {
+        cond.notify_one();
+        boost::this_thread::yield();
+    }
+    nPushing--;
+    return true;
+}
+
+void CLogWriter::Drain()
+{
+    std::vector<CLogLine> vLines;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        for (std::vector<std::shared_ptr<CLogRing> >::iterator it = vRings.begin(); it != vRings.end();) {
+            (*it)->PopAll(vLines);
+            // the thread that owned it has exited
+            if (it->use_count() == 1 && (*it)->Empty())
+                it = vRings.erase(it);
+            else
+                it++;
+        }
+    }
+    if (vLines.empty())
+        return;
+
+    std::sort(vLines.begin(), vLines.end(), [](const CLogLine& a, const CLogLine& b) { return a.nSequence < b.nSequence; });
+
+    std::string strOut;
+    for (const CLogLine& line : vLines) {
+        if (fJson) {
+            std::string str = line.str;
+            if (!str.empty() && str[str.size() - 1] == '\n')
+                str.erase(str.size() - 1);
+            strOut += "{\"time\":";
+            AppendJsonString(strOut, DateTimeStrFormat("%Y-%m-%dT%H:%M:%SZ", line.nTime));
+            strOut += ",\"thread\":";
+            AppendJsonString(strOut, line.strThread);
+            strOut += ",\"category\":";
+            AppendJsonString(strOut, line.strCategory);
+            strOut += ",\"message\":";
+            AppendJsonString(strOut, str);
+            strOut += "}\n";
+            continue;
+        }
+
+        if (fLogTimestamps && fStartedNewLine)
+            strOut += DateTimeStrFormat("%Y-%m-%d %H:%M:%S", line.nTime) + " ";
+        fStartedNewLine = !line.str.empty() && line.str[line.str.size() - 1] == '\n';
+        strOut += line.str;
+    }
+
+    writeFn(strOut);
+}
+
+void CLogWriter::Thread()
+{
+    RenameThread("forextrading-log");
+    while (true) {
+        bool fStopping;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (!fStop)
+                cond.timed_wait(lock, boost::posix_time::milliseconds(50));
+            fStopping = fStop;
+        }
+        Drain();
+        if (fStopping)
+            return;
+    }
+}
+
+void CLogWriter::Start()
+{
+    if (fRunning)
+        return;
+    fStop = false;
+    thread = boost::thread(boost::bind(&CLogWriter::Thread, this));
+    fRunning = true;
+}
+
+void CLogWriter::Stop()
+{
+    if (!fRunning)
+        return;
+    // new lines go straight to the file from here on, the writer drains what is queued
+    fRunning = false;
+    while (nPushing > 0) {
+        cond.notify_one();
+        boost::this_thread::yield();
+    }
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fStop = true;
+    }
+    cond.notify_one();
+    thread.join();
+}
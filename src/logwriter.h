@@ -0,0 +1,119 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_LOGWRITER_H
+#define BITCOIN_LOGWRITER_H
+
+#include <stdint.h>
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+#include <boost/thread/thread.hpp>
+#include <boost/thread/tss.hpp>
+
+/** One queued log message */
+struct CLogLine {
+    uint64_t nSequence;
+    int64_t nTime;
+    std::string str;
+    std::string strCategory;
+    std::string strThread;
+};
+
+/**
+ * Lines logged by one thread, waiting for the writer thread. Only the owning
+ * thread pushes and only the writer pops, so the indexes are all the
+ * synchronization needed.
+ */
+class CLogRing
+{
+public:
+    static const uint64_t SIZE = 1024;
+
+private:
+    CLogLine vLines[SIZE];
+    std::atomic<uint64_t> nHead; //! next slot the owner writes
+    std::atomic<uint64_t> nTail; //! next slot the writer reads
+
+public:
+    CLogRing() : nHead(0), nTail(0) {}
+
+    /** Queue line, false if the ring is full */
+    bool Push(CLogLine& line)
+    {
+        uint64_t nPos = nHead.load(std::memory_order_relaxed);
+        if (nPos - nTail.load(std::memory_order_acquire) >= SIZE)
+            return false;
+        vLines[nPos % SIZE] = std::move(line);
+        nHead.store(nPos + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Empty() const
+    {
+        return nHead.load(std::memory_order_acquire) == nTail.load(std::memory_order_relaxed);
+    }
+
+    /** Move every queued line to vOut, oldest first */
+    void PopAll(std::vector<CLogLine>& vOut)
+    {
+        uint64_t nPos = nTail.load(std::memory_order_relaxed);
+        uint64_t nEnd = nHead.load(std::memory_order_acquire);
+        for (; nPos < nEnd; nPos++)
+            vOut.push_back(std::move(vLines[nPos % SIZE]));
+        nTail.store(nPos, std::memory_order_release);
+    }
+};
+
+/**
+ * Drains the rings of all logging threads on a thread of its own and hands
+ * the formatted text to a write function, every 50ms and when stopped.
+ *
+ * With fJson every line becomes a JSON object with time, thread name,
+ * category and message.
+ */
+class CLogWriter
+{
+public:
+    typedef boost::function<void(const std::string&)> WriteFn;
+
+private:
+    WriteFn writeFn;
+    boost::mutex mutex; //! protects vRings and fStop
+    boost::condition_variable cond;
+    std::vector<std::shared_ptr<CLogRing> > vRings;
+    boost::thread_specific_ptr<std::shared_ptr<CLogRing> > ring;
+    std::atomic<uint64_t> nSequence;
+    std::atomic<bool> fRunning;
+    //! Push calls that saw fRunning, Stop waits for them before the last Drain
+    std::atomic<int> nPushing;
+    boost::thread thread;
+    bool fStop;
+    bool fStartedNewLine;
+
+    void Drain();
+    void Thread();
+
+public:
+    bool fJson;
+
+    explicit CLogWriter(const WriteFn& writeFnIn);
+    ~CLogWriter();
+
+    void Start();
+    /** Write out everything queued, including lines of Push calls racing with Stop */
+    void Stop();
+    bool IsRunning() const { return fRunning; }
+
+    /** Queue str, false if the writer isn't running and the caller has to write it itself */
+    bool Push(const std::string& str, const char* category);
+};
+
+#endif // BITCOIN_LOGWRITER_H
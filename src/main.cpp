@@ -9,17 +9,23 @@
 #include "main.h"
 
 #include "accumulators.h"
+#include "accumulatorworker.h"
 #include "accumulatormap.h"
 #include "addrman.h"
 #include "alert.h"
+#include "blockfilereader.h"
 #include "blocksignature.h"
 #include "chainparams.h"
+#include "chaintip.h"
 #include "checkpoints.h"
 #include "checkqueue.h"
+#include "coinstats.h"
 #include "init.h"
 #include "kernel.h"
 #include "masternode-budget.h"
+#include "masternode-collateral.h"
 #include "masternode-payments.h"
+#include "masternode-sigverify.h"
 #include "masternodeman.h"
 #include "merkleblock.h"
 #include "net.h"
@@ -75,6 +81,7 @@ int nScriptCheckThreads = 0;
 bool fImporting = false;
 bool fReindex = false;
 bool fTxIndex = true;
+int nSnapshotHeight = -1;
 bool fIsBareMultisigStd = true;
 bool fCheckBlockIndex = false;
 bool fVerifyingBlocks = false;
@@ -139,13 +146,15 @@ namespace
 
 	/**
 	* The set of all CBlockIndex entries with BLOCK_VALID_TRANSACTIONS (for itself and all ancestors) and
-	* as good as our current tip or better. Entries may be failed, though.
+	* as good as our current tip or better, and without BLOCK_STAKE_PENDING. Entries may be failed, though.
 	*/
 	set<CBlockIndex*, CBlockIndexWorkComparator> setBlockIndexCandidates;
 	/** Number of nodes with fSyncStarted. */
 	int nSyncStarted = 0;
 	/** All pairs A->B, where A (or one if its ancestors) misses transactions, but B has transactions. */
 	multimap<CBlockIndex*, CBlockIndex*> mapBlocksUnlinked;
+	/** All pairs A->B, where B is stored with BLOCK_STAKE_PENDING and waits for the stake of A to be checked or A to be the tip. */
+	multimap<CBlockIndex*, CBlockIndex*> mapBlocksStakePending;
 
 	CCriticalSection cs_LastBlockFile;
 	std::vector<CBlockFileInfo> vinfoBlockFile;
@@ -165,6 +174,13 @@ namespace
 	*/
 	map<uint256, NodeId> mapBlockSource;
 
+	/**
+	* Peers that added the block index entries whose stake isn't checked yet, to cap
+	* them per peer and to punish the peer when the stake turns out invalid.
+	* Protected by cs_main.
+	*/
+	map<uint256, NodeId> mapStakePendingSource;
+
 	/** Blocks that are in flight, and that are in the queue to be downloaded. Protected by cs_main. */
 	struct QueuedBlock {
 		uint256 hash;
@@ -309,6 +325,10 @@ namespace
 		int nBlocksInFlight;
 		//! Whether we consider this a preferred download peer.
 		bool fPreferredDownload;
+		//! Index entries this peer added whose stake isn't checked yet.
+		set<uint256> setStakePending;
+		//! Whether we stopped asking for headers until setStakePending shrinks.
+		bool fHeadersPaused;
 
 		CNodeBlocks nodeBlocks;
 
@@ -324,6 +344,7 @@ namespace
 			nStallingSince = 0;
 			nBlocksInFlight = 0;
 			fPreferredDownload = false;
+			fHeadersPaused = false;
 		}
 	};
 
@@ -339,6 +360,42 @@ namespace
 		return &it->second;
 	}
 
+	// Requires cs_main.
+	void AddStakePendingSource(const uint256& hash, NodeId nodeid)
+	{
+		if (!mapStakePendingSource.insert(make_pair(hash, nodeid)).second)
+			return;
+		CNodeState* state = State(nodeid);
+		if (state)
+			state->setStakePending.insert(hash);
+	}
+
+	// Requires cs_main. Returns the peer that added the entry, or -1.
+	NodeId PopStakePendingSource(const uint256& hash)
+	{
+		map<uint256, NodeId>::iterator it = mapStakePendingSource.find(hash);
+		if (it == mapStakePendingSource.end())
+			return -1;
+		NodeId nodeid = it->second;
+		CNodeState* state = State(nodeid);
+		if (state)
+			state->setStakePending.erase(hash);
+		mapStakePendingSource.erase(it);
+		return nodeid;
+	}
+
+	// Requires cs_main. Forget the unchecked stakes a disconnecting peer added. The entries stay
+	// in the block index without block data, like any header no block was received for yet.
+	void EraseStakePendingFor(NodeId nodeid)
+	{
+		CNodeState* state = State(nodeid);
+		BOOST_FOREACH (const uint256& hash, state->setStakePending)
+			mapStakePendingSource.erase(hash);
+		if (!state->setStakePending.empty())
+			LogPrint("net", "forgot %u headers with unchecked stake from peer=%d\n", state->setStakePending.size(), nodeid);
+		state->setStakePending.clear();
+	}
+
 	int GetHeight()
 	{
 		while (true) {
@@ -384,6 +441,7 @@ namespace
 		BOOST_FOREACH(const QueuedBlock& entry, state->vBlocksInFlight)
 			mapBlocksInFlight.erase(entry.hash);
 		EraseOrphansFor(nodeid);
+		EraseStakePendingFor(nodeid);
 		nPreferredDownload -= state->fPreferredDownload;
 
 		mapNodeState.erase(nodeid);
@@ -612,6 +670,7 @@ CBlockIndex* FindForkInGlobalIndex(const CChain& chain, const CBlockLocator& loc
 	return chain.Genesis();
 }
 
+CCoinsViewDB* pcoinsdbview = NULL;
 CCoinsViewCache* pcoinsTip = NULL;
 CBlockTreeDB* pblocktree = NULL;
 CZerocoinDB* zerocoinDB = NULL;
@@ -898,22 +957,7 @@ unsigned int GetP2SHSigOpCount(const CTransaction& tx, const CCoinsViewCache& in
 
 int GetInputAge(CTxIn& vin)
 {
-	CCoinsView viewDummy;
-	CCoinsViewCache view(&viewDummy);
-	{
-		LOCK(mempool.cs);
-		CCoinsViewMemPool viewMempool(pcoinsTip, mempool);
-		view.SetBackend(viewMempool); // temporarily switch cache backend to db+mempool view
-
-		const CCoins* coins = view.AccessCoins(vin.prevout.hash);
-
-		if (coins) {
-			if (coins->nHeight < 0) return 0;
-			return (chainActive.Tip()->nHeight + 1) - coins->nHeight;
-		}
-		else
-			return -1;
-	}
+	return collateralTracker.GetInputAge(vin.prevout);
 }
 
 int GetInputAgeIX(uint256 nTXHash, CTxIn& vin)
@@ -1168,7 +1212,7 @@ bool CheckTransaction(const CTransaction& tx, bool fZerocoinActive, bool fReject
 	// Size limits
 	unsigned int nMaxSize = MAX_ZEROCOIN_TX_SIZE;
 
-	if (::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION) > nMaxSize)
+	if (tx.GetTotalSize() > nMaxSize)
 		return state.DoS(100, error("CheckTransaction() : size limits failed"),
 			REJECT_INVALID, "bad-txns-oversize");
 
@@ -1547,6 +1591,8 @@ bool AcceptToMemoryPool(CTxMemPool& pool, CValidationState& state, const CTransa
 
 		// Store transaction in memory
 		pool.addUnchecked(hash, entry);
+		if (&pool == &mempool)
+			PublishChainTipSnapshot();
 	}
 
 	SyncWithWallets(tx, NULL);
@@ -1888,6 +1934,41 @@ bool ReadBlockFromDisk(CBlock& block, const CBlockIndex* pindex)
 	return true;
 }
 
+bool ReadRawBlockFromDisk(std::vector<unsigned char>& vchBlock, const CBlockIndex* pindex)
+{
+	// the block size is stored right before the block
+	CDiskBlockPos pos = pindex->GetBlockPos();
+	if (pos.nPos < sizeof(unsigned int))
+		return error("%s : invalid block position", __func__);
+	pos.nPos -= sizeof(unsigned int);
+
+	CAutoFile filein(OpenBlockFile(pos, true), SER_DISK, CLIENT_VERSION);
+	if (filein.IsNull())
+		return error("%s : OpenBlockFile failed", __func__);
+
+	CBlockHeader header;
+	try {
+		unsigned int nSize;
+		filein >> nSize;
+		if (nSize == 0 || nSize > MAX_BLOCK_SIZE_CURRENT)
+			return error("%s : implausible block size %u", __func__, nSize);
+		vchBlock.resize(nSize);
+		filein.read((char*)&vchBlock[0], nSize);
+
+		// only the header is decoded, to check the block is the one asked for
+		const char* pbegin = (const char*)&vchBlock[0];
+		CDataStream ssHeader(pbegin, pbegin + std::min<size_t>(nSize, 256), SER_DISK, CLIENT_VERSION);
+		ssHeader >> header;
+	}
+	catch (std::exception& e) {
+		return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+	}
+
+	if (header.GetHash() != pindex->GetBlockHash())
+		return error("%s : GetHash() doesn't match index", __func__);
+	return true;
+}
+
 
 double ConvertBitsToDouble(unsigned int nBits)
 {
@@ -2910,7 +2991,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 					REJECT_INVALID, "bad-txns-inputs-missingorspent");
 
 			// Check that the inputs are not marked as invalid/fraudulent
-			for (CTxIn in : tx.vin) {
+			for (const CTxIn& in : tx.vin) {
 				if (!ValidOutPoint(in.prevout, pindex->nHeight)) {
 					return state.DoS(100, error("%s : tried to spend invalid input %s in tx %s", __func__, in.prevout.ToString(),
 						tx.GetHash().GetHex()), REJECT_INVALID, "bad-txns-invalid-inputs");
@@ -3048,7 +3129,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 					continue;
 
 				//Search block for matching tx, turn into wtx, set merkle branch, add to wallet
-				for (CTransaction tx : block.vtx) {
+				for (const CTransaction& tx : block.vtx) {
 					if (tx.GetHash() == pSpend.second) {
 						CWalletTx wtx(pwalletMain, tx);
 						wtx.nTimeReceived = pindex->GetBlockTime();
@@ -3064,6 +3145,7 @@ bool ConnectBlock(const CBlock& block, CValidationState& state, CBlockIndex* pin
 	// Flush spend/mint info to disk
 	if (!zerocoinDB->WriteCoinSpendBatch(vSpends)) return state.Abort(("Failed to record coin serials to database"));
 	if (!zerocoinDB->WriteCoinMintBatch(vMints)) return state.Abort(("Failed to record new mints to database"));
+	if (!vMints.empty() && !IndexBlockPubcoins(block, pindex)) return state.Abort(("Failed to index block pubcoins"));
 
 	//Record accumulator checksums
 	DatabaseChecksums(mapAccumulators);
@@ -3175,7 +3257,7 @@ void FlushStateToDisk()
 void static UpdateTip(CBlockIndex* pindexNew)
 {
 	chainActive.SetTip(pindexNew);
-
+	PublishChainTipSnapshot();
 
 	// New best block
 	nTimeBestReceived = GetTime();
@@ -3225,6 +3307,7 @@ bool static DisconnectTip(CValidationState& state)
 		CCoinsViewCache view(pcoinsTip);
 		if (!DisconnectBlock(block, state, pindexDelete, view))
 			return error("DisconnectTip() : DisconnectBlock %s failed", pindexDelete->GetBlockHash().ToString());
+		coinsStatsTracker.BlockDisconnected(block, pindexDelete, *pcoinsTip, view);
 		assert(view.Flush());
 	}
 	LogPrint("bench", "- Disconnect block: %.2fms\n", (GetTimeMicros() - nStart) * 0.001);
@@ -3257,6 +3340,8 @@ static int64_t nTimeFlush = 0;
 static int64_t nTimeChainState = 0;
 static int64_t nTimePostConnect = 0;
 
+static void CheckStakePendingChildren(CBlockIndex* pindexParent);
+
 /**
 * Connect a new block to chainActive. pblock is either NULL or a pointer to a CBlock
 * corresponding to pindexNew, to bypass loading it again from disk.
@@ -3285,6 +3370,9 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
 	LogPrint("bench", "  - Load block from disk: %.2fms [%.2fs]\n", (nTime2 - nTime1) * 0.001, nTimeReadFromDisk * 0.000001);
 	{
 		CInv inv(MSG_BLOCK, pindexNew->GetBlockHash());
+		// blocks whose stake isn't checked yet never become candidates, see CheckStakePendingChildren
+		if (pindexNew->nStatus & BLOCK_STAKE_PENDING)
+			return error("ConnectTip() : stake of %s not checked", pindexNew->GetBlockHash().ToString());
 		bool rv = ConnectBlock(*pblock, state, pindexNew, view, false, fAlreadyChecked);
 		GetMainSignals().BlockChecked(*pblock, state);
 		if (!rv) {
@@ -3296,6 +3384,7 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
 		nTime3 = GetTimeMicros();
 		nTimeConnectTotal += nTime3 - nTime2;
 		LogPrint("bench", "  - Connect total: %.2fms [%.2fs]\n", (nTime3 - nTime2) * 0.001, nTimeConnectTotal * 0.000001);
+		coinsStatsTracker.BlockConnected(*pblock, pindexNew, *pcoinsTip, view);
 		assert(view.Flush());
 	}
 	int64_t nTime4 = GetTimeMicros();
@@ -3318,6 +3407,8 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
 	mempool.check(pcoinsTip);
 	// Update chainActive & related variables.
 	UpdateTip(pindexNew);
+	// Start on the accumulator checkpoint due 10 blocks from now
+	accumulatorWorker.Schedule(pindexNew);
 	// Tell wallet about transactions that went from mempool
 	// to conflicted:
 	BOOST_FOREACH(const CTransaction& tx, txConflicted) {
@@ -3333,6 +3424,9 @@ bool static ConnectTip(CValidationState& state, CBlockIndex* pindexNew, CBlock*
 	nTimeTotal += nTime6 - nTime1;
 	LogPrint("bench", "  - Connect postprocess: %.2fms [%.2fs]\n", (nTime6 - nTime5) * 0.001, nTimePostConnect * 0.000001);
 	LogPrint("bench", "- Connect block: %.2fms [%.2fs]\n", (nTime6 - nTime1) * 0.001, nTimeTotal * 0.000001);
+
+	// stored blocks whose staked output was missing while they were ahead of the tip
+	CheckStakePendingChildren(pindexNew);
 	return true;
 }
 
@@ -3661,7 +3755,8 @@ bool InvalidateBlock(CValidationState& state, CBlockIndex* pindex)
 	// add them again.
 	BlockMap::iterator it = mapBlockIndex.begin();
 	while (it != mapBlockIndex.end()) {
-		if (it->second->IsValid(BLOCK_VALID_TRANSACTIONS) && it->second->nChainTx && !setBlockIndexCandidates.value_comp()(it->second, chainActive.Tip())) {
+		if (it->second->IsValid(BLOCK_VALID_TRANSACTIONS) && it->second->nChainTx && !(it->second->nStatus & BLOCK_STAKE_PENDING) &&
+			!setBlockIndexCandidates.value_comp()(it->second, chainActive.Tip())) {
 			setBlockIndexCandidates.insert(it->second);
 		}
 		it++;
@@ -3683,7 +3778,8 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex* pindex)
 		if (!it->second->IsValid() && it->second->GetAncestor(nHeight) == pindex) {
 			it->second->nStatus &= ~BLOCK_FAILED_MASK;
 			setDirtyBlockIndex.insert(it->second);
-			if (it->second->IsValid(BLOCK_VALID_TRANSACTIONS) && it->second->nChainTx && setBlockIndexCandidates.value_comp()(chainActive.Tip(), it->second)) {
+			if (it->second->IsValid(BLOCK_VALID_TRANSACTIONS) && it->second->nChainTx && !(it->second->nStatus & BLOCK_STAKE_PENDING) &&
+				setBlockIndexCandidates.value_comp()(chainActive.Tip(), it->second)) {
 				setBlockIndexCandidates.insert(it->second);
 			}
 			if (it->second == pindexBestInvalid) {
@@ -3705,6 +3801,36 @@ bool ReconsiderBlock(CValidationState& state, CBlockIndex* pindex)
 	return true;
 }
 
+/** Fill in the proof-of-stake fields of a block index whose predecessors have theirs */
+static void SetStakeIndexFields(CBlockIndex* pindexNew)
+{
+	const uint256& hash = pindexNew->GetBlockHash();
+
+	// ppcoin: compute chain trust score
+	pindexNew->bnChainTrust = (pindexNew->pprev ? pindexNew->pprev->bnChainTrust : 0) + pindexNew->GetBlockTrust();
+
+	// ppcoin: compute stake entropy bit for stake modifier
+	if (!pindexNew->SetStakeEntropyBit(pindexNew->GetStakeEntropyBit()))
+		LogPrintf("AddToBlockIndex() : SetStakeEntropyBit() failed \n");
+
+	// ppcoin: record proof-of-stake hash value
+	if (pindexNew->IsProofOfStake()) {
+		if (!mapProofOfStake.count(hash))
+			LogPrintf("AddToBlockIndex() : hashProofOfStake not found in map \n");
+		pindexNew->hashProofOfStake = mapProofOfStake[hash];
+	}
+
+	// ppcoin: compute stake modifier
+	uint64_t nStakeModifier = 0;
+	bool fGeneratedStakeModifier = false;
+	if (!ComputeNextStakeModifier(pindexNew->pprev, nStakeModifier, fGeneratedStakeModifier))
+		LogPrintf("AddToBlockIndex() : ComputeNextStakeModifier() failed \n");
+	pindexNew->SetStakeModifier(nStakeModifier, fGeneratedStakeModifier);
+	pindexNew->nStakeModifierChecksum = GetStakeModifierChecksum(pindexNew);
+	if (!CheckStakeModifierCheckpoints(pindexNew->nHeight, pindexNew->nStakeModifierChecksum))
+		LogPrintf("AddToBlockIndex() : Rejected by stake modifier checkpoint height=%d, modifier=%s \n", pindexNew->nHeight, boost::lexical_cast<std::string>(nStakeModifier));
+}
+
 CBlockIndex* AddToBlockIndex(const CBlock& block)
 {
 	// Check for duplicate
@@ -3736,34 +3862,21 @@ CBlockIndex* AddToBlockIndex(const CBlock& block)
 		//update previous block pointer
 		pindexNew->pprev->pnext = pindexNew;
 
-		// ppcoin: compute chain trust score
-		pindexNew->bnChainTrust = (pindexNew->pprev ? pindexNew->pprev->bnChainTrust : 0) + pindexNew->GetBlockTrust();
-
-		// ppcoin: compute stake entropy bit for stake modifier
-		if (!pindexNew->SetStakeEntropyBit(pindexNew->GetStakeEntropyBit()))
-			LogPrintf("AddToBlockIndex() : SetStakeEntropyBit() failed \n");
-
-		// ppcoin: record proof-of-stake hash value
-		if (pindexNew->IsProofOfStake()) {
-			if (!mapProofOfStake.count(hash))
-				LogPrintf("AddToBlockIndex() : hashProofOfStake not found in map \n");
-			pindexNew->hashProofOfStake = mapProofOfStake[hash];
-		}
-
-		// ppcoin: compute stake modifier
-		uint64_t nStakeModifier = 0;
-		bool fGeneratedStakeModifier = false;
-		if (!ComputeNextStakeModifier(pindexNew->pprev, nStakeModifier, fGeneratedStakeModifier))
-			LogPrintf("AddToBlockIndex() : ComputeNextStakeModifier() failed \n");
-		pindexNew->SetStakeModifier(nStakeModifier, fGeneratedStakeModifier);
-		pindexNew->nStakeModifierChecksum = GetStakeModifierChecksum(pindexNew);
-		if (!CheckStakeModifierCheckpoints(pindexNew->nHeight, pindexNew->nStakeModifierChecksum))
-			LogPrintf("AddToBlockIndex() : Rejected by stake modifier checkpoint height=%d, modifier=%s \n", pindexNew->nHeight, boost::lexical_cast<std::string>(nStakeModifier));
+		// A header doesn't tell whether the block is proof of stake, and the stake modifier
+		// depends on the stakes of the blocks before it. Both have to wait for the block.
+		if (block.vtx.empty() || (pindexNew->pprev->nStatus & BLOCK_STAKE_PENDING))
+			pindexNew->nStatus |= BLOCK_STAKE_PENDING;
+		else
+			SetStakeIndexFields(pindexNew);
 	}
 	pindexNew->nChainWork = (pindexNew->pprev ? pindexNew->pprev->nChainWork : 0) + GetBlockProof(*pindexNew);
 	pindexNew->RaiseValidity(BLOCK_VALID_TREE);
-	if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexNew->nChainWork)
+	// A header whose stake isn't checked yet doesn't count until it is, see SetPendingStakeFields
+	if (!(pindexNew->nStatus & BLOCK_STAKE_PENDING) &&
+		(pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindexNew->nChainWork)) {
 		pindexBestHeader = pindexNew;
+		PublishChainTipSnapshot();
+	}
 
 	//update previous block pointer
 	if (pindexNew->nHeight)
@@ -3802,7 +3915,7 @@ bool ReceivedBlockTransactions(const CBlock& block, CValidationState& state, CBl
 				LOCK(cs_nBlockSequenceId);
 				pindex->nSequenceId = nBlockSequenceId++;
 			}
-			if (chainActive.Tip() == NULL || !setBlockIndexCandidates.value_comp()(pindex, chainActive.Tip())) {
+			if (!(pindex->nStatus & BLOCK_STAKE_PENDING) && (chainActive.Tip() == NULL || !setBlockIndexCandidates.value_comp()(pindex, chainActive.Tip()))) {
 				setBlockIndexCandidates.insert(pindex);
 			}
 			std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksUnlinked.equal_range(pindex);
@@ -4099,6 +4212,36 @@ bool CheckWork(const CBlock block, CBlockIndex* const pindexPrev)
 	return true;
 }
 
+/**
+ * Checks for a header that arrives without its block. A proof-of-stake header
+ * proves nothing by itself, so this only keeps header chains to what a valid
+ * chain could look like: no timestamps from the future, the retargeted
+ * difficulty, and proof of work up to the last PoW block. The stake is
+ * checked when the block extends the tip, or else when it is connected; the
+ * headers handler caps how many such headers a peer may add.
+ */
+static bool CheckHeaderSanity(const CBlockHeader& header, CValidationState& state, const CBlockIndex* pindexPrev)
+{
+	const int nHeight = pindexPrev->nHeight + 1;
+	const bool fProofOfStake = nHeight > Params().LAST_POW_BLOCK();
+
+	if (header.GetBlockTime() > GetAdjustedTime() + (fProofOfStake ? 180 : 7200))
+		return state.Invalid(error("%s : header timestamp too far in the future", __func__),
+			REJECT_INVALID, "time-too-new");
+
+	if (!fProofOfStake) {
+		if (!CheckProofOfWork(header.GetHash(), header.nBits))
+			return state.DoS(50, error("%s : proof of work failed", __func__),
+				REJECT_INVALID, "high-hash");
+	}
+	else if (header.nBits != GetNextWorkRequired(pindexPrev, &header)) {
+		return state.DoS(100, error("%s : incorrect difficulty at %d", __func__, nHeight),
+			REJECT_INVALID, "bad-diffbits");
+	}
+
+	return true;
+}
+
 bool ContextualCheckBlockHeader(const CBlockHeader& block, CValidationState& state, CBlockIndex* const pindexPrev)
 {
 	uint256 hash = block.GetHash();
@@ -4285,264 +4428,416 @@ bool ContextualCheckZerocoinStake(int nHeight, CStakeInput* stake)
 	return true;
 }
 
-bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex, CDiskBlockPos* dbp, bool fAlreadyCheckedBlock)
+/** Fill in the stake fields of an index whose header came first, once the block's stake is checked */
+static void SetPendingStakeFields(const CBlock& block, CBlockIndex* pindex)
 {
-	AssertLockHeld(cs_main);
+	if (block.IsProofOfStake()) {
+		pindex->SetProofOfStake();
+		pindex->prevoutStake = block.vtx[1].vin[0].prevout;
+		pindex->nStakeTime = block.nTime;
+		setStakeSeen.insert(make_pair(pindex->prevoutStake, pindex->nStakeTime));
+	}
 
-	CBlockIndex*& pindex = *ppindex;
+	SetStakeIndexFields(pindex);
+	pindex->nStatus &= ~BLOCK_STAKE_PENDING;
+	setDirtyBlockIndex.insert(pindex);
+	PopStakePendingSource(pindex->GetBlockHash());
 
-	// Get prev block index
-	CBlockIndex* pindexPrev = NULL;
-	if (block.GetHash() != Params().HashGenesisBlock()) {
-		BlockMap::iterator mi = mapBlockIndex.find(block.hashPrevBlock);
-		if (mi == mapBlockIndex.end())
-			return state.DoS(0, error("%s : prev block %s not found", __func__, block.hashPrevBlock.ToString().c_str()), 0, "bad-prevblk");
-		pindexPrev = (*mi).second;
-		if (pindexPrev->nStatus & BLOCK_FAILED_MASK) {
-			//If this "invalid" block is an exact match from the checkpoints, then reconsider it
-			if (Checkpoints::CheckBlock(pindexPrev->nHeight, block.hashPrevBlock, true)) {
-				LogPrintf("%s : Reconsidering block %s height %d\n", __func__, pindexPrev->GetBlockHash().GetHex(), pindexPrev->nHeight);
-				CValidationState statePrev;
-				ReconsiderBlock(statePrev, pindexPrev);
-				if (statePrev.IsValid()) {
-					ActivateBestChain(statePrev);
-					return true;
-				}
-			}
-			return state.DoS(100, error("%s : prev block %s is invalid, unable to add block %s", __func__, block.hashPrevBlock.GetHex(), block.GetHash().GetHex()),
-				REJECT_INVALID, "bad-prevblk");
-		}
+	if (pindexBestHeader == NULL || pindexBestHeader->nChainWork < pindex->nChainWork) {
+		pindexBestHeader = pindex;
+		PublishChainTipSnapshot();
 	}
+}
 
-	if (block.GetHash() != Params().HashGenesisBlock() && !CheckWork(block, pindexPrev))
+/** Whether some block of the active chain below the snapshot base hasn't been stored yet */
+static bool IsSnapshotHistoryMissing()
+{
+	AssertLockHeld(cs_main);
+	static int nBackfilledHeight = 0;
+	if (nSnapshotHeight < 0)
 		return false;
+	while (nBackfilledHeight < nSnapshotHeight && nBackfilledHeight < chainActive.Height() &&
+		(chainActive[nBackfilledHeight + 1]->nStatus & BLOCK_HAVE_DATA))
+		nBackfilledHeight++;
+	return nBackfilledHeight < nSnapshotHeight;
+}
 
-	bool isPoS = false;
-	if (block.IsProofOfStake()) {
-		isPoS = true;
-		uint256 hashProofOfStake = 0;
-		unique_ptr<CStakeInput> stake;
-
-		if (!CheckProofOfStake(block, hashProofOfStake, stake))
-			return state.DoS(100, error("%s: proof of stake check failed", __func__));
+/**
+ * Check the kernel of a proof-of-stake block on top of pindexPrev. fMissingInput tells
+ * whether it failed because the output being staked isn't known to this node.
+ */
+static bool CheckBlockKernel(const CBlock& block, CValidationState& state, CBlockIndex* pindexPrev, bool& fMissingInput)
+{
+	AssertLockHeld(cs_main);
+	uint256 hashProofOfStake = 0;
+	unique_ptr<CStakeInput> stake;
 
-		if (!stake)
-			return error("%s: null stake ptr", __func__);
+	// a fork may stake an output the active chain spent, created in a block that hasn't been
+	// backfilled yet: that stake can't be judged, every other failure is the peer's
+	fMissingInput = false;
+	if (!CheckProofOfStake(block, hashProofOfStake, stake, &fMissingInput))
+		return state.DoS(fMissingInput && IsSnapshotHistoryMissing() ? 0 : 100, error("%s: proof of stake check failed", __func__));
 
-		if (stake->IsZ4XT() && !ContextualCheckZerocoinStake(pindexPrev->nHeight, stake.get()))
-			return state.DoS(100, error("%s: staked z4xt fails context checks", __func__));
+	if (!stake)
+		return error("%s: null stake ptr", __func__);
 
-		uint256 hash = block.GetHash();
-		if (!mapProofOfStake.count(hash)) // add to mapProofOfStake
-			mapProofOfStake.insert(make_pair(hash, hashProofOfStake));
-	}
+	if (stake->IsZ4XT() && !ContextualCheckZerocoinStake(pindexPrev->nHeight, stake.get()))
+		return state.DoS(100, error("%s: staked z4xt fails context checks", __func__));
 
-	if (!AcceptBlockHeader(block, state, &pindex))
-		return false;
-
-	if (pindex->nStatus & BLOCK_HAVE_DATA) {
-		// TODO: deal better with duplicate blocks.
-		// return state.DoS(20, error("AcceptBlock() : already have block %d %s", pindex->nHeight, pindex->GetBlockHash().ToString()), REJECT_DUPLICATE, "duplicate");
-		LogPrintf("AcceptBlock() : already have block %d %s", pindex->nHeight, pindex->GetBlockHash().ToString());
-		return true;
-	}
-
-	if ((!fAlreadyCheckedBlock && !CheckBlock(block, state)) || !ContextualCheckBlock(block, state, pindex->pprev)) {
-		if (state.IsInvalid() && !state.CorruptionPossible()) {
-			pindex->nStatus |= BLOCK_FAILED_VALID;
-			setDirtyBlockIndex.insert(pindex);
-		}
-		return false;
-	}
+	uint256 hash = block.GetHash();
+	if (!mapProofOfStake.count(hash)) // add to mapProofOfStake
+		mapProofOfStake.insert(make_pair(hash, hashProofOfStake));
+	return true;
+}
 
+/**
+ * Check that the coinstake inputs of a proof-of-stake block aren't spent in the block
+ * itself, on its fork or in the active chain before the fork. A block ahead of the tip
+ * skips this, ConnectBlock checks its inputs without disconnecting anything.
+ */
+static bool CheckStakeInputs(const CBlock& block, CValidationState& state, CBlockIndex* pindex)
+{
+	AssertLockHeld(cs_main);
+	CBlockIndex* pindexPrev = pindex->pprev;
 	int nHeight = pindex->nHeight;
 	int splitHeight = -1;
 
-	if (isPoS) {
-		LOCK(cs_main);
-
-		// Blocks arrives in order, so if prev block is not the tip then we are on a fork.
-		// Extra info: duplicated blocks are skipping this checks, so we don't have to worry about those here.
-		bool isBlockFromFork = pindexPrev != nullptr && chainActive.Tip() != pindexPrev;
+	// Blocks arrives in order, so if prev block is not the tip then we are on a fork.
+	// Extra info: duplicated blocks are skipping this checks, so we don't have to worry about those here.
+	bool isBlockFromFork = pindexPrev != nullptr && chainActive.Tip() != pindexPrev;
 
-		// Coin stake
-		CTransaction &stakeTxIn = block.vtx[1];
+	// Coin stake
+	const CTransaction& stakeTxIn = block.vtx[1];
 
-		// Inputs
-		std::vector<CTxIn> ForexTradingInputs;
-		std::vector<CTxIn> z4xtInputs;
+	// Inputs
+	std::vector<CTxIn> ForexTradingInputs;
+	std::vector<CTxIn> z4xtInputs;
 
-		for (CTxIn stakeIn : stakeTxIn.vin) {
-			if (stakeIn.scriptSig.IsZerocoinSpend()) {
-				z4xtInputs.push_back(stakeIn);
-			}
-			else {
-				ForexTradingInputs.push_back(stakeIn);
-			}
+	for (const CTxIn& stakeIn : stakeTxIn.vin) {
+		if (stakeIn.scriptSig.IsZerocoinSpend()) {
+			z4xtInputs.push_back(stakeIn);
 		}
-		const bool hasForexTradingInputs = !ForexTradingInputs.empty();
-		const bool hasZForexTradingInputs = !z4xtInputs.empty();
+		else {
+			ForexTradingInputs.push_back(stakeIn);
+		}
+	}
+	const bool hasForexTradingInputs = !ForexTradingInputs.empty();
+	const bool hasZForexTradingInputs = !z4xtInputs.empty();
 
-		// ZC started after PoS.
-		// Check for serial double spent on the same block, TODO: Move this to the proper method..
+	// ZC started after PoS.
+	// Check for serial double spent on the same block, TODO: Move this to the proper method..
 
-		vector<CBigNum> inBlockSerials;
-		for (CTransaction tx : block.vtx) {
-			for (CTxIn in : tx.vin) {
-				if (nHeight >= Params().Zerocoin_StartHeight()) {
-					if (in.scriptSig.IsZerocoinSpend()) {
-						CoinSpend spend = TxInToZerocoinSpend(in);
-						// Check for serials double spending in the same block
-						if (std::find(inBlockSerials.begin(), inBlockSerials.end(), spend.getCoinSerialNumber()) !=
-							inBlockSerials.end()) {
-							return state.DoS(100, error("%s: serial double spent on the same block", __func__));
-						}
-						inBlockSerials.push_back(spend.getCoinSerialNumber());
+	vector<CBigNum> inBlockSerials;
+	for (const CTransaction& tx : block.vtx) {
+		for (const CTxIn& in : tx.vin) {
+			if (nHeight >= Params().Zerocoin_StartHeight()) {
+				if (in.scriptSig.IsZerocoinSpend()) {
+					CoinSpend spend = TxInToZerocoinSpend(in);
+					// Check for serials double spending in the same block
+					if (std::find(inBlockSerials.begin(), inBlockSerials.end(), spend.getCoinSerialNumber()) !=
+						inBlockSerials.end()) {
+						return state.DoS(100, error("%s: serial double spent on the same block", __func__));
 					}
+					inBlockSerials.push_back(spend.getCoinSerialNumber());
 				}
-				if (tx.IsCoinStake()) continue;
-				if (hasForexTradingInputs)
-					// Check if coinstake input is double spent inside the same block
-					for (CTxIn ForexTradingIn : ForexTradingInputs) {
-						if (ForexTradingIn.prevout == in.prevout) {
-							// double spent coinstake input inside block
-							return error("%s: double spent coinstake input inside block", __func__);
-						}
-					}
 			}
+			if (tx.IsCoinStake()) continue;
+			if (hasForexTradingInputs)
+				// Check if coinstake input is double spent inside the same block
+				for (const CTxIn& ForexTradingIn : ForexTradingInputs) {
+					if (ForexTradingIn.prevout == in.prevout) {
+						// double spent coinstake input inside block
+						return error("%s: double spent coinstake input inside block", __func__);
+					}
+				}
 		}
-		inBlockSerials.clear();
+	}
+	inBlockSerials.clear();
 
 
-		// Check whether is a fork or not
-		if (isBlockFromFork) {
+	// Check whether is a fork or not
+	if (isBlockFromFork) {
 
-			// Start at the block we're adding on to
-			CBlockIndex *prev = pindexPrev;
+		// Start at the block we're adding on to
+		CBlockIndex *prev = pindexPrev;
 
-			int readBlock = 0;
-			vector<CBigNum> vBlockSerials;
-			CBlock bl;
-			// Go backwards on the forked chain up to the split
-			do {
-				// Check if the forked chain is longer than the max reorg limit
-				if (readBlock == Params().MaxReorganizationDepth()) {
-					// TODO: Remove this chain from disk.
-					return error("%s: forked chain longer than maximum reorg limit", __func__);
-				}
+		int readBlock = 0;
+		vector<CBigNum> vBlockSerials;
+		CBlock bl;
+		// Go backwards on the forked chain up to the split
+		do {
+			// Check if the forked chain is longer than the max reorg limit
+			if (readBlock == Params().MaxReorganizationDepth()) {
+				// TODO: Remove this chain from disk.
+				return error("%s: forked chain longer than maximum reorg limit", __func__);
+			}
 
-				if (!ReadBlockFromDisk(bl, prev))
-					// Previous block not on disk
-					return error("%s: previous block %s not on disk", __func__, prev->GetBlockHash().GetHex());
-				// Increase amount of read blocks
-				readBlock++;
-				// Loop through every input from said block
-				for (CTransaction t : bl.vtx) {
-					for (CTxIn in : t.vin) {
-						// Loop through every input of the staking tx
-						for (CTxIn stakeIn : ForexTradingInputs) {
-							// if it's already spent
-
-							// First regular staking check
-							if (hasForexTradingInputs) {
-								if (stakeIn.prevout == in.prevout) {
-									return state.DoS(100, error("%s: input already spent on a previous block", __func__));
-								}
-
-								// Second, if there is zPoS staking then store the serials for later check
-								if (in.scriptSig.IsZerocoinSpend()) {
-									vBlockSerials.push_back(TxInToZerocoinSpend(in).getCoinSerialNumber());
-								}
+			if (!ReadBlockFromDisk(bl, prev))
+				// Previous block not on disk
+				return error("%s: previous block %s not on disk", __func__, prev->GetBlockHash().GetHex());
+			// Increase amount of read blocks
+			readBlock++;
+			// Loop through every input from said block
+			for (const CTransaction& t : bl.vtx) {
+				for (const CTxIn& in : t.vin) {
+					// Loop through every input of the staking tx
+					for (const CTxIn& stakeIn : ForexTradingInputs) {
+						// if it's already spent
+
+						// First regular staking check
+						if (hasForexTradingInputs) {
+							if (stakeIn.prevout == in.prevout) {
+								return state.DoS(100, error("%s: input already spent on a previous block", __func__));
+							}
+
+							// Second, if there is zPoS staking then store the serials for later check
+							if (in.scriptSig.IsZerocoinSpend()) {
+								vBlockSerials.push_back(TxInToZerocoinSpend(in).getCoinSerialNumber());
 							}
 						}
 					}
 				}
+			}
 
-				prev = prev->pprev;
+			prev = prev->pprev;
 
-			} while (!chainActive.Contains(prev));
+		} while (!chainActive.Contains(prev));
 
-			// Split height
-			splitHeight = prev->nHeight;
+		// Split height
+		splitHeight = prev->nHeight;
 
-			// Now that this loop if completed. Check if we have z4xt inputs.
-			if (hasZForexTradingInputs) {
-				for (CTxIn zPscsInput : z4xtInputs) {
-					CoinSpend spend = TxInToZerocoinSpend(zPscsInput);
+		// Now that this loop if completed. Check if we have z4xt inputs.
+		if (hasZForexTradingInputs) {
+			for (const CTxIn& zPscsInput : z4xtInputs) {
+				CoinSpend spend = TxInToZerocoinSpend(zPscsInput);
 
-					// First check if the serials were not already spent on the forked blocks.
-					CBigNum coinSerial = spend.getCoinSerialNumber();
-					for (CBigNum serial : vBlockSerials) {
-						if (serial == coinSerial) {
-							return state.DoS(100, error("%s: serial double spent on fork", __func__));
-						}
+				// First check if the serials were not already spent on the forked blocks.
+				CBigNum coinSerial = spend.getCoinSerialNumber();
+				for (const CBigNum& serial : vBlockSerials) {
+					if (serial == coinSerial) {
+						return state.DoS(100, error("%s: serial double spent on fork", __func__));
 					}
+				}
 
-					// Now check if the serial exists before the chain split.
-					int nHeightTx = 0;
-					if (IsSerialInBlockchain(spend.getCoinSerialNumber(), nHeightTx)) {
-						// if the height is nHeightTx > chainSplit means that the spent occurred after the chain split
-						if (nHeightTx <= splitHeight)
-							return state.DoS(100, error("%s: serial double spent on main chain", __func__));
-					}
+				// Now check if the serial exists before the chain split.
+				int nHeightTx = 0;
+				if (IsSerialInBlockchain(spend.getCoinSerialNumber(), nHeightTx)) {
+					// if the height is nHeightTx > chainSplit means that the spent occurred after the chain split
+					if (nHeightTx <= splitHeight)
+						return state.DoS(100, error("%s: serial double spent on main chain", __func__));
+				}
 
-					if (!ContextualCheckZerocoinSpendNoSerialCheck(stakeTxIn, spend, pindex, 0))
-						return state.DoS(100, error("%s: forked chain ContextualCheckZerocoinSpend failed for tx %s", __func__,
-							stakeTxIn.GetHash().GetHex()), REJECT_INVALID, "bad-txns-invalid-z4xt");
+				if (!ContextualCheckZerocoinSpendNoSerialCheck(stakeTxIn, spend, pindex, 0))
+					return state.DoS(100, error("%s: forked chain ContextualCheckZerocoinSpend failed for tx %s", __func__,
+						stakeTxIn.GetHash().GetHex()), REJECT_INVALID, "bad-txns-invalid-z4xt");
 
-					// Now only the ZKP left..
-					// As the spend maturity is 200, the acc value must be accumulated, otherwise it's not ready to be spent
-					CBigNum bnAccumulatorValue = 0;
-					if (!zerocoinDB->ReadAccumulatorValue(spend.getAccumulatorChecksum(), bnAccumulatorValue)) {
-						return state.DoS(100, error("%s: stake zerocoinspend not ready to be spent", __func__));
-					}
+				// Now only the ZKP left..
+				// As the spend maturity is 200, the acc value must be accumulated, otherwise it's not ready to be spent
+				CBigNum bnAccumulatorValue = 0;
+				if (!zerocoinDB->ReadAccumulatorValue(spend.getAccumulatorChecksum(), bnAccumulatorValue)) {
+					return state.DoS(100, error("%s: stake zerocoinspend not ready to be spent", __func__));
+				}
 
-					Accumulator accumulator(Params().Zerocoin_Params(chainActive.Height() < Params().Zerocoin_Block_V2_Start()),
-						spend.getDenomination(), bnAccumulatorValue);
+				Accumulator accumulator(Params().Zerocoin_Params(chainActive.Height() < Params().Zerocoin_Block_V2_Start()),
+					spend.getDenomination(), bnAccumulatorValue);
 
-					//Check that the coinspend is valid
-					if (!spend.Verify(accumulator))
-						return state.DoS(100, error("%s: zerocoin spend did not verify", __func__));
+				//Check that the coinspend is valid
+				if (!spend.Verify(accumulator))
+					return state.DoS(100, error("%s: zerocoin spend did not verify", __func__));
 
-				}
 			}
-
 		}
 
+	}
+
 
-		// If the stake is not a zPoS then let's check if the inputs were spent on the main chain
-		const CCoinsViewCache coins(pcoinsTip);
-		if (!stakeTxIn.IsZerocoinSpend()) {
-			for (CTxIn in : stakeTxIn.vin) {
-				const CCoins* coin = coins.AccessCoins(in.prevout.hash);
+	// If the stake is not a zPoS then let's check if the inputs were spent on the main chain
+	const CCoinsViewCache coins(pcoinsTip);
+	if (!stakeTxIn.IsZerocoinSpend()) {
+		for (const CTxIn& in : stakeTxIn.vin) {
+			const CCoins* coin = coins.AccessCoins(in.prevout.hash);
 
-				if (!coin && !isBlockFromFork) {
-					// No coins on the main chain
-					return error("%s: coin stake inputs not available on main chain, received height %d vs current %d", __func__, nHeight, chainActive.Height());
+			if (!coin && !isBlockFromFork) {
+				// No coins on the main chain
+				return error("%s: coin stake inputs not available on main chain, received height %d vs current %d", __func__, nHeight, chainActive.Height());
+			}
+			if (coin && !coin->IsAvailable(in.prevout.n)) {
+				// If this is not available get the height of the spent and validate it with the forked height
+				// Check if this occurred before the chain split
+				if (!(isBlockFromFork && coin->nHeight > splitHeight)) {
+					// Coins not available
+					return error("%s: coin stake inputs already spent in main chain", __func__);
 				}
-				if (coin && !coin->IsAvailable(in.prevout.n)) {
-					// If this is not available get the height of the spent and validate it with the forked height
-					// Check if this occurred before the chain split
-					if (!(isBlockFromFork && coin->nHeight > splitHeight)) {
-						// Coins not available
-						return error("%s: coin stake inputs already spent in main chain", __func__);
+			}
+		}
+	}
+	else {
+		if (!isBlockFromFork)
+			for (const CTxIn& zPscsInput : z4xtInputs) {
+				CoinSpend spend = TxInToZerocoinSpend(zPscsInput);
+				if (!ContextualCheckZerocoinSpend(stakeTxIn, spend, pindex, 0))
+					return state.DoS(100, error("%s: main chain ContextualCheckZerocoinSpend failed for tx %s", __func__,
+						stakeTxIn.GetHash().GetHex()), REJECT_INVALID, "bad-txns-invalid-z4xt");
+			}
+
+	}
+
+	return true;
+}
+
+/** Whether pindexPrev is a descendant of the tip, so a block on top of it is ahead of the tip */
+static bool IsAheadOfTip(const CBlockIndex* pindexPrev)
+{
+	return pindexPrev && pindexPrev != chainActive.Tip() && pindexPrev->GetAncestor(chainActive.Height()) == chainActive.Tip();
+}
+
+/**
+ * Check the stakes of the stored blocks that waited for the stake of pindexParent, or for
+ * it to become the tip. A block that passes becomes a candidate for the active chain and
+ * the blocks waiting for it are checked in turn.
+ */
+static void CheckStakePendingChildren(CBlockIndex* pindexParent)
+{
+	AssertLockHeld(cs_main);
+	deque<CBlockIndex*> queue;
+	queue.push_back(pindexParent);
+	while (!queue.empty()) {
+		CBlockIndex* pindexPrev = queue.front();
+		queue.pop_front();
+		std::pair<std::multimap<CBlockIndex*, CBlockIndex*>::iterator, std::multimap<CBlockIndex*, CBlockIndex*>::iterator> range = mapBlocksStakePending.equal_range(pindexPrev);
+		while (range.first != range.second) {
+			std::multimap<CBlockIndex*, CBlockIndex*>::iterator it = range.first++;
+			CBlockIndex* pindex = it->second;
+			CBlock block;
+			if (!ReadBlockFromDisk(block, pindex)) {
+				error("%s : failed to read block %s", __func__, pindex->GetBlockHash().ToString());
+				continue;
+			}
+
+			CValidationState state;
+			if (block.IsProofOfStake()) {
+				bool fMissingInput = false;
+				bool fValid = CheckBlockKernel(block, state, pindexPrev, fMissingInput) &&
+					(IsAheadOfTip(pindexPrev) || CheckStakeInputs(block, state, pindex));
+				if (!fValid && fMissingInput && pindexPrev != chainActive.Tip())
+					continue;
+				if (!fValid) {
+					// InvalidBlockFound punishes the peer that sent the block, this one sent its header
+					NodeId nodeid = PopStakePendingSource(pindex->GetBlockHash());
+					int nDoS = 0;
+					if (state.IsInvalid(nDoS)) {
+						std::map<uint256, NodeId>::iterator itSource = mapBlockSource.find(pindex->GetBlockHash());
+						if (nodeid >= 0 && (itSource == mapBlockSource.end() || itSource->second != nodeid))
+							Misbehaving(nodeid, nDoS);
+						InvalidBlockFound(pindex, state);
+						mapBlocksStakePending.erase(it);
 					}
+					error("%s : stake check of %s failed", __func__, pindex->GetBlockHash().ToString());
+					continue;
 				}
 			}
+
+			SetPendingStakeFields(block, pindex);
+			mapBlocksStakePending.erase(it);
+			if (pindex->nChainTx && !setBlockIndexCandidates.value_comp()(pindex, chainActive.Tip()))
+				setBlockIndexCandidates.insert(pindex);
+			queue.push_back(pindex);
 		}
-		else {
-			if (!isBlockFromFork)
-				for (CTxIn zPscsInput : z4xtInputs) {
-					CoinSpend spend = TxInToZerocoinSpend(zPscsInput);
-					if (!ContextualCheckZerocoinSpend(stakeTxIn, spend, pindex, 0))
-						return state.DoS(100, error("%s: main chain ContextualCheckZerocoinSpend failed for tx %s", __func__,
-							stakeTxIn.GetHash().GetHex()), REJECT_INVALID, "bad-txns-invalid-z4xt");
+	}
+}
+
+bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex, CDiskBlockPos* dbp, bool fAlreadyCheckedBlock)
+{
+	AssertLockHeld(cs_main);
+
+	// A block of the active chain up to the snapshot base is already part of the chain state, its
+	// data only backfills the block files. The stake checks below need older blocks that may not
+	// be there yet, so it only gets the context free checks.
+	bool fBackfill = false;
+	// A block gets its stake checked here when the stake of its parent is checked, also when its
+	// header came first. One on top of a block whose stake isn't checked yet, or ahead of the tip
+	// and staking an output of a block that isn't connected yet, is stored as it arrives. It isn't
+	// a candidate for the active chain until CheckStakePendingChildren checked its stake.
+	// ProcessNewBlock and the headers handler cap how many of those a peer may add.
+	bool fStakePending = false;
+	BlockMap::iterator miSelf = mapBlockIndex.find(block.GetHash());
+	if (miSelf != mapBlockIndex.end()) {
+		fBackfill = nSnapshotHeight >= 0 && miSelf->second->nHeight <= nSnapshotHeight &&
+			chainActive.Contains(miSelf->second) && !(miSelf->second->nStatus & BLOCK_HAVE_DATA);
+	}
+
+	CBlockIndex*& pindex = *ppindex;
+
+	// Get prev block index
+	CBlockIndex* pindexPrev = NULL;
+	if (block.GetHash() != Params().HashGenesisBlock()) {
+		BlockMap::iterator mi = mapBlockIndex.find(block.hashPrevBlock);
+		if (mi == mapBlockIndex.end())
+			return state.DoS(0, error("%s : prev block %s not found", __func__, block.hashPrevBlock.ToString().c_str()), 0, "bad-prevblk");
+		pindexPrev = (*mi).second;
+		if (pindexPrev->nStatus & BLOCK_FAILED_MASK) {
+			//If this "invalid" block is an exact match from the checkpoints, then reconsider it
+			if (Checkpoints::CheckBlock(pindexPrev->nHeight, block.hashPrevBlock, true)) {
+				LogPrintf("%s : Reconsidering block %s height %d\n", __func__, pindexPrev->GetBlockHash().GetHex(), pindexPrev->nHeight);
+				CValidationState statePrev;
+				ReconsiderBlock(statePrev, pindexPrev);
+				if (statePrev.IsValid()) {
+					ActivateBestChain(statePrev);
+					return true;
 				}
+			}
+			return state.DoS(100, error("%s : prev block %s is invalid, unable to add block %s", __func__, block.hashPrevBlock.GetHex(), block.GetHash().GetHex()),
+				REJECT_INVALID, "bad-prevblk");
+		}
+	}
+
+	if (block.GetHash() != Params().HashGenesisBlock() && !CheckWork(block, pindexPrev))
+		return false;
+
+	if (pindexPrev && (pindexPrev->nStatus & BLOCK_STAKE_PENDING))
+		fStakePending = true;
 
+	bool isPoS = false;
+	if (block.IsProofOfStake() && !fBackfill && !fStakePending) {
+		bool fMissingInput = false;
+		if (CheckBlockKernel(block, state, pindexPrev, fMissingInput)) {
+			isPoS = true;
+		} else if (fMissingInput && pindexPrev != chainActive.Tip()) {
+			// the output may be created by a block before this one that isn't connected yet
+			state = CValidationState();
+			fStakePending = true;
+		} else {
+			return false;
 		}
+	}
 
+	// Without its transactions the index of a new block is marked BLOCK_STAKE_PENDING
+	if (!AcceptBlockHeader(fStakePending ? CBlock(block.GetBlockHeader()) : block, state, &pindex))
+		return false;
+
+	if (pindex->nStatus & BLOCK_HAVE_DATA) {
+		// TODO: deal better with duplicate blocks.
+		// return state.DoS(20, error("AcceptBlock() : already have block %d %s", pindex->nHeight, pindex->GetBlockHash().ToString()), REJECT_DUPLICATE, "duplicate");
+		LogPrintf("AcceptBlock() : already have block %d %s", pindex->nHeight, pindex->GetBlockHash().ToString());
+		return true;
+	}
+
+	if ((!fAlreadyCheckedBlock && !CheckBlock(block, state)) || !ContextualCheckBlock(block, state, pindex->pprev)) {
+		if (state.IsInvalid() && !state.CorruptionPossible()) {
+			pindex->nStatus |= BLOCK_FAILED_VALID;
+			setDirtyBlockIndex.insert(pindex);
+		}
+		return false;
 	}
 
+	int nHeight = pindex->nHeight;
+
+	if (isPoS && !IsAheadOfTip(pindexPrev) && !CheckStakeInputs(block, state, pindex))
+		return false;
+
+	if ((pindex->nStatus & BLOCK_STAKE_PENDING) && !fStakePending)
+		SetPendingStakeFields(block, pindex);
+
 	// Write block to history file
 	try {
 		unsigned int nBlockSize = ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
@@ -4561,6 +4856,11 @@ bool AcceptBlock(CBlock& block, CValidationState& state, CBlockIndex** ppindex,
 		return state.Abort(std::string("System error: ") + e.what());
 	}
 
+	if (fStakePending)
+		mapBlocksStakePending.insert(std::make_pair(pindexPrev, pindex));
+	else
+		CheckStakePendingChildren(pindex);
+
 	return true;
 }
 
@@ -4673,11 +4973,23 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDis
 			return error("%s : CheckBlock FAILED for block %s", __func__, pblock->GetHash().GetHex());
 		}
 
+		// A block that doesn't extend the tip may be stored with its stake unchecked
+		CNodeState* nodestateFrom = pfrom ? State(pfrom->GetId()) : nullptr;
+		BlockMap::iterator miPrev = mapBlockIndex.find(pblock->hashPrevBlock);
+		if (nodestateFrom && !mapBlockIndex.count(pblock->GetHash()) && miPrev != mapBlockIndex.end() &&
+			miPrev->second != chainActive.Tip() && ((int)nodestateFrom->setStakePending.size() >= MAX_STAKE_PENDING_PER_PEER ||
+			(int)mapStakePendingSource.size() >= MAX_STAKE_PENDING)) {
+			return error("%s : too many blocks with unchecked stake from peer=%d, ignoring %s", __func__, pfrom->id,
+				pblock->GetHash().GetHex());
+		}
+
 		// Store to disk
 		CBlockIndex* pindex = nullptr;
 		bool ret = AcceptBlock(*pblock, state, &pindex, dbp, checked);
 		if (pindex && pfrom) {
 			mapBlockSource[pindex->GetBlockHash()] = pfrom->GetId();
+			if (pindex->nStatus & BLOCK_STAKE_PENDING)
+				AddStakePendingSource(pindex->GetBlockHash(), pfrom->GetId());
 		}
 		CheckBlockIndex();
 		if (!ret) {
@@ -4714,16 +5026,6 @@ bool ProcessNewBlock(CValidationState& state, CNode* pfrom, CBlock* pblock, CDis
 		}
 	}
 
-	if (pwalletMain) {
-		// If turned on MultiSend will send a transaction (or more) on the after maturity of a stake
-		if (pwalletMain->isMultiSendEnabled())
-			pwalletMain->MultiSend();
-
-		// If turned on Auto Combine will scan wallet for dust to combine
-		if (pwalletMain->fCombineDust)
-			pwalletMain->AutoCombineDust();
-	}
-
 	LogPrintf("%s : ACCEPTED Block %ld in %ld milliseconds with size=%d\n", __func__, GetHeight(), GetTimeMillis() - nStartTime,
 		pblock->GetSerializeSize(SER_DISK, CLIENT_VERSION));
 
@@ -4872,13 +5174,16 @@ bool static LoadBlockIndexDB(string& strError)
 				pindex->nChainTx = pindex->nTx;
 			}
 		}
-		if (pindex->IsValid(BLOCK_VALID_TRANSACTIONS) && (pindex->nChainTx || pindex->pprev == NULL))
+		if (pindex->IsValid(BLOCK_VALID_TRANSACTIONS) && (pindex->nChainTx || pindex->pprev == NULL) && !(pindex->nStatus & BLOCK_STAKE_PENDING))
 			setBlockIndexCandidates.insert(pindex);
+		if ((pindex->nStatus & BLOCK_HAVE_DATA) && (pindex->nStatus & BLOCK_STAKE_PENDING) && pindex->pprev)
+			mapBlocksStakePending.insert(std::make_pair(pindex->pprev, pindex));
 		if (pindex->nStatus & BLOCK_FAILED_MASK && (!pindexBestInvalid || pindex->nChainWork > pindexBestInvalid->nChainWork))
 			pindexBestInvalid = pindex;
 		if (pindex->pprev)
 			pindex->BuildSkip();
-		if (pindex->IsValid(BLOCK_VALID_TREE) && (pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
+		if (pindex->IsValid(BLOCK_VALID_TREE) && !(pindex->nStatus & BLOCK_STAKE_PENDING) &&
+			(pindexBestHeader == NULL || CBlockIndexWorkComparator()(pindexBestHeader, pindex)))
 			pindexBestHeader = pindex;
 	}
 
@@ -4930,6 +5235,10 @@ bool static LoadBlockIndexDB(string& strError)
 	pblocktree->ReadFlag("txindex", fTxIndex);
 	LogPrintf("LoadBlockIndexDB(): transaction index %s\n", fTxIndex ? "enabled" : "disabled");
 
+	// Check whether the chain state was started from a snapshot
+	if (pblocktree->ReadInt("snapshotheight", nSnapshotHeight))
+		LogPrintf("LoadBlockIndexDB(): chain state loaded from a snapshot at height %d\n", nSnapshotHeight);
+
 	// If this is written true before the next client init, then we know the shutdown process failed
 	pblocktree->WriteFlag("shutdown", false);
 
@@ -4938,6 +5247,13 @@ bool static LoadBlockIndexDB(string& strError)
 	if (it == mapBlockIndex.end())
 		return true;
 	chainActive.SetTip(it->second);
+	PublishChainTipSnapshot();
+
+	// stored blocks that waited for the tip to check their stake
+	{
+		LOCK(cs_main);
+		CheckStakePendingChildren(chainActive.Tip());
+	}
 
 	PruneBlockIndexCandidates();
 
@@ -4982,6 +5298,9 @@ bool CVerifyDB::VerifyDB(CCoinsView* coinsview, int nCheckLevel, int nCheckDepth
 		uiInterface.ShowProgress(_("Verifying blocks..."), std::max(1, std::min(99, (int)(((double)(chainActive.Height() - pindex->nHeight)) / (double)nCheckDepth * (nCheckLevel >= 4 ? 50 : 100)))));
 		if (pindex->nHeight < chainActive.Height() - nCheckDepth)
 			break;
+		// blocks below a snapshot's base may not have been downloaded yet
+		if ((pindex->nStatus & (BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO)) != (BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO))
+			break;
 		CBlock block;
 		// check level 0: read from disk
 		if (!ReadBlockFromDisk(block, pindex))
@@ -5041,8 +5360,10 @@ void UnloadBlockIndex()
 {
 	mapBlockIndex.clear();
 	setBlockIndexCandidates.clear();
+	mapBlocksStakePending.clear();
 	chainActive.SetTip(NULL);
 	pindexBestInvalid = NULL;
+	PublishChainTipSnapshot();
 }
 
 bool LoadBlockIndex(string& strError)
@@ -5095,10 +5416,12 @@ bool InitBlockIndex()
 }
 
 
-bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
+// Map of disk positions for blocks with unknown parent (only used for reindex)
+static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
+
+/** Read fileIn through a ring buffer, for files that can't be memory mapped */
+static bool LoadExternalBlockFileBuffered(FILE* fileIn, CDiskBlockPos* dbp)
 {
-	// Map of disk positions for blocks with unknown parent (only used for reindex)
-	static std::multimap<uint256, CDiskBlockPos> mapBlocksUnknownParent;
 	int64_t nStart = GetTimeMillis();
 
 	int nLoaded = 0;
@@ -5199,6 +5522,127 @@ bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
 	return nLoaded > 0;
 }
 
+/**
+ * Hand a block of a mapped file to ProcessNewBlock, false on a fatal error.
+ * fAccepted tells whether the block is stored now, so its successors can follow.
+ */
+static bool ProcessMappedBlock(CMappedBlockFile& mapped, const CBlockFileEntry& entry, CDiskBlockPos* dbp, int& nLoaded, bool& fAccepted)
+{
+	// the header scan already tells which blocks are known, those aren't decoded at all
+	fAccepted = false;
+	BlockMap::iterator mi = mapBlockIndex.find(entry.hash);
+	if (mi != mapBlockIndex.end() && (mi->second->nStatus & BLOCK_HAVE_DATA)) {
+		if (entry.hash != Params().HashGenesisBlock() && mi->second->nHeight % 1000 == 0)
+			LogPrintf("Block Import: already had block %s at height %d\n", entry.hash.ToString(), mi->second->nHeight);
+		fAccepted = true;
+		return true;
+	}
+
+	CBlock block;
+	try {
+		if (!mapped.ReadBlock(entry, block))
+			return true;
+	}
+	catch (const std::exception& e) {
+		LogPrintf("%s : Deserialize or I/O error - %s", __func__, e.what());
+		return true;
+	}
+
+	CDiskBlockPos pos;
+	if (dbp)
+		pos = CDiskBlockPos(dbp->nFile, (unsigned int)entry.nPos);
+	CValidationState state;
+	if (ProcessNewBlock(state, NULL, &block, dbp ? &pos : NULL)) {
+		nLoaded++;
+		fAccepted = true;
+	}
+	return !state.IsError();
+}
+
+bool LoadExternalBlockFile(FILE* fileIn, CDiskBlockPos* dbp)
+{
+	CMappedBlockFile mapped(fileIn);
+	if (mapped.IsNull())
+		return LoadExternalBlockFileBuffered(mapped.release(), dbp);
+
+	int64_t nStart = GetTimeMillis();
+	int nLoaded = 0;
+	try {
+		// Find all blocks of the file from their headers first, so blocks can be
+		// connected in chain order instead of the order they were written in
+		std::vector<CBlockFileEntry> vEntries;
+		mapped.ScanHeaders(vEntries);
+		LogPrint("reindex", "%s: found %u blocks in %dms\n", __func__, vEntries.size(), GetTimeMillis() - nStart);
+
+		// Blocks of this file whose parent isn't known yet, by parent hash
+		std::multimap<uint256, size_t> mapWaiting;
+		bool fAbort = false;
+		for (size_t i = 0; i < vEntries.size() && !fAbort; i++) {
+			boost::this_thread::interruption_point();
+
+			const CBlockFileEntry& entry = vEntries[i];
+			if (entry.hash != Params().HashGenesisBlock() && mapBlockIndex.find(entry.hashPrev) == mapBlockIndex.end()) {
+				LogPrint("reindex", "%s: Out of order block %s, parent %s not known\n", __func__, entry.hash.ToString(),
+					entry.hashPrev.ToString());
+				mapWaiting.insert(std::make_pair(entry.hashPrev, i));
+				continue;
+			}
+			bool fAccepted;
+			if (!ProcessMappedBlock(mapped, entry, dbp, nLoaded, fAccepted))
+				break;
+
+			// Recursively process successors of this block, from this file and earlier ones
+			deque<uint256> queue;
+			queue.push_back(entry.hash);
+			while (!queue.empty() && !fAbort) {
+				uint256 head = queue.front();
+				queue.pop_front();
+
+				std::pair<std::multimap<uint256, size_t>::iterator, std::multimap<uint256, size_t>::iterator> rangeWaiting = mapWaiting.equal_range(head);
+				for (std::multimap<uint256, size_t>::iterator it = rangeWaiting.first; it != rangeWaiting.second; ++it) {
+					const CBlockFileEntry& child = vEntries[it->second];
+					if (!ProcessMappedBlock(mapped, child, dbp, nLoaded, fAccepted)) {
+						fAbort = true;
+						break;
+					}
+					if (fAccepted)
+						queue.push_back(child.hash);
+				}
+				mapWaiting.erase(rangeWaiting.first, rangeWaiting.second);
+
+				std::pair<std::multimap<uint256, CDiskBlockPos>::iterator, std::multimap<uint256, CDiskBlockPos>::iterator> range = mapBlocksUnknownParent.equal_range(head);
+				while (range.first != range.second) {
+					std::multimap<uint256, CDiskBlockPos>::iterator it = range.first;
+					CBlock block;
+					if (ReadBlockFromDisk(block, it->second)) {
+						LogPrintf("%s: Processing out of order child %s of %s\n", __func__, block.GetHash().ToString(),
+							head.ToString());
+						CValidationState dummy;
+						if (ProcessNewBlock(dummy, NULL, &block, &it->second)) {
+							nLoaded++;
+							queue.push_back(block.GetHash());
+						}
+					}
+					range.first++;
+					mapBlocksUnknownParent.erase(it);
+				}
+			}
+		}
+
+		// The parents of the remaining blocks may be in a later block file
+		if (dbp) {
+			for (std::multimap<uint256, size_t>::iterator it = mapWaiting.begin(); it != mapWaiting.end(); ++it)
+				mapBlocksUnknownParent.insert(std::make_pair(it->first, CDiskBlockPos(dbp->nFile, (unsigned int)vEntries[it->second].nPos)));
+		}
+	}
+	catch (std::runtime_error& e) {
+		AbortNode(std::string("System error: ") + e.what());
+	}
+	if (nLoaded > 0)
+		LogPrintf("Loaded %i blocks from external file in %dms\n", nLoaded, GetTimeMillis() - nStart);
+	return nLoaded > 0;
+}
+
 void static CheckBlockIndex()
 {
 	if (!fCheckBlockIndex) {
@@ -5269,7 +5713,7 @@ void static CheckBlockIndex()
 			// Checks for not-invalid blocks.
 			assert((pindex->nStatus & BLOCK_FAILED_MASK) == 0); // The failed mask cannot be set for blocks without invalid parents.
 		}
-		if (!CBlockIndexWorkComparator()(pindex, chainActive.Tip()) && pindexFirstMissing == NULL) {
+		if (!CBlockIndexWorkComparator()(pindex, chainActive.Tip()) && pindexFirstMissing == NULL && !(pindex->nStatus & BLOCK_STAKE_PENDING)) {
 			if (pindexFirstInvalid == NULL) { // If this block sorts at least as good as the current tip and is valid, it must be in setBlockIndexCandidates.
 				assert(setBlockIndexCandidates.count(pindex));
 			}
@@ -5516,7 +5960,8 @@ void static ProcessGetData(CNode* pfrom)
 					{
 						LOCK(pfrom->cs_filter);
 						if (pfrom->pfilter) {
-							CMerkleBlock merkleBlock(block, *pfrom->pfilter);
+							CBloomBlockElementsRef elements = GetBloomBlockElements(inv.hash, block);
+							CMerkleBlock merkleBlock(block, *pfrom->pfilter, *elements);
 							pfrom->PushMessage("merkleblock", merkleBlock);
 							// CMerkleBlock just contains hashes, so also push any transactions in the block the client did not see
 							// This avoids hurting performance by pointlessly requiring a round-trip
@@ -5550,20 +5995,17 @@ void static ProcessGetData(CNode* pfrom)
 				bool pushed = false;
 				{
 					LOCK(cs_mapRelay);
-					map<CInv, CDataStream>::iterator mi = mapRelay.find(inv);
+					map<CInv, CTransactionRef>::iterator mi = mapRelay.find(inv);
 					if (mi != mapRelay.end()) {
-						pfrom->PushMessage(inv.GetCommand(), (*mi).second);
+						pfrom->PushMessage(inv.GetCommand(), *mi->second);
 						pushed = true;
 					}
 				}
 
 				if (!pushed && inv.type == MSG_TX) {
-					CTransaction tx;
-					if (mempool.lookup(inv.hash, tx)) {
-						CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
-						ss.reserve(1000);
-						ss << tx;
-						pfrom->PushMessage("tx", ss);
+					CTransactionRef ptx = mempool.get(inv.hash);
+					if (ptx) {
+						pfrom->PushMessage("tx", *ptx);
 						pushed = true;
 					}
 				}
@@ -5945,9 +6387,22 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 			if (inv.type == MSG_BLOCK) {
 				UpdateBlockAvailability(pfrom->GetId(), inv.hash);
 				if (!fAlreadyHave && !fImporting && !fReindex && !mapBlocksInFlight.count(inv.hash)) {
-					// Add this to the list of blocks to request
-					vToFetch.push_back(inv);
-					LogPrint("net", "getblocks (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
+					if (Params().HeadersFirstSyncingActive() && pfrom->nVersion >= HEADERS_FIRST_VERSION) {
+						// Ask for the headers leading up to the announced block first, so the block can be
+						// accepted when it arrives and the peer's best block is known to the download
+						// scheduler. Near the tip the block itself is requested right away as well.
+						pfrom->PushMessage("getheaders", chainActive.GetLocator(pindexBestHeader), inv.hash);
+						if (chainActive.Tip()->GetBlockTime() > GetAdjustedTime() - Params().TargetSpacing() * 20) {
+							vToFetch.push_back(inv);
+							MarkBlockAsInFlight(pfrom->GetId(), inv.hash);
+						}
+						LogPrint("net", "getheaders (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
+					}
+					else {
+						// Add this to the list of blocks to request
+						vToFetch.push_back(inv);
+						LogPrint("net", "getblocks (%d) %s to peer=%d\n", pindexBestHeader->nHeight, inv.hash.ToString(), pfrom->id);
+					}
 				}
 			}
 
@@ -5985,7 +6440,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 	}
 
 
-	else if (strCommand == "getblocks" || strCommand == "getheaders") {
+	else if (strCommand == "getblocks" || (strCommand == "getheaders" && (!Params().HeadersFirstSyncingActive() || pfrom->nVersion < HEADERS_FIRST_VERSION))) {
 		CBlockLocator locator;
 		uint256 hashStop;
 		vRecv >> locator >> hashStop;
@@ -6017,7 +6472,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 	}
 
 
-	else if (strCommand == "headers" && Params().HeadersFirstSyncingActive()) {
+	else if (strCommand == "getheaders") {
 		CBlockLocator locator;
 		uint256 hashStop;
 		vRecv >> locator >> hashStop;
@@ -6242,6 +6697,7 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 			// Nothing interesting. Stop asking this peers for more headers.
 			return true;
 		}
+		CNodeState* nodestate = State(pfrom->GetId());
 		CBlockIndex* pindexLast = NULL;
 		BOOST_FOREACH(const CBlockHeader& header, headers) {
 			CValidationState state;
@@ -6250,9 +6706,26 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 				return error("non-continuous headers sequence");
 			}
 
-			/*TODO: this has a CBlock cast on it so that it will compile. There should be a solution for this
-			* before headers are reimplemented on mainnet
-			*/
+			const bool fNew = !mapBlockIndex.count(header.GetHash());
+			if (fNew && ((int)nodestate->setStakePending.size() >= MAX_STAKE_PENDING_PER_PEER || (int)mapStakePendingSource.size() >= MAX_STAKE_PENDING)) {
+				// the rest is asked for again once enough pending blocks have been connected
+				LogPrint("net", "pausing headers from peer=%d, %u of %u with unchecked stake\n", pfrom->id, nodestate->setStakePending.size(),
+					mapStakePendingSource.size());
+				nodestate->fHeadersPaused = true;
+				break;
+			}
+
+			if (fNew) {
+				BlockMap::iterator mi = mapBlockIndex.find(header.hashPrevBlock);
+				if (mi != mapBlockIndex.end() && !CheckHeaderSanity(header, state, mi->second)) {
+					int nDoS;
+					if (state.IsInvalid(nDoS) && nDoS > 0)
+						Misbehaving(pfrom->GetId(), nDoS);
+					return error("invalid header received %s", header.GetHash().ToString());
+				}
+			}
+
+			// AcceptBlockHeader takes a CBlock, one without transactions marks the index as a header only
 			if (!AcceptBlockHeader((CBlock)header, state, &pindexLast)) {
 				int nDoS;
 				if (state.IsInvalid(nDoS)) {
@@ -6262,12 +6735,14 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 					return error(strError.c_str());
 				}
 			}
+			if (fNew && pindexLast && (pindexLast->nStatus & BLOCK_STAKE_PENDING))
+				AddStakePendingSource(pindexLast->GetBlockHash(), pfrom->GetId());
 		}
 
 		if (pindexLast)
 			UpdateBlockAvailability(pfrom->GetId(), pindexLast->GetBlockHash());
 
-		if (nCount == MAX_HEADERS_RESULTS && pindexLast) {
+		if (nCount == MAX_HEADERS_RESULTS && pindexLast && !nodestate->fHeadersPaused) {
 			// Headers message had its maximum size; the peer may have more headers.
 			// TODO: optimize: if pindexLast is an ancestor of chainActive.Tip or pindexBestHeader, continue
 			// from there instead.
@@ -6302,8 +6777,10 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 		else {
 			pfrom->AddInventoryKnown(inv);
 
+			// a block whose header came first is already in the index, but still needs processing
 			CValidationState state;
-			if (!mapBlockIndex.count(block.GetHash())) {
+			BlockMap::iterator mi = mapBlockIndex.find(hashBlock);
+			if (mi == mapBlockIndex.end() || !(mi->second->nStatus & BLOCK_HAVE_DATA)) {
 				ProcessNewBlock(state, pfrom, &block);
 				int nDoS;
 				if (state.IsInvalid(nDoS)) {
@@ -6560,6 +7037,9 @@ bool static ProcessMessage(CNode* pfrom, string strCommand, CDataStream& vRecv,
 		ProcessMessageSwiftTX(pfrom, strCommand, vRecv);
 		ProcessSpork(pfrom, strCommand, vRecv);
 		masternodeSync.ProcessMessage(pfrom, strCommand, vRecv);
+
+		// signature results that were already known, now that cs_budget and friends are released
+		mnSigVerifier.RunDeferred();
 	}
 
 
@@ -6798,21 +7278,37 @@ bool SendMessages(CNode* pto, bool fSendTrickle)
 		state.rejects.clear();
 
 		// Start block sync
-		if (pindexBestHeader == NULL)
+		if (pindexBestHeader == NULL) {
 			pindexBestHeader = chainActive.Tip();
+			PublishChainTipSnapshot();
+		}
 		bool fFetch = state.fPreferredDownload || (nPreferredDownload == 0 && !pto->fClient && !pto->fOneShot); // Download if this is a nice peer, or we have no nice peers and this one might do.
 		if (!state.fSyncStarted && !pto->fClient && fFetch /*&& !fImporting*/ && !fReindex) {
 			// Only actively request headers from a single peer, unless we're close to end of initial download.
 			if (nSyncStarted == 0 || pindexBestHeader->GetBlockTime() > GetAdjustedTime() - 6 * 60 * 60) { // NOTE: was "close to today" and 24h in Bitcoin
 				state.fSyncStarted = true;
 				nSyncStarted++;
-				//CBlockIndex *pindexStart = pindexBestHeader->pprev ? pindexBestHeader->pprev : pindexBestHeader;
-				//LogPrint("net", "initial getheaders (%d) to peer=%d (startheight:%d)\n", pindexStart->nHeight, pto->id, pto->nStartingHeight);
-				//pto->PushMessage("getheaders", chainActive.GetLocator(pindexStart), uint256(0));
-				pto->PushMessage("getblocks", chainActive.GetLocator(chainActive.Tip()), uint256(0));
+				if (Params().HeadersFirstSyncingActive() && pto->nVersion >= HEADERS_FIRST_VERSION) {
+					// Blocks are then requested from every peer known to have them, see FindNextBlocksToDownload
+					CBlockIndex *pindexStart = pindexBestHeader->pprev ? pindexBestHeader->pprev : pindexBestHeader;
+					LogPrint("net", "initial getheaders (%d) to peer=%d (startheight:%d)\n", pindexStart->nHeight, pto->id, pto->nStartingHeight);
+					pto->PushMessage("getheaders", chainActive.GetLocator(pindexStart), uint256(0));
+				}
+				else
+					pto->PushMessage("getblocks", chainActive.GetLocator(chainActive.Tip()), uint256(0));
 			}
 		}
 
+		// Resume headers held back while too many of this peer's blocks had an unchecked stake
+		if (state.fHeadersPaused && (int)state.setStakePending.size() + (int)MAX_HEADERS_RESULTS <= MAX_STAKE_PENDING_PER_PEER &&
+			(int)mapStakePendingSource.size() + (int)MAX_HEADERS_RESULTS <= MAX_STAKE_PENDING) {
+			// Continue from the last header this peer gave us, unchecked headers aren't the best header
+			CBlockIndex* pindexStart = state.pindexBestKnownBlock ? state.pindexBestKnownBlock : pindexBestHeader;
+			state.fHeadersPaused = false;
+			LogPrint("net", "resume getheaders (%d) to peer=%d\n", pindexStart->nHeight, pto->id);
+			pto->PushMessage("getheaders", chainActive.GetLocator(pindexStart), uint256(0));
+		}
+
 		// Resend wallet transactions that haven't gotten in a block yet
 		// Except during reindex, importing and IBD, when old wallet
 		// transactions become unconfirmed and spams other nodes.
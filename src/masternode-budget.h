@@ -75,6 +75,7 @@ public:
     CBudgetVote();
     CBudgetVote(CTxIn vin, uint256 nProposalHash, int nVoteIn);
 
+    std::string GetStrMessage();
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool SignatureValid(bool fSignatureCheck);
     void Relay();
@@ -187,6 +188,18 @@ private:
     // XX42    map<uint256, CTransaction> mapCollateral;
     map<uint256, uint256> mapCollateralTxids;
 
+    // ranked budget returned by GetBudget(), rebuilt when the tip, the proposals/votes or the
+    // masternode list (vote validity, enabled count) change, or once another proposal becomes established
+    std::vector<CBudgetProposal*> vCachedBudget;
+    int nCachedBudgetHeight;
+    int64_t nCachedBudgetVersion;
+    int64_t nCachedBudgetMasternodes;
+    int64_t nCachedBudgetEstablishedTime;
+    int64_t nProposalsVersion;
+
+    // proposals or their votes changed -- the cached budget has to be rebuilt
+    void ProposalsChanged() { nProposalsVersion++; }
+
 public:
     // critical section to protect the inner data structures
     mutable CCriticalSection cs;
@@ -206,6 +219,11 @@ public:
     {
         mapProposals.clear();
         mapFinalizedBudgets.clear();
+        nCachedBudgetHeight = -1;
+        nCachedBudgetVersion = -1;
+        nCachedBudgetMasternodes = -1;
+        nCachedBudgetEstablishedTime = -1;
+        nProposalsVersion = 0;
     }
 
     void ClearSeen()
@@ -240,6 +258,7 @@ public:
     bool AddFinalizedBudget(CFinalizedBudget& finalizedBudget);
     void SubmitFinalBudget();
 
+    void ProcessVoteSignature(CBudgetVote vote, NodeId nodeId, bool fSignatureValid);
     bool UpdateProposal(CBudgetVote& vote, CNode* pfrom, std::string& strError);
     bool UpdateFinalizedBudget(CFinalizedBudgetVote& vote, CNode* pfrom, std::string& strError);
     bool PropExists(uint256 nHash);
@@ -261,6 +280,7 @@ public:
         mapSeenFinalizedBudgetVotes.clear();
         mapOrphanMasternodeBudgetVotes.clear();
         mapOrphanFinalizedBudgetVotes.clear();
+        ProposalsChanged();
     }
     void CheckAndRemove();
     std::string ToString() const;
@@ -280,6 +300,9 @@ public:
 
         READWRITE(mapProposals);
         READWRITE(mapFinalizedBudgets);
+
+        if (ser_action.ForRead())
+            ProposalsChanged();
     }
 };
 
@@ -467,6 +490,17 @@ private:
     mutable CCriticalSection cs;
     CAmount nAlloted;
 
+protected:
+    // vote tallies, kept in step with mapVotes by AddOrUpdateVote() and CleanAndRemove()
+    int nYeas;      // valid YES votes
+    int nNays;      // valid NO votes
+    int nAbstains;  // valid ABSTAIN votes
+    int nRatioYeas; // all YES votes, valid or not (see GetRatio)
+    int nRatioNays; // all NO votes, valid or not
+
+    void CountVote(const CBudgetVote& vote, int nDelta);
+    void RecountVotes();
+
 public:
     bool fValid;
     std::string strProposalName;
@@ -498,12 +532,18 @@ public:
     bool IsValid(std::string& strError, bool fCheckCollateral = true);
 
     bool IsEstablished()
+    {
+        return GetEstablishedTime() < GetTime();
+    }
+
+    // first time at which IsEstablished() holds
+    int64_t GetEstablishedTime()
     {
         // Proposals must be at least a day old to make it into a budget
-        if (Params().NetworkID() == CBaseChainParams::MAIN) return (nTime < GetTime() - (60 * 60 * 24));
+        if (Params().NetworkID() == CBaseChainParams::MAIN) return nTime + (60 * 60 * 24);
 
         // For testing purposes - 5 minutes
-        return (nTime < GetTime() - (60 * 5));
+        return nTime + (60 * 5);
     }
 
     std::string GetName() { return strProposalName; }
@@ -558,6 +598,9 @@ public:
 
         //for saving to the serialized db
         READWRITE(mapVotes);
+
+        if (ser_action.ForRead())
+            RecountVotes();
     }
 };
 
@@ -586,6 +629,8 @@ public:
         swap(first.nTime, second.nTime);
         swap(first.nFeeTXHash, second.nFeeTXHash);
         first.mapVotes.swap(second.mapVotes);
+        first.RecountVotes();
+        second.RecountVotes();
     }
 
     CBudgetProposalBroadcast& operator=(CBudgetProposalBroadcast from)
@@ -0,0 +1,114 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-collateral.h"
+
+#include "chain.h"
+#include "coins.h"
+#include "main.h"
+#include "txmempool.h"
+
+#include <boost/foreach.hpp>
+
+CCollateralTracker collateralTracker;
+
+void CCollateralTracker::Lookup(const COutPoint& outpoint, CCollateralCoin& coin) const
+{
+    uint64_t nGenerationStart;
+    {
+        LOCK(cs);
+        std::map<COutPoint, CCollateralCoin>::const_iterator it = mapCoins.find(outpoint);
+        if (it != mapCoins.end()) {
+            coin = it->second;
+            return;
+        }
+        nGenerationStart = nGeneration;
+    }
+
+    CCoins coins;
+    {
+        LOCK(mempool.cs);
+        CCoinsViewMemPool viewMempool(pcoinsTip, mempool);
+        coin.fTxFound = viewMempool.GetCoins(outpoint.hash, coins);
+    }
+    coin.nHeight = coin.fTxFound ? coins.nHeight : 0;
+    coin.fUnspent = coin.fTxFound && coins.IsAvailable(outpoint.n);
+    coin.nValue = coin.fUnspent ? coins.vout[outpoint.n].nValue : 0;
+    coin.fCoinBase = coin.fTxFound && (coins.IsCoinBase() || coins.IsCoinStake());
+
+    // a mempool transaction can leave the mempool without a notification
+    if (coin.fTxFound && coin.nHeight == MEMPOOL_HEIGHT)
+        return;
+
+    LOCK(cs);
+    if (nGeneration != nGenerationStart)
+        return;
+    if (mapCoins.size() >= MAX_COLLATERAL_CACHE_SIZE)
+        mapCoins.clear();
+    mapCoins[outpoint] = coin;
+}
+
+void CCollateralTracker::ForgetTx(const uint256& txid)
+{
+    std::map<COutPoint, CCollateralCoin>::iterator it = mapCoins.lower_bound(COutPoint(txid, 0));
+    while (it != mapCoins.end() && it->first.hash == txid)
+        mapCoins.erase(it++);
+}
+
+void CCollateralTracker::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
+{
+    // connected, disconnected, added to or removed from the mempool: all of
+    // them can change what the outputs created or spent by tx look like
+    LOCK(cs);
+    nGeneration++;
+    ForgetTx(tx.GetHash());
+    BOOST_FOREACH (const CTxIn& txin, tx.vin) {
+        if (!txin.prevout.IsNull())
+            ForgetTx(txin.prevout.hash);
+    }
+}
+
+int CCollateralTracker::GetInputAge(const COutPoint& outpoint) const
+{
+    CCollateralCoin coin;
+    Lookup(outpoint, coin);
+    if (!coin.fTxFound)
+        return -1;
+    if (coin.nHeight < 0)
+        return 0;
+    return (chainActive.Tip()->nHeight + 1) - coin.nHeight;
+}
+
+bool CCollateralTracker::IsUnspent(const COutPoint& outpoint, CAmount& nValue) const
+{
+    {
+        LOCK(mempool.cs);
+        if (mempool.mapNextTx.count(outpoint))
+            return false;
+    }
+
+    CCollateralCoin coin;
+    Lookup(outpoint, coin);
+    if (!coin.fUnspent)
+        return false;
+    nValue = coin.nValue;
+    return true;
+}
+
+bool CCollateralTracker::IsMature(const COutPoint& outpoint, int nSpendHeight) const
+{
+    CCollateralCoin coin;
+    Lookup(outpoint, coin);
+    if (!coin.fTxFound)
+        return false;
+    // same rule as CheckInputs (bad-txns-premature-spend-of-coinbase)
+    return !coin.fCoinBase || nSpendHeight - coin.nHeight >= Params().COINBASE_MATURITY();
+}
+
+void CCollateralTracker::Clear()
+{
+    LOCK(cs);
+    nGeneration++;
+    mapCoins.clear();
+}
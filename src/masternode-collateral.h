@@ -0,0 +1,73 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MASTERNODE_COLLATERAL_H
+#define MASTERNODE_COLLATERAL_H
+
+#include "amount.h"
+#include "primitives/transaction.h"
+#include "sync.h"
+#include "validationinterface.h"
+
+#include <map>
+
+class CCollateralTracker;
+
+/** Number of outpoints remembered before the cache starts over */
+static const unsigned int MAX_COLLATERAL_CACHE_SIZE = 20000;
+
+extern CCollateralTracker collateralTracker;
+
+/**
+ * Remembers the chain state of the outpoints masternode and SwiftX checks ask
+ * about: the height of the transaction that created them and whether they are
+ * still unspent.
+ *
+ * An outpoint is looked up in the UTXO set the first time it is asked about
+ * and answered from the cache afterwards. The block connect/disconnect and
+ * mempool notifications forget every entry of a transaction that is created
+ * or spent, so the next question about it goes to the UTXO set again.
+ * Outpoints that only exist in the mempool are never cached, and mempool
+ * spends are checked on every call, so mempool evictions need no notification.
+ */
+class CCollateralTracker : public CValidationInterface
+{
+private:
+    struct CCollateralCoin {
+        //! the transaction has unspent outputs in the chain
+        bool fTxFound;
+        int nHeight;
+        bool fUnspent;
+        CAmount nValue;
+        //! created by a coinbase or coinstake, subject to COINBASE_MATURITY
+        bool fCoinBase;
+    };
+
+    mutable CCriticalSection cs;
+    mutable std::map<COutPoint, CCollateralCoin> mapCoins;
+    //! bumped by every notification, a lookup racing with one isn't cached
+    mutable uint64_t nGeneration;
+
+    void Lookup(const COutPoint& outpoint, CCollateralCoin& coin) const;
+    void ForgetTx(const uint256& txid);
+
+protected:
+    void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
+
+public:
+    CCollateralTracker() : nGeneration(0) {}
+
+    /** Confirmations of the transaction that created outpoint, -1 if it isn't known or fully spent */
+    int GetInputAge(const COutPoint& outpoint) const;
+
+    /** Whether outpoint is unspent in the chain and the mempool, with its value if it is */
+    bool IsUnspent(const COutPoint& outpoint, CAmount& nValue) const;
+
+    /** Whether a transaction at nSpendHeight may spend outpoint, i.e. it isn't an immature coinbase or coinstake output */
+    bool IsMature(const COutPoint& outpoint, int nSpendHeight) const;
+
+    void Clear();
+};
+
+#endif // MASTERNODE_COLLATERAL_H
@@ -8,6 +8,7 @@
 #include "addrman.h"
 #include "chainparams.h"
 #include "masternode-budget.h"
+#include "masternode-sigverify.h"
 #include "masternode-sync.h"
 #include "masternodeman.h"
 #include "obfuscation.h"
@@ -15,6 +16,7 @@
 #include "sync.h"
 #include "util.h"
 #include "utilmoneystr.h"
+#include <boost/bind.hpp>
 #include <boost/filesystem.hpp>
 
 /** Object for who's going to get paid on which blocks */
@@ -413,26 +415,41 @@ void CMasternodePayments::ProcessMessageMasternodePayments(CNode* pfrom, std::st
             return;
         }
 
-        if (!winner.SignatureValid()) {
-            if (masternodeSync.IsSynced()) {
-                LogPrintf("CMasternodePayments::ProcessMessageMasternodePayments() : mnw - invalid signature\n");
-                Misbehaving(pfrom->GetId(), 20);
-            }
-            // it could just be a non-synced masternode
-            mnodeman.AskForMN(pfrom, winner.vinMasternode);
+        CMasternode* pmn = mnodeman.Find(winner.vinMasternode);
+        if (pmn == NULL) {
+            ProcessWinnerSignature(winner, pfrom->GetId(), false);
             return;
         }
 
-        CTxDestination address1;
-        ExtractDestination(winner.payee, address1);
-        CBitcoinAddress address2(address1);
+        // the winner is added by ProcessWinnerSignature once the signature is checked
+        mnSigVerifier.VerifyAsync(pmn->pubKeyMasternode, winner.vchSig, winner.GetStrMessage(),
+            boost::bind(&CMasternodePayments::ProcessWinnerSignature, this, winner, pfrom->GetId(), _1));
+    }
+}
 
-        //   LogPrint("mnpayments", "mnw - winning vote - Addr %s Height %d bestHeight %d - %s\n", address2.ToString().c_str(), winner.nBlockHeight, nHeight, winner.vinMasternode.prevout.ToStringShort());
+void CMasternodePayments::ProcessWinnerSignature(CMasternodePaymentWinner winner, NodeId nodeId, bool fSignatureValid)
+{
+    if (!fSignatureValid) {
+        if (masternodeSync.IsSynced()) {
+            LogPrintf("CMasternodePayments::ProcessWinnerSignature() : mnw - invalid signature\n");
+            LOCK(cs_main);
+            Misbehaving(nodeId, 20);
+        }
 
-        if (masternodePayments.AddWinningMasternode(winner)) {
-            winner.Relay();
-            masternodeSync.AddedMasternodeWinner(winner.GetHash());
+        // it could just be a non-synced masternode
+        LOCK(cs_vNodes);
+        BOOST_FOREACH (CNode* pnode, vNodes) {
+            if (pnode->GetId() == nodeId) {
+                mnodeman.AskForMN(pnode, winner.vinMasternode);
+                break;
+            }
         }
+        return;
+    }
+
+    if (AddWinningMasternode(winner)) {
+        winner.Relay();
+        masternodeSync.AddedMasternodeWinner(winner.GetHash());
     }
 }
 
@@ -441,7 +458,7 @@ bool CMasternodePaymentWinner::Sign(CKey& keyMasternode, CPubKey& pubKeyMasterno
     std::string errorMessage;
     std::string strMasterNodeSignMessage;
 
-    std::string strMessage = vinMasternode.prevout.ToStringShort() + std::to_string(nBlockHeight) + payee.ToString();
+    std::string strMessage = GetStrMessage();
 
     if (!obfuScationSigner.SignMessage(strMessage, errorMessage, vchSig, keyMasternode)) {
         LogPrint("masternode","CMasternodePing::Sign() - Error: %s\n", errorMessage.c_str());
@@ -557,7 +574,7 @@ bool CMasternodeBlockPayees::IsTransactionValid(const CTransaction& txNew)
 
     for (CMasternodePayee& payee : vecPayments) {
         bool found = false;
-        for (CTxOut out : txNew.vout) {
+        for (const CTxOut& out : txNew.vout) {
             if (payee.scriptPubKey == out.scriptPubKey) {
                 if(out.nValue >= requiredMasternodePayment)
                     found = true;
@@ -768,12 +785,17 @@ void CMasternodePaymentWinner::Relay()
     RelayInv(inv);
 }
 
+std::string CMasternodePaymentWinner::GetStrMessage()
+{
+    return vinMasternode.prevout.ToStringShort() + std::to_string(nBlockHeight) + payee.ToString();
+}
+
 bool CMasternodePaymentWinner::SignatureValid()
 {
     CMasternode* pmn = mnodeman.Find(vinMasternode);
 
     if (pmn != NULL) {
-        std::string strMessage = vinMasternode.prevout.ToStringShort() + std::to_string(nBlockHeight) + payee.ToString();
+        std::string strMessage = GetStrMessage();
 
         std::string errorMessage = "";
         if (!obfuScationSigner.VerifyMessage(pmn->pubKeyMasternode, vchSig, strMessage, errorMessage)) {
@@ -193,6 +193,7 @@ public:
         return ss.GetHash();
     }
 
+    std::string GetStrMessage();
     bool Sign(CKey& keyMasternode, CPubKey& pubKeyMasternode);
     bool IsValid(CNode* pnode, std::string& strError);
     bool SignatureValid();
@@ -283,6 +284,7 @@ public:
 
     int GetMinMasternodePaymentsProto();
     void ProcessMessageMasternodePayments(CNode* pfrom, std::string& strCommand, CDataStream& vRecv);
+    void ProcessWinnerSignature(CMasternodePaymentWinner winner, NodeId nodeId, bool fSignatureValid);
     std::string GetRequiredPaymentsString(int nBlockHeight);
     void FillBlockPayee(CMutableTransaction& txNew, int64_t nFees, bool fProofOfStake, bool fZ4XTStake);
     std::string ToString() const;
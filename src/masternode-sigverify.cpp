@@ -0,0 +1,244 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "masternode-sigverify.h"
+
+#include "hash.h"
+#include "main.h"
+#include "random.h"
+#include "ui_interface.h"
+#include "util.h"
+
+#include <boost/thread.hpp>
+
+CMasternodeSigVerifier mnSigVerifier;
+
+void ThreadMasternodeSigVerify()
+{
+    RenameThread("forextrading-mnsigverify");
+    mnSigVerifier.Thread();
+}
+
+uint256 CMasternodeSigVerifier::GetMessageHash(const std::string& strMessage)
+{
+    CHashWriter ss(SER_GETHASH, 0);
+    ss << strMessageMagic;
+    ss << strMessage;
+    return ss.GetHash();
+}
+
+uint256 CMasternodeSigVerifier::GetCacheKey(const uint256& hashMessage, const std::vector<unsigned char>& vchSig)
+{
+    return Hash(hashMessage.begin(), hashMessage.end(), vchSig.begin(), vchSig.end());
+}
+
+CKeyID CMasternodeSigVerifier::Recover(const uint256& hashMessage, const std::vector<unsigned char>& vchSig)
+{
+    CPubKey pubkey;
+    if (!pubkey.RecoverCompact(hashMessage, vchSig))
+        return CKeyID();
+    return pubkey.GetID();
+}
+
+bool CMasternodeSigVerifier::GetCached(const uint256& key, CKeyID& keyID)
+{
+    // requires mutex
+    std::map<uint256, CKeyID>::const_iterator it = mapRecovered.find(key);
+    if (it == mapRecovered.end())
+        return false;
+    keyID = it->second;
+    return true;
+}
+
+void CMasternodeSigVerifier::SetCached(const uint256& key, const CKeyID& keyID)
+{
+    // requires mutex
+    while (mapRecovered.size() >= MAX_MN_SIGCACHE_SIZE) {
+        // Evict a random entry, so that a peer can't pre-compute which entries get dropped
+        std::map<uint256, CKeyID>::iterator it = mapRecovered.lower_bound(GetRandHash());
+        if (it == mapRecovered.end())
+            it = mapRecovered.begin();
+        mapRecovered.erase(it);
+    }
+    mapRecovered[key] = keyID;
+}
+
+bool CMasternodeSigVerifier::Verify(const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& errorMessage)
+{
+    uint256 hashMessage = GetMessageHash(strMessage);
+    uint256 key = GetCacheKey(hashMessage, vchSig);
+    CKeyID keyID;
+    bool fCached;
+
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        fCached = GetCached(key, keyID);
+    }
+
+    if (!fCached) {
+        keyID = Recover(hashMessage, vchSig);
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+        SetCached(key, keyID);
+    }
+
+    if (keyID.IsNull()) {
+        errorMessage = _("Error recovering public key.");
+        return false;
+    }
+
+    if (fDebug && keyID != pubkey.GetID())
+        LogPrintf("CMasternodeSigVerifier::Verify -- keys don't match: %s %s\n", keyID.ToString(), pubkey.GetID().ToString());
+
+    return keyID == pubkey.GetID();
+}
+
+void CMasternodeSigVerifier::VerifyAsync(const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, const std::string& strMessage, Callback callback)
+{
+    uint256 hashMessage = GetMessageHash(strMessage);
+    uint256 key = GetCacheKey(hashMessage, vchSig);
+    CKeyID keyID;
+
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (!GetCached(key, keyID) && nThreads > 0) {
+            // already queued by another peer's copy of the same message: just wait for that one
+            std::map<uint256, CPendingCheck>::iterator it = mapPending.find(key);
+            if (it == mapPending.end() && mapPending.size() < MAX_MN_SIGVERIFY_QUEUE) {
+                CPendingCheck& check = mapPending[key];
+                check.hashMessage = hashMessage;
+                check.vchSig = vchSig;
+                check.vCallbacks.push_back(std::make_pair(pubkey.GetID(), callback));
+                queue.push_back(key);
+                condWorker.notify_one();
+                return;
+            } else if (it != mapPending.end()) {
+                it->second.vCallbacks.push_back(std::make_pair(pubkey.GetID(), callback));
+                return;
+            }
+        }
+    }
+
+    // known result, nobody to hand the work to, or the workers are flooded: a peer sending
+    // more than they keep up with gets its messages checked on its own processing thread
+    std::string errorMessage;
+    bool fValid = Verify(pubkey, vchSig, strMessage, errorMessage);
+
+    boost::unique_lock<boost::mutex> lock(mutex);
+    vDeferred.push_back(std::make_pair(callback, fValid));
+}
+
+void CMasternodeSigVerifier::RunDeferred()
+{
+    std::vector<std::pair<Callback, bool> > vCallbacks;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        vCallbacks.swap(vDeferred);
+    }
+
+    for (unsigned int i = 0; i < vCallbacks.size(); i++)
+        vCallbacks[i].first(vCallbacks[i].second);
+}
+
+void CMasternodeSigVerifier::ExitWorker()
+{
+    std::map<uint256, CPendingCheck> mapOrphaned;
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        if (--nThreads > 0)
+            return;
+
+        // the last worker is gone: nothing would ever pick up the checks still queued,
+        // so answer them here. Checks a worker is in the middle of are left alone.
+        while (!queue.empty()) {
+            std::map<uint256, CPendingCheck>::iterator it = mapPending.find(queue.front());
+            queue.pop_front();
+            if (it == mapPending.end())
+                continue;
+            mapOrphaned[it->first].vCallbacks.swap(it->second.vCallbacks);
+            mapOrphaned[it->first].hashMessage = it->second.hashMessage;
+            mapOrphaned[it->first].vchSig.swap(it->second.vchSig);
+            mapPending.erase(it);
+        }
+    }
+
+    for (std::map<uint256, CPendingCheck>::iterator it = mapOrphaned.begin(); it != mapOrphaned.end(); ++it) {
+        CKeyID keyID = Recover(it->second.hashMessage, it->second.vchSig);
+
+        boost::unique_lock<boost::mutex> lock(mutex);
+        SetCached(it->first, keyID);
+        for (unsigned int i = 0; i < it->second.vCallbacks.size(); i++)
+            vDeferred.push_back(std::make_pair(it->second.vCallbacks[i].second, !keyID.IsNull() && keyID == it->second.vCallbacks[i].first));
+    }
+}
+
+void CMasternodeSigVerifier::Thread()
+{
+    // keeps nThreads accurate however the loop is left
+    struct CWorkerScope {
+        CMasternodeSigVerifier* pverifier;
+        CWorkerScope(CMasternodeSigVerifier* pverifierIn) : pverifier(pverifierIn)
+        {
+            boost::unique_lock<boost::mutex> lock(pverifier->mutex);
+            pverifier->nThreads++;
+        }
+        ~CWorkerScope() { pverifier->ExitWorker(); }
+    } scope(this);
+
+    while (true) {
+        uint256 key;
+        CPendingCheck check;
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            while (queue.empty())
+                condWorker.wait(lock);
+
+            key = queue.front();
+            queue.pop_front();
+            check.hashMessage = mapPending[key].hashMessage;
+            check.vchSig = mapPending[key].vchSig;
+        }
+
+        CKeyID keyID = Recover(check.hashMessage, check.vchSig);
+
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            SetCached(key, keyID);
+            check.vCallbacks.swap(mapPending[key].vCallbacks);
+            mapPending.erase(key);
+        }
+
+        for (unsigned int i = 0; i < check.vCallbacks.size(); i++) {
+            try {
+                check.vCallbacks[i].second(!keyID.IsNull() && keyID == check.vCallbacks[i].first);
+            } catch (const boost::thread_interrupted&) {
+                throw;
+            } catch (std::exception& e) {
+                PrintExceptionContinue(&e, "CMasternodeSigVerifier::Thread()");
+            } catch (...) {
+                PrintExceptionContinue(NULL, "CMasternodeSigVerifier::Thread()");
+            }
+        }
+
+        boost::this_thread::interruption_point();
+    }
+}
+
+int CMasternodeSigVerifier::GetThreadCount()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return nThreads;
+}
+
+int CMasternodeSigVerifier::GetQueueSize()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return (int)queue.size();
+}
+
+int CMasternodeSigVerifier::GetCacheSize()
+{
+    boost::unique_lock<boost::mutex> lock(mutex);
+    return (int)mapRecovered.size();
+}
@@ -0,0 +1,99 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef MASTERNODE_SIGVERIFY_H
+#define MASTERNODE_SIGVERIFY_H
+
+#include "pubkey.h"
+#include "uint256.h"
+
+#include <deque>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <boost/function.hpp>
+#include <boost/thread/condition_variable.hpp>
+#include <boost/thread/mutex.hpp>
+
+class CMasternodeSigVerifier;
+
+/** Maximum number of recovered message signatures kept in the cache */
+static const unsigned int MAX_MN_SIGCACHE_SIZE = 20000;
+/** -mnsigthreads default and upper bound */
+static const int DEFAULT_MN_SIGVERIFY_THREADS = 2;
+static const int MAX_MN_SIGVERIFY_THREADS = 16;
+/** Maximum number of distinct checks waiting for a worker; beyond it checks run on the caller's thread */
+static const unsigned int MAX_MN_SIGVERIFY_QUEUE = 5000;
+
+extern CMasternodeSigVerifier mnSigVerifier;
+
+void ThreadMasternodeSigVerify();
+
+/**
+ * Verifies the compact signatures of masternode/budget network messages.
+ *
+ * Public key recovery is the expensive part of CObfuScationSigner::VerifyMessage and
+ * peers re-announce the same objects over and over, so the key recovered for each
+ * (message hash, signature) pair is cached. Checks can also be queued: they are
+ * deduplicated by that pair, run on the -mnsigthreads workers and their result is
+ * handed to the callback on the worker thread. When the result is already known or
+ * no workers are running or the queue is full, the callback is deferred until RunDeferred(): callers of
+ * VerifyAsync hold their own message-processing locks, and the callbacks take
+ * cs_main, so running them inline would invert the cs_main -> cs_budget order.
+ */
+class CMasternodeSigVerifier
+{
+public:
+    typedef boost::function<void(bool)> Callback;
+
+private:
+    struct CPendingCheck {
+        uint256 hashMessage;
+        std::vector<unsigned char> vchSig;
+        std::vector<std::pair<CKeyID, Callback> > vCallbacks;
+    };
+
+    boost::mutex mutex;
+    boost::condition_variable condWorker;
+
+    //! (message hash, signature) -> recovered key id, CKeyID() if recovery failed
+    std::map<uint256, CKeyID> mapRecovered;
+    //! checks waiting for, or currently on, a worker
+    std::map<uint256, CPendingCheck> mapPending;
+    std::deque<uint256> queue;
+    //! results known when VerifyAsync was called, waiting for RunDeferred()
+    std::vector<std::pair<Callback, bool> > vDeferred;
+    int nThreads;
+
+    static uint256 GetMessageHash(const std::string& strMessage);
+    static uint256 GetCacheKey(const uint256& hashMessage, const std::vector<unsigned char>& vchSig);
+    static CKeyID Recover(const uint256& hashMessage, const std::vector<unsigned char>& vchSig);
+
+    void ExitWorker();
+
+    bool GetCached(const uint256& key, CKeyID& keyID);
+    void SetCached(const uint256& key, const CKeyID& keyID);
+
+public:
+    CMasternodeSigVerifier() : nThreads(0) {}
+
+    /** Synchronous, cached verification of a message signed by pubkey */
+    bool Verify(const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, const std::string& strMessage, std::string& errorMessage);
+
+    /** Queue the same check and report the result to callback */
+    void VerifyAsync(const CPubKey& pubkey, const std::vector<unsigned char>& vchSig, const std::string& strMessage, Callback callback);
+
+    /** Run the callbacks VerifyAsync could answer right away. Must be called without holding any locks */
+    void RunDeferred();
+
+    /** Worker loop, returns on thread interruption */
+    void Thread();
+
+    int GetThreadCount();
+    int GetQueueSize();
+    int GetCacheSize();
+};
+
+#endif
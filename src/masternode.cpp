@@ -6,8 +6,10 @@
 
 #include "masternode.h"
 #include "addrman.h"
+#include "masternode-collateral.h"
 #include "masternodeman.h"
 #include "obfuscation.h"
+#include "swifttx.h"
 #include "sync.h"
 #include "util.h"
 #include <boost/lexical_cast.hpp>
@@ -215,20 +217,16 @@ void CMasternode::Check(bool forceCheck)
     }
 
     if (!unitTest) {
-        CValidationState state;
-        CMutableTransaction tx = CMutableTransaction();
-        CTxOut vout = CTxOut(1999.99 * COIN, obfuScationPool.collateralPubKey);
-        tx.vin.push_back(vin);
-        tx.vout.push_back(vout);
-
-        {
-            TRY_LOCK(cs_main, lockMain);
-            if (!lockMain) return;
-
-            if (!AcceptableInputs(mempool, state, CTransaction(tx), false, NULL)) {
-                activeState = MASTERNODE_VIN_SPENT;
-                return;
-            }
+        // the checks AcceptableInputs did on a transaction paying 1999.99 from the collateral
+        TRY_LOCK(cs_main, lockMain);
+        if (!lockMain) return;
+
+        CAmount nValue;
+        if (mapLockedInputs.count(vin.prevout) || !ValidOutPoint(vin.prevout, chainActive.Height()) ||
+            !collateralTracker.IsUnspent(vin.prevout, nValue) || nValue < (CAmount)(1999.99 * COIN) ||
+            !collateralTracker.IsMature(vin.prevout, chainActive.Height() + 1)) {
+            activeState = MASTERNODE_VIN_SPENT;
+            return;
         }
     }
 
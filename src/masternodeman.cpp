@@ -196,6 +196,8 @@ void DumpMasternodes()
 CMasternodeMan::CMasternodeMan()
 {
     nDsqCount = 0;
+    nListVersion = 0;
+    nEnabledCount = 0;
 }
 
 bool CMasternodeMan::Add(CMasternode& mn)
@@ -209,6 +211,7 @@ bool CMasternodeMan::Add(CMasternode& mn)
     if (pmn == NULL) {
         LogPrint("masternode", "CMasternodeMan: Adding new Masternode %s - %i now\n", mn.vin.prevout.hash.ToString(), size() + 1);
         vMasternodes.push_back(mn);
+        nListVersion++;
         return true;
     }
 
@@ -279,11 +282,23 @@ void CMasternodeMan::CheckAndRemove(bool forceExpiredRemoval)
             }
 
             it = vMasternodes.erase(it);
+            nListVersion++;
         } else {
             ++it;
         }
     }
 
+    // a masternode enabling or expiring changes the budget vote threshold, so
+    // treat a changed enabled count like a list change
+    int nEnabled = 0;
+    for (CMasternode& mn : vMasternodes) {
+        if (mn.protocolVersion >= ActiveProtocol() && mn.IsEnabled()) nEnabled++;
+    }
+    if (nEnabled != nEnabledCount) {
+        nEnabledCount = nEnabled;
+        nListVersion++;
+    }
+
     // check who's asked for the Masternode list
     map<CNetAddr, int64_t>::iterator it1 = mAskedUsForMasternodeList.begin();
     while (it1 != mAskedUsForMasternodeList.end()) {
@@ -340,6 +355,7 @@ void CMasternodeMan::Clear()
 {
     LOCK(cs);
     vMasternodes.clear();
+    nListVersion++;
     mAskedUsForMasternodeList.clear();
     mWeAskedForMasternodeList.clear();
     mWeAskedForMasternodeListEntry.clear();
@@ -1140,6 +1156,7 @@ void CMasternodeMan::Remove(CTxIn vin)
         if ((*it).vin == vin) {
             LogPrint("masternode", "CMasternodeMan: Removing Masternode %s - %i now\n", (*it).vin.prevout.hash.ToString(), size() - 1);
             vMasternodes.erase(it);
+            nListVersion++;
             break;
         }
         ++it;
@@ -66,6 +66,10 @@ private:
     std::map<CNetAddr, int64_t> mWeAskedForMasternodeList;
     // which Masternodes we've asked for
     std::map<COutPoint, int64_t> mWeAskedForMasternodeListEntry;
+    // bumped whenever an entry is added to or removed from vMasternodes, or
+    // when CheckAndRemove() finds a different number of enabled entries
+    int64_t nListVersion;
+    int nEnabledCount;
 
 public:
     // Keep track of all broadcasts I've seen
@@ -90,6 +94,9 @@ public:
 
         READWRITE(mapSeenMasternodeBroadcast);
         READWRITE(mapSeenMasternodePing);
+
+        if (ser_action.ForRead())
+            nListVersion++;
     }
 
     CMasternodeMan();
@@ -147,6 +154,13 @@ public:
     /// Return the number of (unique) Masternodes
     int size() { return vMasternodes.size(); }
 
+    /// Changes whenever a Masternode is added to or removed from the list, or the enabled count changes
+    int64_t GetListVersion()
+    {
+        LOCK(cs);
+        return nListVersion;
+    }
+
     /// Return the number of Masternodes older than (default) 8000 seconds
     int stable_size ();
 
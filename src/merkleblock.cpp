@@ -9,12 +9,57 @@
 
 #include "hash.h"
 #include "primitives/block.h" // for MAX_BLOCK_SIZE
+#include "sync.h"
 #include "utilstrencodings.h"
 
+#include <list>
+
 using namespace std;
 
-CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter)
+namespace
+{
+CCriticalSection cs_bloomBlockCache;
+//! most recently requested first
+std::list<std::pair<uint256, CBloomBlockElementsRef> > listBloomBlockCache;
+}
+
+static CBloomBlockElements ExtractBloomElements(const CBlock& block)
+{
+    CBloomBlockElements elements;
+    elements.reserve(block.vtx.size());
+    for (const CTransaction& tx : block.vtx)
+        elements.push_back(CBloomTxElements(tx));
+    return elements;
+}
+
+CBloomBlockElementsRef GetBloomBlockElements(const uint256& hashBlock, const CBlock& block)
+{
+    {
+        LOCK(cs_bloomBlockCache);
+        for (std::list<std::pair<uint256, CBloomBlockElementsRef> >::iterator it = listBloomBlockCache.begin(); it != listBloomBlockCache.end(); ++it) {
+            if (it->first == hashBlock) {
+                listBloomBlockCache.splice(listBloomBlockCache.begin(), listBloomBlockCache, it);
+                return it->second;
+            }
+        }
+    }
+
+    CBloomBlockElementsRef elements = std::make_shared<const CBloomBlockElements>(ExtractBloomElements(block));
+
+    LOCK(cs_bloomBlockCache);
+    listBloomBlockCache.push_front(std::make_pair(hashBlock, elements));
+    if (listBloomBlockCache.size() > MAX_BLOOM_BLOCK_CACHE)
+        listBloomBlockCache.pop_back();
+    return elements;
+}
+
+CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter) : CMerkleBlock(block, filter, ExtractBloomElements(block))
+{
+}
+
+CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter, const CBloomBlockElements& elements)
 {
+    assert(elements.size() == block.vtx.size());
     header = block.GetBlockHeader();
 
     vector<bool> vMatch;
@@ -25,7 +70,7 @@ CMerkleBlock::CMerkleBlock(const CBlock& block, CBloomFilter& filter)
 
     for (unsigned int i = 0; i < block.vtx.size(); i++) {
         const uint256& hash = block.vtx[i].GetHash();
-        if (filter.IsRelevantAndUpdate(block.vtx[i])) {
+        if (filter.IsRelevantAndUpdate(block.vtx[i], elements[i])) {
             vMatch.push_back(true);
             vMatchedTxn.push_back(make_pair(i, hash));
         } else
@@ -13,8 +13,21 @@
 #include "serialize.h"
 #include "uint256.h"
 
+#include <memory>
 #include <vector>
 
+/** Number of recently filtered blocks whose bloom elements are kept */
+static const unsigned int MAX_BLOOM_BLOCK_CACHE = 8;
+
+typedef std::vector<CBloomTxElements> CBloomBlockElements;
+typedef std::shared_ptr<const CBloomBlockElements> CBloomBlockElementsRef;
+
+/**
+ * The bloom elements of every transaction in block, extracted on the first
+ * filtered request for it and shared by every peer asking for it afterwards.
+ */
+CBloomBlockElementsRef GetBloomBlockElements(const uint256& hashBlock, const CBlock& block);
+
 /** Data structure that represents a partial merkle tree.
  *
  * It represents a subset of the txid's of a known block, in a way that
@@ -141,6 +154,8 @@ public:
      * thus the filter will likely be modified.
      */
     CMerkleBlock(const CBlock& block, CBloomFilter& filter);
+    //! Same as above, with the bloom elements of the block already extracted
+    CMerkleBlock(const CBlock& block, CBloomFilter& filter, const CBloomBlockElements& elements);
 
     ADD_SERIALIZE_METHODS;
 
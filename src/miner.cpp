@@ -9,6 +9,7 @@
 #include "miner.h"
 
 #include "amount.h"
+#include "chaintip.h"
 #include "hash.h"
 #include "main.h"
 #include "masternode-sync.h"
@@ -286,7 +287,7 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
 			if (fMissingInputs) continue;
 
 			// Priority is sum(valuein * age) / modified_txsize
-			unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+			unsigned int nTxSize = tx.GetTotalSize();
 			dPriority = tx.ComputePriority(dPriority, nTxSize);
 
 			uint256 hash = tx.GetHash();
@@ -323,7 +324,7 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
 			vecPriority.pop_back();
 
 			// Size limits
-			unsigned int nTxSize = ::GetSerializeSize(tx, SER_NETWORK, PROTOCOL_VERSION);
+			unsigned int nTxSize = tx.GetTotalSize();
 			if (nBlockSize + nTxSize >= nBlockMaxSize)
 				continue;
 
@@ -483,6 +484,7 @@ CBlockTemplate* CreateNewBlock(const CScript& scriptPubKeyIn, CWallet* pwallet,
 		if (!TestBlockValidity(state, *pblock, pindexPrev, false, false)) {
 			LogPrintf("CreateNewBlock() : TestBlockValidity failed\n");
 			mempool.clear();
+			PublishChainTipSnapshot();
 			return NULL;
 		}
 
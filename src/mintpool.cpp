@@ -29,7 +29,8 @@ void CMintPool::Add(const CBigNum& bnValue, const uint32_t& nCount)
 
 void CMintPool::Add(const pair<uint256, uint32_t>& pMint, bool fVerbose)
 {
-    insert(pMint);
+    if (insert(pMint).second)
+        mapCountIndex[pMint.second] = pMint.first;
     if (pMint.second > nCountLastGenerated)
         nCountLastGenerated = pMint.second;
 
@@ -68,6 +69,7 @@ std::list<pair<uint256, uint32_t> > CMintPool::List()
 void CMintPool::Reset()
 {
     clear();
+    mapCountIndex.clear();
     nCountLastGenerated = 0;
     nCountLastRemoved = 0;
 }
@@ -103,6 +105,9 @@ void CMintPool::Remove(const uint256& hashPubcoin)
         return;
 
     nCountLastRemoved = it->second;
+    auto itCount = mapCountIndex.find(it->second);
+    if (itCount != mapCountIndex.end() && itCount->second == hashPubcoin)
+        mapCountIndex.erase(itCount);
     erase(it);
 }
 
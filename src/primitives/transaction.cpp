@@ -147,6 +147,11 @@ bool CTransaction::IsCoinStake() const
     return (vin.size() > 0 && vout.size() >= 2 && vout[0].IsEmpty());
 }
 
+unsigned int CTransaction::GetTotalSize() const
+{
+    return ::GetSerializeSize(*this, SER_NETWORK, PROTOCOL_VERSION);
+}
+
 CAmount CTransaction::GetValueOut() const
 {
     CAmount nValueOut = 0;
@@ -14,6 +14,7 @@
 #include "uint256.h"
 
 #include <list>
+#include <memory>
 
 class CTransaction;
 
@@ -60,6 +61,12 @@ public:
 
 };
 
+template <>
+struct is_flat_serializable<COutPoint> {
+    static_assert(sizeof(COutPoint) == 36, "COutPoint must be serialized as hash followed by n");
+    static const bool value = true;
+};
+
 /** An input of a transaction.  It contains the location of the previous
  * transaction's output that it claims and a signature that matches the
  * output's public key.
@@ -247,6 +254,10 @@ public:
         return hash;
     }
 
+    // Serialized size on the network. vin and vout can still be modified, so it isn't cached
+    // like the hash; callers that need it repeatedly keep their own copy, as CTxMemPoolEntry does.
+    unsigned int GetTotalSize() const;
+
     // Return sum of txouts.
     CAmount GetValueOut() const;
     // GetValueIn() is a method on CCoinsViewCache, because
@@ -306,6 +317,15 @@ public:
 	bool GetCoinAge(uint64_t& nCoinAge) const;  // ppcoin: get transaction coin age
 };
 
+/** Transactions are shared between the mempool and relay rather than copied */
+typedef std::shared_ptr<const CTransaction> CTransactionRef;
+
+template <typename Tx>
+static inline CTransactionRef MakeTransactionRef(Tx&& txIn)
+{
+    return std::make_shared<const CTransaction>(std::forward<Tx>(txIn));
+}
+
 /** A mutable version of CTransaction. */
 struct CMutableTransaction
 {
@@ -155,6 +155,12 @@ public:
     uint256 hash;
 };
 
+template <>
+struct is_flat_serializable<CInv> {
+    static_assert(sizeof(CInv) == 36, "CInv must be serialized as type followed by hash");
+    static const bool value = true;
+};
+
 enum {
     MSG_TX = 1,
     MSG_BLOCK,
@@ -21,6 +21,8 @@
 #include "wallet.h"
 #include "multisigdialog.h"
 
+#include <algorithm>
+
 #include <boost/assign/list_of.hpp> // for 'map_list_of()'
 
 #include <QApplication>
@@ -111,6 +113,9 @@ CoinControlDialog::CoinControlDialog(QWidget* parent, bool fMultisigEnabled) : Q
     // click on checkbox
     connect(ui->treeWidget, SIGNAL(itemChanged(QTreeWidgetItem*, int)), this, SLOT(viewItemChanged(QTreeWidgetItem*, int)));
 
+    // expand wallet address in tree mode
+    connect(ui->treeWidget, SIGNAL(itemExpanded(QTreeWidgetItem*)), this, SLOT(viewItemExpanded(QTreeWidgetItem*)));
+
     // click on header
     ui->treeWidget->header()->setSectionsClickable(true);
     connect(ui->treeWidget->header(), SIGNAL(sectionClicked(int)), this, SLOT(headerSectionClicked(int)));
@@ -450,6 +455,32 @@ void CoinControlDialog::viewItemChanged(QTreeWidgetItem* item, int column)
         if (item->checkState(COLUMN_CHECKBOX) == Qt::PartiallyChecked && item->child(0)->checkState(COLUMN_CHECKBOX) == Qt::PartiallyChecked)
             item->setCheckState(COLUMN_CHECKBOX, Qt::Checked);
     }
+
+    // wallet address whose outputs weren't created yet, (un)select them in coin control directly
+    else if (column == COLUMN_CHECKBOX && item->text(COLUMN_TXHASH).isEmpty() && item->checkState(COLUMN_CHECKBOX) != Qt::PartiallyChecked)
+    {
+        bool fCheck = item->checkState(COLUMN_CHECKBOX) == Qt::Checked;
+        std::map<QString, std::vector<CoinControlEntry> >::const_iterator it = mapCoins.find(item->text(COLUMN_ADDRESS));
+        if (it != mapCoins.end()) {
+            for (const CoinControlEntry& entry : it->second) {
+                if (fCheck && isOutputEnabled(entry))
+                    coinControl->Select(entry.outpoint);
+                else
+                    coinControl->UnSelect(entry.outpoint);
+            }
+        }
+
+        if (ui->treeWidget->isEnabled()) {
+            CoinControlDialog::updateLabels(model, this);
+            updateDialogLabels();
+        }
+    }
+}
+
+// wallet address expanded in tree mode
+void CoinControlDialog::viewItemExpanded(QTreeWidgetItem* item)
+{
+    populateWalletAddress(item);
 }
 
 // return human readable label for priority number
@@ -726,6 +757,98 @@ void CoinControlDialog::updateLabels(WalletModel* model, QDialog* dialog)
         label->setVisible(nChange < 0);
 }
 
+// outputs that can't be selected are shown disabled
+bool CoinControlDialog::isOutputEnabled(const CoinControlEntry& entry) const
+{
+    return !entry.fLocked && (!entry.fMultiSig || fMultisigEnabled);
+}
+
+QTreeWidgetItem* CoinControlDialog::createOutputItem(const CoinControlEntry& entry, const QString& sWalletAddress, const QString& sWalletLabel, bool treeMode, int nDisplayUnit, double mempoolEstimatePriority)
+{
+    QTreeWidgetItem* itemOutput = new QTreeWidgetItem();
+    itemOutput->setFlags(Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsUserCheckable);
+    itemOutput->setCheckState(COLUMN_CHECKBOX, Qt::Unchecked);
+
+    //MultiSig
+    itemOutput->setText(COLUMN_TYPE, entry.fMultiSig ? "MultiSig" : "Personal");
+
+    // address
+    if (!entry.address.isEmpty()) {
+        // if listMode or change => show Forex Trading address. In tree mode, address is not shown again for direct wallet address outputs
+        if (!treeMode || (!(entry.address == sWalletAddress)))
+            itemOutput->setText(COLUMN_ADDRESS, entry.address);
+
+        itemOutput->setToolTip(COLUMN_ADDRESS, entry.address);
+    }
+
+    // label
+    if (!(entry.address == sWalletAddress)) // change
+    {
+        // tooltip from where the change comes from
+        itemOutput->setToolTip(COLUMN_LABEL, tr("change from %1 (%2)").arg(sWalletLabel).arg(sWalletAddress));
+        itemOutput->setText(COLUMN_LABEL, tr("(change)"));
+    } else if (!treeMode) {
+        itemOutput->setText(COLUMN_LABEL, entry.label.isEmpty() ? tr("(no label)") : entry.label);
+    }
+
+    // amount
+    itemOutput->setText(COLUMN_AMOUNT, BitcoinUnits::format(nDisplayUnit, entry.nValue));
+    itemOutput->setToolTip(COLUMN_AMOUNT, BitcoinUnits::format(nDisplayUnit, entry.nValue));
+    itemOutput->setText(COLUMN_AMOUNT_INT64, strPad(QString::number(entry.nValue), 15, " ")); // padding so that sorting works correctly
+
+    // date
+    itemOutput->setText(COLUMN_DATE, GUIUtil::dateTimeStr(entry.nTime));
+    itemOutput->setToolTip(COLUMN_DATE, GUIUtil::dateTimeStr(entry.nTime));
+    itemOutput->setText(COLUMN_DATE_INT64, strPad(QString::number(entry.nTime), 20, " "));
+
+    // confirmations
+    itemOutput->setText(COLUMN_CONFIRMATIONS, strPad(QString::number(entry.nDepth), 8, " "));
+
+    // priority
+    double dPriority = ((double)entry.nValue / (entry.nInputSize + 78)) * (entry.nDepth + 1); // 78 = 2 * 34 + 10
+    itemOutput->setText(COLUMN_PRIORITY, CoinControlDialog::getPriorityLabel(dPriority, mempoolEstimatePriority));
+    itemOutput->setText(COLUMN_PRIORITY_INT64, strPad(QString::number((int64_t)dPriority), 20, " "));
+
+    // transaction hash
+    itemOutput->setText(COLUMN_TXHASH, QString::fromStdString(entry.outpoint.hash.GetHex()));
+
+    // vout index
+    itemOutput->setText(COLUMN_VOUT_INDEX, QString::number(entry.outpoint.n));
+
+    // disable locked coins, and multisig coins unless this is the multisig dialog
+    if (!isOutputEnabled(entry)) {
+        coinControl->UnSelect(entry.outpoint); // just to be sure
+        itemOutput->setDisabled(true);
+        itemOutput->setIcon(COLUMN_CHECKBOX, QIcon(":/icons/lock_closed"));
+    }
+
+    // set checkbox
+    if (coinControl->IsSelected(entry.outpoint.hash, entry.outpoint.n))
+        itemOutput->setCheckState(COLUMN_CHECKBOX, Qt::Checked);
+
+    return itemOutput;
+}
+
+// tree mode: create the output items of a wallet address the first time it is expanded
+void CoinControlDialog::populateWalletAddress(QTreeWidgetItem* itemWalletAddress)
+{
+    if (!model || !model->getOptionsModel() || itemWalletAddress->childCount() > 0 || !itemWalletAddress->text(COLUMN_TXHASH).isEmpty())
+        return;
+
+    std::map<QString, std::vector<CoinControlEntry> >::const_iterator it = mapCoins.find(itemWalletAddress->text(COLUMN_ADDRESS));
+    if (it == mapCoins.end())
+        return;
+
+    int nDisplayUnit = model->getOptionsModel()->getDisplayUnit();
+    double mempoolEstimatePriority = mempool.estimatePriority(nTxConfirmTarget);
+
+    QList<QTreeWidgetItem*> itemsOutput;
+    for (const CoinControlEntry& entry : it->second)
+        itemsOutput.append(createOutputItem(entry, it->first, itemWalletAddress->text(COLUMN_LABEL), true, nDisplayUnit, mempoolEstimatePriority));
+    itemWalletAddress->addChildren(itemsOutput);
+    itemWalletAddress->sortChildren(sortColumn, sortOrder);
+}
+
 void CoinControlDialog::updateView()
 {
     if (!model || !model->getOptionsModel() || !model->getAddressTableModel())
@@ -736,166 +859,99 @@ void CoinControlDialog::updateView()
     ui->treeWidget->clear();
     ui->treeWidget->setEnabled(false); // performance, otherwise updateLabels would be called for every checked checkbox
     ui->treeWidget->setAlternatingRowColors(!treeMode);
-    QFlags<Qt::ItemFlag> flgCheckbox = Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsUserCheckable;
     QFlags<Qt::ItemFlag> flgTristate = Qt::ItemIsSelectable | Qt::ItemIsEnabled | Qt::ItemIsUserCheckable | Qt::ItemIsTristate;
 
     int nDisplayUnit = model->getOptionsModel()->getDisplayUnit();
     double mempoolEstimatePriority = mempool.estimatePriority(nTxConfirmTarget);
 
-    map<QString, vector<COutput>> mapCoins;
+    mapCoins.clear();
     model->listCoins(mapCoins);
 
-    BOOST_FOREACH (PAIRTYPE(QString, vector<COutput>) coins, mapCoins) {
-        QTreeWidgetItem* itemWalletAddress = new QTreeWidgetItem();
-        itemWalletAddress->setCheckState(COLUMN_CHECKBOX, Qt::Unchecked);
-        QString sWalletAddress = coins.first;
+    // Items are built detached and added in one go, in tree mode the outputs
+    // of an address are only created when it is expanded
+    QList<QTreeWidgetItem*> items;
+    for (std::map<QString, std::vector<CoinControlEntry> >::iterator it = mapCoins.begin(); it != mapCoins.end(); ++it) {
+        QString sWalletAddress = it->first;
+        std::vector<CoinControlEntry>& vEntries = it->second;
+
+        // when multisig is enabled, it will only display outputs from multisig addresses
+        if (fMultisigEnabled) {
+            vEntries.erase(std::remove_if(vEntries.begin(), vEntries.end(),
+                               [](const CoinControlEntry& entry) { return !entry.fMultiSig; }),
+                vEntries.end());
+        }
+
         QString sWalletLabel = model->getAddressTableModel()->labelForAddress(sWalletAddress);
         if (sWalletLabel.isEmpty())
             sWalletLabel = tr("(no label)");
 
-        if (treeMode) {
-            // wallet address
-            ui->treeWidget->addTopLevelItem(itemWalletAddress);
+        if (!treeMode) {
+            for (const CoinControlEntry& entry : vEntries)
+                items.append(createOutputItem(entry, sWalletAddress, sWalletLabel, false, nDisplayUnit, mempoolEstimatePriority));
+            continue;
+        }
 
-            itemWalletAddress->setFlags(flgTristate);
-            itemWalletAddress->setCheckState(COLUMN_CHECKBOX, Qt::Unchecked);
+        // wallet address
+        QTreeWidgetItem* itemWalletAddress = new QTreeWidgetItem();
+        itemWalletAddress->setFlags(flgTristate);
+        if (!vEntries.empty())
+            itemWalletAddress->setChildIndicatorPolicy(QTreeWidgetItem::ShowIndicator);
 
-            // label
-            itemWalletAddress->setText(COLUMN_LABEL, sWalletLabel);
-            itemWalletAddress->setToolTip(COLUMN_LABEL, sWalletLabel);
+        // label
+        itemWalletAddress->setText(COLUMN_LABEL, sWalletLabel);
+        itemWalletAddress->setToolTip(COLUMN_LABEL, sWalletLabel);
 
-            // address
-            itemWalletAddress->setText(COLUMN_ADDRESS, sWalletAddress);
-            itemWalletAddress->setToolTip(COLUMN_ADDRESS, sWalletAddress);
-        }
+        // address
+        itemWalletAddress->setText(COLUMN_ADDRESS, sWalletAddress);
+        itemWalletAddress->setToolTip(COLUMN_ADDRESS, sWalletAddress);
 
+        // totals and check state from the outputs, without creating them
         CAmount nSum = 0;
         double dPrioritySum = 0;
-        int nChildren = 0;
         int nInputSum = 0;
-        for(const COutput& out: coins.second) {
-            isminetype mine = pwalletMain->IsMine(out.tx->vout[out.i]);
-            bool fMultiSigUTXO = (mine & ISMINE_MULTISIG);
-            // when multisig is enabled, it will only display outputs from multisig addresses
-            if (fMultisigEnabled && !fMultiSigUTXO)
-                continue;
-            int nInputSize = 0;
-            nSum += out.tx->vout[out.i].nValue;
-            nChildren++;
-
-            QTreeWidgetItem* itemOutput;
-            if (treeMode)
-                itemOutput = new QTreeWidgetItem(itemWalletAddress);
-            else
-                itemOutput = new QTreeWidgetItem(ui->treeWidget);
-            itemOutput->setFlags(flgCheckbox);
-            itemOutput->setCheckState(COLUMN_CHECKBOX, Qt::Unchecked);
-
-            //MultiSig
-            if (fMultiSigUTXO) {
-                itemOutput->setText(COLUMN_TYPE, "MultiSig");
-
-                if (!fMultisigEnabled) {
-                    COutPoint outpt(out.tx->GetHash(), out.i);
-                    coinControl->UnSelect(outpt); // just to be sure
-                    itemOutput->setDisabled(true);
-                    itemOutput->setIcon(COLUMN_CHECKBOX, QIcon(":/icons/lock_closed"));
-                }
-            } else {
-                itemOutput->setText(COLUMN_TYPE, "Personal");
-            }
-
-            // address
-            CTxDestination outputAddress;
-            QString sAddress = "";
-            if (ExtractDestination(out.tx->vout[out.i].scriptPubKey, outputAddress)) {
-                sAddress = QString::fromStdString(CBitcoinAddress(outputAddress).ToString());
-
-                // if listMode or change => show Forex Trading address. In tree mode, address is not shown again for direct wallet address outputs
-                if (!treeMode || (!(sAddress == sWalletAddress)))
-                    itemOutput->setText(COLUMN_ADDRESS, sAddress);
-
-                itemOutput->setToolTip(COLUMN_ADDRESS, sAddress);
-
-                CPubKey pubkey;
-                CKeyID* keyid = boost::get<CKeyID>(&outputAddress);
-                if (keyid && model->getPubKey(*keyid, pubkey) && !pubkey.IsCompressed())
-                    nInputSize = 29; // 29 = 180 - 151 (public key is 180 bytes, priority free area is 151 bytes)
-            }
-
-            // label
-            if (!(sAddress == sWalletAddress)) // change
-            {
-                // tooltip from where the change comes from
-                itemOutput->setToolTip(COLUMN_LABEL, tr("change from %1 (%2)").arg(sWalletLabel).arg(sWalletAddress));
-                itemOutput->setText(COLUMN_LABEL, tr("(change)"));
-            } else if (!treeMode) {
-                QString sLabel = model->getAddressTableModel()->labelForAddress(sAddress);
-                if (sLabel.isEmpty())
-                    sLabel = tr("(no label)");
-                itemOutput->setText(COLUMN_LABEL, sLabel);
-            }
-
-            // amount
-            itemOutput->setText(COLUMN_AMOUNT, BitcoinUnits::format(nDisplayUnit, out.tx->vout[out.i].nValue));
-            itemOutput->setToolTip(COLUMN_AMOUNT, BitcoinUnits::format(nDisplayUnit, out.tx->vout[out.i].nValue));
-            itemOutput->setText(COLUMN_AMOUNT_INT64, strPad(QString::number(out.tx->vout[out.i].nValue), 15, " ")); // padding so that sorting works correctly
-
-            // date
-            itemOutput->setText(COLUMN_DATE, GUIUtil::dateTimeStr(out.tx->GetTxTime()));
-            itemOutput->setToolTip(COLUMN_DATE, GUIUtil::dateTimeStr(out.tx->GetTxTime()));
-            itemOutput->setText(COLUMN_DATE_INT64, strPad(QString::number(out.tx->GetTxTime()), 20, " "));
-
-            // confirmations
-            itemOutput->setText(COLUMN_CONFIRMATIONS, strPad(QString::number(out.nDepth), 8, " "));
-
-            // priority
-            double dPriority = ((double)out.tx->vout[out.i].nValue / (nInputSize + 78)) * (out.nDepth + 1); // 78 = 2 * 34 + 10
-            itemOutput->setText(COLUMN_PRIORITY, CoinControlDialog::getPriorityLabel(dPriority, mempoolEstimatePriority));
-            itemOutput->setText(COLUMN_PRIORITY_INT64, strPad(QString::number((int64_t)dPriority), 20, " "));
-            dPrioritySum += (double)out.tx->vout[out.i].nValue * (out.nDepth + 1);
-            nInputSum += nInputSize;
-
-            // transaction hash
-            uint256 txhash = out.tx->GetHash();
-            itemOutput->setText(COLUMN_TXHASH, QString::fromStdString(txhash.GetHex()));
-
-            // vout index
-            itemOutput->setText(COLUMN_VOUT_INDEX, QString::number(out.i));
-
-            // disable locked coins
-            if (model->isLockedCoin(txhash, out.i)) {
-                COutPoint outpt(txhash, out.i);
-                coinControl->UnSelect(outpt); // just to be sure
-                itemOutput->setDisabled(true);
-                itemOutput->setIcon(COLUMN_CHECKBOX, QIcon(":/icons/lock_closed"));
-            }
-
-            // set checkbox
-            if (coinControl->IsSelected(txhash, out.i))
-                itemOutput->setCheckState(COLUMN_CHECKBOX, Qt::Checked);
+        int nSelected = 0;
+        for (const CoinControlEntry& entry : vEntries) {
+            nSum += entry.nValue;
+            dPrioritySum += (double)entry.nValue * (entry.nDepth + 1);
+            nInputSum += entry.nInputSize;
+            if (!isOutputEnabled(entry))
+                coinControl->UnSelect(entry.outpoint); // just to be sure
+            else if (coinControl->IsSelected(entry.outpoint.hash, entry.outpoint.n))
+                nSelected++;
         }
+        if (nSelected == 0)
+            itemWalletAddress->setCheckState(COLUMN_CHECKBOX, Qt::Unchecked);
+        else if (nSelected == (int)vEntries.size())
+            itemWalletAddress->setCheckState(COLUMN_CHECKBOX, Qt::Checked);
+        else
+            itemWalletAddress->setCheckState(COLUMN_CHECKBOX, Qt::PartiallyChecked);
 
         // amount
-        if (treeMode) {
-            dPrioritySum = dPrioritySum / (nInputSum + 78);
-            itemWalletAddress->setText(COLUMN_CHECKBOX, "(" + QString::number(nChildren) + ")");
-            itemWalletAddress->setText(COLUMN_AMOUNT, BitcoinUnits::format(nDisplayUnit, nSum));
-            itemWalletAddress->setToolTip(COLUMN_AMOUNT, BitcoinUnits::format(nDisplayUnit, nSum));
-            itemWalletAddress->setText(COLUMN_AMOUNT_INT64, strPad(QString::number(nSum), 15, " "));
-            itemWalletAddress->setText(COLUMN_PRIORITY, CoinControlDialog::getPriorityLabel(dPrioritySum, mempoolEstimatePriority));
-            itemWalletAddress->setText(COLUMN_PRIORITY_INT64, strPad(QString::number((int64_t)dPrioritySum), 20, " "));
-        }
+        dPrioritySum = dPrioritySum / (nInputSum + 78);
+        itemWalletAddress->setText(COLUMN_CHECKBOX, "(" + QString::number(vEntries.size()) + ")");
+        itemWalletAddress->setText(COLUMN_AMOUNT, BitcoinUnits::format(nDisplayUnit, nSum));
+        itemWalletAddress->setToolTip(COLUMN_AMOUNT, BitcoinUnits::format(nDisplayUnit, nSum));
+        itemWalletAddress->setText(COLUMN_AMOUNT_INT64, strPad(QString::number(nSum), 15, " "));
+        itemWalletAddress->setText(COLUMN_PRIORITY, CoinControlDialog::getPriorityLabel(dPrioritySum, mempoolEstimatePriority));
+        itemWalletAddress->setText(COLUMN_PRIORITY_INT64, strPad(QString::number((int64_t)dPrioritySum), 20, " "));
+
+        items.append(itemWalletAddress);
     }
+    ui->treeWidget->addTopLevelItems(items);
+
+    // sort view
+    sortView(sortColumn, sortOrder);
 
     // expand all partially selected
     if (treeMode) {
-        for (int i = 0; i < ui->treeWidget->topLevelItemCount(); i++)
-            if (ui->treeWidget->topLevelItem(i)->checkState(COLUMN_CHECKBOX) == Qt::PartiallyChecked)
-                ui->treeWidget->topLevelItem(i)->setExpanded(true);
+        for (int i = 0; i < ui->treeWidget->topLevelItemCount(); i++) {
+            QTreeWidgetItem* itemWalletAddress = ui->treeWidget->topLevelItem(i);
+            if (itemWalletAddress->checkState(COLUMN_CHECKBOX) == Qt::PartiallyChecked) {
+                populateWalletAddress(itemWalletAddress);
+                itemWalletAddress->setExpanded(true);
+            }
+        }
     }
 
-    // sort view
-    sortView(sortColumn, sortOrder);
     ui->treeWidget->setEnabled(true);
 }
@@ -8,6 +8,7 @@
 #define BITCOIN_QT_COINCONTROLDIALOG_H
 
 #include "amount.h"
+#include "walletmodel.h"
 
 #include <QAbstractButton>
 #include <QAction>
@@ -18,8 +19,6 @@
 #include <QString>
 #include <QTreeWidgetItem>
 
-class WalletModel;
-
 class MultisigDialog;
 class CCoinControl;
 class CTxMemPool;
@@ -61,9 +60,15 @@ private:
     QAction* lockAction;
     QAction* unlockAction;
 
+    // Spendable outputs by wallet address, tree mode creates the output items of an address when it is expanded
+    std::map<QString, std::vector<CoinControlEntry> > mapCoins;
+
     QString strPad(QString, int, QString);
     void sortView(int, Qt::SortOrder);
     void updateView();
+    bool isOutputEnabled(const CoinControlEntry& entry) const;
+    QTreeWidgetItem* createOutputItem(const CoinControlEntry& entry, const QString& sWalletAddress, const QString& sWalletLabel, bool treeMode, int nDisplayUnit, double mempoolEstimatePriority);
+    void populateWalletAddress(QTreeWidgetItem* itemWalletAddress);
 
     enum {
         COLUMN_CHECKBOX,
@@ -122,6 +127,7 @@ private slots:
     void radioTreeMode(bool);
     void radioListMode(bool);
     void viewItemChanged(QTreeWidgetItem*, int);
+    void viewItemExpanded(QTreeWidgetItem*);
     void headerSectionClicked(int);
     void buttonBoxClicked(QAbstractButton*);
     void buttonSelectAllClicked();
@@ -143,8 +143,10 @@ static void initTranslations(QTranslator& qtTranslatorBase, QTranslator& qtTrans
 void DebugMessageHandler(QtMsgType type, const QMessageLogContext& context, const QString& msg)
 {
     Q_UNUSED(context);
-    const char* category = (type == QtDebugMsg) ? "qt" : NULL;
-    LogPrint(category, "GUI: %s\n", msg.toStdString());
+    if (type == QtDebugMsg)
+        LogPrint("qt", "GUI: %s\n", msg.toStdString());
+    else
+        LogPrintf("GUI: %s\n", msg.toStdString());
 }
 
 /** Class encapsulating Forex Trading startup and shutdown.
@@ -526,6 +528,9 @@ int main(int argc, char* argv[])
     //   Need to pass name here as CAmount is a typedef (see http://qt-project.org/doc/qt-5/qmetatype.html#qRegisterMetaType)
     //   IMPORTANT if it is no longer a typedef use the normal variant above
     qRegisterMetaType<CAmount>("CAmount");
+#ifdef ENABLE_WALLET
+    qRegisterMetaType<CWalletBalances>("CWalletBalances");
+#endif
 
     /// 3. Application identification
     // must be set before OptionsModel is initialized or translations are loaded,
@@ -343,6 +343,7 @@ void TransactionRecord::updateStatus(const CWalletTx& wtx)
         idx);
     //status.countsForBalance = wtx.IsTrusted() && !(wtx.GetBlocksToMaturity() > 0);
     status.depth = wtx.GetDepthInMainChain();
+    status.pindexBlock = (pindex && chainActive.Contains(pindex)) ? pindex : NULL;
 
     //Determine the depth of the block
     int nBlocksToMaturity = wtx.GetBlocksToMaturity();
@@ -398,6 +399,28 @@ bool TransactionRecord::statusUpdateNeeded()
     return status.cur_num_blocks != chainActive.Height() || status.cur_num_ix_locks != nCompleteTXLocks;
 }
 
+bool TransactionRecord::statusSettled() const
+{
+    // Deep enough that SwiftX locks no longer count towards the depth, and
+    // generated coins have matured
+    return status.status == TransactionStatus::Confirmed && status.pindexBlock &&
+           status.cur_num_blocks - status.pindexBlock->nHeight + 1 >= RecommendedNumConfirmations;
+}
+
+bool TransactionRecord::updateDepth(const CBlockIndex* pindexTip)
+{
+    if (!pindexTip || !statusSettled())
+        return false;
+
+    // Block index entries are never freed and their ancestry never changes,
+    // so this is safe without cs_main
+    if (pindexTip->GetAncestor(status.pindexBlock->nHeight) != status.pindexBlock)
+        return false;
+    status.depth = pindexTip->nHeight - status.pindexBlock->nHeight + 1;
+    status.cur_num_blocks = pindexTip->nHeight;
+    return true;
+}
+
 QString TransactionRecord::getTxID() const
 {
     return QString::fromStdString(hash.ToString());
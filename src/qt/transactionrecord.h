@@ -14,6 +14,7 @@
 #include <QList>
 #include <QString>
 
+class CBlockIndex;
 class CWallet;
 class CWalletTx;
 
@@ -23,7 +24,7 @@ class TransactionStatus
 {
 public:
     TransactionStatus() : countsForBalance(false), sortKey(""),
-                          matures_in(0), status(Offline), depth(0), open_for(0), cur_num_blocks(-1)
+                          matures_in(0), status(Offline), depth(0), open_for(0), pindexBlock(NULL), cur_num_blocks(-1)
     {
     }
 
@@ -61,6 +62,10 @@ public:
                       finalization */
     /**@}*/
 
+    /** Block the transaction was in when the status was computed, NULL if it
+        wasn't in the active chain. Lets the depth follow the tip without locks. */
+    const CBlockIndex* pindexBlock;
+
     /** Current number of blocks (to know whether cached status is still valid) */
     int cur_num_blocks;
 
@@ -152,6 +157,15 @@ public:
     /** Return whether a status update is needed.
      */
     bool statusUpdateNeeded();
+
+    /** Return whether the status can only change by depth from now on, barring a reorg.
+     */
+    bool statusSettled() const;
+
+    /** Move the depth of a settled transaction along with the tip, without taking any locks.
+        Returns false if a full status update is needed instead.
+     */
+    bool updateDepth(const CBlockIndex* pindexTip);
 };
 
 #endif // BITCOIN_QT_TRANSACTIONRECORD_H
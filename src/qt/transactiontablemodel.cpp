@@ -14,6 +14,7 @@
 #include "transactionrecord.h"
 #include "walletmodel.h"
 
+#include "chaintip.h"
 #include "main.h"
 #include "sync.h"
 #include "uint256.h"
@@ -25,6 +26,13 @@
 #include <QDebug>
 #include <QIcon>
 #include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <boost/thread.hpp>
+
+/** Wallet transactions decomposed per cs_main/cs_wallet hold while loading the table */
+static const int TRANSACTION_LOAD_PAGE_SIZE = 1000;
 
 // Amount column is right-aligned it contains numbers
 static int column_alignments[] = {
@@ -57,8 +65,16 @@ class TransactionTablePriv
 {
 public:
     TransactionTablePriv(CWallet* wallet, TransactionTableModel* parent) : wallet(wallet),
-                                                                           parent(parent)
+                                                                           parent(parent),
+                                                                           pindexLastTip(NULL)
+    {
+    }
+
+    ~TransactionTablePriv()
     {
+        threadLoader.interrupt();
+        if (threadLoader.joinable())
+            threadLoader.join();
     }
 
     CWallet* wallet;
@@ -70,21 +86,123 @@ public:
      */
     QList<TransactionRecord> cachedWallet;
 
+    /* Tip as of the last updateConfirmations, to notice reorgs */
+    const CBlockIndex* pindexLastTip;
+
+    /* Pages decomposed by the loader thread that the GUI thread hasn't added yet */
+    QMutex csLoadedPages;
+    QList<QList<TransactionRecord> > loadedPages;
+    boost::thread threadLoader;
+
     /* Query entire wallet anew from core.
+     * The wallet is walked in pages on a background thread, each page under
+     * its own short lock, and the rows show up as the pages come in.
      */
     void refreshWallet()
     {
         qDebug() << "TransactionTablePriv::refreshWallet";
         cachedWallet.clear();
+        pindexLastTip = GetChainTipSnapshot()->pindexTip;
+        threadLoader = boost::thread(boost::bind(&TransactionTablePriv::loadWallet, this));
+    }
+
+    void loadWallet()
+    {
+        RenameThread("forextrading-txload");
+        uint256 hashLast;
+        bool fFirst = true;
+        bool fDone = false;
+        while (!fDone) {
+            boost::this_thread::interruption_point();
+
+            QList<TransactionRecord> page;
+            {
+                LOCK2(cs_main, wallet->cs_wallet);
+                std::map<uint256, CWalletTx>::iterator it = fFirst ? wallet->mapWallet.begin() : wallet->mapWallet.upper_bound(hashLast);
+                for (int n = 0; it != wallet->mapWallet.end() && n < TRANSACTION_LOAD_PAGE_SIZE; ++it, ++n) {
+                    hashLast = it->first;
+                    if (!TransactionRecord::showTransaction(it->second))
+                        continue;
+                    // Compute the status while the locks are held anyway, so
+                    // the view doesn't have to take them for every new row
+                    QList<TransactionRecord> records = TransactionRecord::decomposeTransaction(wallet, it->second);
+                    for (QList<TransactionRecord>::iterator rec = records.begin(); rec != records.end(); ++rec)
+                        rec->updateStatus(it->second);
+                    page.append(records);
+                }
+                fDone = it == wallet->mapWallet.end();
+            }
+            fFirst = false;
+
+            if (page.isEmpty())
+                continue;
+            {
+                QMutexLocker locker(&csLoadedPages);
+                loadedPages.append(page);
+            }
+            QMetaObject::invokeMethod(parent, "addLoadedTransactions", Qt::QueuedConnection);
+        }
+    }
+
+    /* Add the pages the loader has finished. Transactions that arrived
+     * through a notification in the meantime are already in the model.
+     * Ones that were removed or hidden since their page was read got their
+     * notification while they weren't in the model yet, so the wallet is
+     * asked again before a row is added for them.
+     */
+    void addLoadedTransactions()
+    {
+        QList<QList<TransactionRecord> > pages;
         {
-            LOCK2(cs_main, wallet->cs_wallet);
-            for (std::map<uint256, CWalletTx>::iterator it = wallet->mapWallet.begin(); it != wallet->mapWallet.end(); ++it) {
-                if (TransactionRecord::showTransaction(it->second))
-                    cachedWallet.append(TransactionRecord::decomposeTransaction(wallet, it->second));
+            QMutexLocker locker(&csLoadedPages);
+            pages.swap(loadedPages);
+        }
+
+        foreach (const QList<TransactionRecord>& page, pages) {
+            QList<TransactionRecord> toInsert;
+            {
+                LOCK2(cs_main, wallet->cs_wallet);
+                foreach (const TransactionRecord& rec, page) {
+                    QList<TransactionRecord>::iterator it = qLowerBound(cachedWallet.begin(), cachedWallet.end(), rec.hash, TxLessThan());
+                    if (it != cachedWallet.end() && it->hash == rec.hash)
+                        continue;
+                    std::map<uint256, CWalletTx>::iterator mi = wallet->mapWallet.find(rec.hash);
+                    if (mi == wallet->mapWallet.end() || !TransactionRecord::showTransaction(mi->second))
+                        continue;
+                    toInsert.append(rec);
+                }
+            }
+            if (toInsert.isEmpty())
+                continue;
+
+            // Pages come in hash order, so a page normally lands in one place
+            int lowerIndex = qLowerBound(cachedWallet.begin(), cachedWallet.end(), toInsert.first().hash, TxLessThan()) - cachedWallet.begin();
+            if (lowerIndex == cachedWallet.size() || toInsert.last().hash < cachedWallet[lowerIndex].hash) {
+                parent->beginInsertRows(QModelIndex(), lowerIndex, lowerIndex + toInsert.size() - 1);
+                for (int i = 0; i < toInsert.size(); i++)
+                    cachedWallet.insert(lowerIndex + i, toInsert[i]);
+                parent->endInsertRows();
+                continue;
+            }
+
+            foreach (const TransactionRecord& rec, toInsert) {
+                int insertIndex = qUpperBound(cachedWallet.begin(), cachedWallet.end(), rec.hash, TxLessThan()) - cachedWallet.begin();
+                parent->beginInsertRows(QModelIndex(), insertIndex, insertIndex);
+                cachedWallet.insert(insertIndex, rec);
+                parent->endInsertRows();
             }
         }
     }
 
+    /* Remember the new tip, returns whether blocks were disconnected since the last one.
+     */
+    bool updateTip(const CBlockIndex* pindexTip)
+    {
+        bool fReorg = pindexLastTip && (!pindexTip || pindexTip->GetAncestor(pindexLastTip->nHeight) != pindexLastTip);
+        pindexLastTip = pindexTip;
+        return fReorg;
+    }
+
     /* Update our model of the wallet incrementally, to synchronize our model of the wallet
        with that of the core.
 
@@ -170,6 +288,11 @@ public:
         if (idx >= 0 && idx < cachedWallet.size()) {
             TransactionRecord* rec = &cachedWallet[idx];
 
+            // Deeply confirmed transactions only need their depth moved
+            // along with the tip, which needs no locks at all
+            if (rec->updateDepth(GetChainTipSnapshot()->pindexTip))
+                return rec;
+
             // Get required locks upfront. This avoids the GUI from getting
             // stuck if the core is holding the locks for a longer time - for
             // example, during a wallet rescan.
@@ -245,10 +368,31 @@ void TransactionTableModel::updateConfirmations()
 {
     // Blocks came in since last poll.
     // Invalidate status (number of confirmations) and (possibly) description
-    //  for all rows. Qt is smart enough to only actually request the data for the
-    //  visible rows.
-    emit dataChanged(index(0, Status), index(priv->size() - 1, Status));
-    emit dataChanged(index(0, ToAddress), index(priv->size() - 1, ToAddress));
+    //  for the rows whose status can still change. Settled rows only show their
+    //  depth in tooltips and descriptions, which are computed when requested;
+    //  invalidating them would make the filter proxies re-read every row.
+    if (priv->updateTip(GetChainTipSnapshot()->pindexTip)) {
+        // Blocks were disconnected, any row may have changed
+        emit dataChanged(index(0, Status), index(priv->size() - 1, Status));
+        emit dataChanged(index(0, ToAddress), index(priv->size() - 1, ToAddress));
+        return;
+    }
+
+    int nFirst = -1;
+    for (int i = 0; i <= priv->size(); i++) {
+        bool fChanging = i < priv->size() && !priv->cachedWallet[i].statusSettled();
+        if (fChanging && nFirst < 0)
+            nFirst = i;
+        if (!fChanging && nFirst >= 0) {
+            emit dataChanged(index(nFirst, Status), index(i - 1, ToAddress));
+            nFirst = -1;
+        }
+    }
+}
+
+void TransactionTableModel::addLoadedTransactions()
+{
+    priv->addLoadedTransactions();
 }
 
 int TransactionTableModel::rowCount(const QModelIndex& parent) const
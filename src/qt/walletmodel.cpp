@@ -13,6 +13,7 @@
 #include "transactiontablemodel.h"
 
 #include "base58.h"
+#include "chaintip.h"
 #include "db.h"
 #include "keystore.h"
 #include "main.h"
@@ -135,22 +136,18 @@ void WalletModel::updateStatus()
 
 void WalletModel::pollBalanceChanged()
 {
-    // Get required locks upfront. This avoids the GUI from getting stuck on
-    // periodical polls if the core is holding the locks for a longer time -
-    // for example, during a wallet rescan.
-    TRY_LOCK(cs_main, lockMain);
-    if (!lockMain)
-        return;
-    TRY_LOCK(wallet->cs_wallet, lockWallet);
-    if (!lockWallet)
-        return;
-
-    if (fForceCheckBalanceChanged || chainActive.Height() != cachedNumBlocks || nZeromintPercentage != cachedZeromintPercentage || cachedTxLocks != nCompleteTXLocks) {
+    // The wallet computes the balances on the scheduler thread and pushes
+    // them through NotifyBalanceChanged, never take cs_main here. Blocks and
+    // transactions mark them dirty in the wallet already, this covers what
+    // the wallet isn't told about, like blocks connected during initial sync.
+    int nHeight = GetChainTipSnapshot()->nHeight;
+    if (fForceCheckBalanceChanged || nHeight != cachedNumBlocks || nZeromintPercentage != cachedZeromintPercentage || cachedTxLocks != nCompleteTXLocks) {
         fForceCheckBalanceChanged = false;
 
         // Balance and number of transactions might have changed
-        cachedNumBlocks = chainActive.Height();
+        cachedNumBlocks = nHeight;
         cachedZeromintPercentage = nZeromintPercentage;
+        cachedTxLocks = nCompleteTXLocks;
 
         checkBalanceChanged();
         if (transactionTableModel) {
@@ -169,41 +166,34 @@ void WalletModel::emitBalanceChanged()
 
 void WalletModel::checkBalanceChanged()
 {
-    TRY_LOCK(cs_main, lockMain);
-    if (!lockMain) return;
+    // updateBalances is called once the wallet has recomputed them
+    wallet->MarkBalancesDirty();
+}
 
-    CAmount newBalance = getBalance();
-    CAmount newUnconfirmedBalance = getUnconfirmedBalance();
-    CAmount newImmatureBalance = getImmatureBalance();
-    CAmount newZerocoinBalance = getZerocoinBalance();
-    CAmount newUnconfirmedZerocoinBalance = getUnconfirmedZerocoinBalance();
-    CAmount newImmatureZerocoinBalance = getImmatureZerocoinBalance();
+void WalletModel::updateBalances(const CWalletBalances& balances)
+{
     CAmount newWatchOnlyBalance = 0;
     CAmount newWatchUnconfBalance = 0;
     CAmount newWatchImmatureBalance = 0;
     if (haveWatchOnly()) {
-        newWatchOnlyBalance = getWatchBalance();
-        newWatchUnconfBalance = getWatchUnconfirmedBalance();
-        newWatchImmatureBalance = getWatchImmatureBalance();
+        newWatchOnlyBalance = balances.nWatchOnlyBalance;
+        newWatchUnconfBalance = balances.nUnconfirmedWatchOnlyBalance;
+        newWatchImmatureBalance = balances.nImmatureWatchOnlyBalance;
     }
 
-    if (cachedBalance != newBalance || cachedUnconfirmedBalance != newUnconfirmedBalance || cachedImmatureBalance != newImmatureBalance ||
-        cachedZerocoinBalance != newZerocoinBalance || cachedUnconfirmedZerocoinBalance != newUnconfirmedZerocoinBalance || cachedImmatureZerocoinBalance != newImmatureZerocoinBalance ||
-        cachedWatchOnlyBalance != newWatchOnlyBalance || cachedWatchUnconfBalance != newWatchUnconfBalance || cachedWatchImmatureBalance != newWatchImmatureBalance ||
-        cachedTxLocks != nCompleteTXLocks ) {
-        cachedBalance = newBalance;
-        cachedUnconfirmedBalance = newUnconfirmedBalance;
-        cachedImmatureBalance = newImmatureBalance;
-        cachedZerocoinBalance = newZerocoinBalance;
-        cachedUnconfirmedZerocoinBalance = newUnconfirmedZerocoinBalance;
-        cachedImmatureZerocoinBalance = newImmatureZerocoinBalance;
-        cachedTxLocks = nCompleteTXLocks;
+    if (cachedBalance != balances.nBalance || cachedUnconfirmedBalance != balances.nUnconfirmedBalance || cachedImmatureBalance != balances.nImmatureBalance ||
+        cachedZerocoinBalance != balances.nZerocoinBalance || cachedUnconfirmedZerocoinBalance != balances.nUnconfirmedZerocoinBalance || cachedImmatureZerocoinBalance != balances.nImmatureZerocoinBalance ||
+        cachedWatchOnlyBalance != newWatchOnlyBalance || cachedWatchUnconfBalance != newWatchUnconfBalance || cachedWatchImmatureBalance != newWatchImmatureBalance) {
+        cachedBalance = balances.nBalance;
+        cachedUnconfirmedBalance = balances.nUnconfirmedBalance;
+        cachedImmatureBalance = balances.nImmatureBalance;
+        cachedZerocoinBalance = balances.nZerocoinBalance;
+        cachedUnconfirmedZerocoinBalance = balances.nUnconfirmedZerocoinBalance;
+        cachedImmatureZerocoinBalance = balances.nImmatureZerocoinBalance;
         cachedWatchOnlyBalance = newWatchOnlyBalance;
         cachedWatchUnconfBalance = newWatchUnconfBalance;
         cachedWatchImmatureBalance = newWatchImmatureBalance;
-        emit balanceChanged(newBalance, newUnconfirmedBalance, newImmatureBalance, 
-                            newZerocoinBalance, newUnconfirmedZerocoinBalance, newImmatureZerocoinBalance,
-                            newWatchOnlyBalance, newWatchUnconfBalance, newWatchImmatureBalance);
+        emitBalanceChanged();
     }
 }
 
@@ -413,7 +403,7 @@ WalletModel::SendCoinsReturn WalletModel::sendCoins(WalletModelTransaction& tran
         }
         emit coinsSent(wallet, rcp, transaction_array);
     }
-    checkBalanceChanged(); // update balance immediately, otherwise there could be a short noticeable delay until pollBalanceChanged hits
+    checkBalanceChanged(); // update balance on the next wallet notification, otherwise there could be a short noticeable delay until pollBalanceChanged hits
 
     return SendCoinsReturn(OK);
 }
@@ -542,6 +532,12 @@ static void NotifyTransactionChanged(WalletModel* walletmodel, CWallet* wallet,
                               Q_ARG(int, status)*/);
 }
 
+static void NotifyBalanceChanged(WalletModel* walletmodel, CWallet* wallet, const CWalletBalances& balances)
+{
+    QMetaObject::invokeMethod(walletmodel, "updateBalances", Qt::QueuedConnection,
+                              Q_ARG(CWalletBalances, balances));
+}
+
 static void ShowProgress(WalletModel* walletmodel, const std::string& title, int nProgress)
 {
     // emits signal "showProgress"
@@ -610,6 +606,7 @@ void WalletModel::subscribeToCoreSignals()
     wallet->NotifyStatusChanged.connect(boost::bind(&NotifyKeyStoreStatusChanged, this, _1));
     wallet->NotifyAddressBookChanged.connect(boost::bind(NotifyAddressBookChanged, this, _1, _2, _3, _4, _5, _6));
     wallet->NotifyTransactionChanged.connect(boost::bind(NotifyTransactionChanged, this, _1, _2, _3));
+    wallet->NotifyBalanceChanged.connect(boost::bind(NotifyBalanceChanged, this, _1, _2));
     wallet->ShowProgress.connect(boost::bind(ShowProgress, this, _1, _2));
     wallet->NotifyWatchonlyChanged.connect(boost::bind(NotifyWatchonlyChanged, this, _1));
     wallet->NotifyMultiSigChanged.connect(boost::bind(NotifyMultiSigChanged, this, _1));
@@ -624,6 +621,7 @@ void WalletModel::unsubscribeFromCoreSignals()
     wallet->NotifyStatusChanged.disconnect(boost::bind(&NotifyKeyStoreStatusChanged, this, _1));
     wallet->NotifyAddressBookChanged.disconnect(boost::bind(NotifyAddressBookChanged, this, _1, _2, _3, _4, _5, _6));
     wallet->NotifyTransactionChanged.disconnect(boost::bind(NotifyTransactionChanged, this, _1, _2, _3));
+    wallet->NotifyBalanceChanged.disconnect(boost::bind(NotifyBalanceChanged, this, _1, _2));
     wallet->ShowProgress.disconnect(boost::bind(ShowProgress, this, _1, _2));
     wallet->NotifyWatchonlyChanged.disconnect(boost::bind(NotifyWatchonlyChanged, this, _1));
     wallet->NotifyMultiSigChanged.disconnect(boost::bind(NotifyMultiSigChanged, this, _1));
@@ -699,12 +697,15 @@ bool WalletModel::isSpent(const COutPoint& outpoint) const
 }
 
 // AvailableCoins + LockedCoins grouped by wallet address (put change in one group with wallet address)
-void WalletModel::listCoins(std::map<QString, std::vector<COutput> >& mapCoins) const
+// Spendable outputs grouped by the address they (or the change they came from) were received on.
+// Everything the coin control dialog shows is resolved here in one pass, so the
+// dialog doesn't take the wallet locks again for every output.
+void WalletModel::listCoins(std::map<QString, std::vector<CoinControlEntry> >& mapCoins) const
 {
     std::vector<COutput> vCoins;
     wallet->AvailableCoins(vCoins);
 
-    LOCK2(cs_main, wallet->cs_wallet); // ListLockedCoins, mapWallet
+    LOCK2(cs_main, wallet->cs_wallet); // ListLockedCoins, mapWallet, mapAddressBook
     std::vector<COutPoint> vLockedCoins;
     wallet->ListLockedCoins(vLockedCoins);
 
@@ -717,19 +718,69 @@ void WalletModel::listCoins(std::map<QString, std::vector<COutput> >& mapCoins)
         if (outpoint.n < out.tx->vout.size() && wallet->IsMine(out.tx->vout[outpoint.n]) == ISMINE_SPENDABLE)
             vCoins.push_back(out);
     }
+    std::set<COutPoint> setLockedCoins(vLockedCoins.begin(), vLockedCoins.end());
+
+    // Change chains of reward wallets are long and shared, remember where
+    // every outpoint on a walked chain leads
+    std::map<COutPoint, QString> mapOrigin;
+    std::vector<COutPoint> vChain;
 
     BOOST_FOREACH (const COutput& out, vCoins) {
+        if (!out.fSpendable)
+            continue;
+
+        QString sOrigin;
+        vChain.clear();
         COutput cout = out;
+        while (true) {
+            COutPoint outpoint(cout.tx->GetHash(), cout.i);
+            std::map<COutPoint, QString>::const_iterator it = mapOrigin.find(outpoint);
+            if (it != mapOrigin.end()) {
+                sOrigin = it->second;
+                break;
+            }
+            vChain.push_back(outpoint);
+
+            if (wallet->IsChange(cout.tx->vout[cout.i]) && cout.tx->vin.size() > 0 && wallet->IsMine(cout.tx->vin[0]) &&
+                wallet->mapWallet.count(cout.tx->vin[0].prevout.hash)) {
+                cout = COutput(&wallet->mapWallet[cout.tx->vin[0].prevout.hash], cout.tx->vin[0].prevout.n, 0, true);
+                continue;
+            }
 
-        while (wallet->IsChange(cout.tx->vout[cout.i]) && cout.tx->vin.size() > 0 && wallet->IsMine(cout.tx->vin[0])) {
-            if (!wallet->mapWallet.count(cout.tx->vin[0].prevout.hash)) break;
-            cout = COutput(&wallet->mapWallet[cout.tx->vin[0].prevout.hash], cout.tx->vin[0].prevout.n, 0, true);
+            CTxDestination address;
+            if (ExtractDestination(cout.tx->vout[cout.i].scriptPubKey, address))
+                sOrigin = QString::fromStdString(CBitcoinAddress(address).ToString());
+            break;
         }
+        BOOST_FOREACH (const COutPoint& outpoint, vChain)
+            mapOrigin[outpoint] = sOrigin;
+        if (sOrigin.isEmpty())
+            continue;
+
+        const CTxOut& txout = out.tx->vout[out.i];
+        CoinControlEntry entry;
+        entry.outpoint = COutPoint(out.tx->GetHash(), out.i);
+        entry.nValue = txout.nValue;
+        entry.nDepth = out.nDepth;
+        entry.nTime = out.tx->GetTxTime();
+        entry.fMultiSig = (wallet->IsMine(txout) & ISMINE_MULTISIG);
+        entry.fLocked = setLockedCoins.count(entry.outpoint);
 
         CTxDestination address;
-        if (!out.fSpendable || !ExtractDestination(cout.tx->vout[cout.i].scriptPubKey, address))
-            continue;
-        mapCoins[QString::fromStdString(CBitcoinAddress(address).ToString())].push_back(out);
+        if (ExtractDestination(txout.scriptPubKey, address)) {
+            entry.address = QString::fromStdString(CBitcoinAddress(address).ToString());
+
+            std::map<CTxDestination, CAddressBookData>::const_iterator mi = wallet->mapAddressBook.find(address);
+            if (mi != wallet->mapAddressBook.end())
+                entry.label = QString::fromStdString(mi->second.name);
+
+            CPubKey pubkey;
+            CKeyID* keyid = boost::get<CKeyID>(&address);
+            if (keyid && wallet->GetPubKey(*keyid, pubkey) && !pubkey.IsCompressed())
+                entry.nInputSize = 29; // 29 = 180 - 151 (public key is 180 bytes, priority free area is 151 bytes)
+        }
+
+        mapCoins[sOrigin].push_back(entry);
     }
 }
 
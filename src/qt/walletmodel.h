@@ -99,6 +99,25 @@ public:
     }
 };
 
+/** A spendable output with everything coin control shows about it, resolved under one wallet lock */
+class CoinControlEntry
+{
+public:
+    CoinControlEntry() : nValue(0), nDepth(0), nTime(0), fMultiSig(false), fLocked(false), nInputSize(0) {}
+
+    COutPoint outpoint;
+    CAmount nValue;
+    int nDepth;
+    int64_t nTime;
+    // Destination of this output, and its address book label
+    QString address;
+    QString label;
+    bool fMultiSig;
+    bool fLocked;
+    // Bytes the input adds on top of the priority free area (uncompressed public keys)
+    int nInputSize;
+};
+
 /** Interface to Bitcoin wallet from Qt view code. */
 class WalletModel : public QObject
 {
@@ -207,7 +226,7 @@ public:
     bool isMine(CBitcoinAddress address);
     void getOutputs(const std::vector<COutPoint>& vOutpoints, std::vector<COutput>& vOutputs);
     bool isSpent(const COutPoint& outpoint) const;
-    void listCoins(std::map<QString, std::vector<COutput> >& mapCoins) const;
+    void listCoins(std::map<QString, std::vector<CoinControlEntry> >& mapCoins) const;
 
     bool isLockedCoin(uint256 hash, unsigned int n) const;
     void lockCoin(COutPoint& output);
@@ -297,10 +316,14 @@ public slots:
     void updateWatchOnlyFlag(bool fHaveWatchonly);
     /* MultiSig added */
     void updateMultiSigFlag(bool fHaveMultiSig);
-    /* Current, immature or unconfirmed balance might have changed - emit 'balanceChanged' if so */
+    /* Chain tip or SwiftX locks might have changed - ask the wallet for new balances if so */
     void pollBalanceChanged();
+    /* Balances recomputed by the wallet - emit 'balanceChanged' if they differ */
+    void updateBalances(const CWalletBalances& balances);
     /* Update address book labels in the database */
     void updateAddressBookLabels(const CTxDestination& address, const string& strName, const string& strPurpose);
 };
 
+Q_DECLARE_METATYPE(CWalletBalances)
+
 #endif // BITCOIN_QT_WALLETMODEL_H
@@ -6,25 +6,35 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "chain.h"
+#include "checkqueue.h"
 #include "primitives/block.h"
 #include "primitives/transaction.h"
 #include "main.h"
 #include "httpserver.h"
+#include "jsonstream.h"
 #include "rpc/server.h"
 #include "streams.h"
 #include "sync.h"
+#include "txdb.h"
 #include "txmempool.h"
 #include "utilstrencodings.h"
 #include "version.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/dynamic_bitset.hpp>
+#include <boost/thread.hpp>
 
 #include <univalue.h>
 
 using namespace std;
 
-static const size_t MAX_GETUTXOS_OUTPOINTS = 15; //allow a max of 15 outpoints to be queried at once
+static const size_t MAX_GETUTXOS_OUTPOINTS = 10000; //allow a max of 10000 outpoints to be queried at once
+//! coin database lookups a getutxos thread takes at once, and the threads shared by all requests
+static const unsigned int GETUTXOS_LOOKUPS_PER_BATCH = 128;
+static const int GETUTXOS_LOOKUP_THREADS = 7;
+static const long MAX_REST_HEADERS_RESULTS = 20000;
+static const long MAX_REST_BLOCKHASHES_RESULTS = 100000;
 
 enum RetFormat {
     RF_UNDEF,
@@ -60,9 +70,9 @@ struct CCoin {
 };
 
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
-extern UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false);
+extern void blockToJSONStream(const CBlock& block, const CBlockIndex* blockindex, bool txDetails, CJSONStream& stream);
 extern UniValue mempoolInfoToJSON();
-extern UniValue mempoolToJSON(bool fVerbose = false);
+extern void mempoolToJSONStream(bool fVerbose, CJSONStream& stream);
 extern void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
 extern UniValue blockheaderToJSON(const CBlockIndex* blockindex);
 
@@ -73,6 +83,49 @@ static bool RESTERR(HTTPRequest* req, enum HTTPStatusCode status, string message
     return false;
 }
 
+/**
+ * Send the JSON document written by writeFn. Once it outgrows one chunk it is
+ * sent chunked while it is being written, a smaller one goes out as usual.
+ */
+static bool RESTStreamJSON(HTTPRequest* req, const boost::function<void(CJSONStream&)>& writeFn)
+{
+    bool fChunked = false;
+    CJSONStream stream(JSON_STREAM_CHUNK_SIZE, [&](const std::string& strChunk) {
+        if (!fChunked) {
+            req->WriteHeader("Content-Type", "application/json");
+            req->StartReplyChunked(HTTP_OK);
+            fChunked = true;
+        }
+        if (!req->WriteReplyChunk(strChunk))
+            throw jsonstream_aborted("client went away");
+    });
+
+    try {
+        writeFn(stream);
+        stream.Raw("\n");
+        if (fChunked)
+            stream.Flush();
+    } catch (const jsonstream_aborted& e) {
+        LogPrint("http", "%s: reply aborted, %s\n", __func__, e.what());
+        req->AbortReplyChunked();
+        return true;
+    } catch (...) {
+        if (!fChunked)
+            throw;
+        LogPrintf("%s: failed after part of the reply was sent\n", __func__);
+        req->AbortReplyChunked();
+        return true;
+    }
+
+    if (fChunked) {
+        req->EndReplyChunked();
+    } else {
+        req->WriteHeader("Content-Type", "application/json");
+        req->WriteReply(HTTP_OK, stream.GetBuffer());
+    }
+    return true;
+}
+
 static enum RetFormat ParseDataFormat(vector<string>& params, const string& strReq)
 {
     boost::split(params, strReq, boost::is_any_of("."));
@@ -118,6 +171,21 @@ static bool CheckWarmup(HTTPRequest* req)
     return true;
 }
 
+static void HeadersToJSONStream(const std::vector<const CBlockIndex*>& headers, CJSONStream& stream)
+{
+    stream.BeginArray();
+    BOOST_FOREACH(const CBlockIndex *pindex, headers) {
+        UniValue header;
+        {
+            // confirmations depend on the active chain
+            LOCK(cs_main);
+            header = blockheaderToJSON(pindex);
+        }
+        stream.Value(header);
+    }
+    stream.EndArray();
+}
+
 static bool rest_headers(HTTPRequest* req,
                          const std::string& strURIPart)
 {
@@ -132,7 +200,7 @@ static bool rest_headers(HTTPRequest* req,
         return RESTERR(req, HTTP_BAD_REQUEST, "No header count specified. Use /rest/headers/<count>/<hash>.<ext>.");
 
     long count = strtol(path[0].c_str(), NULL, 10);
-    if (count < 1 || count > 2000)
+    if (count < 1 || count > MAX_REST_HEADERS_RESULTS)
         return RESTERR(req, HTTP_BAD_REQUEST, "Header count out of range: " + path[0]);
 
     string hashStr = path[1];
@@ -174,17 +242,10 @@ static bool rest_headers(HTTPRequest* req,
         return true;
     }
     case RF_JSON: {
-        UniValue jsonHeaders(UniValue::VARR);
-        BOOST_FOREACH(const CBlockIndex *pindex, headers) {
-            jsonHeaders.push_back(blockheaderToJSON(pindex));
-        }
-        string strJSON = jsonHeaders.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return RESTStreamJSON(req, boost::bind(&HeadersToJSONStream, boost::cref(headers), _1));
     }
     default: {
-        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: .bin, .hex)");
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
     }
     }
 
@@ -206,7 +267,6 @@ static bool rest_block(HTTPRequest* req,
     if (!ParseHashStr(hashStr, hash))
         return RESTERR(req, HTTP_BAD_REQUEST, "Invalid hash: " + hashStr);
 
-    CBlock block;
     CBlockIndex* pblockindex = NULL;
     {
         LOCK(cs_main);
@@ -216,35 +276,35 @@ static bool rest_block(HTTPRequest* req,
         pblockindex = mapBlockIndex[hash];
         if (!(pblockindex->nStatus & BLOCK_HAVE_DATA) && pblockindex->nTx > 0)
             return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not available (pruned data)");
-
-        if (!ReadBlockFromDisk(block, pblockindex))
-            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
     }
 
-    CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
-    ssBlock << block;
-
+    // block files are append-only, so the block is read without holding cs_main
     switch (rf) {
     case RF_BINARY: {
-        string binaryBlock = ssBlock.str();
+        // the stored serialization is the network one, it is sent as is
+        std::vector<unsigned char> vchBlock;
+        if (!ReadRawBlockFromDisk(vchBlock, pblockindex))
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
         req->WriteHeader("Content-Type", "application/octet-stream");
-        req->WriteReply(HTTP_OK, binaryBlock);
+        req->WriteReply(HTTP_OK, string(vchBlock.begin(), vchBlock.end()));
         return true;
     }
 
     case RF_HEX: {
-        string strHex = HexStr(ssBlock.begin(), ssBlock.end()) + "\n";
+        std::vector<unsigned char> vchBlock;
+        if (!ReadRawBlockFromDisk(vchBlock, pblockindex))
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        string strHex = HexStr(vchBlock.begin(), vchBlock.end()) + "\n";
         req->WriteHeader("Content-Type", "text/plain");
         req->WriteReply(HTTP_OK, strHex);
         return true;
     }
 
     case RF_JSON: {
-        UniValue objBlock = blockToJSON(block, pblockindex, showTxDetails);
-        string strJSON = objBlock.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        CBlock block;
+        if (!ReadBlockFromDisk(block, pblockindex))
+            return RESTERR(req, HTTP_NOT_FOUND, hashStr + " not found");
+        return RESTStreamJSON(req, boost::bind(&blockToJSONStream, boost::cref(block), pblockindex, showTxDetails, _1));
     }
 
     default: {
@@ -266,6 +326,87 @@ static bool rest_block_notxdetails(HTTPRequest* req, const std::string& strURIPa
     return rest_block(req, strURIPart, false);
 }
 
+static void BlockHashesToJSONStream(const std::vector<uint256>& hashes, CJSONStream& stream)
+{
+    stream.BeginArray();
+    BOOST_FOREACH(const uint256& hash, hashes)
+        stream.Value(hash.GetHex());
+    stream.EndArray();
+}
+
+static bool rest_blockhash_by_height(HTTPRequest* req, const std::string& strURIPart)
+{
+    if (!CheckWarmup(req))
+        return false;
+    vector<string> params;
+    const RetFormat rf = ParseDataFormat(params, strURIPart);
+    vector<string> path;
+    boost::split(path, params[0], boost::is_any_of("/"));
+
+    if (path.size() < 1 || path.size() > 2)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Use /rest/blockhashbyheight/<height>.<ext> or /rest/blockhashbyheight/<height>/<count>.<ext>.");
+
+    int32_t nHeight;
+    if (!ParseInt32(path[0], &nHeight) || nHeight < 0)
+        return RESTERR(req, HTTP_BAD_REQUEST, "Invalid height: " + path[0]);
+
+    int32_t nCount = 1;
+    if (path.size() == 2 && (!ParseInt32(path[1], &nCount) || nCount < 1 || nCount > MAX_REST_BLOCKHASHES_RESULTS))
+        return RESTERR(req, HTTP_BAD_REQUEST, "Block hash count out of range: " + path[1]);
+
+    // the range is cut off at the tip
+    std::vector<uint256> hashes;
+    {
+        LOCK(cs_main);
+        if (nHeight > chainActive.Height())
+            return RESTERR(req, HTTP_NOT_FOUND, "Block height out of range");
+        int nEnd = std::min(chainActive.Height() + 1, nHeight + nCount);
+        hashes.reserve(nEnd - nHeight);
+        for (int i = nHeight; i < nEnd; i++)
+            hashes.push_back(chainActive[i]->GetBlockHash());
+    }
+
+    switch (rf) {
+    case RF_BINARY: {
+        string binaryHashes;
+        binaryHashes.reserve(hashes.size() * sizeof(uint256));
+        BOOST_FOREACH(const uint256& hash, hashes)
+            binaryHashes.append((const char*)hash.begin(), hash.size());
+        req->WriteHeader("Content-Type", "application/octet-stream");
+        req->WriteReply(HTTP_OK, binaryHashes);
+        return true;
+    }
+
+    case RF_HEX: {
+        string strHex;
+        strHex.reserve(hashes.size() * (2 * sizeof(uint256) + 1));
+        BOOST_FOREACH(const uint256& hash, hashes)
+            strHex += hash.GetHex() + "\n";
+        req->WriteHeader("Content-Type", "text/plain");
+        req->WriteReply(HTTP_OK, strHex);
+        return true;
+    }
+
+    case RF_JSON: {
+        if (path.size() == 1) {
+            UniValue obj(UniValue::VOBJ);
+            obj.push_back(Pair("blockhash", hashes[0].GetHex()));
+            req->WriteHeader("Content-Type", "application/json");
+            req->WriteReply(HTTP_OK, obj.write() + "\n");
+            return true;
+        }
+        return RESTStreamJSON(req, boost::bind(&BlockHashesToJSONStream, boost::cref(hashes), _1));
+    }
+
+    default: {
+        return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: " + AvailableDataFormatsString() + ")");
+    }
+    }
+
+    // not reached
+    return true; // continue to process further HTTP reqs on this cxn
+}
+
 static bool rest_chaininfo(HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -325,12 +466,7 @@ static bool rest_mempool_contents(HTTPRequest* req, const std::string& strURIPar
 
     switch (rf) {
     case RF_JSON: {
-        UniValue mempoolObject = mempoolToJSON(true);
-
-        string strJSON = mempoolObject.write() + "\n";
-        req->WriteHeader("Content-Type", "application/json");
-        req->WriteReply(HTTP_OK, strJSON);
-        return true;
+        return RESTStreamJSON(req, boost::bind(&mempoolToJSONStream, true, _1));
     }
     default: {
         return RESTERR(req, HTTP_NOT_FOUND, "output format not found (available: json)");
@@ -394,6 +530,71 @@ static bool rest_tx(HTTPRequest* req, const std::string& strURIPart)
     return true; // continue to process further HTTP reqs on this cxn
 }
 
+/** One coin database lookup of a getutxos request, done by the shared lookup threads */
+class CCoinsLookup
+{
+private:
+    const leveldb::Snapshot* psnapshot;
+    uint256 txid;
+    CCoins* pcoins;
+    char* pfFound;
+
+public:
+    CCoinsLookup() : psnapshot(NULL), pcoins(NULL), pfFound(NULL) {}
+    CCoinsLookup(const leveldb::Snapshot* psnapshotIn, const uint256& txidIn, CCoins* pcoinsIn, char* pfFoundIn) : psnapshot(psnapshotIn), txid(txidIn), pcoins(pcoinsIn), pfFound(pfFoundIn) {}
+
+    bool operator()()
+    {
+        *pfFound = pcoinsdbview->GetCoins(psnapshot, txid, *pcoins);
+        return true;
+    }
+
+    void swap(CCoinsLookup& lookup)
+    {
+        std::swap(psnapshot, lookup.psnapshot);
+        std::swap(txid, lookup.txid);
+        std::swap(pcoins, lookup.pcoins);
+        std::swap(pfFound, lookup.pfFound);
+    }
+};
+
+static CCheckQueue<CCoinsLookup> coinsLookupQueue(GETUTXOS_LOOKUPS_PER_BATCH);
+//! the queue serves one request at a time, the others wait for it without holding cs_main
+static boost::mutex csCoinsLookupQueue;
+static boost::thread_group threadGroupCoinsLookup;
+
+static void ThreadCoinsLookup()
+{
+    RenameThread("forextrading-restlookup");
+    coinsLookupQueue.Thread();
+}
+
+/**
+ * Look up txids that weren't in the pcoinsTip cache in psnapshot of the coin
+ * database, spread over the lookup threads. Must not hold cs_main.
+ */
+static void ReadCoinsParallel(const leveldb::Snapshot* psnapshot, const std::vector<uint256>& vTxid, std::map<uint256, CCoins>& mapCoins)
+{
+    std::vector<CCoins> vCoins(vTxid.size());
+    std::vector<char> vFound(vTxid.size(), 0);
+
+    std::vector<CCoinsLookup> vLookups;
+    vLookups.reserve(vTxid.size());
+    for (size_t i = 0; i < vTxid.size(); i++)
+        vLookups.push_back(CCoinsLookup(psnapshot, vTxid[i], &vCoins[i], &vFound[i]));
+    {
+        boost::unique_lock<boost::mutex> lock(csCoinsLookupQueue);
+        coinsLookupQueue.Add(vLookups);
+        // this thread works on the queue as well until it is empty
+        coinsLookupQueue.Wait();
+    }
+
+    for (size_t i = 0; i < vTxid.size(); i++) {
+        if (vFound[i])
+            mapCoins[vTxid[i]].swap(vCoins[i]);
+    }
+}
+
 static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 {
     if (!CheckWarmup(req))
@@ -493,22 +694,51 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
     vector<CCoin> outs;
     std::string bitmapStringRepresentation;
     boost::dynamic_bitset<unsigned char> hits(vOutPoints.size());
+    int nChainHeight;
+    uint256 hashChainTip;
     {
-        LOCK2(cs_main, mempool.cs);
-
-        CCoinsView viewDummy;
-        CCoinsViewCache view(&viewDummy);
-
-        CCoinsViewCache& viewChain = *pcoinsTip;
-        CCoinsViewMemPool viewMempool(&viewChain, mempool);
+        // mempool and cached entries are copied under the locks, every other txid is read from a snapshot of
+        // the coin database after releasing them
+        std::map<uint256, CCoins> mapCoins;
+        std::vector<uint256> vMissing;
+        const leveldb::Snapshot* psnapshot;
+        {
+            LOCK2(cs_main, mempool.cs);
+            nChainHeight = chainActive.Height();
+            hashChainTip = chainActive.Tip()->GetBlockHash();
+
+            std::set<uint256> setSeen;
+            for (size_t i = 0; i < vOutPoints.size(); i++) {
+                const uint256& hash = vOutPoints[i].hash;
+                if (!setSeen.insert(hash).second)
+                    continue;
+                CTransaction tx;
+                if (fCheckMemPool && mempool.lookup(hash, tx))
+                    mapCoins[hash] = CCoins(tx, MEMPOOL_HEIGHT);
+                else if (pcoinsTip->HaveCoinsInCache(hash))
+                    pcoinsTip->GetCoins(hash, mapCoins[hash]);
+                else
+                    vMissing.push_back(hash);
+            }
+            // whatever isn't in the cache is as the database has it now
+            psnapshot = pcoinsdbview->GetSnapshot();
+        }
 
-        if (fCheckMemPool)
-            view.SetBackend(viewMempool); // switch cache backend to db+mempool in case user likes to query mempool
+        try {
+            ReadCoinsParallel(psnapshot, vMissing, mapCoins);
+        } catch (...) {
+            pcoinsdbview->ReleaseSnapshot(psnapshot);
+            throw;
+        }
+        pcoinsdbview->ReleaseSnapshot(psnapshot);
 
+        // outputs spent by the mempool since count as spent, as they would have then
+        LOCK(mempool.cs);
         for (size_t i = 0; i < vOutPoints.size(); i++) {
-            CCoins coins;
             uint256 hash = vOutPoints[i].hash;
-            if (view.GetCoins(hash, coins)) {
+            std::map<uint256, CCoins>::const_iterator it = mapCoins.find(hash);
+            if (it != mapCoins.end()) {
+                CCoins coins = it->second;
                 mempool.pruneSpent(hash, coins);
                 if (coins.IsAvailable(vOutPoints[i].n)) {
                     hits[i] = true;
@@ -533,7 +763,7 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
         // serialize data
         // use exact same output as mentioned in Bip64
         CDataStream ssGetUTXOResponse(SER_NETWORK, PROTOCOL_VERSION);
-        ssGetUTXOResponse << chainActive.Height() << chainActive.Tip()->GetBlockHash() << bitmap << outs;
+        ssGetUTXOResponse << nChainHeight << hashChainTip << bitmap << outs;
         string ssGetUTXOResponseString = ssGetUTXOResponse.str();
 
         req->WriteHeader("Content-Type", "application/octet-stream");
@@ -543,7 +773,7 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 
     case RF_HEX: {
         CDataStream ssGetUTXOResponse(SER_NETWORK, PROTOCOL_VERSION);
-        ssGetUTXOResponse << chainActive.Height() << chainActive.Tip()->GetBlockHash() << bitmap << outs;
+        ssGetUTXOResponse << nChainHeight << hashChainTip << bitmap << outs;
         string strHex = HexStr(ssGetUTXOResponse.begin(), ssGetUTXOResponse.end()) + "\n";
 
         req->WriteHeader("Content-Type", "text/plain");
@@ -556,8 +786,8 @@ static bool rest_getutxos(HTTPRequest* req, const std::string& strURIPart)
 
         // pack in some essentials
         // use more or less the same output as mentioned in Bip64
-        objGetUTXOResponse.push_back(Pair("chainHeight", chainActive.Height()));
-        objGetUTXOResponse.push_back(Pair("chaintipHash", chainActive.Tip()->GetBlockHash().GetHex()));
+        objGetUTXOResponse.push_back(Pair("chainHeight", nChainHeight));
+        objGetUTXOResponse.push_back(Pair("chaintipHash", hashChainTip.GetHex()));
         objGetUTXOResponse.push_back(Pair("bitmap", bitmapStringRepresentation));
 
         UniValue utxos(UniValue::VARR);
@@ -601,11 +831,14 @@ static const struct {
       {"/rest/mempool/info", rest_mempool_info},
       {"/rest/mempool/contents", rest_mempool_contents},
       {"/rest/headers/", rest_headers},
+      {"/rest/blockhashbyheight/", rest_blockhash_by_height},
       {"/rest/getutxos", rest_getutxos},
 };
 
 bool StartREST()
 {
+    for (int i = 0; i < GETUTXOS_LOOKUP_THREADS; i++)
+        threadGroupCoinsLookup.create_thread(&ThreadCoinsLookup);
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
         RegisterHTTPHandler(uri_prefixes[i].prefix, false, uri_prefixes[i].handler);
     return true;
@@ -619,4 +852,6 @@ void StopREST()
 {
     for (unsigned int i = 0; i < ARRAYLEN(uri_prefixes); i++)
         UnregisterHTTPHandler(uri_prefixes[i].prefix, false);
+    threadGroupCoinsLookup.interrupt_all();
+    threadGroupCoinsLookup.join_all();
 }
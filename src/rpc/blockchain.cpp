@@ -7,22 +7,31 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "base58.h"
+#include "chaintip.h"
 #include "checkpoints.h"
 #include "clientversion.h"
+#include "coinstats.h"
+#include "jsonstream.h"
 #include "main.h"
 #include "rpc/server.h"
 #include "sync.h"
 #include "txdb.h"
 #include "util.h"
 #include "utilmoneystr.h"
+#include "utxosnapshot.h"
 #include "accumulatormap.h"
 #include "accumulators.h"
 
 #include <stdint.h>
 #include <univalue.h>
 
+#include <boost/filesystem.hpp>
+
 using namespace std;
 
+/** Mempool entries built per lock of mempoolToJSONStream */
+static const size_t MEMPOOL_STREAM_BATCH_SIZE = 100;
+
 extern void TxToJSON(const CTransaction& tx, const uint256 hashBlock, UniValue& entry);
 void ScriptPubKeyToJSON(const CScript& scriptPubKey, UniValue& out, bool fIncludeHex);
 
@@ -81,48 +90,82 @@ UniValue blockheaderToJSON(const CBlockIndex* blockindex)
     return result;
 }
 
-UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+/** The fields of a block before and after its "tx" array, so the transactions can be streamed in between */
+static void blockToJSONParts(const CBlock& block, const CBlockIndex* blockindex, UniValue& before, UniValue& after)
 {
-    UniValue result(UniValue::VOBJ);
-    result.push_back(Pair("hash", block.GetHash().GetHex()));
+    before.setObject();
+    before.push_back(Pair("hash", block.GetHash().GetHex()));
     int confirmations = -1;
     // Only report confirmations if the block is on the main chain
     if (chainActive.Contains(blockindex))
         confirmations = chainActive.Height() - blockindex->nHeight + 1;
-    result.push_back(Pair("confirmations", confirmations));
-    result.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
-    result.push_back(Pair("height", blockindex->nHeight));
-    result.push_back(Pair("version", block.nVersion));
-    result.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
-    result.push_back(Pair("acc_checkpoint", block.nAccumulatorCheckpoint.GetHex()));
-    UniValue txs(UniValue::VARR);
-    BOOST_FOREACH (const CTransaction& tx, block.vtx) {
-        if (txDetails) {
-            UniValue objTx(UniValue::VOBJ);
-            TxToJSON(tx, uint256(0), objTx);
-            txs.push_back(objTx);
-        } else
-            txs.push_back(tx.GetHash().GetHex());
-    }
-    result.push_back(Pair("tx", txs));
-    result.push_back(Pair("time", block.GetBlockTime()));
-    result.push_back(Pair("nonce", (uint64_t)block.nNonce));
-    result.push_back(Pair("bits", strprintf("%08x", block.nBits)));
-    result.push_back(Pair("difficulty", GetDifficulty(blockindex)));
-    result.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
+    before.push_back(Pair("confirmations", confirmations));
+    before.push_back(Pair("size", (int)::GetSerializeSize(block, SER_NETWORK, PROTOCOL_VERSION)));
+    before.push_back(Pair("height", blockindex->nHeight));
+    before.push_back(Pair("version", block.nVersion));
+    before.push_back(Pair("merkleroot", block.hashMerkleRoot.GetHex()));
+    before.push_back(Pair("acc_checkpoint", block.nAccumulatorCheckpoint.GetHex()));
+
+    after.setObject();
+    after.push_back(Pair("time", block.GetBlockTime()));
+    after.push_back(Pair("nonce", (uint64_t)block.nNonce));
+    after.push_back(Pair("bits", strprintf("%08x", block.nBits)));
+    after.push_back(Pair("difficulty", GetDifficulty(blockindex)));
+    after.push_back(Pair("chainwork", blockindex->nChainWork.GetHex()));
 
     if (blockindex->pprev)
-        result.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
+        after.push_back(Pair("previousblockhash", blockindex->pprev->GetBlockHash().GetHex()));
     CBlockIndex* pnext = chainActive.Next(blockindex);
     if (pnext)
-        result.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
+        after.push_back(Pair("nextblockhash", pnext->GetBlockHash().GetHex()));
 
-    result.push_back(Pair("moneysupply",ValueFromAmount(blockindex->nMoneySupply)));
+    after.push_back(Pair("moneysupply",ValueFromAmount(blockindex->nMoneySupply)));
+}
+
+static UniValue blockTxToJSON(const CTransaction& tx, bool txDetails)
+{
+    if (!txDetails)
+        return tx.GetHash().GetHex();
+    UniValue objTx(UniValue::VOBJ);
+    TxToJSON(tx, uint256(0), objTx);
+    return objTx;
+}
 
+UniValue blockToJSON(const CBlock& block, const CBlockIndex* blockindex, bool txDetails = false)
+{
+    UniValue before, after;
+    blockToJSONParts(block, blockindex, before, after);
 
+    UniValue result = before;
+    UniValue txs(UniValue::VARR);
+    BOOST_FOREACH (const CTransaction& tx, block.vtx)
+        txs.push_back(blockTxToJSON(tx, txDetails));
+    result.push_back(Pair("tx", txs));
+    result.pushKVs(after);
     return result;
 }
 
+/**
+ * Same document as blockToJSON, one transaction at a time.
+ * Takes cs_main only to look up the chain, callers must not hold it:
+ * writing may wait for a slow client.
+ */
+void blockToJSONStream(const CBlock& block, const CBlockIndex* blockindex, bool txDetails, CJSONStream& stream)
+{
+    UniValue before, after;
+    {
+        LOCK(cs_main);
+        blockToJSONParts(block, blockindex, before, after);
+    }
+
+    stream.BeginObject().Pairs(before);
+    stream.Key("tx").BeginArray();
+    BOOST_FOREACH (const CTransaction& tx, block.vtx)
+        stream.Value(blockTxToJSON(tx, txDetails));
+    stream.EndArray();
+    stream.Pairs(after).EndObject();
+}
+
 UniValue getblockcount(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 0)
@@ -136,8 +179,7 @@ UniValue getblockcount(const UniValue& params, bool fHelp)
             "\nExamples:\n" +
             HelpExampleCli("getblockcount", "") + HelpExampleRpc("getblockcount", ""));
 
-    LOCK(cs_main);
-    return chainActive.Height();
+    return GetChainTipSnapshot()->nHeight;
 }
 
 UniValue getbestblockhash(const UniValue& params, bool fHelp)
@@ -153,8 +195,7 @@ UniValue getbestblockhash(const UniValue& params, bool fHelp)
             "\nExamples\n" +
             HelpExampleCli("getbestblockhash", "") + HelpExampleRpc("getbestblockhash", ""));
 
-    LOCK(cs_main);
-    return chainActive.Tip()->GetBlockHash().GetHex();
+    return GetChainTipSnapshot()->hashTip.GetHex();
 }
 
 UniValue getdifficulty(const UniValue& params, bool fHelp)
@@ -170,41 +211,44 @@ UniValue getdifficulty(const UniValue& params, bool fHelp)
             "\nExamples:\n" +
             HelpExampleCli("getdifficulty", "") + HelpExampleRpc("getdifficulty", ""));
 
-    LOCK(cs_main);
-    return GetDifficulty();
+    CChainTipSnapshotRef tip = GetChainTipSnapshot();
+    return tip->pindexTip ? GetDifficulty(tip->pindexTip) : 1.0;
 }
 
 
+/** Requires mempool.cs and cs_main */
+static UniValue mempoolEntryToJSON(const CTxMemPoolEntry& e)
+{
+    UniValue info(UniValue::VOBJ);
+    info.push_back(Pair("size", (int)e.GetTxSize()));
+    info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
+    info.push_back(Pair("time", e.GetTime()));
+    info.push_back(Pair("height", (int)e.GetHeight()));
+    info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
+    info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
+    const CTransaction& tx = e.GetTx();
+    set<string> setDepends;
+    BOOST_FOREACH (const CTxIn& txin, tx.vin) {
+        if (mempool.exists(txin.prevout.hash))
+            setDepends.insert(txin.prevout.hash.ToString());
+    }
+
+    UniValue depends(UniValue::VARR);
+    BOOST_FOREACH(const string& dep, setDepends) {
+        depends.push_back(dep);
+    }
+
+    info.push_back(Pair("depends", depends));
+    return info;
+}
+
 UniValue mempoolToJSON(bool fVerbose = false)
 {
     if (fVerbose) {
         LOCK(mempool.cs);
         UniValue o(UniValue::VOBJ);
-        BOOST_FOREACH (const PAIRTYPE(uint256, CTxMemPoolEntry) & entry, mempool.mapTx) {
-            const uint256& hash = entry.first;
-            const CTxMemPoolEntry& e = entry.second;
-            UniValue info(UniValue::VOBJ);
-            info.push_back(Pair("size", (int)e.GetTxSize()));
-            info.push_back(Pair("fee", ValueFromAmount(e.GetFee())));
-            info.push_back(Pair("time", e.GetTime()));
-            info.push_back(Pair("height", (int)e.GetHeight()));
-            info.push_back(Pair("startingpriority", e.GetPriority(e.GetHeight())));
-            info.push_back(Pair("currentpriority", e.GetPriority(chainActive.Height())));
-            const CTransaction& tx = e.GetTx();
-            set<string> setDepends;
-            BOOST_FOREACH (const CTxIn& txin, tx.vin) {
-                if (mempool.exists(txin.prevout.hash))
-                    setDepends.insert(txin.prevout.hash.ToString());
-            }
-
-            UniValue depends(UniValue::VARR);
-            BOOST_FOREACH(const string& dep, setDepends) {
-                depends.push_back(dep);
-            }
-
-            info.push_back(Pair("depends", depends));
-            o.push_back(Pair(hash.ToString(), info));
-        }
+        BOOST_FOREACH (const PAIRTYPE(uint256, CTxMemPoolEntry) & entry, mempool.mapTx)
+            o.push_back(Pair(entry.first.ToString(), mempoolEntryToJSON(entry.second)));
         return o;
     } else {
         vector<uint256> vtxid;
@@ -218,6 +262,41 @@ UniValue mempoolToJSON(bool fVerbose = false)
     }
 }
 
+/**
+ * Same document as mempoolToJSON. The verbose entries are built a batch at a
+ * time under the locks and written after releasing them, so a slow client
+ * doesn't hold up the node; transactions that left the pool in between are
+ * skipped. Callers must not hold cs_main or mempool.cs.
+ */
+void mempoolToJSONStream(bool fVerbose, CJSONStream& stream)
+{
+    vector<uint256> vtxid;
+    mempool.queryHashes(vtxid);
+
+    if (!fVerbose) {
+        stream.BeginArray();
+        BOOST_FOREACH (const uint256& hash, vtxid)
+            stream.Value(hash.ToString());
+        stream.EndArray();
+        return;
+    }
+
+    stream.BeginObject();
+    for (size_t i = 0; i < vtxid.size(); i += MEMPOOL_STREAM_BATCH_SIZE) {
+        UniValue batch(UniValue::VOBJ);
+        {
+            LOCK2(cs_main, mempool.cs);
+            for (size_t j = i; j < std::min(vtxid.size(), i + MEMPOOL_STREAM_BATCH_SIZE); j++) {
+                std::map<uint256, CTxMemPoolEntry>::const_iterator it = mempool.mapTx.find(vtxid[j]);
+                if (it != mempool.mapTx.end())
+                    batch.push_back(Pair(it->first.ToString(), mempoolEntryToJSON(it->second)));
+            }
+        }
+        stream.Pairs(batch);
+    }
+    stream.EndObject();
+}
+
 UniValue getrawmempool(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() > 1)
@@ -261,6 +340,19 @@ UniValue getrawmempool(const UniValue& params, bool fHelp)
     return mempoolToJSON(fVerbose);
 }
 
+void getrawmempool_stream(const UniValue& params, CJSONStream& stream)
+{
+    // wrong arguments, the actor throws its help text
+    if (params.size() > 1)
+        getrawmempool(params, true);
+
+    bool fVerbose = false;
+    if (params.size() > 0)
+        fVerbose = params[0].get_bool();
+
+    mempoolToJSONStream(fVerbose, stream);
+}
+
 UniValue getblockhash(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() != 1)
@@ -356,6 +448,41 @@ UniValue getblock(const UniValue& params, bool fHelp)
     return blockToJSON(block, pblockindex);
 }
 
+void getblock_stream(const UniValue& params, CJSONStream& stream)
+{
+    // wrong arguments, the actor throws its help text
+    if (params.size() < 1 || params.size() > 2)
+        getblock(params, true);
+
+    std::string strHash = params[0].get_str();
+    uint256 hash(strHash);
+
+    bool fVerbose = true;
+    if (params.size() > 1)
+        fVerbose = params[1].get_bool();
+
+    CBlock block;
+    CBlockIndex* pblockindex;
+    {
+        LOCK(cs_main);
+        if (mapBlockIndex.count(hash) == 0)
+            throw JSONRPCError(RPC_INVALID_ADDRESS_OR_KEY, "Block not found");
+
+        pblockindex = mapBlockIndex[hash];
+        if (!ReadBlockFromDisk(block, pblockindex))
+            throw JSONRPCError(RPC_INTERNAL_ERROR, "Can't read block from disk");
+    }
+
+    if (!fVerbose) {
+        CDataStream ssBlock(SER_NETWORK, PROTOCOL_VERSION);
+        ssBlock << block;
+        stream.Value(HexStr(ssBlock.begin(), ssBlock.end()));
+        return;
+    }
+
+    blockToJSONStream(block, pblockindex, false, stream);
+}
+
 UniValue getblockheader(const UniValue& params, bool fHelp)
 {
     if (fHelp || params.size() < 1 || params.size() > 2)
@@ -407,13 +534,34 @@ UniValue getblockheader(const UniValue& params, bool fHelp)
     return blockheaderToJSON(pblockindex);
 }
 
+static UniValue CoinsStatsToJSON(const CCoinsStats& stats, CoinStatsHashType hashType)
+{
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("height", (int64_t)stats.nHeight));
+    ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
+    ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
+    ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
+    ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
+    if (hashType == COINSTATS_HASH_SERIALIZED)
+        ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
+    else if (hashType == COINSTATS_HASH_MUHASH)
+        ret.push_back(Pair("muhash", stats.hashSerialized.GetHex()));
+    ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+    return ret;
+}
+
 UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
 {
-    if (fHelp || params.size() != 0)
+    if (fHelp || params.size() > 1)
         throw runtime_error(
-            "gettxoutsetinfo\n"
+            "gettxoutsetinfo ( \"hash_type\" )\n"
             "\nReturns statistics about the unspent transaction output set.\n"
-            "Note this call may take some time.\n"
+            "The set is scanned from a database snapshot without holding up block processing, and only\n"
+            "the first call has to scan it when hash_type is \"none\": the totals are kept up to date block by block.\n"
+
+            "\nArguments:\n"
+            "1. \"hash_type\"   (string, optional, default=\"hash_serialized\") Which set hash to compute:\n"
+            "                   \"hash_serialized\" (single threaded), \"muhash\" (order independent, multi threaded) or \"none\"\n"
 
             "\nResult:\n"
             "{\n"
@@ -422,28 +570,130 @@ UniValue gettxoutsetinfo(const UniValue& params, bool fHelp)
             "  \"transactions\": n,      (numeric) The number of transactions\n"
             "  \"txouts\": n,            (numeric) The number of output transactions\n"
             "  \"bytes_serialized\": n,  (numeric) The serialized size\n"
-            "  \"hash_serialized\": \"hash\",   (string) The serialized hash\n"
+            "  \"hash_serialized\": \"hash\",   (string) The serialized hash (only with hash_type \"hash_serialized\")\n"
+            "  \"muhash\": \"hash\",            (string) The order independent set hash (only with hash_type \"muhash\")\n"
             "  \"total_amount\": x.xxx          (numeric) The total amount\n"
             "}\n"
 
             "\nExamples:\n" +
-            HelpExampleCli("gettxoutsetinfo", "") + HelpExampleRpc("gettxoutsetinfo", ""));
+            HelpExampleCli("gettxoutsetinfo", "") + HelpExampleCli("gettxoutsetinfo", "\"none\"") + HelpExampleRpc("gettxoutsetinfo", "\"muhash\""));
+
+    CoinStatsHashType hashType = COINSTATS_HASH_SERIALIZED;
+    if (params.size() > 0) {
+        std::string strHashType = params[0].get_str();
+        if (strHashType == "none")
+            hashType = COINSTATS_HASH_NONE;
+        else if (strHashType == "muhash")
+            hashType = COINSTATS_HASH_MUHASH;
+        else if (strHashType != "hash_serialized")
+            throw JSONRPCError(RPC_INVALID_PARAMETER, "Unknown hash_type " + strHashType);
+    }
 
-    LOCK(cs_main);
+    CCoinsStats stats;
+    const leveldb::Snapshot* psnapshot;
+    {
+        LOCK(cs_main);
+        if (hashType == COINSTATS_HASH_NONE && coinsStatsTracker.GetTotals(stats))
+            return CoinsStatsToJSON(stats, hashType);
 
-    UniValue ret(UniValue::VOBJ);
+        coinsStatsTracker.Enable();
+        FlushStateToDisk();
+        psnapshot = pcoinsdbview->GetSnapshot();
+        stats.nHeight = chainActive.Height();
+    }
 
-    CCoinsStats stats;
-    FlushStateToDisk();
-    if (pcoinsTip->GetStats(stats)) {
-        ret.push_back(Pair("height", (int64_t)stats.nHeight));
-        ret.push_back(Pair("bestblock", stats.hashBlock.GetHex()));
-        ret.push_back(Pair("transactions", (int64_t)stats.nTransactions));
-        ret.push_back(Pair("txouts", (int64_t)stats.nTransactionOutputs));
-        ret.push_back(Pair("bytes_serialized", (int64_t)stats.nSerializedSize));
-        ret.push_back(Pair("hash_serialized", stats.hashSerialized.GetHex()));
-        ret.push_back(Pair("total_amount", ValueFromAmount(stats.nTotalAmount)));
+    bool fOk;
+    try {
+        fOk = GetUTXOStats(pcoinsdbview, psnapshot, stats, hashType, GetUTXOStatsThreads());
+    } catch (...) {
+        pcoinsdbview->ReleaseSnapshot(psnapshot);
+        throw;
     }
+    pcoinsdbview->ReleaseSnapshot(psnapshot);
+    if (!fOk)
+        throw JSONRPCError(RPC_DATABASE_ERROR, "Unable to read UTXO set");
+
+    {
+        LOCK(cs_main);
+        coinsStatsTracker.SetBaseline(stats);
+    }
+    return CoinsStatsToJSON(stats, hashType);
+}
+
+UniValue dumptxoutset(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 1)
+        throw runtime_error(
+            "dumptxoutset \"path\"\n"
+            "\nWrite a snapshot of the chain state at the current tip to a binary file.\n"
+            "The snapshot holds the block index of the active chain, the unspent transaction outputs and the\n"
+            "zerocoin mints, spends and accumulator values. A new node can start from it with -loadsnapshot.\n"
+            "The state is read from database snapshots, so blocks keep being processed while it is written.\n"
+
+            "\nArguments:\n"
+            "1. \"path\"   (string, required) destination file, relative paths are taken relative to the data directory\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"path\": \"path\",             (string) the absolute path the snapshot was written to\n"
+            "  \"height\": n,                (numeric) the height of the block the snapshot belongs to\n"
+            "  \"bestblock\": \"hex\",        (string) the hash of that block\n"
+            "  \"blocks\": n,                (numeric) the number of block index entries written\n"
+            "  \"transactions\": n,          (numeric) the number of transactions with unspent outputs written\n"
+            "  \"mints\": n,                 (numeric) the number of zerocoin mints written\n"
+            "  \"spends\": n,                (numeric) the number of zerocoin spends written\n"
+            "  \"accumulator_values\": n,    (numeric) the number of accumulator checkpoint values written\n"
+            "  \"muhash\": \"hex\",           (string) the muhash of the unspent outputs, as in gettxoutsetinfo \"muhash\"\n"
+            "  \"snapshot_hash\": \"hex\"     (string) the hash -loadsnapshot checks the file against\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("dumptxoutset", "\"utxo.dat\"") + HelpExampleRpc("dumptxoutset", "\"utxo.dat\""));
+
+    boost::filesystem::path path(params[0].get_str());
+    if (!path.is_complete())
+        path = GetDataDir() / path;
+    if (boost::filesystem::exists(path))
+        throw JSONRPCError(RPC_INVALID_PARAMETER, path.string() + " already exists");
+
+    std::vector<CBlockIndex*> vChain;
+    const leveldb::Snapshot* pcoinssnapshot;
+    const leveldb::Snapshot* pzerocoinsnapshot;
+    {
+        LOCK(cs_main);
+        FlushStateToDisk();
+        pcoinssnapshot = pcoinsdbview->GetSnapshot();
+        pzerocoinsnapshot = zerocoinDB->GetSnapshot();
+        vChain.reserve(chainActive.Height() + 1);
+        for (int i = 0; i <= chainActive.Height(); i++)
+            vChain.push_back(chainActive[i]);
+    }
+
+    CUTXOSnapshotInfo info;
+    bool fOk;
+    try {
+        fOk = WriteUTXOSnapshot(path, vChain, pcoinsdbview, pcoinssnapshot, zerocoinDB, pzerocoinsnapshot, info);
+    } catch (...) {
+        pcoinsdbview->ReleaseSnapshot(pcoinssnapshot);
+        zerocoinDB->ReleaseSnapshot(pzerocoinsnapshot);
+        throw;
+    }
+    pcoinsdbview->ReleaseSnapshot(pcoinssnapshot);
+    zerocoinDB->ReleaseSnapshot(pzerocoinsnapshot);
+    if (!fOk)
+        throw JSONRPCError(RPC_MISC_ERROR, "Unable to write " + path.string());
+
+    UniValue ret(UniValue::VOBJ);
+    ret.push_back(Pair("path", path.string()));
+    ret.push_back(Pair("height", info.nHeight));
+    ret.push_back(Pair("bestblock", info.hashBlock.GetHex()));
+    ret.push_back(Pair("blocks", (int64_t)info.nBlocks));
+    ret.push_back(Pair("transactions", (int64_t)info.nCoins));
+    ret.push_back(Pair("mints", (int64_t)info.nMints));
+    ret.push_back(Pair("spends", (int64_t)info.nSpends));
+    ret.push_back(Pair("accumulator_values", (int64_t)info.nAccumulatorValues));
+    ret.push_back(Pair("muhash", info.hashCoins.GetHex()));
+    ret.push_back(Pair("snapshot_hash", info.hashSnapshot.GetHex()));
     return ret;
 }
 
@@ -579,16 +829,16 @@ UniValue getblockchaininfo(const UniValue& params, bool fHelp)
             "\nExamples:\n" +
             HelpExampleCli("getblockchaininfo", "") + HelpExampleRpc("getblockchaininfo", ""));
 
-    LOCK(cs_main);
+    CChainTipSnapshotRef tip = GetChainTipSnapshot();
 
     UniValue obj(UniValue::VOBJ);
     obj.push_back(Pair("chain", Params().NetworkIDString()));
-    obj.push_back(Pair("blocks", (int)chainActive.Height()));
-    obj.push_back(Pair("headers", pindexBestHeader ? pindexBestHeader->nHeight : -1));
-    obj.push_back(Pair("bestblockhash", chainActive.Tip()->GetBlockHash().GetHex()));
-    obj.push_back(Pair("difficulty", (double)GetDifficulty()));
-    obj.push_back(Pair("verificationprogress", Checkpoints::GuessVerificationProgress(chainActive.Tip())));
-    obj.push_back(Pair("chainwork", chainActive.Tip()->nChainWork.GetHex()));
+    obj.push_back(Pair("blocks", tip->nHeight));
+    obj.push_back(Pair("headers", tip->nHeaderHeight));
+    obj.push_back(Pair("bestblockhash", tip->hashTip.GetHex()));
+    obj.push_back(Pair("difficulty", tip->pindexTip ? GetDifficulty(tip->pindexTip) : 1.0));
+    obj.push_back(Pair("verificationprogress", Checkpoints::GuessVerificationProgress(tip->pindexTip)));
+    obj.push_back(Pair("chainwork", tip->pindexTip ? tip->pindexTip->nChainWork.GetHex() : uint256().GetHex()));
     return obj;
 }
 
@@ -781,9 +1031,10 @@ UniValue getfeeinfo(const UniValue& params, bool fHelp)
 
 UniValue mempoolInfoToJSON()
 {
+    CChainTipSnapshotRef tip = GetChainTipSnapshot();
     UniValue ret(UniValue::VOBJ);
-    ret.push_back(Pair("size", (int64_t) mempool.size()));
-    ret.push_back(Pair("bytes", (int64_t) mempool.GetTotalTxSize()));
+    ret.push_back(Pair("size", (int64_t) tip->nMempoolTx));
+    ret.push_back(Pair("bytes", (int64_t) tip->nMempoolBytes));
     //ret.push_back(Pair("usage", (int64_t) mempool.DynamicMemoryUsage()));
 
     return ret;
@@ -9,7 +9,9 @@
 #include "rpc/server.h"
 
 #include "base58.h"
+#include "httpserver.h"
 #include "init.h"
+#include "jsonstream.h"
 #include "main.h"
 #include "random.h"
 #include "sync.h"
@@ -27,6 +29,9 @@
 #include <boost/thread.hpp>
 #include <boost/algorithm/string/case_conv.hpp> // for to_upper()
 
+#include <deque>
+#include <set>
+
 #include <univalue.h>
 
 using namespace RPCServer;
@@ -43,6 +48,135 @@ static std::vector<RPCTimerInterface*> timerInterfaces;
  * @note Can be changed to std::unique_ptr when C++11 */
 static std::map<std::string, boost::shared_ptr<RPCTimerBase> > deadlineTimers;
 
+/** Upper bounds of the getrpcinfo latency buckets in microseconds, the last bucket has none */
+static const int64_t RPC_LATENCY_BUCKETS[] = {1000, 10000, 100000, 1000000, 10000000};
+static const char* RPC_LATENCY_BUCKET_NAMES[] = {"1ms", "10ms", "100ms", "1s", "10s", "inf"};
+static const unsigned int RPC_LATENCY_BUCKET_COUNT = sizeof(RPC_LATENCY_BUCKET_NAMES) / sizeof(RPC_LATENCY_BUCKET_NAMES[0]);
+
+struct CRPCMethodStats {
+    uint64_t nCalls;
+    int64_t nTotalMicros;
+    int64_t nMaxMicros;
+    //! time spent blocked on contended locks, part of nTotalMicros
+    int64_t nLockWaitMicros;
+    uint64_t vBuckets[RPC_LATENCY_BUCKET_COUNT];
+
+    CRPCMethodStats() : nCalls(0), nTotalMicros(0), nMaxMicros(0), nLockWaitMicros(0)
+    {
+        std::fill(vBuckets, vBuckets + RPC_LATENCY_BUCKET_COUNT, 0);
+    }
+};
+
+static CCriticalSection cs_rpcStats;
+static std::map<std::string, CRPCMethodStats> mapRPCStats;
+
+/** Records the duration and lock waits of one call when it goes out of scope */
+class CRPCCallTimer
+{
+private:
+    std::string strMethod;
+    int64_t nStart;
+    CLockWaitTimer lockWait;
+
+public:
+    explicit CRPCCallTimer(const std::string& strMethodIn) : strMethod(strMethodIn), nStart(GetTimeMicros()) {}
+
+    ~CRPCCallTimer()
+    {
+        int64_t nMicros = GetTimeMicros() - nStart;
+        unsigned int nBucket = 0;
+        while (nBucket < RPC_LATENCY_BUCKET_COUNT - 1 && nMicros >= RPC_LATENCY_BUCKETS[nBucket])
+            nBucket++;
+
+        LOCK(cs_rpcStats);
+        CRPCMethodStats& stats = mapRPCStats[strMethod];
+        stats.nCalls++;
+        stats.nTotalMicros += nMicros;
+        stats.nMaxMicros = std::max(stats.nMaxMicros, nMicros);
+        stats.nLockWaitMicros += lockWait.GetWaitMicros();
+        stats.vBuckets[nBucket]++;
+    }
+};
+
+/** Read-only lookups that may run concurrently within one batch */
+static const char* const vParallelBatchRPC[] = {
+    "decoderawtransaction", "decodescript", "getbestblockhash", "getblock", "getblockchaininfo",
+    "getblockcount", "getblockhash", "getblockheader", "getdifficulty", "getmempoolinfo",
+    "getrawmempool", "getrawtransaction", "gettxout", "validateaddress", "verifymessage"};
+static const std::set<std::string> setParallelBatchRPC(vParallelBatchRPC, vParallelBatchRPC + sizeof(vParallelBatchRPC) / sizeof(vParallelBatchRPC[0]));
+
+static UniValue JSONRPCExecOne(const UniValue& req);
+
+/** The calls of one batch, worked off by the caller and any idle batch threads */
+class CRPCBatch
+{
+private:
+    const UniValue vReq;
+    std::vector<UniValue> vReply;
+    boost::mutex mutex;
+    boost::condition_variable condDone;
+    size_t nNext;
+    size_t nDone;
+
+public:
+    explicit CRPCBatch(const UniValue& vReqIn) : vReq(vReqIn), vReply(vReqIn.size()), nNext(0), nDone(0) {}
+
+    /** Execute calls until none is left to start */
+    void Drain()
+    {
+        while (true) {
+            size_t i;
+            {
+                boost::unique_lock<boost::mutex> lock(mutex);
+                if (nNext == vReq.size())
+                    return;
+                i = nNext++;
+            }
+
+            UniValue reply = JSONRPCExecOne(vReq[i]);
+
+            boost::unique_lock<boost::mutex> lock(mutex);
+            vReply[i] = reply;
+            if (++nDone == vReq.size())
+                condDone.notify_all();
+        }
+    }
+
+    /** Wait for the calls other threads started, then return the replies in request order */
+    const std::vector<UniValue>& Wait()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        while (nDone < vReq.size())
+            condDone.wait(lock);
+        return vReply;
+    }
+};
+
+static boost::mutex csBatchQueue;
+static boost::condition_variable condBatchQueue;
+static std::deque<boost::shared_ptr<CRPCBatch> > queueBatch;
+static boost::thread_group* batchThreadGroup = NULL;
+static int nBatchThreads = 0;
+
+static void ThreadRPCBatch()
+{
+    RenameThread("forextrading-rpcbatch");
+    while (true) {
+        boost::shared_ptr<CRPCBatch> batch;
+        {
+            boost::unique_lock<boost::mutex> lock(csBatchQueue);
+            while (queueBatch.empty())
+                condBatchQueue.wait(lock);
+            batch = queueBatch.front();
+            queueBatch.pop_front();
+        }
+
+        // a call that was started is always finished, its batch waits for it
+        boost::this_thread::disable_interruption di;
+        batch->Drain();
+    }
+}
+
 static struct CRPCSignals
 {
     boost::signals2::signal<void ()> Started;
@@ -272,6 +406,71 @@ UniValue stop(const UniValue& params, bool fHelp)
 }
 
 
+UniValue getrpcinfo(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() > 1)
+        throw runtime_error(
+            "getrpcinfo ( \"method\" )\n"
+            "\nReturns execution statistics of the RPC methods called since startup.\n"
+            "\nArguments:\n"
+            "1. \"method\"     (string, optional) Only show this method\n"
+            "\nResult:\n"
+            "{\n"
+            "  \"batchthreads\": n,          (numeric) threads executing parallel batches\n"
+            "  \"methods\": {\n"
+            "    \"name\": {\n"
+            "      \"calls\": n,             (numeric) number of calls\n"
+            "      \"total_ms\": x.xxx,      (numeric) total execution time\n"
+            "      \"avg_ms\": x.xxx,        (numeric) average execution time\n"
+            "      \"max_ms\": x.xxx,        (numeric) longest execution time\n"
+            "      \"lockwait_ms\": x.xxx,   (numeric) part of the total spent waiting for locks\n"
+            "      \"histogram\": {          (json object) number of calls by execution time\n"
+            "        \"1ms\": n,             (numeric) calls that took less than 1ms\n"
+            "        ...\n"
+            "        \"inf\": n              (numeric) calls that took 10s or longer\n"
+            "      }\n"
+            "    }, ...\n"
+            "  }\n"
+            "}\n"
+            "\nExamples:\n" +
+            HelpExampleCli("getrpcinfo", "") + HelpExampleCli("getrpcinfo", "\"getblock\"") + HelpExampleRpc("getrpcinfo", ""));
+
+    string strFilter;
+    if (params.size() > 0)
+        strFilter = params[0].get_str();
+
+    UniValue methods(UniValue::VOBJ);
+    {
+        LOCK(cs_rpcStats);
+        for (std::map<std::string, CRPCMethodStats>::const_iterator it = mapRPCStats.begin(); it != mapRPCStats.end(); ++it) {
+            if (!strFilter.empty() && it->first != strFilter)
+                continue;
+            const CRPCMethodStats& stats = it->second;
+            UniValue histogram(UniValue::VOBJ);
+            for (unsigned int i = 0; i < RPC_LATENCY_BUCKET_COUNT; i++)
+                histogram.push_back(Pair(RPC_LATENCY_BUCKET_NAMES[i], stats.vBuckets[i]));
+
+            UniValue method(UniValue::VOBJ);
+            method.push_back(Pair("calls", stats.nCalls));
+            method.push_back(Pair("total_ms", stats.nTotalMicros / 1000.0));
+            method.push_back(Pair("avg_ms", stats.nTotalMicros / 1000.0 / stats.nCalls));
+            method.push_back(Pair("max_ms", stats.nMaxMicros / 1000.0));
+            method.push_back(Pair("lockwait_ms", stats.nLockWaitMicros / 1000.0));
+            method.push_back(Pair("histogram", histogram));
+            methods.push_back(Pair(it->first, method));
+        }
+    }
+
+    UniValue obj(UniValue::VOBJ);
+    {
+        boost::unique_lock<boost::mutex> lock(csBatchQueue);
+        obj.push_back(Pair("batchthreads", nBatchThreads));
+    }
+    obj.push_back(Pair("methods", methods));
+    return obj;
+}
+
+
 /**
  * Call Table
  */
@@ -281,6 +480,7 @@ static const CRPCCommand vRPCCommands[] =
         //  --------------------- ------------------------  -----------------------  ---------- ---------- ---------
         /* Overall control/query calls */
         {"control", "getinfo", &getinfo, true, false, false}, /* uses wallet if enabled */
+        {"control", "getrpcinfo", &getrpcinfo, true, true, false},
         {"control", "help", &help, true, true, false},
         {"control", "stop", &stop, true, true, false},
 
@@ -303,16 +503,17 @@ static const CRPCCommand vRPCCommands[] =
         {"blockchain", "getblockchaininfo", &getblockchaininfo, true, false, false},
         {"blockchain", "getbestblockhash", &getbestblockhash, true, false, false},
         {"blockchain", "getblockcount", &getblockcount, true, false, false},
-        {"blockchain", "getblock", &getblock, true, false, false},
+        {"blockchain", "getblock", &getblock, true, false, false, &getblock_stream},
         {"blockchain", "getblockhash", &getblockhash, true, false, false},
         {"blockchain", "getblockheader", &getblockheader, false, false, false},
         {"blockchain", "getchaintips", &getchaintips, true, false, false},
         {"blockchain", "getdifficulty", &getdifficulty, true, false, false},
         {"blockchain", "getfeeinfo", &getfeeinfo, true, false, false},
         {"blockchain", "getmempoolinfo", &getmempoolinfo, true, true, false},
-        {"blockchain", "getrawmempool", &getrawmempool, true, false, false},
+        {"blockchain", "getrawmempool", &getrawmempool, true, false, false, &getrawmempool_stream},
         {"blockchain", "gettxout", &gettxout, true, false, false},
         {"blockchain", "gettxoutsetinfo", &gettxoutsetinfo, true, false, false},
+        {"blockchain", "dumptxoutset", &dumptxoutset, true, false, false},
         {"blockchain", "invalidateblock", &invalidateblock, true, true, false},
         {"blockchain", "reconsiderblock", &reconsiderblock, true, true, false},
         {"blockchain", "verifychain", &verifychain, true, false, false},
@@ -397,6 +598,7 @@ static const CRPCCommand vRPCCommands[] =
         {"wallet", "getaccountaddress", &getaccountaddress, true, false, true},
         {"wallet", "getaccount", &getaccount, true, false, true},
         {"wallet", "getaddressesbyaccount", &getaddressesbyaccount, true, false, true},
+        {"wallet", "getautocombinestatus", &getautocombinestatus, false, false, true},
         {"wallet", "getbalance", &getbalance, false, false, true},
         {"wallet", "getnewaddress", &getnewaddress, true, false, true},
         {"wallet", "getrawchangeaddress", &getrawchangeaddress, true, false, true},
@@ -461,6 +663,16 @@ bool StartRPC()
 {
     LogPrint("rpc", "Starting RPC\n");
     fRPCRunning = true;
+
+    {
+        boost::unique_lock<boost::mutex> lock(csBatchQueue);
+        nBatchThreads = std::max((int)GetArg("-rpcbatchthreads", DEFAULT_RPC_BATCH_THREADS), 0);
+        LogPrint("rpc", "Starting %d RPC batch threads\n", nBatchThreads);
+        batchThreadGroup = new boost::thread_group();
+        for (int i = 0; i < nBatchThreads; i++)
+            batchThreadGroup->create_thread(&ThreadRPCBatch);
+    }
+
     g_rpcSignals.Started();
     return true;
 }
@@ -476,6 +688,21 @@ void StopRPC()
 {
     LogPrint("rpc", "Stopping RPC\n");
     deadlineTimers.clear();
+
+    // batches still queued are finished by the threads that submitted them
+    boost::thread_group* threadGroup;
+    {
+        boost::unique_lock<boost::mutex> lock(csBatchQueue);
+        nBatchThreads = 0;
+        queueBatch.clear();
+        threadGroup = batchThreadGroup;
+        batchThreadGroup = NULL;
+    }
+    if (threadGroup) {
+        threadGroup->interrupt_all();
+        threadGroup->join_all();
+        delete threadGroup;
+    }
     g_rpcSignals.Stopped();
 }
 
@@ -556,11 +783,38 @@ static UniValue JSONRPCExecOne(const UniValue& req)
     return rpc_result;
 }
 
+static bool IsParallelBatch(const UniValue& vReq)
+{
+    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++) {
+        if (!vReq[reqIdx].isObject())
+            return false;
+        const UniValue& method = find_value(vReq[reqIdx].get_obj(), "method");
+        if (!method.isStr() || !setParallelBatchRPC.count(method.get_str()))
+            return false;
+    }
+    return true;
+}
+
 std::string JSONRPCExecBatch(const UniValue& vReq)
 {
     UniValue ret(UniValue::VARR);
-    for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
-        ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    if (vReq.size() > 1 && IsParallelBatch(vReq)) {
+        boost::shared_ptr<CRPCBatch> batch(new CRPCBatch(vReq));
+        {
+            boost::unique_lock<boost::mutex> lock(csBatchQueue);
+            for (int i = 0; i < nBatchThreads && i < (int)vReq.size() - 1; i++)
+                queueBatch.push_back(batch);
+            condBatchQueue.notify_all();
+        }
+
+        batch->Drain();
+        const std::vector<UniValue>& vReply = batch->Wait();
+        for (unsigned int reqIdx = 0; reqIdx < vReply.size(); reqIdx++)
+            ret.push_back(vReply[reqIdx]);
+    } else {
+        for (unsigned int reqIdx = 0; reqIdx < vReq.size(); reqIdx++)
+            ret.push_back(JSONRPCExecOne(vReq[reqIdx]));
+    }
 
     return ret.write() + "\n";
 }
@@ -576,6 +830,7 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
 
     try {
         // Execute
+        CRPCCallTimer timer(strMethod);
         return pcmd->actor(params, false);
     } catch (std::exception& e) {
         throw JSONRPCError(RPC_MISC_ERROR, e.what());
@@ -584,6 +839,28 @@ UniValue CRPCTable::execute(const std::string &strMethod, const UniValue &params
     g_rpcSignals.PostCommand(*pcmd);
 }
 
+bool CRPCTable::executeStream(const std::string &strMethod, const UniValue &params, CJSONStream& stream) const
+{
+    const CRPCCommand* pcmd = tableRPC[strMethod];
+    if (!pcmd || !pcmd->streamActor)
+        return false;
+
+    g_rpcSignals.PreCommand(*pcmd);
+
+    try {
+        CRPCCallTimer timer(strMethod);
+        pcmd->streamActor(params, stream);
+    } catch (const jsonstream_aborted&) {
+        // nobody is reading the reply anymore, not an RPC error
+        throw;
+    } catch (std::exception& e) {
+        throw JSONRPCError(RPC_MISC_ERROR, e.what());
+    }
+
+    g_rpcSignals.PostCommand(*pcmd);
+    return true;
+}
+
 std::vector<std::string> CRPCTable::listCommands() const
 {
     std::vector<std::string> commandList;
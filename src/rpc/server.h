@@ -21,6 +21,7 @@
 
 #include <univalue.h>
 
+class CJSONStream;
 class CRPCCommand;
 
 namespace RPCServer
@@ -114,16 +115,25 @@ void RPCUnregisterTimerInterface(RPCTimerInterface *iface);
 void RPCRunLater(const std::string& name, boost::function<void(void)> func, int64_t nSeconds);
 
 typedef UniValue(*rpcfn_type)(const UniValue& params, bool fHelp);
+/** Writes the result of a call straight to a stream, for results too large to build in memory */
+typedef void(*rpcstreamfn_type)(const UniValue& params, CJSONStream& stream);
 
 class CRPCCommand
 {
 public:
+    CRPCCommand(const std::string& categoryIn, const std::string& nameIn, rpcfn_type actorIn, bool okSafeModeIn,
+        bool threadSafeIn, bool reqWalletIn, rpcstreamfn_type streamActorIn = NULL)
+        : category(categoryIn), name(nameIn), actor(actorIn), okSafeMode(okSafeModeIn), threadSafe(threadSafeIn),
+          reqWallet(reqWalletIn), streamActor(streamActorIn) {}
+
     std::string category;
     std::string name;
     rpcfn_type actor;
     bool okSafeMode;
     bool threadSafe;
     bool reqWallet;
+    //! optional, used instead of actor when the reply can be streamed
+    rpcstreamfn_type streamActor;
 };
 
 /**
@@ -148,6 +158,13 @@ public:
      */
     UniValue execute(const std::string &method, const UniValue &params) const;
 
+    /**
+     * Execute a method that has a stream actor, writing its result to stream.
+     * @returns false, writing nothing, if the method can't stream its result.
+     * @throws an exception (UniValue) when an error happens.
+     */
+    bool executeStream(const std::string &method, const UniValue &params, CJSONStream& stream) const;
+
     /**
     * Returns a list of registered commands
     * @returns List of registered commands.
@@ -246,6 +263,7 @@ extern UniValue setstakesplitthreshold(const UniValue& params, bool fHelp);
 extern UniValue getstakesplitthreshold(const UniValue& params, bool fHelp);
 extern UniValue multisend(const UniValue& params, bool fHelp);
 extern UniValue autocombinerewards(const UniValue& params, bool fHelp);
+extern UniValue getautocombinestatus(const UniValue& params, bool fHelp);
 
 extern UniValue getrawtransaction(const UniValue& params, bool fHelp); // in rpc/rawtransaction.cpp
 extern UniValue listunspent(const UniValue& params, bool fHelp);
@@ -264,11 +282,14 @@ extern UniValue getdifficulty(const UniValue& params, bool fHelp);
 extern UniValue settxfee(const UniValue& params, bool fHelp);
 extern UniValue getmempoolinfo(const UniValue& params, bool fHelp);
 extern UniValue getrawmempool(const UniValue& params, bool fHelp);
+extern void getrawmempool_stream(const UniValue& params, CJSONStream& stream);
 extern UniValue getblockhash(const UniValue& params, bool fHelp);
 extern UniValue getblock(const UniValue& params, bool fHelp);
+extern void getblock_stream(const UniValue& params, CJSONStream& stream);
 extern UniValue getblockheader(const UniValue& params, bool fHelp);
 extern UniValue getfeeinfo(const UniValue& params, bool fHelp);
 extern UniValue gettxoutsetinfo(const UniValue& params, bool fHelp);
+extern UniValue dumptxoutset(const UniValue& params, bool fHelp);
 extern UniValue gettxout(const UniValue& params, bool fHelp);
 extern UniValue verifychain(const UniValue& params, bool fHelp);
 extern UniValue getchaintips(const UniValue& params, bool fHelp);
@@ -318,6 +339,11 @@ extern UniValue getstakingstatus(const UniValue& params, bool fHelp);
 bool StartRPC();
 void InterruptRPC();
 void StopRPC();
+/**
+ * Execute a JSON-RPC batch. When every call in it is a read-only lookup, the
+ * calls are spread over the batch executor threads and the calling thread,
+ * and the replies are put back in request order.
+ */
 std::string JSONRPCExecBatch(const UniValue& vReq);
 
 #endif // BITCOIN_RPCSERVER_H
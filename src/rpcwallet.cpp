@@ -2280,6 +2280,46 @@ UniValue autocombinerewards(const UniValue& params, bool fHelp)
     return NullUniValue;
 }
 
+UniValue getautocombinestatus(const UniValue& params, bool fHelp)
+{
+    if (fHelp || params.size() != 0)
+        throw runtime_error(
+            "getautocombinestatus\n"
+            "\nReturns the progress of the background dust combiner enabled by autocombinerewards.\n"
+
+            "\nResult:\n"
+            "{\n"
+            "  \"enabled\": true|false,        (boolean) if auto combine is enabled\n"
+            "  \"threshold\": n,               (numeric) coins below this amount are combined\n"
+            "  \"plannedheight\": n,           (numeric) block height the pending combines were planned at\n"
+            "  \"pending\": n,                 (numeric) combine transactions planned but not sent yet\n"
+            "  \"sent\": n,                    (numeric) combine transactions sent since startup\n"
+            "  \"inputscombined\": n,          (numeric) inputs spent by them\n"
+            "  \"amountcombined\": x.xxx,      (numeric) amount spent by them\n"
+            "  \"lastround\": ttt,             (numeric) time of the last round in seconds since epoch\n"
+            "  \"lastroundms\": n,             (numeric) milliseconds the last round took\n"
+            "  \"lasterror\": \"xxx\"          (string) last combine that failed, if any\n"
+            "}\n"
+
+            "\nExamples:\n" +
+            HelpExampleCli("getautocombinestatus", "") + HelpExampleRpc("getautocombinestatus", ""));
+
+    LOCK(pwalletMain->cs_wallet);
+    const CAutoCombineStatus& status = pwalletMain->autoCombineStatus;
+    UniValue obj(UniValue::VOBJ);
+    obj.push_back(Pair("enabled", pwalletMain->fCombineDust));
+    obj.push_back(Pair("threshold", pwalletMain->nAutoCombineThreshold));
+    obj.push_back(Pair("plannedheight", status.nPlannedHeight));
+    obj.push_back(Pair("pending", (int)pwalletMain->GetPendingCombines()));
+    obj.push_back(Pair("sent", (int)status.nSent));
+    obj.push_back(Pair("inputscombined", (int)status.nInputsCombined));
+    obj.push_back(Pair("amountcombined", ValueFromAmount(status.nValueCombined)));
+    obj.push_back(Pair("lastround", status.nLastRoundTime));
+    obj.push_back(Pair("lastroundms", status.nLastRoundMillis));
+    obj.push_back(Pair("lasterror", status.strLastError));
+    return obj;
+}
+
 UniValue printMultiSend()
 {
     UniValue ret(UniValue::VARR);
@@ -244,16 +244,16 @@ bool CScript::IsPayToScriptHash() const
 {
     // Extra-fast test for pay-to-script-hash CScripts:
     return (this->size() == 23 &&
-            this->at(0) == OP_HASH160 &&
-            this->at(1) == 0x14 &&
-            this->at(22) == OP_EQUAL);
+            (*this)[0] == OP_HASH160 &&
+            (*this)[1] == 0x14 &&
+            (*this)[22] == OP_EQUAL);
 }
 
 bool CScript::IsZerocoinMint() const
 {
     //fast test for Zerocoin Mint CScripts
     return (this->size() > 0 &&
-        this->at(0) == OP_ZEROCOINMINT);
+        (*this)[0] == OP_ZEROCOINMINT);
 }
 
 bool CScript::IsZerocoinSpend() const
@@ -261,7 +261,7 @@ bool CScript::IsZerocoinSpend() const
     if (this->empty())
         return false;
 
-    return (this->at(0) == OP_ZEROCOINSPEND);
+    return ((*this)[0] == OP_ZEROCOINSPEND);
 }
 
 bool CScript::IsPushOnly(const_iterator pc) const
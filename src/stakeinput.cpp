@@ -169,32 +169,46 @@ bool CZPscsStake::MarkSpent(CWallet *pwallet, const uint256& txid)
 bool CPscsStake::SetInput(CTransaction txPrev, unsigned int n)
 {
     this->txFrom = txPrev;
+    this->hashFrom = txPrev.GetHash();
+    this->outFrom = txPrev.vout[n];
     this->nPosition = n;
     return true;
 }
 
+bool CPscsStake::SetInput(const uint256& hashPrev, unsigned int n, const CTxOut& outPrev, CBlockIndex* pindexFromIn)
+{
+    this->txFrom = CTransaction();
+    this->hashFrom = hashPrev;
+    this->outFrom = outPrev;
+    this->nPosition = n;
+    this->pindexFrom = pindexFromIn;
+    return true;
+}
+
 bool CPscsStake::GetTxFrom(CTransaction& tx)
 {
+    if (txFrom.IsNull())
+        return false;
     tx = txFrom;
     return true;
 }
 
 bool CPscsStake::CreateTxIn(CWallet* pwallet, CTxIn& txIn, uint256 hashTxOut)
 {
-    txIn = CTxIn(txFrom.GetHash(), nPosition);
+    txIn = CTxIn(hashFrom, nPosition);
     return true;
 }
 
 CAmount CPscsStake::GetValue()
 {
-    return txFrom.vout[nPosition].nValue;
+    return outFrom.nValue;
 }
 
 bool CPscsStake::CreateTxOuts(CWallet* pwallet, vector<CTxOut>& vout, CAmount nTotal)
 {
     vector<valtype> vSolutions;
     txnouttype whichType;
-    CScript scriptPubKeyKernel = txFrom.vout[nPosition].scriptPubKey;
+    CScript scriptPubKeyKernel = outFrom.scriptPubKey;
     if (!Solver(scriptPubKeyKernel, whichType, vSolutions)) {
         LogPrintf("CreateCoinStake : failed to parse kernel\n");
         return false;
@@ -243,16 +257,20 @@ CDataStream CPscsStake::GetUniqueness()
 {
     //The unique identifier for a 4XT stake is the outpoint
     CDataStream ss(SER_NETWORK, 0);
-    ss << nPosition << txFrom.GetHash();
+    ss << nPosition << hashFrom;
     return ss;
 }
 
 //The block that the UTXO was added to the chain
 CBlockIndex* CPscsStake::GetIndexFrom()
 {
+    // set along with the output when it came from the coins view
+    if (txFrom.IsNull())
+        return pindexFrom;
+
     uint256 hashBlock = 0;
     CTransaction tx;
-    if (GetTransaction(txFrom.GetHash(), tx, hashBlock, true)) {
+    if (GetTransaction(hashFrom, tx, hashBlock, true)) {
         // If the index is in the chain, then set it as the "index from"
         if (mapBlockIndex.count(hashBlock)) {
             CBlockIndex* pindex = mapBlockIndex.at(hashBlock);
@@ -260,7 +278,7 @@ CBlockIndex* CPscsStake::GetIndexFrom()
                 pindexFrom = pindex;
         }
     } else {
-        LogPrintf("%s : failed to find tx %s\n", __func__, txFrom.GetHash().GetHex());
+        LogPrintf("%s : failed to find tx %s\n", __func__, hashFrom.GetHex());
     }
 
     return pindexFrom;
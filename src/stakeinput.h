@@ -68,6 +68,8 @@ class CPscsStake : public CStakeInput
 {
 private:
     CTransaction txFrom;
+    uint256 hashFrom;
+    CTxOut outFrom;
     unsigned int nPosition;
 public:
     CPscsStake()
@@ -76,6 +78,8 @@ public:
     }
 
     bool SetInput(CTransaction txPrev, unsigned int n);
+    //! an unspent output known from the coins view only, created in block pindexFromIn
+    bool SetInput(const uint256& hashPrev, unsigned int n, const CTxOut& outPrev, CBlockIndex* pindexFromIn);
 
     CBlockIndex* GetIndexFrom() override;
     bool GetTxFrom(CTransaction& tx) override;
@@ -22,6 +22,27 @@ void PrintLockContention(const char* pszName, const char* pszFile, int nLine)
 }
 #endif /* DEBUG_LOCKCONTENTION */
 
+static void NoCleanup(int64_t*) {}
+static boost::thread_specific_ptr<int64_t> lockWaitCounter(NoCleanup);
+
+int64_t* GetLockWaitCounter()
+{
+    return lockWaitCounter.get();
+}
+
+CLockWaitTimer::CLockWaitTimer() : nWaitMicros(0), pnOuter(lockWaitCounter.get())
+{
+    lockWaitCounter.reset(&nWaitMicros);
+}
+
+CLockWaitTimer::~CLockWaitTimer()
+{
+    // an enclosing timer counts the waits of this one too
+    if (pnOuter)
+        *pnOuter += nWaitMicros;
+    lockWaitCounter.reset(pnOuter);
+}
+
 #ifdef DEBUG_LOCKORDER
 //
 // Early deadlock detection.
@@ -9,6 +9,7 @@
 #define BITCOIN_SYNC_H
 
 #include "threadsafety.h"
+#include "utiltime.h"
 
 #include <boost/thread/condition_variable.hpp>
 #include <boost/thread/locks.hpp>
@@ -109,6 +110,23 @@ typedef boost::condition_variable CConditionVariable;
 void PrintLockContention(const char* pszName, const char* pszFile, int nLine);
 #endif
 
+/** Counter the calling thread adds its time blocked on contended locks to, NULL if it isn't counting */
+int64_t* GetLockWaitCounter();
+
+/** Counts the microseconds the calling thread waits for contended locks while in scope */
+class CLockWaitTimer
+{
+private:
+    int64_t nWaitMicros;
+    int64_t* pnOuter;
+
+public:
+    CLockWaitTimer();
+    ~CLockWaitTimer();
+
+    int64_t GetWaitMicros() const { return nWaitMicros; }
+};
+
 /** Wrapper around boost::unique_lock<CCriticalSection> */
 template <typename Mutex>
 class SCOPED_LOCKABLE CMutexLock
@@ -119,14 +137,16 @@ private:
     void Enter(const char* pszName, const char* pszFile, int nLine)
     {
         EnterCritical(pszName, pszFile, nLine, (void*)(lock.mutex()));
-#ifdef DEBUG_LOCKCONTENTION
         if (!lock.try_lock()) {
+#ifdef DEBUG_LOCKCONTENTION
             PrintLockContention(pszName, pszFile, nLine);
 #endif
+            int64_t* pnWait = GetLockWaitCounter();
+            int64_t nStart = pnWait ? GetTimeMicros() : 0;
             lock.lock();
-#ifdef DEBUG_LOCKCONTENTION
+            if (pnWait)
+                *pnWait += GetTimeMicros() - nStart;
         }
-#endif
     }
 
     bool TryEnter(const char* pszName, const char* pszFile, int nLine)
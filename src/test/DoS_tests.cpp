@@ -15,6 +15,7 @@
 #include "script/sign.h"
 #include "serialize.h"
 #include "util.h"
+#include "utiltime.h"
 
 #include <stdint.h>
 
@@ -41,6 +42,55 @@ CService ip(uint32_t i)
     return CService(CNetAddr(s), Params().GetDefaultPort());
 }
 
+// Headers of nCount blocks on top of pindexTip, at the target spacing; nNonce tells chains apart
+std::vector<CBlockHeader> HeadersOnTop(CBlockIndex* pindexTip, unsigned int nCount, unsigned int nNonce)
+{
+    std::vector<CBlockHeader> vHeaders(nCount);
+    std::vector<CBlockIndex> vIndex(nCount);
+    CBlockIndex* pindexPrev = pindexTip;
+    uint256 hashPrev = pindexTip->GetBlockHash();
+    for (unsigned int i = 0; i < nCount; i++) {
+        CBlockHeader& header = vHeaders[i];
+        header.nTime = pindexPrev->nTime + Params().TargetSpacing();
+        header.nVersion = header.GetBlockTime() > Params().Zerocoin_StartTime() ? Params().Zerocoin_HeaderVersion() : 3;
+        header.hashPrevBlock = hashPrev;
+        header.nNonce = nNonce;
+        header.nBits = GetNextWorkRequired(pindexPrev, &header);
+
+        vIndex[i].pprev = pindexPrev;
+        vIndex[i].nHeight = pindexPrev->nHeight + 1;
+        vIndex[i].nTime = header.nTime;
+        vIndex[i].nBits = header.nBits;
+        pindexPrev = &vIndex[i];
+        hashPrev = header.GetHash();
+    }
+    return vHeaders;
+}
+
+// Feed a "headers" message with up to MAX_HEADERS_RESULTS headers from nStart to the node
+void ReceiveHeaders(CNode& node, const std::vector<CBlockHeader>& vHeaders, unsigned int nStart)
+{
+    unsigned int nEnd = std::min((unsigned int)vHeaders.size(), nStart + MAX_HEADERS_RESULTS);
+    CDataStream ssPayload(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ssPayload, nEnd - nStart);
+    for (unsigned int i = nStart; i < nEnd; i++) {
+        ssPayload << vHeaders[i];
+        WriteCompactSize(ssPayload, 0);
+    }
+
+    CMessageHeader hdr("headers", ssPayload.size());
+    uint256 hash = Hash(ssPayload.begin(), ssPayload.end());
+    memcpy(&hdr.nChecksum, &hash, sizeof(hdr.nChecksum));
+    CDataStream ssMessage(SER_NETWORK, PROTOCOL_VERSION);
+    ssMessage << hdr;
+    ssMessage.write(&ssPayload[0], ssPayload.size());
+
+    // replies to a dummy node fail to send and mark it as disconnecting
+    node.fDisconnect = false;
+    BOOST_CHECK(node.ReceiveMsgBytes(&ssMessage[0], ssMessage.size()));
+    ProcessMessages(&node);
+}
+
 BOOST_AUTO_TEST_SUITE(DoS_tests)
 
 BOOST_AUTO_TEST_CASE(DoS_banning)
@@ -196,4 +246,65 @@ BOOST_AUTO_TEST_CASE(DoS_mapOrphans)
     BOOST_CHECK(mapOrphanTransactionsByPrev.empty());
 }
 
+BOOST_AUTO_TEST_CASE(DoS_stake_pending_headers)
+{
+    ModifiableParams()->setSkipProofOfWorkCheck(true);
+    LOCK(cs_main);
+    CBlockIndex* pindexTip = chainActive.Tip();
+    CBlockIndex* pindexBestHeaderBefore = pindexBestHeader;
+    const size_t nIndexBefore = mapBlockIndex.size();
+    SetMockTime(pindexTip->GetBlockTime() + Params().TargetSpacing() * (MAX_STAKE_PENDING_PER_PEER + MAX_HEADERS_RESULTS));
+
+    // One peer adds at most MAX_STAKE_PENDING_PER_PEER headers with an unchecked stake
+    std::vector<CBlockHeader> vHeaders = HeadersOnTop(pindexTip, MAX_STAKE_PENDING_PER_PEER + MAX_HEADERS_RESULTS, 0);
+    for (int nReconnect = 0; nReconnect < 2; nReconnect++) {
+        {
+            CNode dummyNode(INVALID_SOCKET, CAddress(ip(0xa0b0c001)), "", true);
+            dummyNode.nVersion = 1;
+            for (unsigned int n = 0; n < vHeaders.size(); n += MAX_HEADERS_RESULTS)
+                ReceiveHeaders(dummyNode, vHeaders, n);
+            // unchecked headers don't become the best header
+            BOOST_CHECK(pindexBestHeader == pindexBestHeaderBefore);
+            if (nReconnect == 0) {
+                BOOST_CHECK_EQUAL(mapBlockIndex.size(), nIndexBefore + MAX_STAKE_PENDING_PER_PEER);
+                BOOST_CHECK(mapBlockIndex.count(vHeaders[MAX_STAKE_PENDING_PER_PEER - 1].GetHash()));
+                BOOST_CHECK(!mapBlockIndex.count(vHeaders[MAX_STAKE_PENDING_PER_PEER].GetHash()));
+            }
+        }
+        // Disconnecting keeps the headers but releases the peer's quota, so the rest gets in on reconnect
+        BOOST_CHECK(mapBlockIndex.count(vHeaders[0].GetHash()));
+        BOOST_CHECK(mapBlockIndex[vHeaders[0].GetHash()]->nStatus & BLOCK_STAKE_PENDING);
+    }
+    BOOST_CHECK_EQUAL(mapBlockIndex.size(), nIndexBefore + vHeaders.size());
+    const size_t nIndexForgotten = mapBlockIndex.size();
+
+    // All peers together add at most MAX_STAKE_PENDING
+    const int nPeers = MAX_STAKE_PENDING / MAX_STAKE_PENDING_PER_PEER + 1;
+    std::vector<CNode*> vNodes;
+    for (int i = 0; i < nPeers; i++) {
+        vNodes.push_back(new CNode(INVALID_SOCKET, CAddress(ip(0xa0b0c010 + i)), "", true));
+        vNodes.back()->nVersion = 1;
+        vHeaders = HeadersOnTop(pindexTip, MAX_STAKE_PENDING_PER_PEER, i + 1);
+        for (unsigned int n = 0; n < vHeaders.size(); n += MAX_HEADERS_RESULTS)
+            ReceiveHeaders(*vNodes.back(), vHeaders, n);
+    }
+    BOOST_CHECK_EQUAL(mapBlockIndex.size(), nIndexForgotten + MAX_STAKE_PENDING);
+    BOOST_CHECK(!mapBlockIndex.count(vHeaders[0].GetHash()));
+    BOOST_FOREACH (CNode* pnode, vNodes)
+        delete pnode;
+
+    // Once they are gone the last peer's headers get in
+    {
+        CNode dummyNode(INVALID_SOCKET, CAddress(ip(0xa0b0c001)), "", true);
+        dummyNode.nVersion = 1;
+        ReceiveHeaders(dummyNode, vHeaders, 0);
+    }
+    BOOST_CHECK(mapBlockIndex.count(vHeaders[0].GetHash()));
+    BOOST_CHECK_EQUAL(mapBlockIndex.size(), nIndexForgotten + MAX_STAKE_PENDING + MAX_HEADERS_RESULTS);
+    BOOST_CHECK(pindexBestHeader == pindexBestHeaderBefore);
+
+    SetMockTime(0);
+    ModifiableParams()->setSkipProofOfWorkCheck(false);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,205 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "accumulators.h"
+
+#include "accumulatorworker.h"
+#include "chain.h"
+#include "chainparams.h"
+#include "main.h"
+#include "random.h"
+#include "script/script.h"
+#include "txdb.h"
+#include "utiltime.h"
+
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+using namespace libzerocoin;
+
+BOOST_AUTO_TEST_SUITE(accumulators_tests)
+
+namespace
+{
+// Blocks in a block file of their own, made the active chain with zerocoin v2 from the
+// start. Every block from height 10 mints a random 1 denomination value and the accumulator
+// checkpoints are computed like ConnectBlock does, the first one at height 30.
+struct ZerocoinChain {
+    int nStartHeight;
+    int nV2Start;
+    CBlockIndex* pindexTipBefore;
+    CZerocoinDB* zerocoinDBBefore;
+    std::vector<uint256> vHashes;
+    std::vector<CBlockIndex> vIndex;
+
+    static CTxOut MintOut(const CBigNum& bnValue)
+    {
+        std::vector<unsigned char> vch = bnValue.getvch();
+        CTxOut out;
+        out.nValue = ZerocoinDenominationToAmount(ZQ_ONE);
+        out.scriptPubKey = CScript() << OP_ZEROCOINMINT << vch.size() << vch;
+        return out;
+    }
+
+    // pcoin is minted at nHeightCoin as well
+    ZerocoinChain(int nBlocks, const PublicCoin* pcoin = NULL, int nHeightCoin = -1) : vHashes(nBlocks), vIndex(nBlocks)
+    {
+        nStartHeight = Params().Zerocoin_StartHeight();
+        nV2Start = Params().Zerocoin_Block_V2_Start();
+        ModifiableParams()->setZerocoinStartHeight(0);
+        ModifiableParams()->setZerocoinBlockV2Start(0);
+        ModifiableParams()->setSkipProofOfWorkCheck(true);
+        zerocoinDBBefore = zerocoinDB;
+        zerocoinDB = new CZerocoinDB(1 << 20, true);
+
+        LOCK(cs_main);
+        pindexTipBefore = chainActive.Tip();
+        CDiskBlockPos pos(99, 0);
+        for (int i = 0; i < nBlocks; i++) {
+            CMutableTransaction tx;
+            tx.vin.resize(1);
+            tx.vin[0].prevout = COutPoint(GetRandHash(), 0);
+            if (i >= 10) {
+                // as long as a real value, so it sits at the offset TxOutToPublicCoin reads from
+                std::vector<unsigned char> vch;
+                for (int k = 0; k < 6; k++) {
+                    uint256 hash = GetRandHash();
+                    vch.insert(vch.end(), hash.begin(), hash.end());
+                }
+                vch.back() = 0x01;
+                tx.vout.push_back(MintOut(CBigNum(vch)));
+                vIndex[i].vMintDenominationsInBlock.push_back(ZQ_ONE);
+            }
+            if (pcoin && i == nHeightCoin) {
+                tx.vout.push_back(MintOut(pcoin->getValue()));
+                vIndex[i].vMintDenominationsInBlock.push_back(ZQ_ONE);
+            }
+            if (tx.vout.empty())
+                tx.vout.push_back(CTxOut(1, CScript() << OP_TRUE));
+
+            CBlock block;
+            block.nVersion = 3;
+            block.hashPrevBlock = i > 0 ? vHashes[i - 1] : uint256();
+            block.nNonce = i;
+            block.vtx.push_back(tx);
+            block.hashMerkleRoot = block.BuildMerkleTree();
+            BOOST_CHECK(WriteBlockToDisk(block, pos));
+
+            vHashes[i] = block.GetHash();
+            vIndex[i].phashBlock = &vHashes[i];
+            vIndex[i].pprev = i > 0 ? &vIndex[i - 1] : NULL;
+            vIndex[i].nHeight = i;
+            vIndex[i].nFile = pos.nFile;
+            vIndex[i].nDataPos = pos.nPos;
+            vIndex[i].nStatus = BLOCK_HAVE_DATA;
+            vIndex[i].BuildSkip();
+            mapBlockIndex.insert(std::make_pair(vHashes[i], &vIndex[i]));
+
+            std::vector<std::pair<uint256, CDiskTxPos> > vPos(1, std::make_pair(block.vtx[0].GetHash(), CDiskTxPos(pos, GetSizeOfCompactSize(1))));
+            BOOST_CHECK(pblocktree->WriteTxIndex(vPos));
+            if (pcoin && i == nHeightCoin) {
+                std::vector<std::pair<PublicCoin, uint256> > vMints(1, std::make_pair(*pcoin, block.vtx[0].GetHash()));
+                BOOST_CHECK(zerocoinDB->WriteCoinMintBatch(vMints));
+            }
+            pos.nPos += ::GetSerializeSize(block, SER_DISK, CLIENT_VERSION);
+
+            vIndex[i].nAccumulatorCheckpoint = i > 0 ? vIndex[i - 1].nAccumulatorCheckpoint : 0;
+            if (i >= 30 && i % 10 == 0) {
+                chainActive.SetTip(&vIndex[i - 1]);
+                AccumulatorMap mapAccumulators(Params().Zerocoin_Params(false));
+                BOOST_CHECK(CalculateAccumulatorCheckpoint(i, vIndex[i].nAccumulatorCheckpoint, mapAccumulators));
+                DatabaseChecksums(mapAccumulators);
+            }
+        }
+        chainActive.SetTip(&vIndex.back());
+    }
+
+    ~ZerocoinChain()
+    {
+        LOCK(cs_main);
+        chainActive.SetTip(pindexTipBefore);
+        for (const uint256& hash : vHashes)
+            mapBlockIndex.erase(hash);
+        delete zerocoinDB;
+        zerocoinDB = zerocoinDBBefore;
+        ModifiableParams()->setSkipProofOfWorkCheck(false);
+        ModifiableParams()->setZerocoinBlockV2Start(nV2Start);
+        ModifiableParams()->setZerocoinStartHeight(nStartHeight);
+    }
+};
+}
+
+BOOST_AUTO_TEST_CASE(witness_cache_matches_fresh)
+{
+    PrivateCoin privateCoin(Params().Zerocoin_Params(false), ZQ_ONE);
+    const PublicCoin& pubcoin = privateCoin.getPublicCoin();
+    ZerocoinChain chain(101, &pubcoin, 21);
+    std::string strError;
+
+    // without a cached state, up to two checkpoints below the tip
+    Accumulator accumulatorFresh(Params().Zerocoin_Params(false), ZQ_ONE);
+    AccumulatorWitness witnessFresh(Params().Zerocoin_Params(false), accumulatorFresh, pubcoin);
+    int nMintsFresh = 0;
+    BOOST_CHECK(GenerateAccumulatorWitness(pubcoin, accumulatorFresh, witnessFresh, 100, nMintsFresh, strError));
+
+    // cache the state of an earlier checkpoint, then forget the mints it covered: a witness
+    // that doesn't resume from the cache can't match any more
+    Accumulator accumulatorEarlier(Params().Zerocoin_Params(false), ZQ_ONE);
+    AccumulatorWitness witnessEarlier(Params().Zerocoin_Params(false), accumulatorEarlier, pubcoin);
+    int nMintsEarlier = 0;
+    BOOST_CHECK(GenerateAccumulatorWitness(pubcoin, accumulatorEarlier, witnessEarlier, 100, nMintsEarlier, strError, &chain.vIndex[60]));
+    BOOST_CHECK(nMintsEarlier < nMintsFresh);
+    for (int i = 20; i < 50; i++)
+        chain.vIndex[i].vMintDenominationsInBlock.clear();
+
+    Accumulator accumulatorCached(Params().Zerocoin_Params(false), ZQ_ONE);
+    AccumulatorWitness witnessCached(Params().Zerocoin_Params(false), accumulatorCached, pubcoin);
+    int nMintsCached = 0;
+    BOOST_CHECK(GenerateAccumulatorWitness(pubcoin, accumulatorCached, witnessCached, 100, nMintsCached, strError));
+    BOOST_CHECK(witnessCached.getValue() == witnessFresh.getValue());
+    BOOST_CHECK(accumulatorCached.getValue() == accumulatorFresh.getValue());
+    BOOST_CHECK_EQUAL(nMintsCached, nMintsFresh);
+}
+
+BOOST_AUTO_TEST_CASE(accumulatorworker_matches_inline)
+{
+    ZerocoinChain chain(41);
+    LOCK(cs_main);
+    chainActive.SetTip(&chain.vIndex[39]);
+
+    // inline, before the worker has anything for this base
+    uint256 nCheckpointInline;
+    AccumulatorMap mapInline(Params().Zerocoin_Params(false));
+    BOOST_CHECK(CalculateAccumulatorCheckpoint(40, nCheckpointInline, mapInline));
+    BOOST_CHECK(nCheckpointInline == chain.vIndex[40].nAccumulatorCheckpoint);
+
+    // precomputed by the worker thread for the same base
+    boost::thread thread(&ThreadAccumulatorWorker);
+    for (int i = 0; i < 500 && accumulatorWorker.GetThreadCount() == 0; i++)
+        MilliSleep(10);
+    const uint256 hashBase = chain.vHashes[30];
+    accumulatorWorker.Schedule(&chain.vIndex[30]);
+    for (int i = 0; i < 500 && !accumulatorWorker.IsFinished(hashBase); i++)
+        MilliSleep(10);
+
+    uint256 nCheckpoint;
+    AccumulatorCheckpoints::Checkpoint values;
+    BOOST_CHECK(accumulatorWorker.Get(hashBase, nCheckpoint, values));
+    BOOST_CHECK(nCheckpoint == nCheckpointInline);
+    for (CoinDenomination denom : zerocoinDenomList)
+        BOOST_CHECK(values[denom] == mapInline.GetValue(denom));
+
+    // and CalculateAccumulatorCheckpoint picks it up
+    uint256 nCheckpointPrecomputed;
+    AccumulatorMap mapPrecomputed(Params().Zerocoin_Params(false));
+    BOOST_CHECK(CalculateAccumulatorCheckpoint(40, nCheckpointPrecomputed, mapPrecomputed));
+    BOOST_CHECK(nCheckpointPrecomputed == nCheckpointInline);
+    for (CoinDenomination denom : zerocoinDenomList)
+        BOOST_CHECK(mapPrecomputed.GetValue(denom) == mapInline.GetValue(denom));
+
+    thread.interrupt();
+    thread.join();
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,138 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "addrman.h"
+#include "clientversion.h"
+#include "netbase.h"
+#include "streams.h"
+#include "utiltime.h"
+
+#include <map>
+#include <string>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(addrman_tests)
+
+static CService MakeService(int i)
+{
+    return CService(strprintf("%d.%d.%d.%d", 1 + i % 200, (i / 200) % 250, i % 7, 1 + i % 250), 9999);
+}
+
+BOOST_AUTO_TEST_CASE(addrman_select)
+{
+    CAddrMan addrman;
+    BOOST_CHECK(!addrman.Select().IsValid());
+
+    const int nAddrs = 400;
+    for (int i = 0; i < nAddrs; i++) {
+        CAddress addr(MakeService(i));
+        addr.nTime = GetAdjustedTime();
+        addrman.Add(addr, CNetAddr(strprintf("250.%d.1.1", i % 20)));
+    }
+    int nSize = addrman.size();
+    BOOST_CHECK(nSize > nAddrs / 2);
+
+    // Move some to tried, and try to connect to half of the others without success
+    std::map<CService, bool> mapAttempted;
+    for (int i = 0; i < nAddrs; i++) {
+        if (i % 4 == 0)
+            addrman.Good(MakeService(i));
+        else if (i % 2 == 0) {
+            addrman.Attempt(MakeService(i));
+            mapAttempted[MakeService(i)] = true;
+        }
+    }
+    BOOST_CHECK_EQUAL(addrman.size(), nSize);
+
+    // Only known addresses come out, recently attempted ones much less often
+    int nSelectedAttempted = 0;
+    for (int i = 0; i < 2000; i++) {
+        CAddress addr = addrman.Select();
+        BOOST_CHECK(addr.IsValid());
+        if (mapAttempted.count(addr))
+            nSelectedAttempted++;
+    }
+    BOOST_CHECK(nSelectedAttempted < 200);
+
+    // The tables survive a round trip, and selection still works afterwards
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    uint64_t nChanges = addrman.GetChanges();
+    ss << addrman;
+    BOOST_CHECK_EQUAL(addrman.GetChanges(), nChanges);
+    CAddrMan addrman2;
+    ss >> addrman2;
+    BOOST_CHECK_EQUAL(addrman2.size(), nSize);
+    for (int i = 0; i < 100; i++)
+        BOOST_CHECK(addrman2.Select().IsValid());
+}
+
+BOOST_AUTO_TEST_CASE(addrman_changes)
+{
+    CAddrMan addrman;
+    CNetAddr source("250.1.1.1");
+    CAddress addr(MakeService(1));
+    addr.nTime = GetAdjustedTime();
+    BOOST_CHECK(addrman.Add(addr, source));
+    uint64_t nChanges = addrman.GetChanges();
+
+    // nothing peers.dat stores changes
+    BOOST_CHECK(!addrman.Add(addr, source));
+    addrman.Connected(MakeService(1), addr.nTime);
+    addrman.Good(MakeService(2));
+    addrman.Attempt(MakeService(2));
+    BOOST_CHECK_EQUAL(addrman.GetChanges(), nChanges);
+
+    addrman.Connected(MakeService(1), addr.nTime + 30 * 60);
+    BOOST_CHECK(addrman.GetChanges() > nChanges);
+    nChanges = addrman.GetChanges();
+    addrman.Attempt(MakeService(1));
+    BOOST_CHECK(addrman.GetChanges() > nChanges);
+    nChanges = addrman.GetChanges();
+    addrman.Good(MakeService(1));
+    BOOST_CHECK(addrman.GetChanges() > nChanges);
+}
+
+BOOST_AUTO_TEST_CASE(addrman_recent_after_load)
+{
+    int64_t nNow = GetTime();
+    SetMockTime(nNow);
+
+    // all tried, the even ones connected to just now
+    CAddrMan addrman;
+    const int nAddrs = 200;
+    for (int i = 0; i < nAddrs; i++) {
+        CAddress addr(MakeService(i));
+        addr.nTime = nNow;
+        addrman.Add(addr, CNetAddr(strprintf("250.%d.1.1", i % 20)));
+        addrman.Good(MakeService(i), i % 2 == 0 ? nNow : nNow - 60 * 60);
+    }
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << addrman;
+    CAddrMan addrman2;
+    ss >> addrman2;
+
+    int nRecent = 0;
+    for (int i = 0; i < 1000; i++) {
+        CAddress addr = addrman2.Select();
+        if (addr.nLastTry == nNow)
+            nRecent++;
+    }
+    BOOST_CHECK(nRecent < 100);
+
+    // once the attempts are no longer recent all entries weigh the same again
+    SetMockTime(nNow + ADDRMAN_RECENT_TRY_SECONDS + 1);
+    nRecent = 0;
+    for (int i = 0; i < 1000; i++) {
+        CAddress addr = addrman2.Select();
+        if (addr.nLastTry == nNow)
+            nRecent++;
+    }
+    BOOST_CHECK(nRecent > 300);
+
+    SetMockTime(0);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,77 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "blockfilereader.h"
+
+#include "chainparams.h"
+#include "clientversion.h"
+#include "random.h"
+#include "streams.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(blockfilereader_tests)
+
+static void WriteFrame(CAutoFile& file, const CBlock& block)
+{
+    file << FLATDATA(Params().MessageStart()) << (unsigned int)::GetSerializeSize(block, SER_DISK, CLIENT_VERSION) << block;
+}
+
+BOOST_AUTO_TEST_CASE(scan_headers)
+{
+    boost::filesystem::path path = GetTempPath() / strprintf("blockfilereader_%s", GetRandHash().ToString());
+
+    std::vector<CBlock> vBlocks;
+    CBlock block = Params().GenesisBlock();
+    for (int i = 0; i < 3; i++) {
+        vBlocks.push_back(block);
+        block.hashPrevBlock = block.GetHash();
+        block.nNonce = i;
+    }
+
+    {
+        CAutoFile file(fopen(path.string().c_str(), "wb"), SER_DISK, CLIENT_VERSION);
+        BOOST_REQUIRE(!file.IsNull());
+        // garbage containing the first magic byte, a frame with a bogus size and
+        // blocks out of chain order, all of which a reindex may run into
+        std::vector<unsigned char> vGarbage(100, Params().MessageStart()[0]);
+        file << FLATDATA(vGarbage);
+        file << FLATDATA(Params().MessageStart()) << (unsigned int)10;
+        WriteFrame(file, vBlocks[0]);
+        WriteFrame(file, vBlocks[2]);
+        file << FLATDATA(vGarbage);
+        WriteFrame(file, vBlocks[1]);
+        // truncated frame at the end
+        file << FLATDATA(Params().MessageStart()) << (unsigned int)1000;
+    }
+
+    CMappedBlockFile mapped(fopen(path.string().c_str(), "rb"));
+#ifndef WIN32
+    BOOST_REQUIRE(!mapped.IsNull());
+    std::vector<CBlockFileEntry> vEntries;
+    mapped.ScanHeaders(vEntries);
+    BOOST_REQUIRE_EQUAL(vEntries.size(), 3U);
+
+    const int vOrder[] = {0, 2, 1};
+    for (unsigned int i = 0; i < vEntries.size(); i++) {
+        const CBlock& expected = vBlocks[vOrder[i]];
+        BOOST_CHECK(vEntries[i].hash == expected.GetHash());
+        BOOST_CHECK(vEntries[i].hashPrev == expected.hashPrevBlock);
+        BOOST_CHECK_EQUAL(vEntries[i].nSize, ::GetSerializeSize(expected, SER_DISK, CLIENT_VERSION));
+
+        CBlock read;
+        BOOST_CHECK(mapped.ReadBlock(vEntries[i], read));
+        BOOST_CHECK(read.GetHash() == expected.GetHash());
+        BOOST_CHECK(read.vtx.size() == expected.vtx.size());
+    }
+#else
+    BOOST_CHECK(mapped.IsNull());
+#endif
+
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
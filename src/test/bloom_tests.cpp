@@ -10,6 +10,7 @@
 #include "clientversion.h"
 #include "key.h"
 #include "merkleblock.h"
+#include "random.h"
 #include "serialize.h"
 #include "streams.h"
 #include "uint256.h"
@@ -461,4 +462,49 @@ BOOST_AUTO_TEST_CASE(merkle_block_4_test_update_none)
     BOOST_CHECK(!filter.contains(COutPoint(uint256("0x02981fa052f0481dbc5868f4fc2166035a10f27a03cfd2de67326471df5bc041"), 0)));
 }
 
+BOOST_AUTO_TEST_CASE(bloom_tx_elements_hash)
+{
+    // Elements of every length against the plain MurmurHash3 of their data
+    CMutableTransaction tx;
+    tx.vin.resize(1);
+    tx.vin[0].prevout = COutPoint(GetRandHash(), 7);
+    vector<vector<unsigned char> > vData;
+    for (unsigned int nSize = 1; nSize <= 40; nSize++) {
+        vector<unsigned char> data(nSize);
+        for (unsigned int i = 0; i < nSize; i++)
+            data[i] = insecure_rand();
+        tx.vin[0].scriptSig << data;
+        vData.push_back(data);
+    }
+    tx.vout.resize(1);
+    tx.vout[0].scriptPubKey = CScript() << OP_RETURN;
+
+    CTransaction txFinal(tx);
+    CBloomTxElements elements(txFinal);
+    BOOST_CHECK_EQUAL(elements.size(), 2 + vData.size());
+
+    CDataStream stream(SER_NETWORK, PROTOCOL_VERSION);
+    stream << tx.vin[0].prevout;
+    vector<unsigned char> prevout(stream.begin(), stream.end());
+    const uint256& hash = txFinal.GetHash();
+    for (unsigned int nSeed = 0; nSeed < 100; nSeed++) {
+        uint32_t nHashSeed = nSeed * 0xFBA4C795 + insecure_rand();
+        BOOST_CHECK_EQUAL(elements.Hash(0, nHashSeed), MurmurHash3(nHashSeed, vector<unsigned char>(hash.begin(), hash.end())));
+        BOOST_CHECK_EQUAL(elements.Hash(1, nHashSeed), MurmurHash3(nHashSeed, prevout));
+        for (unsigned int i = 0; i < vData.size(); i++)
+            BOOST_CHECK_EQUAL(elements.Hash(2 + i, nHashSeed), MurmurHash3(nHashSeed, vData[i]));
+    }
+
+    // The same filter matched both ways ends up with the same contents
+    CBloomFilter filter(10, 0.000001, 0, BLOOM_UPDATE_ALL);
+    filter.insert(vData[5]);
+    CBloomFilter filterElements = filter;
+    BOOST_CHECK(filter.IsRelevantAndUpdate(txFinal));
+    BOOST_CHECK(filterElements.IsRelevantAndUpdate(txFinal, elements));
+    CDataStream ss1(SER_NETWORK, PROTOCOL_VERSION), ss2(SER_NETWORK, PROTOCOL_VERSION);
+    ss1 << filter;
+    ss2 << filterElements;
+    BOOST_CHECK(ss1.str() == ss2.str());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,6 +3,7 @@
 // Distributed under the MIT/X11 software license, see the accompanying
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
+#include "clientversion.h"
 #include "masternode-budget.h"
 #include "tinyformat.h"
 #include "utilmoneystr.h"
@@ -30,4 +31,55 @@ BOOST_AUTO_TEST_CASE(budget_value)
     CheckBudgetValue(nHeightTest, "mainnet", 43200*COIN);
 }
 
+BOOST_AUTO_TEST_CASE(budget_vote_tally)
+{
+    CBudgetProposal proposal;
+    std::string strError;
+    int64_t nTime = GetTime() - 2 * BUDGET_VOTE_UPDATE_MIN;
+
+    CBudgetVote vote1(CTxIn(COutPoint(uint256(1), 0)), proposal.GetHash(), VOTE_YES);
+    CBudgetVote vote2(CTxIn(COutPoint(uint256(2), 0)), proposal.GetHash(), VOTE_NO);
+    CBudgetVote vote3(CTxIn(COutPoint(uint256(3), 0)), proposal.GetHash(), VOTE_ABSTAIN);
+    CBudgetVote vote4(CTxIn(COutPoint(uint256(4), 0)), proposal.GetHash(), VOTE_YES);
+    vote1.nTime = vote2.nTime = vote3.nTime = vote4.nTime = nTime;
+    vote4.fValid = false;
+
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote1, strError));
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote2, strError));
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote3, strError));
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote4, strError));
+
+    // invalid votes only count towards the ratio
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 1);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 1);
+    BOOST_CHECK_EQUAL(proposal.GetAbstains(), 1);
+    BOOST_CHECK_CLOSE(proposal.GetRatio(), 2.0 / 3.0, 0.0001);
+
+    // a vote update replaces the previous vote of the same masternode
+    vote1.nVote = VOTE_NO;
+    vote1.nTime = nTime + BUDGET_VOTE_UPDATE_MIN;
+    BOOST_CHECK(proposal.AddOrUpdateVote(vote1, strError));
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 0);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 2);
+    BOOST_CHECK_CLOSE(proposal.GetRatio(), 1.0 / 3.0, 0.0001);
+
+    // rejected updates leave the tallies alone
+    vote2.nVote = VOTE_YES;
+    BOOST_CHECK(!proposal.AddOrUpdateVote(vote2, strError));
+    BOOST_CHECK_EQUAL(proposal.GetYeas(), 0);
+    BOOST_CHECK_EQUAL(proposal.GetNays(), 2);
+
+    // copies and serialized round trips keep the same tallies
+    CBudgetProposal proposalCopy(proposal);
+    BOOST_CHECK_EQUAL(proposalCopy.GetNays(), 2);
+    BOOST_CHECK_EQUAL(proposalCopy.GetAbstains(), 1);
+
+    CDataStream ss(SER_DISK, CLIENT_VERSION);
+    ss << proposal;
+    CBudgetProposal proposalRead;
+    ss >> proposalRead;
+    BOOST_CHECK_EQUAL(proposalRead.GetNays(), 2);
+    BOOST_CHECK_EQUAL(proposalRead.GetAbstains(), 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
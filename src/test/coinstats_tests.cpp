@@ -0,0 +1,94 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coinstats.h"
+#include "random.h"
+#include "txdb.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(coinstats_tests)
+
+BOOST_AUTO_TEST_CASE(muhash_order_independent)
+{
+    std::vector<unsigned char> a(1, 'a'), b(1, 'b'), c(1, 'c');
+
+    CMuHash3072 abc, cba, empty;
+    abc.Insert(a);
+    abc.Insert(b);
+    abc.Insert(c);
+    cba.Insert(c);
+    cba.Insert(b);
+    cba.Insert(a);
+    BOOST_CHECK(abc.Finalize() == cba.Finalize());
+    BOOST_CHECK(abc.Finalize() != empty.Finalize());
+
+    // combining the hashes of disjoint subsets gives the hash of the union
+    CMuHash3072 ab, justc;
+    ab.Insert(a);
+    ab.Insert(b);
+    justc.Insert(c);
+    ab *= justc;
+    BOOST_CHECK(ab.Finalize() == abc.Finalize());
+
+    abc.Remove(b);
+    abc.Remove(a);
+    abc.Remove(c);
+    BOOST_CHECK(abc.Finalize() == empty.Finalize());
+}
+
+BOOST_AUTO_TEST_CASE(utxo_stats_parallel)
+{
+    CCoinsViewDB db(1 << 20, true);
+    CAmount nTotal = 0;
+    uint64_t nOutputs = 0;
+    {
+        CCoinsViewCache cache(&db);
+        for (int i = 0; i < 500; i++) {
+            CCoinsModifier coins = cache.ModifyCoins(GetRandHash());
+            coins->nVersion = 1;
+            coins->nHeight = i;
+            coins->vout.resize(1 + i % 3);
+            for (unsigned int j = 0; j < coins->vout.size(); j++) {
+                coins->vout[j].nValue = 1000 * i + j + 1;
+                coins->vout[j].scriptPubKey = CScript() << OP_TRUE;
+                nTotal += coins->vout[j].nValue;
+                nOutputs++;
+            }
+        }
+        cache.SetBestBlock(GetRandHash());
+        BOOST_CHECK(cache.Flush());
+    }
+
+    CCoinsStats legacy, single, parallel, totals;
+    const leveldb::Snapshot* psnapshot = db.GetSnapshot();
+    BOOST_CHECK(GetUTXOStats(&db, psnapshot, legacy, COINSTATS_HASH_SERIALIZED, 4));
+    BOOST_CHECK(GetUTXOStats(&db, psnapshot, single, COINSTATS_HASH_MUHASH, 1));
+    BOOST_CHECK(GetUTXOStats(&db, psnapshot, parallel, COINSTATS_HASH_MUHASH, 7));
+    BOOST_CHECK(GetUTXOStats(&db, psnapshot, totals, COINSTATS_HASH_NONE, 3));
+    db.ReleaseSnapshot(psnapshot);
+
+    BOOST_CHECK_EQUAL(legacy.nTransactions, 500U);
+    BOOST_CHECK_EQUAL(legacy.nTransactionOutputs, nOutputs);
+    BOOST_CHECK_EQUAL(legacy.nTotalAmount, nTotal);
+    BOOST_CHECK(legacy.hashBlock == db.GetBestBlock());
+
+    BOOST_CHECK(single.hashSerialized == parallel.hashSerialized);
+    BOOST_CHECK(single.hashSerialized != legacy.hashSerialized);
+
+    const CCoinsStats* vStats[] = {&single, &parallel, &totals};
+    for (unsigned int i = 0; i < 3; i++) {
+        BOOST_CHECK_EQUAL(vStats[i]->nTransactions, legacy.nTransactions);
+        BOOST_CHECK_EQUAL(vStats[i]->nTransactionOutputs, legacy.nTransactionOutputs);
+        BOOST_CHECK_EQUAL(vStats[i]->nSerializedSize, legacy.nSerializedSize);
+        BOOST_CHECK_EQUAL(vStats[i]->nTotalAmount, legacy.nTotalAmount);
+    }
+
+    // without a snapshot the current state is read
+    CCoinsStats stats;
+    BOOST_CHECK(GetUTXOStats(&db, NULL, stats, COINSTATS_HASH_SERIALIZED, 1));
+    BOOST_CHECK(stats.hashSerialized == legacy.hashSerialized);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,176 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "logwriter.h"
+#include "util.h"
+#include "utiltime.h"
+
+#include <stdio.h>
+
+#include <atomic>
+#include <memory>
+
+#include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
+#include <boost/test/unit_test.hpp>
+#include <boost/thread.hpp>
+
+#include <univalue.h>
+
+BOOST_AUTO_TEST_SUITE(logwriter_tests)
+
+/** Collects everything a CLogWriter writes */
+struct CLogCapture {
+    boost::mutex mutex;
+    std::string str;
+
+    void Write(const std::string& strIn)
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        str += strIn;
+    }
+
+    std::vector<std::string> Lines()
+    {
+        boost::unique_lock<boost::mutex> lock(mutex);
+        std::vector<std::string> vLines;
+        boost::split(vLines, str, boost::is_any_of("\n"));
+        if (!vLines.empty() && vLines.back().empty())
+            vLines.pop_back();
+        return vLines;
+    }
+};
+
+static void PushLines(CLogWriter* pwriter, int nThread, int nLines, std::atomic<int>* pnRejected)
+{
+    for (int i = 0; i < nLines; i++) {
+        if (!pwriter->Push(strprintf("%d %d\n", nThread, i), "net"))
+            (*pnRejected)++;
+    }
+}
+
+static void PushUntilStopped(CLogWriter* pwriter, int nThread, std::atomic<int>* pnPushed)
+{
+    for (int i = 0; pwriter->Push(strprintf("%d %d\n", nThread, i), NULL); i++)
+        (*pnPushed)++;
+}
+
+static void PushNamed(CLogWriter* pwriter)
+{
+    RenameThread("forextrading-logtest");
+    pwriter->Push("a \"quoted\"\tline\n", "net");
+    pwriter->Push("uncategorized\n", NULL);
+}
+
+BOOST_AUTO_TEST_CASE(logwriter_ring)
+{
+    std::unique_ptr<CLogRing> ring(new CLogRing());
+    std::vector<CLogLine> vLines;
+    BOOST_CHECK(ring->Empty());
+
+    for (int nRound = 0; nRound < 3; nRound++) {
+        for (uint64_t i = 0; i < CLogRing::SIZE; i++) {
+            CLogLine line;
+            line.nSequence = i;
+            BOOST_CHECK(ring->Push(line));
+        }
+        // full: the caller has to wait for the writer
+        CLogLine line;
+        BOOST_CHECK(!ring->Push(line));
+        BOOST_CHECK(!ring->Empty());
+
+        vLines.clear();
+        ring->PopAll(vLines);
+        BOOST_CHECK(ring->Empty());
+        BOOST_CHECK_EQUAL(vLines.size(), CLogRing::SIZE);
+        for (uint64_t i = 0; i < vLines.size(); i++)
+            BOOST_CHECK_EQUAL(vLines[i].nSequence, i);
+    }
+}
+
+BOOST_AUTO_TEST_CASE(logwriter_order)
+{
+    bool fLogTimestampsOld = fLogTimestamps;
+    fLogTimestamps = false;
+
+    CLogCapture capture;
+    CLogWriter writer(boost::bind(&CLogCapture::Write, &capture, _1));
+    BOOST_CHECK(!writer.Push("not running\n", NULL));
+
+    writer.Start();
+    BOOST_CHECK(writer.IsRunning());
+
+    // more lines per thread than a ring holds, so pushers wait for the writer
+    const int nThreads = 4;
+    const int nLines = 3 * CLogRing::SIZE;
+    std::atomic<int> nRejected(0);
+    boost::thread_group threads;
+    for (int i = 0; i < nThreads; i++)
+        threads.create_thread(boost::bind(&PushLines, &writer, i, nLines, &nRejected));
+    threads.join_all();
+    writer.Stop();
+    BOOST_CHECK_EQUAL(nRejected.load(), 0);
+    BOOST_CHECK(!writer.IsRunning());
+    BOOST_CHECK(!writer.Push("stopped\n", NULL));
+
+    std::vector<std::string> vLines = capture.Lines();
+    BOOST_CHECK_EQUAL(vLines.size(), (size_t)(nThreads * nLines));
+    std::vector<int> vNext(nThreads, 0);
+    for (const std::string& strLine : vLines) {
+        int nThread = -1, nLine = -1;
+        BOOST_CHECK_EQUAL(sscanf(strLine.c_str(), "%d %d", &nThread, &nLine), 2);
+        BOOST_REQUIRE(nThread >= 0 && nThread < nThreads);
+        BOOST_CHECK_EQUAL(nLine, vNext[nThread]++);
+    }
+
+    fLogTimestamps = fLogTimestampsOld;
+}
+
+BOOST_AUTO_TEST_CASE(logwriter_stop_race)
+{
+    // every line Push accepted is written, even when it raced with Stop
+    for (int nRound = 0; nRound < 20; nRound++) {
+        CLogCapture capture;
+        CLogWriter writer(boost::bind(&CLogCapture::Write, &capture, _1));
+        writer.Start();
+
+        std::atomic<int> nPushed(0);
+        boost::thread_group threads;
+        for (int i = 0; i < 3; i++)
+            threads.create_thread(boost::bind(&PushUntilStopped, &writer, i, &nPushed));
+        MilliSleep(nRound % 5);
+        writer.Stop();
+        threads.join_all();
+
+        BOOST_CHECK_EQUAL(capture.Lines().size(), (size_t)nPushed.load());
+    }
+}
+
+BOOST_AUTO_TEST_CASE(logwriter_json)
+{
+    CLogCapture capture;
+    CLogWriter writer(boost::bind(&CLogCapture::Write, &capture, _1));
+    writer.fJson = true;
+    writer.Start();
+    boost::thread thread(boost::bind(&PushNamed, &writer));
+    thread.join();
+    writer.Stop();
+
+    std::vector<std::string> vLines = capture.Lines();
+    BOOST_REQUIRE_EQUAL(vLines.size(), 2U);
+
+    UniValue line;
+    BOOST_REQUIRE(line.read(vLines[0]));
+    BOOST_CHECK(line.isObject());
+    BOOST_CHECK_EQUAL(find_value(line, "message").get_str(), "a \"quoted\"\tline");
+    BOOST_CHECK_EQUAL(find_value(line, "category").get_str(), "net");
+    BOOST_CHECK_EQUAL(find_value(line, "thread").get_str(), "forextrading-logtest");
+    BOOST_CHECK_EQUAL(find_value(line, "time").get_str().size(), 20U);
+
+    BOOST_REQUIRE(line.read(vLines[1]));
+    BOOST_CHECK_EQUAL(find_value(line, "message").get_str(), "uncategorized");
+    BOOST_CHECK_EQUAL(find_value(line, "category").get_str(), "");
+}
+
+BOOST_AUTO_TEST_SUITE_END()
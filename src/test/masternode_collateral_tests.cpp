@@ -0,0 +1,102 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "coins.h"
+#include "main.h"
+#include "masternode-collateral.h"
+#include "validationinterface.h"
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(masternode_collateral_tests)
+
+BOOST_AUTO_TEST_CASE(collateral_tracker)
+{
+    CCollateralTracker tracker;
+    RegisterValidationInterface(&tracker);
+
+    CMutableTransaction txCollateral;
+    txCollateral.vin.resize(1);
+    txCollateral.vin[0].prevout = COutPoint(GetRandHash(), 0);
+    txCollateral.vout.resize(2);
+    txCollateral.vout[0].nValue = 2000 * COIN;
+    txCollateral.vout[1].nValue = 1 * COIN;
+    CTransaction tx(txCollateral);
+    COutPoint outpoint(tx.GetHash(), 0);
+
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+        *pcoinsTip->ModifyCoins(tx.GetHash()) = CCoins(tx, nHeight);
+    }
+
+    CAmount nValue = 0;
+    BOOST_CHECK_EQUAL(tracker.GetInputAge(outpoint), 1);
+    BOOST_CHECK(tracker.IsUnspent(outpoint, nValue));
+    BOOST_CHECK_EQUAL(nValue, 2000 * COIN);
+    BOOST_CHECK_EQUAL(tracker.GetInputAge(COutPoint(GetRandHash(), 0)), -1);
+    BOOST_CHECK(tracker.IsMature(outpoint, nHeight + 1));
+
+    // the spend only shows once it is announced
+    {
+        LOCK(cs_main);
+        pcoinsTip->ModifyCoins(tx.GetHash())->Spend(0);
+    }
+    BOOST_CHECK(tracker.IsUnspent(outpoint, nValue));
+
+    CMutableTransaction txSpend;
+    txSpend.vin.resize(1);
+    txSpend.vin[0].prevout = outpoint;
+    txSpend.vout.resize(1);
+    GetMainSignals().SyncTransaction(CTransaction(txSpend), NULL);
+    BOOST_CHECK(!tracker.IsUnspent(outpoint, nValue));
+    BOOST_CHECK(tracker.IsUnspent(COutPoint(tx.GetHash(), 1), nValue));
+    BOOST_CHECK_EQUAL(nValue, 1 * COIN);
+    BOOST_CHECK_EQUAL(tracker.GetInputAge(outpoint), 1);
+
+    {
+        LOCK(cs_main);
+        pcoinsTip->ModifyCoins(tx.GetHash())->Clear();
+    }
+    UnregisterValidationInterface(&tracker);
+}
+
+BOOST_AUTO_TEST_CASE(collateral_tracker_maturity)
+{
+    CCollateralTracker tracker;
+
+    CMutableTransaction txReward;
+    txReward.vin.resize(1);
+    txReward.vin[0].prevout.SetNull();
+    txReward.vin[0].scriptSig = CScript() << OP_0 << OP_0;
+    txReward.vout.resize(1);
+    txReward.vout[0].nValue = 2000 * COIN;
+    CTransaction tx(txReward);
+    COutPoint outpoint(tx.GetHash(), 0);
+    BOOST_CHECK(tx.IsCoinBase());
+
+    int nHeight;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+        *pcoinsTip->ModifyCoins(tx.GetHash()) = CCoins(tx, nHeight);
+    }
+
+    // an immature reward is unspent but can't back a masternode yet
+    CAmount nValue = 0;
+    int nMaturity = Params().COINBASE_MATURITY();
+    BOOST_CHECK(tracker.IsUnspent(outpoint, nValue));
+    BOOST_CHECK(!tracker.IsMature(outpoint, nHeight + 1));
+    BOOST_CHECK(!tracker.IsMature(outpoint, nHeight + nMaturity - 1));
+    BOOST_CHECK(tracker.IsMature(outpoint, nHeight + nMaturity));
+    BOOST_CHECK(!tracker.IsMature(COutPoint(GetRandHash(), 0), nHeight + nMaturity));
+
+    {
+        LOCK(cs_main);
+        pcoinsTip->ModifyCoins(tx.GetHash())->Clear();
+    }
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,163 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "key.h"
+#include "masternode-sigverify.h"
+#include "obfuscation.h"
+#include "utiltime.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(masternode_sigverify_tests)
+
+static void StoreResult(boost::mutex* pmutex, std::vector<bool>* pvResults, bool fValid)
+{
+    boost::unique_lock<boost::mutex> lock(*pmutex);
+    pvResults->push_back(fValid);
+}
+
+static void ThrowResult(bool fValid)
+{
+    throw std::runtime_error("callback failed");
+}
+
+static bool WaitForThreads(CMasternodeSigVerifier& verifier, int nThreads)
+{
+    for (int i = 0; i < 500; i++) {
+        if (verifier.GetThreadCount() == nThreads) return true;
+        MilliSleep(10);
+    }
+    return false;
+}
+
+static bool WaitForResults(boost::mutex& mutex, std::vector<bool>& vResults, unsigned int nResults)
+{
+    for (int i = 0; i < 500; i++) {
+        {
+            boost::unique_lock<boost::mutex> lock(mutex);
+            if (vResults.size() == nResults) return true;
+        }
+        MilliSleep(10);
+    }
+    return false;
+}
+
+BOOST_AUTO_TEST_CASE(sigverify_sync)
+{
+    CMasternodeSigVerifier verifier;
+    CKey key, key2;
+    key.MakeNewKey(true);
+    key2.MakeNewKey(true);
+
+    std::string strMessage = "masternode message";
+    std::string errorMessage;
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(obfuScationSigner.SignMessage(strMessage, errorMessage, vchSig, key));
+
+    BOOST_CHECK(verifier.Verify(key.GetPubKey(), vchSig, strMessage, errorMessage));
+    BOOST_CHECK(!verifier.Verify(key2.GetPubKey(), vchSig, strMessage, errorMessage));
+    BOOST_CHECK(!verifier.Verify(key.GetPubKey(), vchSig, strMessage + "x", errorMessage));
+    BOOST_CHECK_EQUAL(verifier.GetCacheSize(), 2);
+
+    // cached answers are the same as fresh ones
+    BOOST_CHECK(verifier.Verify(key.GetPubKey(), vchSig, strMessage, errorMessage));
+    BOOST_CHECK(!verifier.Verify(key2.GetPubKey(), vchSig, strMessage, errorMessage));
+    BOOST_CHECK_EQUAL(verifier.GetCacheSize(), 2);
+
+    std::vector<unsigned char> vchBadSig(65, 0);
+    BOOST_CHECK(!verifier.Verify(key.GetPubKey(), vchBadSig, strMessage, errorMessage));
+}
+
+BOOST_AUTO_TEST_CASE(sigverify_async)
+{
+    CMasternodeSigVerifier verifier;
+    CKey key, key2;
+    key.MakeNewKey(true);
+    key2.MakeNewKey(true);
+
+    std::string strMessage = "masternode message";
+    std::string errorMessage;
+    std::vector<unsigned char> vchSig;
+    BOOST_CHECK(obfuScationSigner.SignMessage(strMessage, errorMessage, vchSig, key));
+
+    boost::mutex mutex;
+    std::vector<bool> vResults;
+
+    // without workers the callback waits for RunDeferred, not the caller's locks
+    verifier.VerifyAsync(key.GetPubKey(), vchSig, strMessage, boost::bind(&StoreResult, &mutex, &vResults, _1));
+    BOOST_CHECK(vResults.empty());
+    verifier.RunDeferred();
+    BOOST_CHECK_EQUAL(vResults.size(), 1U);
+    BOOST_CHECK(vResults[0]);
+    vResults.clear();
+
+    boost::thread_group threadGroup;
+    threadGroup.create_thread(boost::bind(&CMasternodeSigVerifier::Thread, &verifier));
+    BOOST_CHECK(WaitForThreads(verifier, 1));
+
+    std::string strMessage2 = "another masternode message";
+    std::vector<unsigned char> vchSig2;
+    BOOST_CHECK(obfuScationSigner.SignMessage(strMessage2, errorMessage, vchSig2, key));
+
+    // duplicates of the same check get one result each, for their own public key
+    verifier.VerifyAsync(key.GetPubKey(), vchSig2, strMessage2, boost::bind(&StoreResult, &mutex, &vResults, _1));
+    verifier.VerifyAsync(key2.GetPubKey(), vchSig2, strMessage2, boost::bind(&StoreResult, &mutex, &vResults, _1));
+
+    BOOST_CHECK(WaitForResults(mutex, vResults, 2));
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    BOOST_CHECK_EQUAL(verifier.GetThreadCount(), 0);
+
+    BOOST_CHECK_EQUAL(vResults.size(), 2U);
+    BOOST_CHECK_EQUAL(std::count(vResults.begin(), vResults.end(), true), 1);
+    BOOST_CHECK_EQUAL(verifier.GetQueueSize(), 0);
+    vResults.clear();
+
+    // a cache hit is deferred the same way
+    verifier.VerifyAsync(key.GetPubKey(), vchSig2, strMessage2, boost::bind(&StoreResult, &mutex, &vResults, _1));
+    BOOST_CHECK(vResults.empty());
+    verifier.RunDeferred();
+    BOOST_CHECK_EQUAL(vResults.size(), 1U);
+    BOOST_CHECK(vResults[0]);
+}
+
+BOOST_AUTO_TEST_CASE(sigverify_worker_survives_callback_exception)
+{
+    CMasternodeSigVerifier verifier;
+    CKey key;
+    key.MakeNewKey(true);
+
+    std::string errorMessage;
+    std::vector<unsigned char> vchSig, vchSig2;
+    BOOST_CHECK(obfuScationSigner.SignMessage("first message", errorMessage, vchSig, key));
+    BOOST_CHECK(obfuScationSigner.SignMessage("second message", errorMessage, vchSig2, key));
+
+    boost::mutex mutex;
+    std::vector<bool> vResults;
+
+    boost::thread_group threadGroup;
+    threadGroup.create_thread(boost::bind(&CMasternodeSigVerifier::Thread, &verifier));
+    BOOST_CHECK(WaitForThreads(verifier, 1));
+
+    // a throwing callback neither kills the worker nor strands the checks queued after it
+    verifier.VerifyAsync(key.GetPubKey(), vchSig, "first message", boost::bind(&ThrowResult, _1));
+    verifier.VerifyAsync(key.GetPubKey(), vchSig2, "second message", boost::bind(&StoreResult, &mutex, &vResults, _1));
+    BOOST_CHECK(WaitForResults(mutex, vResults, 1));
+    BOOST_CHECK_EQUAL(verifier.GetThreadCount(), 1);
+
+    threadGroup.interrupt_all();
+    threadGroup.join_all();
+    BOOST_CHECK_EQUAL(verifier.GetThreadCount(), 0);
+
+    BOOST_CHECK_EQUAL(vResults.size(), 1U);
+    BOOST_CHECK(vResults[0]);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
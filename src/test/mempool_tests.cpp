@@ -99,4 +99,31 @@ BOOST_AUTO_TEST_CASE(MempoolRemoveTest)
     removed.clear();
 }
 
+BOOST_AUTO_TEST_CASE(MempoolSharedTxTest)
+{
+    CMutableTransaction mtx;
+    mtx.vin.resize(1);
+    mtx.vin[0].scriptSig = CScript() << OP_11;
+    mtx.vout.resize(1);
+    mtx.vout[0].scriptPubKey = CScript() << OP_11 << OP_EQUAL;
+    mtx.vout[0].nValue = 33000LL;
+
+    CTransactionRef ptx = MakeTransactionRef(CTransaction(mtx));
+    BOOST_CHECK_EQUAL(ptx->GetTotalSize(), ::GetSerializeSize(*ptx, SER_NETWORK, PROTOCOL_VERSION));
+
+    CTxMemPool testPool(CFeeRate(0));
+    BOOST_CHECK(!testPool.get(ptx->GetHash()));
+
+    // The pool keeps the transaction it was given rather than a copy
+    testPool.addUnchecked(ptx->GetHash(), CTxMemPoolEntry(ptx, 0, 0, 0.0, 1));
+    BOOST_CHECK(testPool.get(ptx->GetHash()) == ptx);
+    BOOST_CHECK_EQUAL(testPool.GetTotalTxSize(), ptx->GetTotalSize());
+
+    std::list<CTransaction> removed;
+    testPool.remove(*ptx, removed, true);
+    BOOST_CHECK_EQUAL(removed.size(), 1);
+    BOOST_CHECK(!testPool.get(ptx->GetHash()));
+    BOOST_CHECK_EQUAL(ptx.use_count(), 1);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
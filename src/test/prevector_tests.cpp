@@ -0,0 +1,295 @@
+// Copyright (c) 2015 The Bitcoin Core developers
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "prevector.h"
+#include "primitives/block.h"
+#include "random.h"
+#include "script/script.h"
+#include "serialize.h"
+#include "streams.h"
+#include "version.h"
+
+#include <vector>
+
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(prevector_tests)
+
+template <unsigned int N, typename T>
+class prevector_tester
+{
+    typedef std::vector<T> realtype;
+    realtype real_vector;
+
+    typedef prevector<N, T> pretype;
+    pretype pre_vector;
+
+    typedef typename pretype::size_type Size;
+
+    void test()
+    {
+        const pretype& const_pre_vector = pre_vector;
+        BOOST_CHECK_EQUAL(real_vector.size(), pre_vector.size());
+        BOOST_CHECK_EQUAL(real_vector.empty(), pre_vector.empty());
+        for (Size s = 0; s < real_vector.size(); s++) {
+            BOOST_CHECK(real_vector[s] == pre_vector[s]);
+            BOOST_CHECK(&(pre_vector[s]) == &(pre_vector.begin()[s]));
+            BOOST_CHECK(&(pre_vector[s]) == &*(pre_vector.begin() + s));
+            BOOST_CHECK(&(pre_vector[s]) == &*((pre_vector.end() + s) - real_vector.size()));
+        }
+        BOOST_CHECK(pre_vector.capacity() >= pre_vector.size());
+        Size pos = 0;
+        for (const T& v : pre_vector) {
+            BOOST_CHECK(v == real_vector[pos++]);
+        }
+        pos = 0;
+        for (const T& v : const_pre_vector) {
+            BOOST_CHECK(v == real_vector[pos++]);
+        }
+        CDataStream ss1(SER_DISK, 0);
+        CDataStream ss2(SER_DISK, 0);
+        ss1 << real_vector;
+        ss2 << pre_vector;
+        BOOST_CHECK_EQUAL(ss1.size(), ss2.size());
+        for (Size s = 0; s < ss1.size(); s++) {
+            BOOST_CHECK_EQUAL(ss1[s], ss2[s]);
+        }
+        pretype pre_vector_copy;
+        ss2 >> pre_vector_copy;
+        BOOST_CHECK(pre_vector_copy == pre_vector);
+    }
+
+public:
+    void resize(Size s)
+    {
+        real_vector.resize(s);
+        BOOST_CHECK_EQUAL(real_vector.size(), s);
+        pre_vector.resize(s);
+        BOOST_CHECK_EQUAL(pre_vector.size(), s);
+        test();
+    }
+
+    void reserve(Size s)
+    {
+        real_vector.reserve(s);
+        BOOST_CHECK(real_vector.capacity() >= s);
+        pre_vector.reserve(s);
+        BOOST_CHECK(pre_vector.capacity() >= s);
+        test();
+    }
+
+    void insert(Size position, const T& value)
+    {
+        real_vector.insert(real_vector.begin() + position, value);
+        pre_vector.insert(pre_vector.begin() + position, value);
+        test();
+    }
+
+    void insert(Size position, Size count, const T& value)
+    {
+        real_vector.insert(real_vector.begin() + position, count, value);
+        pre_vector.insert(pre_vector.begin() + position, count, value);
+        test();
+    }
+
+    template <typename I>
+    void insert_range(Size position, I first, I last)
+    {
+        real_vector.insert(real_vector.begin() + position, first, last);
+        pre_vector.insert(pre_vector.begin() + position, first, last);
+        test();
+    }
+
+    void erase(Size position)
+    {
+        real_vector.erase(real_vector.begin() + position);
+        pre_vector.erase(pre_vector.begin() + position);
+        test();
+    }
+
+    void erase(Size first, Size last)
+    {
+        real_vector.erase(real_vector.begin() + first, real_vector.begin() + last);
+        pre_vector.erase(pre_vector.begin() + first, pre_vector.begin() + last);
+        test();
+    }
+
+    void update(Size pos, const T& value)
+    {
+        real_vector[pos] = value;
+        pre_vector[pos] = value;
+        test();
+    }
+
+    void push_back(const T& value)
+    {
+        real_vector.push_back(value);
+        pre_vector.push_back(value);
+        test();
+    }
+
+    void pop_back()
+    {
+        real_vector.pop_back();
+        pre_vector.pop_back();
+        test();
+    }
+
+    void clear()
+    {
+        real_vector.clear();
+        pre_vector.clear();
+    }
+
+    void assign(Size n, const T& value)
+    {
+        real_vector.assign(n, value);
+        pre_vector.assign(n, value);
+    }
+
+    Size size()
+    {
+        return real_vector.size();
+    }
+
+    void shrink_to_fit()
+    {
+        pre_vector.shrink_to_fit();
+        test();
+    }
+
+    void swap()
+    {
+        real_vector.swap(real_vector_alt);
+        pre_vector.swap(pre_vector_alt);
+        test();
+    }
+
+    void compare()
+    {
+        BOOST_CHECK_EQUAL(real_vector < real_vector_alt, pre_vector < pre_vector_alt);
+        BOOST_CHECK_EQUAL(real_vector == real_vector_alt, pre_vector == pre_vector_alt);
+    }
+
+    realtype real_vector_alt;
+    pretype pre_vector_alt;
+};
+
+BOOST_AUTO_TEST_CASE(PrevectorTestInt)
+{
+    seed_insecure_rand(true);
+    for (int j = 0; j < 64; j++) {
+        prevector_tester<8, int> test;
+        for (int i = 0; i < 2048; i++) {
+            int r = insecure_rand();
+            if ((r % 4) == 0) {
+                test.insert(insecure_rand() % (test.size() + 1), insecure_rand());
+            }
+            if (test.size() > 0 && ((r >> 2) % 4) == 1) {
+                test.erase(insecure_rand() % test.size());
+            }
+            if (((r >> 4) % 8) == 2) {
+                int new_size = std::max<int>(0, std::min<int>(30, test.size() + (insecure_rand() % 5) - 2));
+                test.resize(new_size);
+            }
+            if (((r >> 7) % 8) == 3) {
+                test.insert(insecure_rand() % (test.size() + 1), 1 + (insecure_rand() % 2), insecure_rand());
+            }
+            if (((r >> 10) % 8) == 4) {
+                int del = std::min<int>(test.size(), 1 + (insecure_rand() % 2));
+                int beg = insecure_rand() % (test.size() + 1 - del);
+                test.erase(beg, beg + del);
+            }
+            if (((r >> 13) % 16) == 5) {
+                test.push_back(insecure_rand());
+            }
+            if (test.size() > 0 && ((r >> 17) % 16) == 6) {
+                test.pop_back();
+            }
+            if (((r >> 21) % 32) == 7) {
+                int values[4];
+                int num = 1 + (insecure_rand() % 4);
+                for (int k = 0; k < num; k++) {
+                    values[k] = insecure_rand();
+                }
+                test.insert_range(insecure_rand() % (test.size() + 1), values, values + num);
+            }
+            if (((r >> 26) % 32) == 8) {
+                int del = std::min<int>(test.size(), 1 + (insecure_rand() % 4));
+                int beg = insecure_rand() % (test.size() + 1 - del);
+                test.erase(beg, beg + del);
+            }
+            r = insecure_rand();
+            if (r % 32 == 9) {
+                test.reserve(insecure_rand() % 32);
+            }
+            if ((r >> 5) % 64 == 10) {
+                test.shrink_to_fit();
+            }
+            if (test.size() > 0 && (r >> 11) % 8 == 3) {
+                test.update(insecure_rand() % test.size(), insecure_rand());
+            }
+            if (((r >> 14) % 1024) == 12) {
+                test.clear();
+            }
+            if (((r >> 24) % 1024) == 13) {
+                test.assign(insecure_rand() % 32, insecure_rand());
+            }
+            if (((r >> 19) % 16) == 14) {
+                test.swap();
+            }
+            if (((r >> 23) % 16) == 15) {
+                test.compare();
+            }
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(script_inline_storage)
+{
+    // The common output scripts are stored without a heap allocation
+    CScript p2pkh = CScript() << OP_DUP << OP_HASH160 << std::vector<unsigned char>(20, 0x01) << OP_EQUALVERIFY << OP_CHECKSIG;
+    CScript p2sh = CScript() << OP_HASH160 << std::vector<unsigned char>(20, 0x02) << OP_EQUAL;
+    CScript p2pk = CScript() << std::vector<unsigned char>(33, 0x03) << OP_CHECKSIG;
+    CScript scriptSig = CScript() << std::vector<unsigned char>(72, 0x04) << std::vector<unsigned char>(33, 0x05);
+    BOOST_CHECK_EQUAL(p2pkh.allocated_memory(), 0U);
+    BOOST_CHECK_EQUAL(p2sh.allocated_memory(), 0U);
+    BOOST_CHECK_EQUAL(p2pk.allocated_memory(), 0U);
+    BOOST_CHECK(scriptSig.allocated_memory() >= scriptSig.size());
+
+    // Count the script allocations made deserializing a block full of them
+    CBlock block;
+    const unsigned int nTx = 2000;
+    for (unsigned int i = 0; i < nTx; i++) {
+        CMutableTransaction tx;
+        tx.vin.resize(1);
+        tx.vin[0].prevout = COutPoint(GetRandHash(), i);
+        tx.vin[0].scriptSig = scriptSig;
+        tx.vout.resize(3);
+        tx.vout[0].scriptPubKey = p2pkh;
+        tx.vout[1].scriptPubKey = p2sh;
+        tx.vout[2].scriptPubKey = p2pk;
+        block.vtx.push_back(CTransaction(tx));
+    }
+
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << block;
+    CBlock blockRead;
+    ss >> blockRead;
+    BOOST_CHECK_EQUAL(blockRead.vtx.size(), nTx);
+
+    unsigned int nInputAllocs = 0, nOutputAllocs = 0;
+    for (const CTransaction& tx : blockRead.vtx) {
+        for (const CTxIn& txin : tx.vin)
+            nInputAllocs += txin.scriptSig.allocated_memory() > 0;
+        for (const CTxOut& txout : tx.vout)
+            nOutputAllocs += txout.scriptPubKey.allocated_memory() > 0;
+    }
+    BOOST_TEST_MESSAGE("script allocations for " << nTx << " transactions: " << nInputAllocs << " scriptSig, " << nOutputAllocs << " scriptPubKey");
+    BOOST_CHECK_EQUAL(nInputAllocs, nTx);
+    BOOST_CHECK_EQUAL(nOutputAllocs, 0U);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
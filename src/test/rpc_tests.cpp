@@ -8,10 +8,14 @@
 #include "rpc/client.h"
 
 #include "base58.h"
+#include "chaintip.h"
+#include "jsonstream.h"
+#include "main.h"
 #include "netbase.h"
 #include "util.h"
 
 #include <boost/algorithm/string.hpp>
+#include <boost/bind.hpp>
 #include <boost/test/unit_test.hpp>
 
 #include <univalue.h>
@@ -265,4 +269,93 @@ BOOST_AUTO_TEST_CASE(rpc_ban)
     BOOST_CHECK_EQUAL(adr.get_str(), "2001:4d48:ac57:400:cacf:e9ff:fe1d:9c63/128");
 }
 
+static void AppendChunk(std::string* pstr, const std::string& strChunk)
+{
+    *pstr += strChunk;
+}
+
+BOOST_AUTO_TEST_CASE(json_stream)
+{
+    UniValue inner(UniValue::VOBJ);
+    inner.push_back(Pair("a", 1));
+    inner.push_back(Pair("b \"quoted\"", "x\ny"));
+
+    UniValue expected(UniValue::VOBJ);
+    expected.push_back(Pair("first", true));
+    UniValue arr(UniValue::VARR);
+    for (int i = 0; i < 100; i++)
+        arr.push_back(inner);
+    arr.push_back(UniValue(UniValue::VARR));
+    expected.push_back(Pair("list", arr));
+    expected.push_back(Pair("a", 1));
+    expected.push_back(Pair("b \"quoted\"", "x\ny"));
+    expected.push_back(Pair("last", NullUniValue));
+
+    // a small chunk size makes the document go out in many pieces
+    std::string strChunks;
+    int64_t nOne = 1;
+    CJSONStream stream(16, boost::bind(&AppendChunk, &strChunks, _1));
+    stream.BeginObject().Key("first").Value(true);
+    stream.Key("list").BeginArray();
+    for (int i = 0; i < 100; i++)
+        stream.BeginObject().Key("a").Value(nOne).Key("b \"quoted\"").Value("x\ny").EndObject();
+    stream.BeginArray().EndArray();
+    stream.EndArray();
+    stream.Pairs(inner).Key("last").Null().EndObject();
+    BOOST_CHECK(stream.Started());
+    stream.Flush();
+
+    BOOST_CHECK_EQUAL(strChunks, expected.write());
+}
+
+BOOST_AUTO_TEST_CASE(rpc_chaintip_snapshot)
+{
+    int nHeight;
+    uint256 hashTip;
+    {
+        LOCK(cs_main);
+        nHeight = chainActive.Height();
+        hashTip = chainActive.Tip()->GetBlockHash();
+    }
+
+    CChainTipSnapshotRef tip = GetChainTipSnapshot();
+    BOOST_CHECK_EQUAL(tip->nHeight, nHeight);
+    BOOST_CHECK(tip->hashTip == hashTip);
+
+    // the snapshot RPCs report the same chain as cs_main would
+    BOOST_CHECK_EQUAL(CallRPC("getblockcount").get_int(), nHeight);
+    BOOST_CHECK_EQUAL(CallRPC("getbestblockhash").get_str(), hashTip.GetHex());
+    UniValue info = CallRPC("getblockchaininfo");
+    BOOST_CHECK_EQUAL(find_value(info.get_obj(), "blocks").get_int(), nHeight);
+    BOOST_CHECK_EQUAL(find_value(info.get_obj(), "bestblockhash").get_str(), hashTip.GetHex());
+    info = CallRPC("getmempoolinfo");
+    BOOST_CHECK_EQUAL(find_value(info.get_obj(), "size").get_int64(), (int64_t)mempool.size());
+    BOOST_CHECK_EQUAL(find_value(info.get_obj(), "bytes").get_int64(), (int64_t)mempool.GetTotalTxSize());
+}
+
+BOOST_AUTO_TEST_CASE(rpc_batch)
+{
+    // a batch of read-only lookups is executed in parallel, replies keep the request order
+    UniValue vReq(UniValue::VARR);
+    for (int i = 0; i < 10; i++) {
+        UniValue req(UniValue::VOBJ);
+        req.push_back(Pair("id", i));
+        req.push_back(Pair("method", i % 2 ? "getblockcount" : "getbestblockhash"));
+        vReq.push_back(req);
+    }
+    UniValue vReply;
+    BOOST_CHECK(vReply.read(JSONRPCExecBatch(vReq)));
+    BOOST_CHECK_EQUAL(vReply.size(), 10);
+    for (int i = 0; i < 10; i++) {
+        BOOST_CHECK_EQUAL(find_value(vReply[i].get_obj(), "id").get_int(), i);
+        BOOST_CHECK(find_value(vReply[i].get_obj(), "error").isNull());
+        BOOST_CHECK_EQUAL(find_value(vReply[i].get_obj(), "result").isNum(), i % 2 == 1);
+    }
+
+    UniValue info = CallRPC("getrpcinfo getblockcount");
+    const UniValue& stats = find_value(find_value(info.get_obj(), "methods").get_obj(), "getblockcount");
+    BOOST_CHECK(find_value(stats.get_obj(), "calls").get_int64() >= 5);
+    BOOST_CHECK(find_value(find_value(info.get_obj(), "methods").get_obj(), "getbestblockhash").isNull());
+}
+
 BOOST_AUTO_TEST_SUITE_END()
@@ -3,7 +3,12 @@
 // file COPYING or http://www.opensource.org/licenses/mit-license.php.
 
 #include "serialize.h"
+#include "primitives/transaction.h"
+#include "protocol.h"
+#include "random.h"
 #include "streams.h"
+#include "uint256.h"
+#include "utiltime.h"
 
 #include <stdint.h>
 
@@ -161,4 +166,64 @@ BOOST_AUTO_TEST_CASE(insert_delete)
     BOOST_CHECK_EQUAL(ss.size(), 0);
 }
 
+template <typename T>
+static void CheckFlatVector(const std::vector<T>& v, const char* name)
+{
+    // Element by element, the way vectors of other types are serialized
+    int64_t nStart = GetTimeMicros();
+    CDataStream ssElements(SER_NETWORK, PROTOCOL_VERSION);
+    WriteCompactSize(ssElements, v.size());
+    for (const T& item : v)
+        ssElements << item;
+    int64_t nElementsTime = GetTimeMicros() - nStart;
+
+    nStart = GetTimeMicros();
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << v;
+    int64_t nFlatTime = GetTimeMicros() - nStart;
+
+    BOOST_CHECK(ss.str() == ssElements.str());
+    BOOST_CHECK_EQUAL(GetSerializeSize(v, SER_NETWORK, PROTOCOL_VERSION), ss.size());
+
+    nStart = GetTimeMicros();
+    std::vector<T> vRead;
+    ss >> vRead;
+    int64_t nReadTime = GetTimeMicros() - nStart;
+    BOOST_CHECK_EQUAL(vRead.size(), v.size());
+    BOOST_CHECK(ss.empty());
+    ss << vRead;
+    BOOST_CHECK(ss.str() == ssElements.str());
+
+    BOOST_TEST_MESSAGE(v.size() << " " << name << ": " << nElementsTime << "us element by element, " << nFlatTime << "us flat, " << nReadTime << "us flat read");
+}
+
+BOOST_AUTO_TEST_CASE(flat_vectors)
+{
+    seed_insecure_rand(true);
+    // the size of a full inv or getdata message
+    const unsigned int nCount = 50000;
+
+    std::vector<uint256> vHashes;
+    std::vector<CInv> vInv;
+    std::vector<COutPoint> vOutPoints;
+    for (unsigned int i = 0; i < nCount; i++) {
+        uint256 hash = GetRandHash();
+        vHashes.push_back(hash);
+        vInv.push_back(CInv(1 + insecure_rand() % 2, hash));
+        vOutPoints.push_back(COutPoint(hash, insecure_rand()));
+    }
+
+    CheckFlatVector(vHashes, "uint256");
+    CheckFlatVector(vInv, "CInv");
+    CheckFlatVector(vOutPoints, "COutPoint");
+    CheckFlatVector(std::vector<CInv>(), "CInv");
+
+    // A truncated vector fails to read instead of reading garbage
+    CDataStream ss(SER_NETWORK, PROTOCOL_VERSION);
+    ss << vInv;
+    ss.resize(ss.size() - 1);
+    std::vector<CInv> vRead;
+    BOOST_CHECK_THROW(ss >> vRead, std::ios_base::failure);
+}
+
 BOOST_AUTO_TEST_SUITE_END()
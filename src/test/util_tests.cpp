@@ -426,4 +426,31 @@ BOOST_AUTO_TEST_CASE(test_FormatSubVersion)
     BOOST_CHECK_EQUAL(FormatSubVersion("Test", 99900, comments),std::string("/Test:0.9.99(comment1)/"));
     BOOST_CHECK_EQUAL(FormatSubVersion("Test", 99900, comments2),std::string("/Test:0.9.99(comment1; comment2)/"));
 }
+
+BOOST_AUTO_TEST_CASE(test_LogPrint)
+{
+    // arguments of a disabled category are never evaluated
+    bool fDebugOld = fDebug;
+    fDebug = false;
+    int nEvaluated = 0;
+    LogPrint("net", "%d\n", ++nEvaluated);
+    BOOST_CHECK_EQUAL(nEvaluated, 0);
+    BOOST_CHECK(!LogAcceptCategory("net"));
+    BOOST_CHECK(LogAcceptCategory(NULL));
+    BOOST_CHECK(LogAcceptCategoryBit(LOG_CATEGORY_ALWAYS));
+    BOOST_CHECK(!LogAcceptCategoryBit(LogCategoryBit("net")));
+    fDebug = fDebugOld;
+
+    // every category has a bit of its own, unknown ones share LOG_CATEGORY_OTHER
+    BOOST_CHECK_EQUAL(LogCategoryBit(NULL), LOG_CATEGORY_ALWAYS);
+    BOOST_CHECK(LogCategoryBit("net") != LogCategoryBit("mempool"));
+    BOOST_CHECK_EQUAL(LogCategoryBit("net") & (LogCategoryBit("net") - 1), 0U);
+    BOOST_CHECK_EQUAL(LogCategoryBit("no such category"), LOG_CATEGORY_OTHER);
+    BOOST_CHECK(LogCategoryBit("addrman") != LOG_CATEGORY_OTHER);
+    BOOST_CHECK(LogCategoryBit("staking") != LOG_CATEGORY_OTHER);
+
+    // a message without arguments isn't a format string
+    BOOST_CHECK_EQUAL(LogFormat("100%"), "100%");
+    BOOST_CHECK_EQUAL(LogFormat("%d%%", 100), "100%");
+}
 BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,211 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxosnapshot.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "random.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/test/unit_test.hpp>
+
+BOOST_AUTO_TEST_SUITE(utxosnapshot_tests)
+
+namespace
+{
+struct SnapshotSource {
+    std::vector<uint256> vHashes;
+    std::vector<CBlockIndex> vIndex;
+    std::vector<CBlockIndex*> vChain;
+    CCoinsViewDB coinsdb;
+    CZerocoinDB zerocoindb;
+    std::vector<std::pair<uint256, uint256> > vMints, vSpends;
+
+    SnapshotSource(int nBlocks) : vHashes(nBlocks), vIndex(nBlocks), coinsdb(1 << 20, true), zerocoindb(1 << 20, true)
+    {
+        CBlock block = Params().GenesisBlock();
+        for (int i = 0; i < nBlocks; i++) {
+            vIndex[i] = CBlockIndex(block);
+            vHashes[i] = block.GetHash();
+            vIndex[i].phashBlock = &vHashes[i];
+            vIndex[i].pprev = i > 0 ? &vIndex[i - 1] : NULL;
+            vIndex[i].nHeight = i;
+            vIndex[i].nTx = 1;
+            vIndex[i].nStatus = BLOCK_VALID_SCRIPTS | BLOCK_HAVE_DATA | BLOCK_HAVE_UNDO;
+            vChain.push_back(&vIndex[i]);
+
+            block.hashPrevBlock = vHashes[i];
+            block.nTime += 60;
+            block.nNonce = i;
+        }
+
+        CCoinsViewCache cache(&coinsdb);
+        for (int i = 0; i < 100; i++) {
+            CCoinsModifier coins = cache.ModifyCoins(GetRandHash());
+            coins->nVersion = 1;
+            coins->nHeight = i % nBlocks;
+            coins->vout.resize(1 + i % 2);
+            for (unsigned int j = 0; j < coins->vout.size(); j++) {
+                coins->vout[j].nValue = 100 * i + j + 1;
+                coins->vout[j].scriptPubKey = CScript() << OP_TRUE;
+            }
+        }
+        cache.SetBestBlock(vHashes.back());
+        BOOST_CHECK(cache.Flush());
+
+        for (int i = 0; i < 5; i++) {
+            vMints.push_back(std::make_pair(GetRandHash(), GetRandHash()));
+            vSpends.push_back(std::make_pair(GetRandHash(), GetRandHash()));
+        }
+        BOOST_CHECK(zerocoindb.WriteCoinMintHashes(vMints));
+        BOOST_CHECK(zerocoindb.WriteCoinSpendHashes(vSpends));
+        BOOST_CHECK(zerocoindb.WriteAccumulatorValue(7, CBigNum(12345)));
+    }
+
+    bool Write(const boost::filesystem::path& path, CUTXOSnapshotInfo& info)
+    {
+        const leveldb::Snapshot* pcoinssnapshot = coinsdb.GetSnapshot();
+        const leveldb::Snapshot* pzerocoinsnapshot = zerocoindb.GetSnapshot();
+        bool fOk = WriteUTXOSnapshot(path, vChain, &coinsdb, pcoinssnapshot, &zerocoindb, pzerocoinsnapshot, info);
+        coinsdb.ReleaseSnapshot(pcoinssnapshot);
+        zerocoindb.ReleaseSnapshot(pzerocoinsnapshot);
+        return fOk;
+    }
+};
+} // anon namespace
+
+BOOST_AUTO_TEST_CASE(snapshot_roundtrip)
+{
+    SnapshotSource source(20);
+    boost::filesystem::path path = GetTempPath() / strprintf("utxosnapshot_%s", GetRandHash().ToString());
+
+    CUTXOSnapshotInfo written;
+    BOOST_CHECK(source.Write(path, written));
+    BOOST_CHECK(written.hashBlock == source.vHashes.back());
+    BOOST_CHECK_EQUAL(written.nHeight, 19);
+    BOOST_CHECK_EQUAL(written.nBlocks, 20U);
+    BOOST_CHECK_EQUAL(written.nCoins, 100U);
+    BOOST_CHECK_EQUAL(written.nMints, 5U);
+    BOOST_CHECK_EQUAL(written.nSpends, 5U);
+    BOOST_CHECK_EQUAL(written.nAccumulatorValues, 1U);
+    ModifiableParams()->setSnapshot(written.nHeight, written.hashBlock, written.hashSnapshot);
+
+    CBlockTreeDB blocktree(1 << 20, true);
+    CCoinsViewDB coinsdb(1 << 20, true);
+    CZerocoinDB zerocoindb(1 << 20, true);
+    CUTXOSnapshotInfo loaded;
+    std::string strError;
+    BOOST_CHECK(LoadUTXOSnapshot(path, &blocktree, &coinsdb, &zerocoindb, loaded, strError));
+    BOOST_CHECK_MESSAGE(strError.empty(), strError);
+    BOOST_CHECK(loaded.hashBlock == written.hashBlock);
+    BOOST_CHECK(loaded.hashCoins == written.hashCoins);
+    BOOST_CHECK(loaded.hashSnapshot == written.hashSnapshot);
+    BOOST_CHECK_EQUAL(loaded.nCoins, written.nCoins);
+
+    BOOST_CHECK(coinsdb.GetBestBlock() == written.hashBlock);
+    int nHeight = -1;
+    bool fTxIndexLoaded = true;
+    BOOST_CHECK(blocktree.ReadInt("snapshotheight", nHeight) && nHeight == 19);
+    BOOST_CHECK(blocktree.ReadFlag("txindex", fTxIndexLoaded) && !fTxIndexLoaded);
+
+    uint256 txid;
+    BOOST_CHECK(zerocoindb.ReadCoinMint(source.vMints[3].first, txid) && txid == source.vMints[3].second);
+    BOOST_CHECK(zerocoindb.ReadCoinSpend(source.vSpends[1].first, txid) && txid == source.vSpends[1].second);
+    CBigNum bnValue;
+    BOOST_CHECK(zerocoindb.ReadAccumulatorValue(7, bnValue) && bnValue == CBigNum(12345));
+
+    // writing the imported state again gives the same file
+    CUTXOSnapshotInfo rewritten;
+    const leveldb::Snapshot* psnapshot = coinsdb.GetSnapshot();
+    const leveldb::Snapshot* pzerocoinsnapshot = zerocoindb.GetSnapshot();
+    boost::filesystem::path path2 = path;
+    path2 += ".2";
+    BOOST_CHECK(WriteUTXOSnapshot(path2, source.vChain, &coinsdb, psnapshot, &zerocoindb, pzerocoinsnapshot, rewritten));
+    coinsdb.ReleaseSnapshot(psnapshot);
+    zerocoindb.ReleaseSnapshot(pzerocoinsnapshot);
+    BOOST_CHECK(rewritten.hashCoins == written.hashCoins);
+    BOOST_CHECK(rewritten.hashSnapshot == written.hashSnapshot);
+
+    boost::filesystem::remove(path);
+    boost::filesystem::remove(path2);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_corruption)
+{
+    SnapshotSource source(5);
+    boost::filesystem::path path = GetTempPath() / strprintf("utxosnapshot_%s", GetRandHash().ToString());
+    CUTXOSnapshotInfo info;
+    BOOST_CHECK(source.Write(path, info));
+
+    // flip one byte in the middle of the records
+    FILE* file = fopen(path.string().c_str(), "r+b");
+    BOOST_REQUIRE(file != NULL);
+    long nPos = (long)boost::filesystem::file_size(path) / 2;
+    fseek(file, nPos, SEEK_SET);
+    int ch = fgetc(file);
+    fseek(file, nPos, SEEK_SET);
+    fputc(ch ^ 0x01, file);
+    fclose(file);
+
+    CBlockTreeDB blocktree(1 << 20, true);
+    CCoinsViewDB coinsdb(1 << 20, true);
+    CZerocoinDB zerocoindb(1 << 20, true);
+    std::string strError;
+    BOOST_CHECK(!LoadUTXOSnapshot(path, &blocktree, &coinsdb, &zerocoindb, info, strError));
+    BOOST_CHECK_EQUAL(strError, "checksum mismatch");
+    BOOST_CHECK(coinsdb.GetBestBlock() == uint256(0));
+
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_CASE(snapshot_unknown)
+{
+    SnapshotSource source(10);
+    boost::filesystem::path path = GetTempPath() / strprintf("utxosnapshot_%s", GetRandHash().ToString());
+    CUTXOSnapshotInfo info;
+    BOOST_CHECK(source.Write(path, info));
+
+    // a well-formed file is still refused unless the chain parameters list it
+    {
+        CBlockTreeDB blocktree(1 << 20, true);
+        CCoinsViewDB coinsdb(1 << 20, true);
+        CZerocoinDB zerocoindb(1 << 20, true);
+        CUTXOSnapshotInfo loaded;
+        std::string strError;
+        BOOST_CHECK(!LoadUTXOSnapshot(path, &blocktree, &coinsdb, &zerocoindb, loaded, strError));
+        BOOST_CHECK(strError.find("is known to this version") != std::string::npos);
+        BOOST_CHECK(coinsdb.GetBestBlock() == uint256(0));
+    }
+
+    // so is one whose contents differ from the listed snapshot at the same block
+    ModifiableParams()->setSnapshot(info.nHeight, info.hashBlock, GetRandHash());
+    {
+        CBlockTreeDB blocktree(1 << 20, true);
+        CCoinsViewDB coinsdb(1 << 20, true);
+        CZerocoinDB zerocoindb(1 << 20, true);
+        CUTXOSnapshotInfo loaded;
+        std::string strError;
+        BOOST_CHECK(!LoadUTXOSnapshot(path, &blocktree, &coinsdb, &zerocoindb, loaded, strError));
+        BOOST_CHECK(strError.find("doesn't match the expected") != std::string::npos);
+        BOOST_CHECK(coinsdb.GetBestBlock() == uint256(0));
+    }
+
+    ModifiableParams()->setSnapshot(info.nHeight, info.hashBlock, info.hashSnapshot);
+    {
+        CBlockTreeDB blocktree(1 << 20, true);
+        CCoinsViewDB coinsdb(1 << 20, true);
+        CZerocoinDB zerocoindb(1 << 20, true);
+        CUTXOSnapshotInfo loaded;
+        std::string strError;
+        BOOST_CHECK(LoadUTXOSnapshot(path, &blocktree, &coinsdb, &zerocoindb, loaded, strError));
+        BOOST_CHECK(coinsdb.GetBestBlock() == info.hashBlock);
+    }
+
+    boost::filesystem::remove(path);
+}
+
+BOOST_AUTO_TEST_SUITE_END()
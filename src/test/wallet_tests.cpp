@@ -305,4 +305,50 @@ BOOST_AUTO_TEST_CASE(coin_selection_tests)
     empty_wallet();
 }
 
+BOOST_AUTO_TEST_CASE(combine_dust_packer_tests)
+{
+    CBitcoinAddress address;
+    const CAmount nThreshold = 1 * COIN;
+    const CAmount nInputFee = 1000;
+    deque<CCombinePlan> vPlans;
+
+    empty_wallet();
+
+    // coins worth no more than their input fee stay, and one coin isn't combined with itself
+    add_coin(nInputFee);
+    add_coin(5*CENT);
+    CWallet::PackCombinePlans(address, vCoins, nThreshold, nInputFee, vPlans);
+    BOOST_CHECK(vPlans.empty());
+
+    // smallest first, a transaction is cut as soon as it passes the threshold
+    add_coin(80*CENT); add_coin(60*CENT); add_coin(2*CENT); add_coin(70*CENT); add_coin(50*CENT);
+    CWallet::PackCombinePlans(address, vCoins, nThreshold, nInputFee, vPlans);
+    BOOST_REQUIRE_EQUAL(vPlans.size(), 2U);
+    BOOST_CHECK_EQUAL(vPlans[0].vInputs.size(), 4U);
+    BOOST_CHECK_EQUAL(vPlans[0].nValue, 117*CENT);
+    BOOST_CHECK(!vPlans[0].fMaxSize);
+    BOOST_CHECK_EQUAL(vPlans[1].vInputs.size(), 2U);
+    BOOST_CHECK_EQUAL(vPlans[1].nValue, 150*CENT);
+    BOOST_CHECK(vPlans[0].address == address);
+
+    // every input is planned once
+    set<COutPoint> setInputs;
+    BOOST_FOREACH(const CCombinePlan& plan, vPlans)
+        setInputs.insert(plan.vInputs.begin(), plan.vInputs.end());
+    BOOST_CHECK_EQUAL(setInputs.size(), 6U);
+
+    // lots of tiny coins are cut at the standard size, below the threshold
+    empty_wallet();
+    vPlans.clear();
+    for (int i = 0; i < 1000; i++)
+        add_coin(10000);
+    CWallet::PackCombinePlans(address, vCoins, nThreshold, nInputFee, vPlans);
+    BOOST_REQUIRE(vPlans.size() > 1);
+    BOOST_CHECK(vPlans[0].fMaxSize);
+    BOOST_CHECK(vPlans[0].nValue < nThreshold);
+    BOOST_CHECK(90 + 190 * vPlans[0].vInputs.size() < MAX_STANDARD_TX_SIZE);
+    BOOST_CHECK(90 + 190 * vPlans[0].vInputs.size() >= MAX_STANDARD_TX_SIZE - 200);
+    empty_wallet();
+}
+
 BOOST_AUTO_TEST_SUITE_END()
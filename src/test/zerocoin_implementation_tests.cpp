@@ -466,6 +466,26 @@ BOOST_AUTO_TEST_CASE(bignum_setdecimal)
 	BOOST_CHECK_MESSAGE(bnDec == bnHex, "CBigNum.SetDec() does not work correctly");
 }
 
+BOOST_AUTO_TEST_CASE(bignum_fixedbase_multipow)
+{
+    libzerocoin::ZerocoinParams* params = Params().Zerocoin_Params(false);
+    const libzerocoin::IntegerGroupParams& group = params->coinCommitmentGroup;
+
+    for (int i = 0; i < 5; i++) {
+        CBigNum x = CBigNum::randBignum(group.groupOrder);
+        CBigNum y = CBigNum::randBignum(group.groupOrder);
+        CBigNum expected = group.g.pow_mod(x, group.modulus).mul_mod(group.h.pow_mod(y, group.modulus), group.modulus);
+        BOOST_CHECK_MESSAGE(group.pow_g(x, group.modulus) == group.g.pow_mod(x, group.modulus), "fixed-base pow_g differs from pow_mod");
+        BOOST_CHECK_MESSAGE(group.pow_gh(x, y, group.modulus) == expected, "fixed-base pow_gh differs from pow_mod");
+        BOOST_CHECK_MESSAGE(CBigNum::multi_pow_mod(group.g, x, group.h, y, group.modulus) == expected, "multi_pow_mod differs from pow_mod");
+
+        // negative exponents go through the inverse of the base
+        CBigNum z = CBigNum::randBignum(group.groupOrder);
+        CBigNum expectedNeg = expected.mul_mod(group.g.pow_mod(-z, group.modulus), group.modulus);
+        BOOST_CHECK_MESSAGE(CBigNum::multi_pow_mod(group.g, x, group.h, y, group.g, -z, group.modulus) == expectedNeg, "multi_pow_mod differs with a negative exponent");
+    }
+}
+
 BOOST_AUTO_TEST_CASE(test_checkpoints)
 {
     BOOST_CHECK_MESSAGE(AccumulatorCheckpoints::LoadCheckpoints("main"), "failed to load checkpoints");
@@ -517,4 +537,46 @@ BOOST_AUTO_TEST_CASE(deterministic_tests)
 }
 
 
+BOOST_AUTO_TEST_CASE(block_pubcoin_index)
+{
+    CZerocoinDB db(1 << 20, true);
+    uint256 hashBlock = GetRandHash();
+
+    std::map<CoinDenomination, std::vector<CBigNum> > mapPubcoins;
+    mapPubcoins[ZQ_ONE].push_back(CBigNum(11));
+    mapPubcoins[ZQ_ONE].push_back(CBigNum(12));
+    mapPubcoins[ZQ_TEN]; // minted, but every mint was filtered out
+    BOOST_CHECK(db.WriteBlockPubcoins(hashBlock, mapPubcoins));
+
+    std::vector<CBigNum> vValues;
+    BOOST_CHECK(db.ReadBlockPubcoins(hashBlock, ZQ_ONE, vValues));
+    BOOST_CHECK(vValues == mapPubcoins[ZQ_ONE]);
+    BOOST_CHECK(db.ReadBlockPubcoins(hashBlock, ZQ_TEN, vValues));
+    BOOST_CHECK(vValues.empty());
+    BOOST_CHECK(!db.ReadBlockPubcoins(hashBlock, ZQ_FIVE, vValues));
+    BOOST_CHECK(!db.ReadBlockPubcoins(GetRandHash(), ZQ_ONE, vValues));
+}
+
+
+BOOST_AUTO_TEST_CASE(mintpool_count_index)
+{
+    CMintPool mintPool;
+    uint256 hashA = GetRandHash();
+    uint256 hashB = GetRandHash();
+    mintPool.Add(std::make_pair(hashA, 1));
+    mintPool.Add(std::make_pair(hashB, 2));
+    BOOST_CHECK(mintPool.HasCount(1));
+    BOOST_CHECK(mintPool.HasCount(2));
+    BOOST_CHECK(!mintPool.HasCount(3));
+    BOOST_CHECK_EQUAL(mintPool.CountOfLastGenerated(), 2U);
+
+    mintPool.Remove(hashA);
+    BOOST_CHECK(!mintPool.HasCount(1));
+    BOOST_CHECK(mintPool.HasCount(2));
+    BOOST_CHECK_EQUAL(mintPool.CountOfLastRemoved(), 1U);
+
+    mintPool.Reset();
+    BOOST_CHECK(!mintPool.HasCount(2));
+}
+
 BOOST_AUTO_TEST_SUITE_END()
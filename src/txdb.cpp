@@ -6,11 +6,13 @@
 
 #include "txdb.h"
 
+#include "coinstats.h"
 #include "main.h"
 #include "pow.h"
 #include "uint256.h"
 #include "accumulators.h"
 
+#include <algorithm>
 #include <stdint.h>
 
 #include <boost/thread.hpp>
@@ -119,55 +121,67 @@ bool CBlockTreeDB::ReadLastBlockFile(int& nFile)
 
 bool CCoinsViewDB::GetStats(CCoinsStats& stats) const
 {
-    /* It seems that there are no "const iterators" for LevelDB.  Since we
-       only need read operations on it, use a const-cast to get around
-       that restriction.  */
-    boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator());
-    pcursor->SeekToFirst();
+    if (!GetUTXOStats(this, NULL, stats, COINSTATS_HASH_SERIALIZED, 1))
+        return false;
+    stats.nHeight = mapBlockIndex.find(stats.hashBlock)->second->nHeight;
+    return true;
+}
+
+const leveldb::Snapshot* CCoinsViewDB::GetSnapshot()
+{
+    return db.GetSnapshot();
+}
+
+void CCoinsViewDB::ReleaseSnapshot(const leveldb::Snapshot* psnapshot)
+{
+    db.ReleaseSnapshot(psnapshot);
+}
+
+bool CCoinsViewDB::GetCoins(const leveldb::Snapshot* psnapshot, const uint256& txid, CCoins& coins) const
+{
+    return db.Read(psnapshot, make_pair('c', txid), coins);
+}
+
+uint256 CCoinsViewDB::GetBestBlock(const leveldb::Snapshot* psnapshot) const
+{
+    uint256 hashBestChain;
+    if (!db.Read(psnapshot, 'B', hashBestChain))
+        return uint256(0);
+    return hashBestChain;
+}
+
+bool CCoinsViewDB::ForEachCoins(const leveldb::Snapshot* psnapshot, unsigned int nBegin, unsigned int nEnd,
+    const boost::function<bool(const uint256&, const CCoins&, unsigned int)>& func) const
+{
+    if (nBegin >= nEnd)
+        return true;
+
+    // keys are 'c' followed by the raw txid bytes, so each first byte is one contiguous range
+    boost::scoped_ptr<leveldb::Iterator> pcursor(const_cast<CLevelDBWrapper*>(&db)->NewIterator(psnapshot));
+    char startKey[2] = {'c', (char)nBegin};
+    pcursor->Seek(leveldb::Slice(startKey, 2));
 
-    CHashWriter ss(SER_GETHASH, PROTOCOL_VERSION);
-    stats.hashBlock = GetBestBlock();
-    ss << stats.hashBlock;
-    CAmount nTotalAmount = 0;
     while (pcursor->Valid()) {
         boost::this_thread::interruption_point();
         try {
             leveldb::Slice slKey = pcursor->key();
+            if (slKey.size() < 2 || slKey[0] != 'c' || (unsigned char)slKey[1] >= nEnd)
+                break;
             CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
             char chType;
-            ssKey >> chType;
-            if (chType == 'c') {
-                leveldb::Slice slValue = pcursor->value();
-                CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
-                CCoins coins;
-                ssValue >> coins;
-                uint256 txhash;
-                ssKey >> txhash;
-                ss << txhash;
-                ss << VARINT(coins.nVersion);
-                ss << (coins.fCoinBase ? 'c' : 'n');
-                ss << VARINT(coins.nHeight);
-                stats.nTransactions++;
-                for (unsigned int i = 0; i < coins.vout.size(); i++) {
-                    const CTxOut& out = coins.vout[i];
-                    if (!out.IsNull()) {
-                        stats.nTransactionOutputs++;
-                        ss << VARINT(i + 1);
-                        ss << out;
-                        nTotalAmount += out.nValue;
-                    }
-                }
-                stats.nSerializedSize += 32 + slValue.size();
-                ss << VARINT(0);
-            }
+            uint256 txhash;
+            ssKey >> chType >> txhash;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            CCoins coins;
+            ssValue >> coins;
+            if (!func(txhash, coins, slValue.size()))
+                return true;
             pcursor->Next();
         } catch (std::exception& e) {
             return error("%s : Deserialize or I/O error - %s", __func__, e.what());
         }
     }
-    stats.nHeight = mapBlockIndex.find(GetBestBlock())->second->nHeight;
-    stats.hashSerialized = ss.GetHash();
-    stats.nTotalAmount = nTotalAmount;
     return true;
 }
 
@@ -319,6 +333,39 @@ bool CZerocoinDB::ReadCoinMint(const uint256& hashPubcoin, uint256& hashTx)
     return Read(make_pair('m', hashPubcoin), hashTx);
 }
 
+bool CZerocoinDB::ReadCoinMints(const std::vector<uint256>& vHashPubcoins, std::map<uint256, uint256>& mapHashTx)
+{
+    // seek in the database's key order with a single iterator instead of a point lookup per mint;
+    // sort the serialized keys, LevelDB compares them bytewise unlike uint256::operator<
+    std::vector<std::pair<std::string, uint256> > vKeys;
+    vKeys.reserve(vHashPubcoins.size());
+    for (const uint256& hashPubcoin : vHashPubcoins) {
+        CDataStream ssKey(SER_DISK, CLIENT_VERSION);
+        ssKey << make_pair('m', hashPubcoin);
+        vKeys.push_back(std::make_pair(ssKey.str(), hashPubcoin));
+    }
+    std::sort(vKeys.begin(), vKeys.end());
+
+    boost::scoped_ptr<leveldb::Iterator> pcursor(NewIterator());
+    for (const std::pair<std::string, uint256>& key : vKeys) {
+        const uint256& hashPubcoin = key.second;
+        pcursor->Seek(key.first);
+        if (!pcursor->Valid() || pcursor->key() != leveldb::Slice(key.first))
+            continue;
+
+        try {
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            uint256 hashTx;
+            ssValue >> hashTx;
+            mapHashTx[hashPubcoin] = hashTx;
+        } catch (const std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
 bool CZerocoinDB::EraseCoinMint(const CBigNum& bnPubcoin)
 {
     uint256 hash = GetPubCoinHash(bnPubcoin);
@@ -424,3 +471,78 @@ bool CZerocoinDB::EraseAccumulatorValue(const uint32_t& nChecksum)
     LogPrint("zero", "%s : checksum:%d\n", __func__, nChecksum);
     return Erase(make_pair('2', nChecksum));
 }
+
+bool CZerocoinDB::WriteBlockPubcoins(const uint256& hashBlock, const std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> >& mapPubcoins)
+{
+    CLevelDBBatch batch;
+    for (std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> >::const_iterator it = mapPubcoins.begin(); it != mapPubcoins.end(); it++)
+        batch.Write(make_pair('p', make_pair(hashBlock, (int)it->first)), it->second);
+
+    return WriteBatch(batch);
+}
+
+bool CZerocoinDB::ReadBlockPubcoins(const uint256& hashBlock, libzerocoin::CoinDenomination denom, std::vector<CBigNum>& vValues)
+{
+    return Read(make_pair('p', make_pair(hashBlock, (int)denom)), vValues);
+}
+
+bool CZerocoinDB::WriteCoinMintHashes(const std::vector<std::pair<uint256, uint256> >& vMints)
+{
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<uint256, uint256> >::const_iterator it = vMints.begin(); it != vMints.end(); it++)
+        batch.Write(make_pair('m', it->first), it->second);
+    return WriteBatch(batch);
+}
+
+bool CZerocoinDB::WriteCoinSpendHashes(const std::vector<std::pair<uint256, uint256> >& vSpends)
+{
+    CLevelDBBatch batch;
+    for (std::vector<std::pair<uint256, uint256> >::const_iterator it = vSpends.begin(); it != vSpends.end(); it++)
+        batch.Write(make_pair('s', it->first), it->second);
+    return WriteBatch(batch);
+}
+
+/** Walk the entries of one type of a CLevelDBWrapper, deserializing their keys (after the type) and values */
+template <typename K, typename V>
+static bool ForEachOfType(CLevelDBWrapper& db, const leveldb::Snapshot* psnapshot, char chType, const boost::function<bool(const K&, const V&)>& func)
+{
+    boost::scoped_ptr<leveldb::Iterator> pcursor(db.NewIterator(psnapshot));
+    pcursor->Seek(leveldb::Slice(&chType, 1));
+    while (pcursor->Valid()) {
+        boost::this_thread::interruption_point();
+        try {
+            leveldb::Slice slKey = pcursor->key();
+            if (slKey.size() < 1 || slKey[0] != chType)
+                break;
+            CDataStream ssKey(slKey.data(), slKey.data() + slKey.size(), SER_DISK, CLIENT_VERSION);
+            char chKeyType;
+            K key;
+            ssKey >> chKeyType >> key;
+            leveldb::Slice slValue = pcursor->value();
+            CDataStream ssValue(slValue.data(), slValue.data() + slValue.size(), SER_DISK, CLIENT_VERSION);
+            V value;
+            ssValue >> value;
+            if (!func(key, value))
+                break;
+            pcursor->Next();
+        } catch (std::exception& e) {
+            return error("%s : Deserialize or I/O error - %s", __func__, e.what());
+        }
+    }
+    return true;
+}
+
+bool CZerocoinDB::ForEachMint(const leveldb::Snapshot* psnapshot, const boost::function<bool(const uint256&, const uint256&)>& func) const
+{
+    return ForEachOfType(*const_cast<CZerocoinDB*>(this), psnapshot, 'm', func);
+}
+
+bool CZerocoinDB::ForEachSpend(const leveldb::Snapshot* psnapshot, const boost::function<bool(const uint256&, const uint256&)>& func) const
+{
+    return ForEachOfType(*const_cast<CZerocoinDB*>(this), psnapshot, 's', func);
+}
+
+bool CZerocoinDB::ForEachAccumulatorValue(const leveldb::Snapshot* psnapshot, const boost::function<bool(const uint32_t&, const CBigNum&)>& func) const
+{
+    return ForEachOfType(*const_cast<CZerocoinDB*>(this), psnapshot, '2', func);
+}
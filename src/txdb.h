@@ -16,6 +16,8 @@
 #include <utility>
 #include <vector>
 
+#include <boost/function.hpp>
+
 class CCoins;
 class uint256;
 
@@ -40,6 +42,20 @@ public:
     uint256 GetBestBlock() const;
     bool BatchWrite(CCoinsMap& mapCoins, const uint256& hashBlock);
     bool GetStats(CCoinsStats& stats) const;
+
+    //! Consistent view of the coin database for long scans that shouldn't hold cs_main
+    const leveldb::Snapshot* GetSnapshot();
+    void ReleaseSnapshot(const leveldb::Snapshot* psnapshot);
+    uint256 GetBestBlock(const leveldb::Snapshot* psnapshot) const;
+    bool GetCoins(const leveldb::Snapshot* psnapshot, const uint256& txid, CCoins& coins) const;
+
+    /**
+     * Call func for every coins entry of psnapshot whose txid's first byte is in [nBegin, nEnd),
+     * in database order. Ranges are disjoint, so several of them can be walked in parallel.
+     * func returns false to stop the walk.
+     */
+    bool ForEachCoins(const leveldb::Snapshot* psnapshot, unsigned int nBegin, unsigned int nEnd,
+        const boost::function<bool(const uint256&, const CCoins&, unsigned int)>& func) const;
 };
 
 /** Access to the block database (blocks/index/) */
@@ -84,6 +100,8 @@ public:
     bool WriteCoinMintBatch(const std::vector<std::pair<libzerocoin::PublicCoin, uint256> >& mintInfo);
     bool ReadCoinMint(const CBigNum& bnPubcoin, uint256& txHash);
     bool ReadCoinMint(const uint256& hashPubcoin, uint256& hashTx);
+    /** Look up many mints at once, mapHashTx gets the pubcoin hash -> tx hash of those found */
+    bool ReadCoinMints(const std::vector<uint256>& vHashPubcoins, std::map<uint256, uint256>& mapHashTx);
     /** Write z4xt spends to the zerocoinDB in a batch */
     bool WriteCoinSpendBatch(const std::vector<std::pair<libzerocoin::CoinSpend, uint256> >& spendInfo);
     bool ReadCoinSpend(const CBigNum& bnSerial, uint256& txHash);
@@ -94,6 +112,19 @@ public:
     bool WriteAccumulatorValue(const uint32_t& nChecksum, const CBigNum& bnValue);
     bool ReadAccumulatorValue(const uint32_t& nChecksum, CBigNum& bnValue);
     bool EraseAccumulatorValue(const uint32_t& nChecksum);
+
+    //! Pubcoin values of one denomination minted in a block, in block order with invalid outpoints filtered
+    bool WriteBlockPubcoins(const uint256& hashBlock, const std::map<libzerocoin::CoinDenomination, std::vector<CBigNum> >& mapPubcoins);
+    bool ReadBlockPubcoins(const uint256& hashBlock, libzerocoin::CoinDenomination denom, std::vector<CBigNum>& vValues);
+
+    //! Copy mints and spends by their hashes, as read by ForEachMint/ForEachSpend
+    bool WriteCoinMintHashes(const std::vector<std::pair<uint256, uint256> >& vMints);
+    bool WriteCoinSpendHashes(const std::vector<std::pair<uint256, uint256> >& vSpends);
+
+    //! Walk the mints, spends or accumulator values of psnapshot (NULL for the current state)
+    bool ForEachMint(const leveldb::Snapshot* psnapshot, const boost::function<bool(const uint256&, const uint256&)>& func) const;
+    bool ForEachSpend(const leveldb::Snapshot* psnapshot, const boost::function<bool(const uint256&, const uint256&)>& func) const;
+    bool ForEachAccumulatorValue(const leveldb::Snapshot* psnapshot, const boost::function<bool(const uint32_t&, const CBigNum&)>& func) const;
 };
 
 #endif // BITCOIN_TXDB_H
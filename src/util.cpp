@@ -14,6 +14,7 @@
 
 #include "allocators.h"
 #include "chainparamsbase.h"
+#include "logwriter.h"
 #include "random.h"
 #include "serialize.h"
 #include "sync.h"
@@ -222,48 +223,114 @@ static void DebugPrintInit()
     mutexDebugLog = new boost::mutex();
 }
 
-bool LogAcceptCategory(const char* category)
-{
-    if (category != NULL) {
-        if (!fDebug)
-            return false;
-
-        // Give each thread quick access to -debug settings.
-        // This helps prevent issues debugging global destructors,
-        // where mapMultiArgs might be deleted before another
-        // global destructor calls LogPrint()
-        static boost::thread_specific_ptr<set<string> > ptrCategory;
-        if (ptrCategory.get() == NULL) {
-            const vector<string>& categories = mapMultiArgs["-debug"];
-            ptrCategory.reset(new set<string>(categories.begin(), categories.end()));
-            // thread_specific_ptr automatically deletes the set when the thread ends.
-            // "forextrading" is a composite category enabling all ForexTrading-related debug output
-            if (ptrCategory->count(string("forextrading"))) {
-                ptrCategory->insert(string("obfuscation"));
-                ptrCategory->insert(string("swiftx"));
-                ptrCategory->insert(string("masternode"));
-                ptrCategory->insert(string("mnpayments"));
-                ptrCategory->insert(string("zero"));
-                ptrCategory->insert(string("mnbudget"));
-            }
-        }
-        const set<string>& setCategories = *ptrCategory.get();
+/** Categories LogPrint is called with, each gets a bit of the -debug mask */
+static const char* const LOG_CATEGORIES[] = {
+    "addrman", "alert", "bench", "coindb", "db", "debug", "estimatefee", "http", "libevent", "lock",
+    "mempool", "net", "proxy", "prune", "qt", "rand", "reindex", "rpc", "selectcoins", "tor", "zmq",
+    "obfuscation", "swiftx", "masternode", "mnpayments", "zero", "mnbudget", "staking"};
+
+static_assert(ARRAYLEN(LOG_CATEGORIES) < 63, "LOG_CATEGORIES does not fit the -debug mask");
 
-        // if not debugging everything and not debugging specific category, LogPrint does nothing.
-        if (setCategories.count(string("")) == 0 &&
-            setCategories.count(string(category)) == 0)
-            return false;
+//! -debug mask, every bit including LOG_CATEGORY_OTHER for -debug or -debug=1
+static uint64_t nLogCategories = 0;
+static boost::once_flag logCategoriesInitFlag = BOOST_ONCE_INIT;
+
+static uint64_t LogCategoryMask(const std::string& category)
+{
+    for (unsigned int i = 0; i < ARRAYLEN(LOG_CATEGORIES); i++) {
+        if (category == LOG_CATEGORIES[i])
+            return (uint64_t)1 << i;
     }
-    return true;
+    return 0;
+}
+
+static void LogCategoriesInit()
+{
+    // read once, global destructors may call LogPrint() after mapMultiArgs is gone
+    const vector<string>& categories = mapMultiArgs["-debug"];
+    for (const string& category : categories) {
+        if (category == "" || category == "1")
+            nLogCategories = ~(uint64_t)0;
+        // "forextrading" is a composite category enabling all ForexTrading-related debug output
+        else if (category == "forextrading")
+            nLogCategories |= LogCategoryMask("obfuscation") | LogCategoryMask("swiftx") | LogCategoryMask("masternode") |
+                              LogCategoryMask("mnpayments") | LogCategoryMask("zero") | LogCategoryMask("mnbudget");
+        else
+            nLogCategories |= LogCategoryMask(category);
+    }
+}
+
+uint64_t LogCategoryBit(const char* category)
+{
+    if (category == NULL)
+        return LOG_CATEGORY_ALWAYS;
+    for (unsigned int i = 0; i < ARRAYLEN(LOG_CATEGORIES); i++) {
+        if (strcmp(category, LOG_CATEGORIES[i]) == 0)
+            return (uint64_t)1 << i;
+    }
+    return LOG_CATEGORY_OTHER;
+}
+
+bool LogAcceptDebugCategories(uint64_t nCategoryBits)
+{
+    boost::call_once(&LogCategoriesInit, logCategoriesInitFlag);
+    return (nLogCategories & nCategoryBits) != 0;
+}
+
+bool LogAcceptDebugCategory(const char* category)
+{
+    return LogAcceptDebugCategories(LogCategoryBit(category));
+}
+
+/** Name RenameThread gave the calling thread, for JSON log lines */
+static boost::thread_specific_ptr<std::string>* pThreadName = new boost::thread_specific_ptr<std::string>();
+
+std::string GetThreadName()
+{
+    std::string* pname = pThreadName->get();
+    return pname ? *pname : std::string();
+}
+
+static void WriteDebugLog(const std::string& str)
+{
+    boost::mutex::scoped_lock scoped_lock(*mutexDebugLog);
+    if (fReopenDebugLog) {
+        fReopenDebugLog = false;
+        boost::filesystem::path pathDebug = GetDataDir() / "debug.log";
+        if (freopen(pathDebug.string().c_str(), "a", fileout) != NULL)
+            setbuf(fileout, NULL); // unbuffered
+    }
+    fwrite(str.data(), 1, str.size(), fileout);
+}
+
+// never deleted, like mutexDebugLog
+static CLogWriter* plogWriter = new CLogWriter(&WriteDebugLog);
+
+void StartLogWriter(bool fJson)
+{
+    if (fPrintToConsole || !fPrintToDebugLog || !AreBaseParamsConfigured())
+        return;
+    boost::call_once(&DebugPrintInit, debugPrintInitFlag);
+    if (fileout == NULL)
+        return;
+    plogWriter->fJson = fJson;
+    plogWriter->Start();
+}
+
+void StopLogWriter()
+{
+    plogWriter->Stop();
 }
 
-int LogPrintStr(const std::string& str)
+int LogPrintStr(const std::string& str, const char* category)
 {
     int ret = 0; // Returns total number of characters written
     if (fPrintToConsole) {
         // print to console
         ret = fwrite(str.data(), 1, str.size(), stdout);
         fflush(stdout);
+    } else if (plogWriter->IsRunning() && plogWriter->Push(str, category)) {
+        ret = str.size();
     } else if (fPrintToDebugLog && AreBaseParamsConfigured()) {
         static bool fStartedNewLine = true;
         boost::call_once(&DebugPrintInit, debugPrintInitFlag);
@@ -789,6 +856,7 @@ void runCommand(std::string strCommand)
 
 void RenameThread(const char* name)
 {
+    pThreadName->reset(new std::string(name));
 #if defined(PR_SET_NAME)
     // Only the first 15 characters are used (16 - NUL terminator)
     ::prctl(PR_SET_NAME, name, 0, 0, 0);
@@ -62,11 +62,58 @@ extern volatile bool fReopenDebugLog;
 void SetupEnvironment();
 bool SetupNetworking();
 
+/** LogCategoryBit of a NULL category, logged unconditionally */
+static const uint64_t LOG_CATEGORY_ALWAYS = ~(uint64_t)0;
+/** LogCategoryBit of a category that isn't in the list, only enabled by -debug=1 */
+static const uint64_t LOG_CATEGORY_OTHER = (uint64_t)1 << 63;
+
+/** Bit of category in the -debug mask */
+uint64_t LogCategoryBit(const char* category);
+/** Return true if one of the -debug categories in nCategoryBits is enabled */
+bool LogAcceptDebugCategories(uint64_t nCategoryBits);
+/** Return true if a -debug category is enabled, see LogAcceptCategory */
+bool LogAcceptDebugCategory(const char* category);
 /** Return true if log accepts specified category */
-bool LogAcceptCategory(const char* category);
+static inline bool LogAcceptCategory(const char* category)
+{
+    return category == NULL || (fDebug && LogAcceptDebugCategory(category));
+}
+/** Return true if log accepts the category with bit nCategoryBit */
+static inline bool LogAcceptCategoryBit(uint64_t nCategoryBit)
+{
+    return nCategoryBit == LOG_CATEGORY_ALWAYS || (fDebug && LogAcceptDebugCategories(nCategoryBit));
+}
 /** Send a string to the log output */
-int LogPrintStr(const std::string& str);
+int LogPrintStr(const std::string& str, const char* category = NULL);
+/** Default for -logasync, lines still queued are lost if the process crashes */
+static const bool DEFAULT_LOGASYNC = false;
+/**
+ * Hand debug.log output to a writer thread. Callers then only queue their
+ * lines in a buffer of their own thread; timestamps are added and the file
+ * written in the background. With fJson every line becomes a JSON object.
+ */
+void StartLogWriter(bool fJson);
+/** Write out everything queued and go back to writing on the caller's thread */
+void StopLogWriter();
+
+/** Format a log message, a message without arguments is printed as is */
+static inline std::string LogFormat(const char* format)
+{
+    return format;
+}
+template <typename... Args>
+static inline std::string LogFormat(const char* format, const Args&... args)
+{
+    return tfm::format(format, args...);
+}
 
+/**
+ * Print to debug.log if -debug=category switch is given OR category is NULL.
+ * The arguments are only evaluated and formatted when the category is enabled.
+ * category must be a string literal (or NULL): each call site looks up its bit
+ * of the -debug mask once and keeps it.
+ */
+#define LogPrint(category, ...) (LogAcceptCategoryBit([]() { static const uint64_t nCategoryBit = LogCategoryBit(category); return nCategoryBit; }()) ? LogPrintStr(LogFormat(__VA_ARGS__), category) : 0)
 #define LogPrintf(...) LogPrint(NULL, __VA_ARGS__)
 
 /**
@@ -74,13 +121,6 @@ int LogPrintStr(const std::string& str);
  * of this macro-based construction (see tinyformat.h).
  */
 #define MAKE_ERROR_AND_LOG_FUNC(n)                                                              \
-    /**   Print to debug.log if -debug=category switch is given OR category is NULL. */         \
-    template <TINYFORMAT_ARGTYPES(n)>                                                           \
-    static inline int LogPrint(const char* category, const char* format, TINYFORMAT_VARARGS(n)) \
-    {                                                                                           \
-        if (!LogAcceptCategory(category)) return 0;                                             \
-        return LogPrintStr(tfm::format(format, TINYFORMAT_PASSARGS(n)));                        \
-    }                                                                                           \
     /**   Log error and return false */                                                         \
     template <TINYFORMAT_ARGTYPES(n)>                                                           \
     static inline bool error(const char* format, TINYFORMAT_VARARGS(n))                         \
@@ -92,14 +132,9 @@ int LogPrintStr(const std::string& str);
 TINYFORMAT_FOREACH_ARGNUM(MAKE_ERROR_AND_LOG_FUNC)
 
 /**
- * Zero-arg versions of logging and error, these are not covered by
+ * Zero-arg version of error, this is not covered by
  * TINYFORMAT_FOREACH_ARGNUM
  */
-static inline int LogPrint(const char* category, const char* format)
-{
-    if (!LogAcceptCategory(category)) return 0;
-    return LogPrintStr(format);
-}
 static inline bool error(const char* format)
 {
     LogPrintStr(std::string("ERROR: ") + format + "\n");
@@ -205,6 +240,8 @@ std::string HelpMessageOpt(const std::string& option, const std::string& message
 
 void SetThreadPriority(int nPriority);
 void RenameThread(const char* name);
+/** Name RenameThread gave the calling thread, empty if none */
+std::string GetThreadName();
 
 /**
  * .. and a wrapper that just calls func once
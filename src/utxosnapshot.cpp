@@ -0,0 +1,330 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#include "utxosnapshot.h"
+
+#include "chain.h"
+#include "chainparams.h"
+#include "clientversion.h"
+#include "coinstats.h"
+#include "hash.h"
+#include "streams.h"
+#include "txdb.h"
+#include "util.h"
+
+#include <boost/bind.hpp>
+#include <boost/filesystem.hpp>
+
+static const char UTXO_SNAPSHOT_MAGIC[4] = {'u', 't', 'x', 'o'};
+
+/** Serialization version of the file, fixed so that the snapshot hash doesn't change with the client version */
+static const int UTXO_SNAPSHOT_SER_VERSION = 1000000;
+
+/** Records are written to the database in batches of this many */
+static const unsigned int UTXO_SNAPSHOT_BATCH_SIZE = 10000;
+
+namespace
+{
+/** Reads or writes a CAutoFile while hashing everything that passes through */
+class CHashingFile
+{
+private:
+    CAutoFile& file;
+    CHashWriter hasher;
+    const int nType;
+    const int nVersion;
+
+public:
+    CHashingFile(CAutoFile& fileIn) : file(fileIn), hasher(SER_GETHASH, 0), nType(fileIn.GetType()), nVersion(fileIn.GetVersion()) {}
+
+    int GetType() const { return nType; }
+    int GetVersion() const { return nVersion; }
+
+    CHashingFile& write(const char* pch, size_t nSize)
+    {
+        file.write(pch, nSize);
+        hasher.write(pch, nSize);
+        return *this;
+    }
+
+    CHashingFile& read(char* pch, size_t nSize)
+    {
+        file.read(pch, nSize);
+        hasher.write(pch, nSize);
+        return *this;
+    }
+
+    template <typename T>
+    CHashingFile& operator<<(const T& obj)
+    {
+        ::Serialize(*this, obj, nType, nVersion);
+        return *this;
+    }
+
+    template <typename T>
+    CHashingFile& operator>>(T& obj)
+    {
+        ::Unserialize(*this, obj, nType, nVersion);
+        return *this;
+    }
+
+    uint256 GetHash() { return hasher.GetHash(); }
+};
+
+bool WriteCoinsRecord(CHashingFile* pfile, CUTXOSnapshotInfo* pinfo, CMuHash3072* pmuhash, const uint256& txhash, const CCoins& coins, unsigned int nValueSize)
+{
+    *pfile << 'c' << txhash << coins;
+    AddCoinsToMuHash(*pmuhash, txhash, coins);
+    pinfo->nCoins++;
+    return true;
+}
+
+template <typename K, typename V>
+bool WriteRecord(CHashingFile* pfile, char chTag, uint64_t* pnCount, const K& key, const V& value)
+{
+    *pfile << chTag << key << value;
+    (*pnCount)++;
+    return true;
+}
+} // anon namespace
+
+bool WriteUTXOSnapshot(const boost::filesystem::path& path, const std::vector<CBlockIndex*>& vChain,
+    const CCoinsViewDB* pcoinsview, const leveldb::Snapshot* pcoinssnapshot,
+    const CZerocoinDB* pzerocoindb, const leveldb::Snapshot* pzerocoinsnapshot,
+    CUTXOSnapshotInfo& info)
+{
+    if (vChain.empty())
+        return error("%s : no blocks to write", __func__);
+
+    info = CUTXOSnapshotInfo();
+    info.hashBlock = vChain.back()->GetBlockHash();
+    info.nHeight = vChain.back()->nHeight;
+    if (pcoinsview->GetBestBlock(pcoinssnapshot) != info.hashBlock)
+        return error("%s : coin database is not at block %s", __func__, info.hashBlock.ToString());
+
+    boost::filesystem::path pathTmp = path;
+    pathTmp += ".incomplete";
+    FILE* file = fopen(pathTmp.string().c_str(), "wb");
+    CAutoFile fileout(file, SER_DISK, UTXO_SNAPSHOT_SER_VERSION);
+    if (fileout.IsNull())
+        return error("%s : failed to open %s", __func__, pathTmp.string());
+
+    bool fOk = true;
+    try {
+        CHashingFile hashout(fileout);
+        hashout << FLATDATA(UTXO_SNAPSHOT_MAGIC) << UTXO_SNAPSHOT_VERSION;
+        hashout << FLATDATA(Params().MessageStart()) << info.hashBlock << info.nHeight;
+
+        for (unsigned int i = 0; i < vChain.size(); i++) {
+            // the importing node has none of the block files
+            CDiskBlockIndex diskindex(vChain[i]);
+            diskindex.nStatus = vChain[i]->nStatus & BLOCK_VALID_MASK;
+            hashout << 'b' << diskindex;
+            info.nBlocks++;
+        }
+
+        CMuHash3072 muhash;
+        fOk = pcoinsview->ForEachCoins(pcoinssnapshot, 0, 256, boost::bind(&WriteCoinsRecord, &hashout, &info, &muhash, _1, _2, _3)) &&
+              pzerocoindb->ForEachMint(pzerocoinsnapshot, boost::bind(&WriteRecord<uint256, uint256>, &hashout, 'm', &info.nMints, _1, _2)) &&
+              pzerocoindb->ForEachSpend(pzerocoinsnapshot, boost::bind(&WriteRecord<uint256, uint256>, &hashout, 's', &info.nSpends, _1, _2)) &&
+              pzerocoindb->ForEachAccumulatorValue(pzerocoinsnapshot, boost::bind(&WriteRecord<uint32_t, CBigNum>, &hashout, '2', &info.nAccumulatorValues, _1, _2));
+
+        if (fOk) {
+            info.hashCoins = muhash.Finalize();
+            hashout << 'e' << info.nBlocks << info.nCoins << info.nMints << info.nSpends << info.nAccumulatorValues << info.hashCoins;
+            info.hashSnapshot = hashout.GetHash();
+            fileout << info.hashSnapshot;
+            FileCommit(fileout.Get());
+        }
+    } catch (const std::exception& e) {
+        fOk = error("%s : %s", __func__, e.what());
+    }
+    fileout.fclose();
+
+    if (!fOk || !RenameOver(pathTmp, path)) {
+        boost::filesystem::remove(pathTmp);
+        return false;
+    }
+    return true;
+}
+
+static bool VerifySnapshotChecksum(const boost::filesystem::path& path, uint256& hashChecksum, std::string& strError)
+{
+    uintmax_t nSize = boost::filesystem::file_size(path);
+    if (nSize < 32) {
+        strError = "file is truncated";
+        return false;
+    }
+
+    CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, UTXO_SNAPSHOT_SER_VERSION);
+    if (filein.IsNull()) {
+        strError = "unable to open file";
+        return false;
+    }
+
+    CHashingFile hashin(filein);
+    std::vector<char> vBuf(1 << 20);
+    for (uintmax_t nLeft = nSize - 32; nLeft > 0;) {
+        size_t nRead = (size_t)std::min<uintmax_t>(nLeft, vBuf.size());
+        hashin.read(&vBuf[0], nRead);
+        nLeft -= nRead;
+    }
+    filein >> hashChecksum;
+    if (hashChecksum != hashin.GetHash()) {
+        strError = "checksum mismatch";
+        return false;
+    }
+    return true;
+}
+
+bool LoadUTXOSnapshot(const boost::filesystem::path& path, CBlockTreeDB* pblocktreedb, CCoinsViewDB* pcoinsview,
+    CZerocoinDB* pzerocoindb, CUTXOSnapshotInfo& info, std::string& strError)
+{
+    info = CUTXOSnapshotInfo();
+    try {
+        if (!VerifySnapshotChecksum(path, info.hashSnapshot, strError))
+            return false;
+
+        CAutoFile filein(fopen(path.string().c_str(), "rb"), SER_DISK, UTXO_SNAPSHOT_SER_VERSION);
+        if (filein.IsNull()) {
+            strError = "unable to open file";
+            return false;
+        }
+
+        char pchMagic[4];
+        int nVersion;
+        MessageStartChars pchMessageStart;
+        filein >> FLATDATA(pchMagic) >> nVersion;
+        if (memcmp(pchMagic, UTXO_SNAPSHOT_MAGIC, sizeof(pchMagic)) != 0 || nVersion != UTXO_SNAPSHOT_VERSION) {
+            strError = strprintf("not a version %d UTXO snapshot", UTXO_SNAPSHOT_VERSION);
+            return false;
+        }
+        filein >> FLATDATA(pchMessageStart) >> info.hashBlock >> info.nHeight;
+        if (memcmp(pchMessageStart, Params().MessageStart(), sizeof(pchMessageStart)) != 0) {
+            strError = "snapshot is for a different network";
+            return false;
+        }
+
+        // the coins, zerocoin state and block index fields the block hashes don't commit to
+        // are only as good as the node that wrote them: take known snapshots only
+        MapSnapshotData::const_iterator itKnown = Params().Snapshots().find(info.nHeight);
+        if (itKnown == Params().Snapshots().end() || itKnown->second.hashBlock != info.hashBlock) {
+            strError = strprintf("no snapshot at block %s (height %d) is known to this version", info.hashBlock.ToString(), info.nHeight);
+            return false;
+        }
+        if (itKnown->second.hashSnapshot != info.hashSnapshot) {
+            strError = strprintf("snapshot hash %s doesn't match the expected %s", info.hashSnapshot.ToString(), itKnown->second.hashSnapshot.ToString());
+            return false;
+        }
+
+        CUTXOSnapshotInfo infoExpected;
+        uint256 hashPrev = 0;
+        CMuHash3072 muhash;
+        CCoinsMap mapCoins;
+        std::vector<std::pair<uint256, uint256> > vMints, vSpends;
+        bool fEnd = false;
+        while (!fEnd) {
+            char chTag;
+            filein >> chTag;
+            switch (chTag) {
+            case 'b': {
+                CDiskBlockIndex diskindex;
+                filein >> diskindex;
+                // the records must form the chain from the genesis block up to the base block
+                if (diskindex.hashPrev != hashPrev || diskindex.nHeight != (int)info.nBlocks ||
+                    (hashPrev == 0 && diskindex.GetBlockHash() != Params().HashGenesisBlock())) {
+                    strError = strprintf("block index record %u doesn't extend the chain", info.nBlocks);
+                    return false;
+                }
+                if (!pblocktreedb->WriteBlockIndex(diskindex)) {
+                    strError = "failed to write block index";
+                    return false;
+                }
+                hashPrev = diskindex.GetBlockHash();
+                info.nBlocks++;
+                break;
+            }
+            case 'c': {
+                uint256 txhash;
+                CCoins coins;
+                filein >> txhash >> coins;
+                AddCoinsToMuHash(muhash, txhash, coins);
+                CCoinsCacheEntry& entry = mapCoins[txhash];
+                entry.coins.swap(coins);
+                entry.flags = CCoinsCacheEntry::DIRTY;
+                // no best block until the import is complete
+                if (mapCoins.size() >= UTXO_SNAPSHOT_BATCH_SIZE && !pcoinsview->BatchWrite(mapCoins, uint256(0))) {
+                    strError = "failed to write coin database";
+                    return false;
+                }
+                info.nCoins++;
+                break;
+            }
+            case 'm':
+            case 's': {
+                std::vector<std::pair<uint256, uint256> >& vRecords = (chTag == 'm' ? vMints : vSpends);
+                uint256 hash, txid;
+                filein >> hash >> txid;
+                vRecords.push_back(std::make_pair(hash, txid));
+                (chTag == 'm' ? info.nMints : info.nSpends)++;
+                if (vRecords.size() >= UTXO_SNAPSHOT_BATCH_SIZE) {
+                    if (!(chTag == 'm' ? pzerocoindb->WriteCoinMintHashes(vRecords) : pzerocoindb->WriteCoinSpendHashes(vRecords))) {
+                        strError = "failed to write zerocoin database";
+                        return false;
+                    }
+                    vRecords.clear();
+                }
+                break;
+            }
+            case '2': {
+                uint32_t nChecksum;
+                CBigNum bnValue;
+                filein >> nChecksum >> bnValue;
+                if (!pzerocoindb->WriteAccumulatorValue(nChecksum, bnValue)) {
+                    strError = "failed to write zerocoin database";
+                    return false;
+                }
+                info.nAccumulatorValues++;
+                break;
+            }
+            case 'e':
+                filein >> infoExpected.nBlocks >> infoExpected.nCoins >> infoExpected.nMints >> infoExpected.nSpends >> infoExpected.nAccumulatorValues >> infoExpected.hashCoins;
+                fEnd = true;
+                break;
+            default:
+                strError = strprintf("unknown record type %d", (int)chTag);
+                return false;
+            }
+        }
+
+        if (!pcoinsview->BatchWrite(mapCoins, uint256(0)) || !pzerocoindb->WriteCoinMintHashes(vMints) || !pzerocoindb->WriteCoinSpendHashes(vSpends)) {
+            strError = "failed to write databases";
+            return false;
+        }
+
+        info.hashCoins = muhash.Finalize();
+        if (hashPrev != info.hashBlock || info.nBlocks != (uint64_t)info.nHeight + 1 ||
+            info.nBlocks != infoExpected.nBlocks || info.nCoins != infoExpected.nCoins || info.nMints != infoExpected.nMints ||
+            info.nSpends != infoExpected.nSpends || info.nAccumulatorValues != infoExpected.nAccumulatorValues) {
+            strError = "record counts don't match the snapshot's summary";
+            return false;
+        }
+        if (info.hashCoins != infoExpected.hashCoins) {
+            strError = "coins don't match the snapshot's muhash";
+            return false;
+        }
+    } catch (const std::exception& e) {
+        strError = strprintf("deserialize or I/O error - %s", e.what());
+        return false;
+    }
+
+    // transactions before the snapshot can't be indexed
+    CCoinsMap mapEmpty;
+    if (!pblocktreedb->WriteFlag("txindex", false) || !pblocktreedb->WriteInt("snapshotheight", info.nHeight) ||
+        !pcoinsview->BatchWrite(mapEmpty, info.hashBlock)) {
+        strError = "failed to write databases";
+        return false;
+    }
+    return true;
+}
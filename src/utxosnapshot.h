@@ -0,0 +1,78 @@
+// Copyright (c) 2020 The Forex Trading developers
+// Distributed under the MIT/X11 software license, see the accompanying
+// file COPYING or http://www.opensource.org/licenses/mit-license.php.
+
+#ifndef BITCOIN_UTXOSNAPSHOT_H
+#define BITCOIN_UTXOSNAPSHOT_H
+
+#include "uint256.h"
+
+#include <string>
+#include <vector>
+
+#include <boost/filesystem/path.hpp>
+
+class CBlockIndex;
+class CBlockTreeDB;
+class CCoinsViewDB;
+class CZerocoinDB;
+
+namespace leveldb
+{
+class Snapshot;
+}
+
+/**
+ * UTXO snapshot files (dumptxoutset, -loadsnapshot)
+ *
+ * A snapshot holds everything ConnectBlock would have built up to one block
+ * of the active chain: the block index of that chain, the coins database and
+ * the zerocoin mints, spends and accumulator values. It starts with a header
+ * (magic, format version, network magic, base block hash and height),
+ * followed by tagged records and an 'e' record with the record counts and the
+ * muhash of the coins (the value gettxoutsetinfo "muhash" reports for the
+ * base block). The file ends with the double SHA256 of everything before it.
+ *
+ * Records are serialized independently of the client version, so every node
+ * writes the same file for the same base block. That checksum is the snapshot
+ * hash: -loadsnapshot only accepts a file whose base block and snapshot hash
+ * are listed in the chain parameters, as it can't check the history itself.
+ */
+static const int UTXO_SNAPSHOT_VERSION = 2;
+
+/** What a snapshot holds */
+struct CUTXOSnapshotInfo {
+    uint256 hashBlock;
+    int nHeight;
+    uint64_t nBlocks;
+    uint64_t nCoins;
+    uint64_t nMints;
+    uint64_t nSpends;
+    uint64_t nAccumulatorValues;
+    uint256 hashCoins;
+    uint256 hashSnapshot;
+
+    CUTXOSnapshotInfo() : hashBlock(0), nHeight(-1), nBlocks(0), nCoins(0), nMints(0), nSpends(0), nAccumulatorValues(0), hashCoins(0), hashSnapshot(0) {}
+};
+
+/**
+ * Write a snapshot of the chain ending at vChain.back(). The coins and zerocoin
+ * database snapshots must have been taken at that block. The file is written
+ * under a temporary name and renamed once complete.
+ */
+bool WriteUTXOSnapshot(const boost::filesystem::path& path, const std::vector<CBlockIndex*>& vChain,
+    const CCoinsViewDB* pcoinsview, const leveldb::Snapshot* pcoinssnapshot,
+    const CZerocoinDB* pzerocoindb, const leveldb::Snapshot* pzerocoinsnapshot,
+    CUTXOSnapshotInfo& info);
+
+/**
+ * Check the checksum of a snapshot file against CChainParams::Snapshots() and
+ * import it into empty databases.
+ * The coins database's best block is only set once every record has been
+ * written and the muhash of the coins matched, so a failed import never
+ * looks like a usable chain state.
+ */
+bool LoadUTXOSnapshot(const boost::filesystem::path& path, CBlockTreeDB* pblocktreedb, CCoinsViewDB* pcoinsview,
+    CZerocoinDB* pzerocoindb, CUTXOSnapshotInfo& info, std::string& strError);
+
+#endif // BITCOIN_UTXOSNAPSHOT_H
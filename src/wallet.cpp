@@ -638,6 +638,7 @@ void CWallet::MarkDirty()
         BOOST_FOREACH (PAIRTYPE(const uint256, CWalletTx) & item, mapWallet)
             item.second.MarkDirty();
     }
+    MarkBalancesDirty();
 }
 
 bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
@@ -694,6 +695,7 @@ bool CWallet::AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet)
 
         // Break debit/credit balance caches:
         wtx.MarkDirty();
+        MarkBalancesDirty();
 
         // Notify UI of new or updated transaction
         NotifyTransactionChanged(this, hash, fInsertedNew ? CT_NEW : CT_UPDATED);
@@ -746,6 +748,19 @@ void CWallet::SyncTransaction(const CTransaction& tx, const CBlock* pblock)
     }
 }
 
+void CWallet::UpdatedBlockTip(const CBlockIndex* pindex)
+{
+    // Depth decides what is immature or unconfirmed
+    MarkBalancesDirty();
+    fConsolidateTip = true;
+}
+
+void CWallet::NotifyTransactionLock(const CTransaction& tx)
+{
+    // A SwiftX lock makes a transaction trusted
+    MarkBalancesDirty();
+}
+
 void CWallet::EraseFromWallet(const uint256& hash)
 {
     if (!fFileBacked)
@@ -839,7 +854,7 @@ int CWallet::GetRealInputObfuscationRounds(CTxIn in, int rounds) const
         }
 
         bool fAllDenoms = true;
-        BOOST_FOREACH (CTxOut out, wtx->vout) {
+        BOOST_FOREACH (const CTxOut& out, wtx->vout) {
             fAllDenoms = fAllDenoms && IsDenominatedAmount(out.nValue);
         }
         // this one is denominated but there is another non-denominated output found in the same tx
@@ -852,7 +867,7 @@ int CWallet::GetRealInputObfuscationRounds(CTxIn in, int rounds) const
         int nShortest = -10; // an initial value, should be no way to get this by calculations
         bool fDenomFound = false;
         // only denoms here so let's look up
-        BOOST_FOREACH (CTxIn in2, wtx->vin) {
+        BOOST_FOREACH (const CTxIn& in2, wtx->vin) {
             if (IsMine(in2)) {
                 int n = GetRealInputObfuscationRounds(in2, rounds + 1);
                 // denom found, find the shortest chain or initially assign nShortest with the first found value
@@ -1919,6 +1934,49 @@ CAmount CWallet::GetLockedWatchOnlyBalance() const
     return nTotal;
 }
 
+/**
+ * All the balances the GUI shows, in one pass over mapWallet. Each
+ * transaction lands in the same buckets as in GetBalance,
+ * GetUnconfirmedBalance, GetImmatureBalance and their watch-only variants.
+ */
+void CWallet::GetBalances(CWalletBalances& balances) const
+{
+    balances.SetNull();
+    LOCK2(cs_main, cs_wallet);
+    for (map<uint256, CWalletTx>::const_iterator it = mapWallet.begin(); it != mapWallet.end(); ++it) {
+        const CWalletTx* pcoin = &(*it).second;
+        bool fTrusted = pcoin->IsTrusted();
+        if (fTrusted) {
+            balances.nBalance += pcoin->GetAvailableCredit();
+            balances.nWatchOnlyBalance += pcoin->GetAvailableWatchOnlyCredit();
+        }
+        if (!IsFinalTx(*pcoin) || (!fTrusted && pcoin->GetDepthInMainChain() == 0)) {
+            balances.nUnconfirmedBalance += pcoin->GetAvailableCredit();
+            balances.nUnconfirmedWatchOnlyBalance += pcoin->GetAvailableWatchOnlyCredit();
+        }
+        balances.nImmatureBalance += pcoin->GetImmatureCredit();
+        balances.nImmatureWatchOnlyBalance += pcoin->GetImmatureWatchOnlyCredit();
+    }
+
+    balances.nZerocoinBalance = GetZerocoinBalance(false);
+    balances.nUnconfirmedZerocoinBalance = GetUnconfirmedZerocoinBalance();
+    balances.nImmatureZerocoinBalance = balances.nZerocoinBalance - GetZerocoinBalance(true) - balances.nUnconfirmedZerocoinBalance;
+}
+
+/** Recompute the balances and push them to NotifyBalanceChanged if anything they depend on changed */
+void CWallet::NotifyBalancesIfDirty()
+{
+    // Nobody listens without a GUI, leave the flag set for whoever connects
+    if (NotifyBalanceChanged.empty())
+        return;
+    if (!fBalancesDirty.exchange(false))
+        return;
+
+    CWalletBalances balances;
+    GetBalances(balances);
+    NotifyBalanceChanged(this, balances);
+}
+
 /**
  * populate vCoins with vector of available COutputs.
  */
@@ -2961,48 +3019,51 @@ bool CWallet::CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int
 
         //iterates each utxo inside of CheckStakeKernelHash()
         if (Stake(stakeInput.get(), nBits, block.GetBlockTime(), nTxNewTime, hashProofOfStake)) {
-            LOCK(cs_main);
-            //Double check that this will pass time requirements
-            if (nTxNewTime <= chainActive.Tip()->GetMedianTimePast()) {
-                LogPrintf("CreateCoinStake() : kernel found, but it is too far in the past \n");
-                continue;
-            }
+            {
+                LOCK(cs_main);
+                //Double check that this will pass time requirements
+                if (nTxNewTime <= chainActive.Tip()->GetMedianTimePast()) {
+                    LogPrintf("CreateCoinStake() : kernel found, but it is too far in the past \n");
+                    continue;
+                }
 
-            // Found a kernel
-            LogPrintf("CreateCoinStake : kernel found\n");
-            nCredit += stakeInput->GetValue();
+                // Found a kernel
+                LogPrintf("CreateCoinStake : kernel found\n");
+                nCredit += stakeInput->GetValue();
 
-            // Calculate reward
-            CAmount nReward;
-            nReward = GetBlockValue(chainActive.Height() + 1);
-            nCredit += nReward;
+                // Calculate reward
+                CAmount nReward;
+                nReward = GetBlockValue(chainActive.Height() + 1);
+                nCredit += nReward;
 
-            // Create the output transaction(s)
-            vector<CTxOut> vout;
-            if (!stakeInput->CreateTxOuts(this, vout, nCredit)) {
-                LogPrintf("%s : failed to get scriptPubKey\n", __func__);
-                continue;
-            }
-            txNew.vout.insert(txNew.vout.end(), vout.begin(), vout.end());
-
-            CAmount nMinFee = 0;
-            if (!stakeInput->IsZ4XT()) {
-                // Set output amount
-                if (txNew.vout.size() == 3) {
-                    txNew.vout[1].nValue = ((nCredit - nMinFee) / 2 / CENT) * CENT;
-                    txNew.vout[2].nValue = nCredit - nMinFee - txNew.vout[1].nValue;
-                } else
-                    txNew.vout[1].nValue = nCredit - nMinFee;
-            }
+                // Create the output transaction(s)
+                vector<CTxOut> vout;
+                if (!stakeInput->CreateTxOuts(this, vout, nCredit)) {
+                    LogPrintf("%s : failed to get scriptPubKey\n", __func__);
+                    continue;
+                }
+                txNew.vout.insert(txNew.vout.end(), vout.begin(), vout.end());
+
+                CAmount nMinFee = 0;
+                if (!stakeInput->IsZ4XT()) {
+                    // Set output amount
+                    if (txNew.vout.size() == 3) {
+                        txNew.vout[1].nValue = ((nCredit - nMinFee) / 2 / CENT) * CENT;
+                        txNew.vout[2].nValue = nCredit - nMinFee - txNew.vout[1].nValue;
+                    } else
+                        txNew.vout[1].nValue = nCredit - nMinFee;
+                }
 
-            // Limit size
-            unsigned int nBytes = ::GetSerializeSize(txNew, SER_NETWORK, PROTOCOL_VERSION);
-            if (nBytes >= DEFAULT_BLOCK_MAX_SIZE / 5)
-                return error("CreateCoinStake : exceeded coinstake size limit");
+                // Limit size
+                unsigned int nBytes = ::GetSerializeSize(txNew, SER_NETWORK, PROTOCOL_VERSION);
+                if (nBytes >= DEFAULT_BLOCK_MAX_SIZE / 5)
+                    return error("CreateCoinStake : exceeded coinstake size limit");
 
-            //Masternode payment
-            FillBlockPayee(txNew, nMinFee, true, stakeInput->IsZ4XT());
+                //Masternode payment
+                FillBlockPayee(txNew, nMinFee, true, stakeInput->IsZ4XT());
+            }
 
+            // cs_main is released here, the witness of a z4xt stake takes it only while walking the chain
             uint256 hashTxOut = txNew.GetHash();
             CTxIn in;
             if (!stakeInput->CreateTxIn(this, in, hashTxOut)) {
@@ -3587,7 +3648,7 @@ set<set<CTxDestination> > CWallet::GetAddressGroupings()
         if (pcoin->vin.size() > 0) {
             bool any_mine = false;
             // group all input addresses with each other
-            BOOST_FOREACH (CTxIn txin, pcoin->vin) {
+            BOOST_FOREACH (const CTxIn& txin, pcoin->vin) {
                 CTxDestination address;
                 if (!IsMine(txin)) /* If this input isn't mine, ignore it */
                     continue;
@@ -3599,7 +3660,7 @@ set<set<CTxDestination> > CWallet::GetAddressGroupings()
 
             // group change with input addresses
             if (any_mine) {
-                BOOST_FOREACH (CTxOut txout, pcoin->vout)
+                BOOST_FOREACH (const CTxOut& txout, pcoin->vout)
                     if (IsChange(txout)) {
                         CTxDestination txoutAddr;
                         if (!ExtractDestination(txout.scriptPubKey, txoutAddr))
@@ -4050,104 +4111,210 @@ void CWallet::AutoZeromint()
     }
 }
 
-void CWallet::AutoCombineDust()
+/**
+ * Pack the dust of one address into combine transactions. The smallest coins
+ * go first so every transaction removes as many outputs as it can, up to the
+ * threshold or the standard size, and coins worth less than the fee of
+ * spending them are left alone.
+ */
+void CWallet::PackCombinePlans(const CBitcoinAddress& address, vector<COutput> vCoins, CAmount nThreshold, CAmount nInputFee, std::deque<CCombinePlan>& vPlans)
 {
-    LOCK2(cs_main, cs_wallet);
-    if (chainActive.Tip()->nTime < (GetAdjustedTime() - 300) || IsLocked()) {
-        return;
+    sort(vCoins.begin(), vCoins.end(), [](const COutput& a, const COutput& b) { return a.Value() < b.Value(); });
+
+    CCombinePlan plan;
+    plan.address = address;
+    // We don't want the tx to be refused for being too large
+    // we use 50 bytes as a base tx size (2 output: 2*34 + overhead: 10 -> 90 to be certain)
+    unsigned int txSizeEstimate = 90;
+    for (const COutput& out : vCoins) {
+        if (!out.fSpendable || out.Value() <= nInputFee)
+            continue;
+        //no coins should get this far if they dont have proper maturity, this is double checking
+        if (out.tx->IsCoinStake() && out.nDepth < Params().COINBASE_MATURITY() + 1)
+            continue;
+
+        plan.vInputs.push_back(COutPoint(out.tx->GetHash(), out.i));
+        plan.nValue += out.Value();
+        txSizeEstimate += 190;
+
+        // Combine to the threshold and not way above
+        plan.fMaxSize = txSizeEstimate >= MAX_STANDARD_TX_SIZE - 200;
+        if (plan.nValue > nThreshold || plan.fMaxSize) {
+            vPlans.push_back(plan);
+            plan.vInputs.clear();
+            plan.nValue = 0;
+            plan.fMaxSize = false;
+            txSizeEstimate = 90;
+        }
     }
 
-    map<CBitcoinAddress, vector<COutput> > mapCoinsByAddress = AvailableCoinsByAddress(true, nAutoCombineThreshold * COIN);
+    //we cannot combine one coin with itself
+    if (plan.vInputs.size() > 1)
+        vPlans.push_back(plan);
+}
+
+/** Plan the combines of every address holding dust */
+void CWallet::PlanCombineDust()
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    const CAmount nThreshold = nAutoCombineThreshold * COIN;
+    // Around 180 bytes per input. We use 190 to be certain
+    const CAmount nInputFee = minTxFee.GetFee(190);
+
+    map<CBitcoinAddress, vector<COutput> > mapCoinsByAddress = AvailableCoinsByAddress(true, nThreshold);
 
     //coins are sectioned by address. This combination code only wants to combine inputs that belong to the same address
-    for (map<CBitcoinAddress, vector<COutput> >::iterator it = mapCoinsByAddress.begin(); it != mapCoinsByAddress.end(); it++) {
-        vector<COutput> vCoins, vRewardCoins;
-        bool maxSize = false;
-        vCoins = it->second;
-
-        // We don't want the tx to be refused for being too large
-        // we use 50 bytes as a base tx size (2 output: 2*34 + overhead: 10 -> 90 to be certain)
-        unsigned int txSizeEstimate = 90;
-
-        //find masternode rewards that need to be combined
-        CCoinControl* coinControl = new CCoinControl();
-        CAmount nTotalRewardsValue = 0;
-        BOOST_FOREACH (const COutput& out, vCoins) {
-            if (!out.fSpendable)
-                continue;
-            //no coins should get this far if they dont have proper maturity, this is double checking
-            if (out.tx->IsCoinStake() && out.tx->GetDepthInMainChain() < Params().COINBASE_MATURITY() + 1)
-                continue;
+    for (map<CBitcoinAddress, vector<COutput> >::const_iterator it = mapCoinsByAddress.begin(); it != mapCoinsByAddress.end(); it++)
+        PackCombinePlans(it->first, it->second, nThreshold, nInputFee, vCombinePlans);
+}
 
-            COutPoint outpt(out.tx->GetHash(), out.i);
-            coinControl->Select(outpt);
-            vRewardCoins.push_back(out);
-            nTotalRewardsValue += out.Value();
+/** Create and commit one planned combine, CreateTransaction and CommitTransaction take the locks they need */
+bool CWallet::SendCombinePlan(const CCombinePlan& plan, std::string& strErr)
+{
+    CCoinControl coinControl;
+    for (const COutPoint& outpt : plan.vInputs)
+        coinControl.Select(outpt);
 
-            // Combine to the threshold and not way above
-            if (nTotalRewardsValue > nAutoCombineThreshold * COIN)
-                break;
+    vector<pair<CScript, CAmount> > vecSend;
+    CScript scriptPubKey = GetScriptForDestination(plan.address.Get());
+    // 10% safety margin to avoid "Insufficient funds" errors
+    vecSend.push_back(make_pair(scriptPubKey, plan.nValue - (plan.nValue / 10)));
 
-            // Around 180 bytes per input. We use 190 to be certain
-            txSizeEstimate += 190;
-            if (txSizeEstimate >= MAX_STANDARD_TX_SIZE - 200) {
-                maxSize = true;
-                break;
-            }
-        }
+    //Send change to same address
+    coinControl.destChange = plan.address.Get();
 
-        //if no inputs found then return
-        if (!coinControl->HasSelected())
-            continue;
+    // Create the transaction and commit it to the network
+    CWalletTx wtx;
+    CReserveKey keyChange(this); // this change address does not end up being used, because change is returned with coin control switch
+    CAmount nFeeRet = 0;
+    if (!CreateTransaction(vecSend, wtx, keyChange, nFeeRet, strErr, &coinControl, ALL_COINS, false, CAmount(0))) {
+        strErr = "createtransaction failed, reason: " + strErr;
+        return false;
+    }
 
-        //we cannot combine one coin with itself
-        if (vRewardCoins.size() <= 1)
-            continue;
+    //we don't combine below the threshold unless the fees are 0 to avoid paying fees over fees over fees
+    if (!plan.fMaxSize && plan.nValue < nAutoCombineThreshold * COIN && nFeeRet > 0)
+        return false;
 
-        vector<pair<CScript, CAmount> > vecSend;
-        CScript scriptPubKey = GetScriptForDestination(it->first.Get());
-        vecSend.push_back(make_pair(scriptPubKey, nTotalRewardsValue));
+    if (!CommitTransaction(wtx, keyChange)) {
+        strErr = "transaction commit failed";
+        return false;
+    }
+    return true;
+}
 
-        //Send change to same address
-        CTxDestination destMyAddress;
-        if (!ExtractDestination(scriptPubKey, destMyAddress)) {
-            LogPrintf("AutoCombineDust: failed to extract destination\n");
-            continue;
+/**
+ * One round of the dust combiner. The wallet is scanned once per new tip,
+ * when the combines planned at the previous one are all sent, and the plans
+ * are sent until the round has used AUTOCOMBINE_TIME_BUDGET. What is left is
+ * sent by the next rounds, without holding cs_main between transactions.
+ */
+void CWallet::AutoCombineDust(bool fPlan)
+{
+    int64_t nStart = GetTimeMillis();
+    {
+        LOCK2(cs_main, cs_wallet);
+        if (chainActive.Tip()->nTime < (GetAdjustedTime() - 300) || IsLocked()) {
+            vCombinePlans.clear();
+            return;
         }
-        coinControl->destChange = destMyAddress;
 
-        // Create the transaction and commit it to the network
-        CWalletTx wtx;
-        CReserveKey keyChange(this); // this change address does not end up being used, because change is returned with coin control switch
-        string strErr;
-        CAmount nFeeRet = 0;
-
-        // 10% safety margin to avoid "Insufficient funds" errors
-        vecSend[0].second = nTotalRewardsValue - (nTotalRewardsValue / 10);
+        if (fPlan && vCombinePlans.empty()) {
+            PlanCombineDust();
+            autoCombineStatus.nPlannedHeight = chainActive.Height();
+        }
+    }
 
-        if (!CreateTransaction(vecSend, wtx, keyChange, nFeeRet, strErr, coinControl, ALL_COINS, false, CAmount(0))) {
-            LogPrintf("AutoCombineDust createtransaction failed, reason: %s\n", strErr);
-            continue;
+    while (GetTimeMillis() - nStart < AUTOCOMBINE_TIME_BUDGET) {
+        CCombinePlan plan;
+        {
+            LOCK(cs_wallet);
+            if (vCombinePlans.empty())
+                break;
+            plan = vCombinePlans.front();
+            vCombinePlans.pop_front();
         }
 
-        //we don't combine below the threshold unless the fees are 0 to avoid paying fees over fees over fees
-        if (!maxSize && nTotalRewardsValue < nAutoCombineThreshold * COIN && nFeeRet > 0)
-            continue;
+        string strErr;
+        bool fSent = SendCombinePlan(plan, strErr);
 
-        if (!CommitTransaction(wtx, keyChange)) {
-            LogPrintf("AutoCombineDust transaction commit failed\n");
-            continue;
+        LOCK(cs_wallet);
+        if (fSent) {
+            autoCombineStatus.nSent++;
+            autoCombineStatus.nInputsCombined += plan.vInputs.size();
+            autoCombineStatus.nValueCombined += plan.nValue;
+            LogPrintf("AutoCombineDust sent transaction\n");
+        } else if (!strErr.empty()) {
+            autoCombineStatus.strLastError = strErr;
+            LogPrintf("AutoCombineDust %s\n", strErr);
         }
+    }
+
+    LOCK(cs_wallet);
+    autoCombineStatus.nLastRoundTime = GetTime();
+    autoCombineStatus.nLastRoundMillis = GetTimeMillis() - nStart;
+}
+
+unsigned int CWallet::GetPendingCombines() const
+{
+    LOCK(cs_wallet);
+    return vCombinePlans.size();
+}
 
-        LogPrintf("AutoCombineDust sent transaction\n");
+/** Whether a coinstake of ours is in the block at nHeight, whose rewards MultiSend sends once they mature */
+bool CWallet::HasMaturedReward(int nHeight) const
+{
+    AssertLockHeld(cs_main);
+    AssertLockHeld(cs_wallet);
+
+    CBlockIndex* pindex = chainActive[nHeight];
+    if (!pindex)
+        return false;
+    CBlock block;
+    if (!ReadBlockFromDisk(block, pindex))
+        return true; // let the wallet scan decide
 
-        delete coinControl;
+    for (const CTransaction& tx : block.vtx) {
+        if (tx.IsCoinStake() && mapWallet.count(tx.GetHash()))
+            return true;
     }
+    return false;
+}
+
+/** Run MultiSend and the dust combiner after a new tip, from the scheduler thread instead of block processing */
+void CWallet::ConsolidateRewards()
+{
+    bool fNewTip = fConsolidateTip.exchange(false);
+
+    // If turned on MultiSend will send a transaction (or more) on the after maturity of a stake
+    if (fNewTip && isMultiSendEnabled()) {
+        MultiSend();
+    } else if (fNewTip) {
+        // rewards maturing while it is off are not sent once it is turned back on
+        LOCK(cs_wallet);
+        hashMultiSendTip = 0;
+    }
+
+    // If turned on Auto Combine will scan wallet for dust to combine
+    if (fCombineDust && (fNewTip || GetPendingCombines() > 0))
+        AutoCombineDust(fNewTip);
 }
 
 bool CWallet::MultiSend()
 {
     LOCK2(cs_main, cs_wallet);
+    // Rewards mature at every height connected since the last run, which may be several blocks or a reorg ago
+    int nHeightFrom = chainActive.Height();
+    BlockMap::iterator mi = mapBlockIndex.find(hashMultiSendTip);
+    if (mi != mapBlockIndex.end()) {
+        const CBlockIndex* pindexFork = chainActive.FindFork(mi->second);
+        if (pindexFork)
+            nHeightFrom = pindexFork->nHeight + 1;
+    }
+    hashMultiSendTip = chainActive.Tip()->GetBlockHash();
+
     // Stop the old blocks from sending multisends
     if (chainActive.Tip()->nTime < (GetAdjustedTime() - 300) || IsLocked()) {
         return false;
@@ -4158,14 +4325,26 @@ bool CWallet::MultiSend()
         return false;
     }
 
+    // Only outputs that matured at one of those heights are sent, don't scan the wallet if none of ours did
+    bool fMatured = false;
+    for (int nHeight = nHeightFrom; nHeight <= chainActive.Height() && !fMatured; nHeight++)
+        fMatured = HasMaturedReward(nHeight - Params().COINBASE_MATURITY());
+    if (!fMatured)
+        return false;
+
+    const int nDepthMin = Params().COINBASE_MATURITY() + 1;
+    const int nDepthMax = nDepthMin + chainActive.Height() - nHeightFrom;
+
     std::vector<COutput> vCoins;
     AvailableCoins(vCoins);
-    bool stakeSent = false;
-    bool mnSent = false;
+    //one stake and one masternode reward per maturity height, as when MultiSend ran at every block
+    std::set<int> setStakeSent;
+    std::set<int> setMnSent;
     for (const COutput& out : vCoins) {
 
         //need output with precise confirm count - this is how we identify which is the output to send
-        if (out.tx->GetDepthInMainChain() != Params().COINBASE_MATURITY() + 1)
+        int nDepth = out.tx->GetDepthInMainChain();
+        if (nDepth < nDepthMin || nDepth > nDepthMax)
             continue;
 
         COutPoint outpoint(out.tx->GetHash(), out.i);
@@ -4175,6 +4354,10 @@ bool CWallet::MultiSend()
         if (!(sendMSOnStake || sendMSonMNReward))
             continue;
 
+        std::set<int>& setSent = sendMSOnStake ? setStakeSent : setMnSent;
+        if (setSent.count(nDepth))
+            continue;
+
         CTxDestination destMyAddress;
         if (!ExtractDestination(out.tx->vout[out.i].scriptPubKey, destMyAddress)) {
             LogPrintf("Multisend: failed to extract destination\n");
@@ -4246,14 +4429,7 @@ bool CWallet::MultiSend()
         LogPrintf("MultiSend successfully sent\n");
 
         //set which MultiSend triggered
-        if (sendMSOnStake)
-            stakeSent = true;
-        else
-            mnSent = true;
-
-        //stop iterating if we have sent out all the MultiSend(s)
-        if ((stakeSent && mnSent) || (stakeSent && !fMultiSendMasternodeReward) || (mnSent && !fMultiSendStake))
-            return true;
+        setSent.insert(nDepth);
     }
 
     return true;
@@ -4593,8 +4769,12 @@ bool CWallet::MintToTxIn(CZerocoinMint zerocoinSelected, int nSecurityLevel, con
 
     uint32_t nChecksum = GetChecksum(accumulator.getValue());
     CBigNum bnValue;
-    if (!GetAccumulatorValueFromChecksum(nChecksum, false, bnValue) || bnValue == 0)
-        return error("%s: could not find checksum used for spend\n", __func__);
+    {
+        // mapAccumulatorValues is written by block connection
+        LOCK(cs_main);
+        if (!GetAccumulatorValueFromChecksum(nChecksum, false, bnValue) || bnValue == 0)
+            return error("%s: could not find checksum used for spend\n", __func__);
+    }
 
     try {
         libzerocoin::CoinSpend spend(paramsCoin, paramsAccumulator, privateCoin, accumulator, nChecksum, witness, hashTxOut,
@@ -28,6 +28,8 @@
 #include "z4xttracker.h"
 
 #include <algorithm>
+#include <atomic>
+#include <deque>
 #include <map>
 #include <set>
 #include <stdexcept>
@@ -59,6 +61,10 @@ static const CAmount nHighTransactionMaxFeeWarning = 100 * nHighTransactionFeeWa
 static const unsigned int MAX_FREE_TRANSACTION_CREATE_SIZE = 1000;
 //! -custombackupthreshold default
 static const int DEFAULT_CUSTOMBACKUPTHRESHOLD = 1;
+//! Milliseconds between checks whether the GUI balances need recomputing
+static const int64_t WALLET_BALANCE_NOTIFY_INTERVAL = 250;
+//! Milliseconds one round of the dust combiner may spend creating transactions
+static const int64_t AUTOCOMBINE_TIME_BUDGET = 500;
 
 // Zerocoin denomination which creates exactly one of each denominations:
 // 6666 = 1*5000 + 1*1000 + 1*500 + 1*100 + 1*50 + 1*10 + 1*5 + 1
@@ -121,6 +127,81 @@ struct CompactTallyItem {
     }
 };
 
+/** Dust of one address the combiner spends together in one transaction */
+struct CCombinePlan {
+    CBitcoinAddress address;
+    std::vector<COutPoint> vInputs;
+    CAmount nValue;
+    //! stopped adding inputs at the standard transaction size
+    bool fMaxSize;
+
+    CCombinePlan() : nValue(0), fMaxSize(false) {}
+};
+
+/** Progress of the background dust combiner, reported by getautocombinestatus */
+struct CAutoCombineStatus {
+    //! tip height the pending combines were planned at
+    int nPlannedHeight;
+    //! combine transactions sent since startup, and what they spent
+    unsigned int nSent;
+    unsigned int nInputsCombined;
+    CAmount nValueCombined;
+    int64_t nLastRoundTime;
+    int64_t nLastRoundMillis;
+    std::string strLastError;
+
+    CAutoCombineStatus() : nPlannedHeight(-1), nSent(0), nInputsCombined(0), nValueCombined(0), nLastRoundTime(0), nLastRoundMillis(0) {}
+};
+
+/** The balances the GUI shows, computed together in one pass over the wallet */
+struct CWalletBalances {
+    CAmount nBalance;
+    CAmount nUnconfirmedBalance;
+    CAmount nImmatureBalance;
+    CAmount nZerocoinBalance;
+    CAmount nUnconfirmedZerocoinBalance;
+    CAmount nImmatureZerocoinBalance;
+    CAmount nWatchOnlyBalance;
+    CAmount nUnconfirmedWatchOnlyBalance;
+    CAmount nImmatureWatchOnlyBalance;
+
+    CWalletBalances()
+    {
+        SetNull();
+    }
+
+    void SetNull()
+    {
+        nBalance = 0;
+        nUnconfirmedBalance = 0;
+        nImmatureBalance = 0;
+        nZerocoinBalance = 0;
+        nUnconfirmedZerocoinBalance = 0;
+        nImmatureZerocoinBalance = 0;
+        nWatchOnlyBalance = 0;
+        nUnconfirmedWatchOnlyBalance = 0;
+        nImmatureWatchOnlyBalance = 0;
+    }
+
+    friend bool operator==(const CWalletBalances& a, const CWalletBalances& b)
+    {
+        return a.nBalance == b.nBalance &&
+               a.nUnconfirmedBalance == b.nUnconfirmedBalance &&
+               a.nImmatureBalance == b.nImmatureBalance &&
+               a.nZerocoinBalance == b.nZerocoinBalance &&
+               a.nUnconfirmedZerocoinBalance == b.nUnconfirmedZerocoinBalance &&
+               a.nImmatureZerocoinBalance == b.nImmatureZerocoinBalance &&
+               a.nWatchOnlyBalance == b.nWatchOnlyBalance &&
+               a.nUnconfirmedWatchOnlyBalance == b.nUnconfirmedWatchOnlyBalance &&
+               a.nImmatureWatchOnlyBalance == b.nImmatureWatchOnlyBalance;
+    }
+
+    friend bool operator!=(const CWalletBalances& a, const CWalletBalances& b)
+    {
+        return !(a == b);
+    }
+};
+
 /** A key pool entry */
 class CKeyPool
 {
@@ -192,6 +273,20 @@ private:
 
     void SyncMetaData(std::pair<TxSpends::iterator, TxSpends::iterator>);
 
+    //! something a balance depends on changed since the last NotifyBalanceChanged
+    std::atomic<bool> fBalancesDirty;
+
+    //! a block was connected since MultiSend and the dust combiner last looked
+    std::atomic<bool> fConsolidateTip;
+    //! tip MultiSend last ran at, rewards maturing at every height above it are still to send
+    uint256 hashMultiSendTip;
+    //! combines planned from one wallet scan, sent over the next rounds
+    std::deque<CCombinePlan> vCombinePlans;
+
+    bool HasMaturedReward(int nHeight) const;
+    void PlanCombineDust();
+    bool SendCombinePlan(const CCombinePlan& plan, std::string& strErr);
+
 public:
     bool MintableCoins();
     bool SelectStakeCoins(std::list<std::unique_ptr<CStakeInput> >& listInputs, CAmount nTargetAmount);
@@ -271,6 +366,7 @@ public:
     //Auto Combine Inputs
     bool fCombineDust;
     CAmount nAutoCombineThreshold;
+    CAutoCombineStatus autoCombineStatus;
 
     CWallet()
     {
@@ -303,6 +399,9 @@ public:
         nTimeFirstKey = 0;
         fWalletUnlockAnonymizeOnly = false;
         fBackupMints = false;
+        fBalancesDirty = true;
+        fConsolidateTip = false;
+        hashMultiSendTip = 0;
 
         // Stake Settings
         nHashDrift = 45;
@@ -322,6 +421,7 @@ public:
         //Auto Combine Dust
         fCombineDust = false;
         nAutoCombineThreshold = 0;
+        autoCombineStatus = CAutoCombineStatus();
     }
 
     int getZeromintPercentage()
@@ -379,6 +479,7 @@ public:
     void AvailableCoins(std::vector<COutput>& vCoins, bool fOnlyConfirmed = true, const CCoinControl* coinControl = NULL, bool fIncludeZeroValue = false, AvailableCoinsType nCoinType = ALL_COINS, bool fUseIX = false, int nWatchonlyConfig = 1) const;
     std::map<CBitcoinAddress, std::vector<COutput> > AvailableCoinsByAddress(bool fConfirmed = true, CAmount maxCoinValue = 0);
     bool SelectCoinsMinConf(const CAmount& nTargetValue, int nConfMine, int nConfTheirs, std::vector<COutput> vCoins, std::set<std::pair<const CWalletTx*, unsigned int> >& setCoinsRet, CAmount& nValueRet) const;
+    static void PackCombinePlans(const CBitcoinAddress& address, std::vector<COutput> vCoins, CAmount nThreshold, CAmount nInputFee, std::deque<CCombinePlan>& vPlans);
 
     /// Get 1000DASH output and keys which can be used for the Masternode
     bool GetMasternodeVinAndKeys(CTxIn& txinRet, CPubKey& pubKeyRet, CKey& keyRet, std::string strTxHash = "", std::string strOutputIndex = "");
@@ -457,6 +558,8 @@ public:
     void MarkDirty();
     bool AddToWallet(const CWalletTx& wtxIn, bool fFromLoadWallet = false);
     void SyncTransaction(const CTransaction& tx, const CBlock* pblock);
+    void UpdatedBlockTip(const CBlockIndex* pindex);
+    void NotifyTransactionLock(const CTransaction& tx);
     bool AddToWalletIfInvolvingMe(const CTransaction& tx, const CBlock* pblock, bool fUpdate);
     void EraseFromWallet(const uint256& hash);
     int ScanForWalletTransactions(CBlockIndex* pindexStart, bool fUpdate = false);
@@ -480,6 +583,9 @@ public:
     CAmount GetUnconfirmedWatchOnlyBalance() const;
     CAmount GetImmatureWatchOnlyBalance() const;
     CAmount GetLockedWatchOnlyBalance() const;
+    void GetBalances(CWalletBalances& balances) const;
+    void MarkBalancesDirty() { fBalancesDirty = true; }
+    void NotifyBalancesIfDirty();
     bool CreateTransaction(CScript scriptPubKey, int64_t nValue, CWalletTx& wtxNew, CReserveKey& reservekey, int64_t& nFeeRet, std::string& strFailReason, const CCoinControl* coinControl);
     bool CreateTransaction(const std::vector<std::pair<CScript, CAmount> >& vecSend,
         CWalletTx& wtxNew,
@@ -499,7 +605,9 @@ public:
     bool ConvertList(std::vector<CTxIn> vCoins, std::vector<int64_t>& vecAmounts);
     bool CreateCoinStake(const CKeyStore& keystore, unsigned int nBits, int64_t nSearchInterval, CMutableTransaction& txNew, unsigned int& nTxNewTime);
     bool MultiSend();
-    void AutoCombineDust();
+    void AutoCombineDust(bool fPlan);
+    void ConsolidateRewards();
+    unsigned int GetPendingCombines() const;
     void AutoZeromint();
 
     static CFeeRate minTxFee;
@@ -652,6 +760,12 @@ public:
      */
     boost::signals2::signal<void(CWallet* wallet, const uint256& hashTx, ChangeType status)> NotifyTransactionChanged;
 
+    /**
+     * Balances recomputed after something they depend on changed.
+     * @note called from the scheduler thread, without any lock held.
+     */
+    boost::signals2::signal<void(CWallet* wallet, const CWalletBalances& balances)> NotifyBalanceChanged;
+
     /** Show progress e.g. for rescan */
     boost::signals2::signal<void(const std::string& title, int nProgress)> ShowProgress;
 
@@ -12,6 +12,9 @@
 #include "primitives/deterministicmint.h"
 #include "z4xtchain.h"
 
+#include <boost/bind.hpp>
+#include <boost/thread.hpp>
+
 using namespace libzerocoin;
 
 Cz4xtWallet::Cz4xtWallet(std::string strWalletFile)
@@ -121,37 +124,65 @@ void Cz4xtWallet::GenerateMintPool(uint32_t nCountStart, uint32_t nCountEnd)
     if (nCountEnd > 0)
         nStop = std::max(n, n + nCountEnd);
 
-    bool fFound;
+    // counts already in the pool don't need to be derived again
+    std::vector<uint32_t> vCounts;
+    for (uint32_t i = n; i < nStop; ++i) {
+        if (!mintPool.HasCount(i))
+            vCounts.push_back(i);
+    }
+    if (vCounts.empty())
+        return;
 
     uint256 hashSeed = Hash(seedMaster.begin(), seedMaster.end());
     LogPrintf("%s : n=%d nStop=%d\n", __func__, n, nStop - 1);
-    for (uint32_t i = n; i < nStop; ++i) {
-        if (ShutdownRequested())
-            return;
-
-        fFound = false;
 
-        // Prevent unnecessary repeated minted
-        for (auto& pair : mintPool) {
-            if(pair.second == i) {
-                fFound = true;
-                break;
-            }
+    // each count derives independently, spread them over a few threads
+    std::vector<CBigNum> vValues(vCounts.size());
+    std::atomic<size_t> nNext(0);
+    int nThreads = std::min((int)vCounts.size(), std::max(1, std::min((int)boost::thread::hardware_concurrency(), MAX_MINTPOOL_THREADS)));
+    if (nThreads == 1) {
+        DeriveMintValues(vCounts, vValues, nNext);
+    } else {
+        boost::thread_group threadGroup;
+        for (int i = 0; i < nThreads; i++)
+            threadGroup.create_thread(boost::bind(&Cz4xtWallet::DeriveMintValues, this, boost::cref(vCounts), boost::ref(vValues), boost::ref(nNext)));
+        try {
+            threadGroup.join_all();
+        } catch (const boost::thread_interrupted&) {
+            // the workers use our stack, don't leave before they do
+            threadGroup.interrupt_all();
+            threadGroup.join_all();
+            throw;
         }
+    }
 
-        if(fFound)
+    // a single transaction for all the pool entries instead of one per mint
+    CWalletDB walletdb(strWalletFile);
+    walletdb.TxnBegin();
+    for (unsigned int i = 0; i < vCounts.size(); i++) {
+        // left empty when shutdown interrupted the derivation
+        if (vValues[i] == 0)
             continue;
 
-        uint512 seedZerocoin = GetZerocoinSeed(i);
-        CBigNum bnValue;
+        mintPool.Add(vValues[i], vCounts[i]);
+        walletdb.WriteMintPoolPair(hashSeed, GetPubCoinHash(vValues[i]), vCounts[i]);
+        LogPrintf("%s : %s count=%d\n", __func__, vValues[i].GetHex().substr(0, 6), vCounts[i]);
+    }
+    walletdb.TxnCommit();
+}
+
+void Cz4xtWallet::DeriveMintValues(const std::vector<uint32_t>& vCounts, std::vector<CBigNum>& vValues, std::atomic<size_t>& nNext)
+{
+    while (!ShutdownRequested()) {
+        size_t i = nNext++;
+        if (i >= vCounts.size())
+            return;
+
+        uint512 seedZerocoin = GetZerocoinSeed(vCounts[i]);
         CBigNum bnSerial;
         CBigNum bnRandomness;
         CKey key;
-        SeedToZ4XT(seedZerocoin, bnValue, bnSerial, bnRandomness, key);
-
-        mintPool.Add(bnValue, i);
-        CWalletDB(strWalletFile).WriteMintPoolPair(hashSeed, GetPubCoinHash(bnValue), i);
-        LogPrintf("%s : %s count=%d\n", __func__, bnValue.GetHex().substr(0, 6), i);
+        SeedToZ4XT(seedZerocoin, vValues[i], bnSerial, bnRandomness, key);
     }
 }
 
@@ -195,6 +226,15 @@ void Cz4xtWallet::SyncWithChain(bool fGenerateMintPool)
 
         std::set<uint256> setChecked;
         list<pair<uint256,uint32_t> > listMints = mintPool.List();
+
+        // find which of the pool's mints made it to the chain in one pass over the db
+        std::vector<uint256> vHashPubcoins;
+        for (const pair<uint256, uint32_t>& pMint : listMints)
+            vHashPubcoins.push_back(pMint.first);
+        std::map<uint256, uint256> mapMintTx;
+        if (!zerocoinDB->ReadCoinMints(vHashPubcoins, mapMintTx))
+            LogPrintf("%s : failed to read mints from the zerocoin db\n", __func__);
+
         for (pair<uint256, uint32_t> pMint : listMints) {
             LOCK(cs_main);
             if (setChecked.count(pMint.first))
@@ -209,9 +249,9 @@ void Cz4xtWallet::SyncWithChain(bool fGenerateMintPool)
                 continue;
             }
 
-            uint256 txHash;
-            CZerocoinMint mint;
-            if (zerocoinDB->ReadCoinMint(pMint.first, txHash)) {
+            std::map<uint256, uint256>::const_iterator itTx = mapMintTx.find(pMint.first);
+            if (itTx != mapMintTx.end()) {
+                uint256 txHash = itTx->second;
                 //this mint has already occurred on the chain, increment counter's state to reflect this
                 LogPrintf("%s : Found wallet coin mint=%s count=%d tx=%s\n", __func__, pMint.first.GetHex(), pMint.second, txHash.GetHex());
                 found = true;
@@ -373,9 +413,7 @@ void Cz4xtWallet::SeedToZ4XT(const uint512& seedZerocoin, CBigNum& bnValue, CBig
 
     //See if serial and randomness make a valid commitment
     // Generate a Pedersen commitment to the serial number
-    CBigNum commitmentValue = params->coinCommitmentGroup.g.pow_mod(bnSerial, params->coinCommitmentGroup.modulus).mul_mod(
-                        params->coinCommitmentGroup.h.pow_mod(bnRandomness, params->coinCommitmentGroup.modulus),
-                        params->coinCommitmentGroup.modulus);
+    CBigNum commitmentValue = params->coinCommitmentGroup.pow_gh(bnSerial, bnRandomness, params->coinCommitmentGroup.modulus);
 
     CBigNum random;
     uint256 attempts256 = 0;
@@ -396,7 +434,7 @@ void Cz4xtWallet::SeedToZ4XT(const uint512& seedZerocoin, CBigNum& bnValue, CBig
                               attempts256.begin(), attempts256.end());
         random.setuint256(hashRandomness);
         bnRandomness = (bnRandomness + random) % params->coinCommitmentGroup.groupOrder;
-        commitmentValue = commitmentValue.mul_mod(params->coinCommitmentGroup.h.pow_mod(random, params->coinCommitmentGroup.modulus), params->coinCommitmentGroup.modulus);
+        commitmentValue = commitmentValue.mul_mod(params->coinCommitmentGroup.pow_h(random, params->coinCommitmentGroup.modulus), params->coinCommitmentGroup.modulus);
     }
 }
 
@@ -6,7 +6,9 @@
 #ifndef ForexTrading_Z4XTWALLET_H
 #define ForexTrading_Z4XTWALLET_H
 
+#include <atomic>
 #include <map>
+#include <vector>
 #include "libzerocoin/Coin.h"
 #include "mintpool.h"
 #include "uint256.h"
@@ -14,6 +16,9 @@
 
 class CDeterministicMint;
 
+/** Most threads GenerateMintPool derives mints on */
+static const int MAX_MINTPOOL_THREADS = 8;
+
 class Cz4xtWallet
 {
 private:
@@ -44,6 +49,8 @@ public:
 
 private:
     uint512 GetZerocoinSeed(uint32_t n);
+    //! Worker of GenerateMintPool, derives the pubcoin values of vCounts[nNext++] until all are taken
+    void DeriveMintValues(const std::vector<uint32_t>& vCounts, std::vector<CBigNum>& vValues, std::atomic<size_t>& nNext);
 };
 
 #endif //ForexTrading_Z4XTWALLET_H